@@ -1,19 +1,12 @@
-QT += core gui widgets multimedia multimediawidgets network
-
-CONFIG += c++17
-
-# FFmpeg 8.0.1 路徑配置
-FFMPEG_PATH = "C:/Users/ccsto/Downloads/ffmpeg-8.0.1-full_build-shared"
-
-INCLUDEPATH += $${FFMPEG_PATH}/include
-LIBS += -L$${FFMPEG_PATH}/lib \
-        -lavformat \
-        -lavcodec \
-        -lavutil \
-        -lswscale \
-        -lswresample
-
-SOURCES += main.cpp \
-           mainwindow.cpp
-
-HEADERS += mainwindow.h
+# engine: 擷取/錄影引擎（靜態庫）
+# recorderd: 背景錄影服務，只用引擎
+# app: 視窗程式，內嵌同一個引擎
+TEMPLATE = subdirs
+
+SUBDIRS += engine recorderd app
+
+engine.file = engine.pro
+recorderd.file = recorderd.pro
+recorderd.depends = engine
+app.file = app.pro
+app.depends = engine
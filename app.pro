@@ -0,0 +1,36 @@
+# 視窗程式：即時畫面、回放與檔案管理，錄影交給內嵌的引擎
+TEMPLATE = app
+TARGET = Topic
+CONFIG += c++17
+QT += core gui widgets multimedia multimediawidgets network
+
+include(recorderengine.pri)
+
+SOURCES += main.cpp \
+           mainwindow.cpp \
+           livedecoder.cpp \
+           decodescheduler.cpp \
+           mosaicwidget.cpp \
+           recordinglistmodel.cpp \
+           videoframeconverter.cpp \
+           avframevideobuffer.cpp \
+           frameseeker.cpp \
+           timelineplayer.cpp \
+           syncplayback.cpp \
+           syncedviewdecoder.cpp \
+           syncplaybackpage.cpp \
+           eventsearchdialog.cpp
+
+HEADERS += mainwindow.h \
+           livedecoder.h \
+           decodescheduler.h \
+           mosaicwidget.h \
+           recordinglistmodel.h \
+           videoframeconverter.h \
+           avframevideobuffer.h \
+           frameseeker.h \
+           timelineplayer.h \
+           syncplayback.h \
+           syncedviewdecoder.h \
+           syncplaybackpage.h \
+           eventsearchdialog.h
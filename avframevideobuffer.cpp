@@ -0,0 +1,48 @@
+#include "avframevideobuffer.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+AVFrameVideoBuffer::AVFrameVideoBuffer(AVFrame *frame, const QVideoFrameFormat &format)
+    : m_frame(frame), m_format(format) {
+}
+
+AVFrameVideoBuffer::~AVFrameVideoBuffer() {
+    av_frame_free(&m_frame);
+}
+
+QAbstractVideoBuffer::MapData AVFrameVideoBuffer::map(QVideoFrame::MapMode mode) {
+    // 顯示端只讀；緩衝可能與解碼器共用，不提供寫入
+    MapData data;
+    if (mode & QVideoFrame::WriteOnly) return data;
+
+    const QVideoFrameFormat::PixelFormat pixelFormat = m_format.pixelFormat();
+    data.planeCount = pixelFormat == QVideoFrameFormat::Format_NV12 || pixelFormat == QVideoFrameFormat::Format_NV21 ? 2
+                      : pixelFormat == QVideoFrameFormat::Format_Y8 ? 1 : 3;
+    const int chromaHeight = pixelFormat == QVideoFrameFormat::Format_YUV422P ? m_frame->height
+                                                                                : (m_frame->height + 1) / 2;
+    for (int plane = 0; plane < data.planeCount; ++plane) {
+        data.data[plane] = m_frame->data[plane];
+        data.bytesPerLine[plane] = m_frame->linesize[plane];
+        data.dataSize[plane] = m_frame->linesize[plane] * (plane == 0 ? m_frame->height : chromaHeight);
+    }
+    return data;
+}
+
+QVideoFrameFormat::PixelFormat AVFrameVideoBuffer::pixelFormatFor(int avFormat) {
+    switch (avFormat) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        return QVideoFrameFormat::Format_YUV420P;
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUVJ422P:
+        return QVideoFrameFormat::Format_YUV422P;
+    case AV_PIX_FMT_NV12:
+        return QVideoFrameFormat::Format_NV12;
+    case AV_PIX_FMT_NV21:
+        return QVideoFrameFormat::Format_NV21;
+    case AV_PIX_FMT_GRAY8:
+        return QVideoFrameFormat::Format_Y8;
+    default:
+        return QVideoFrameFormat::Format_Invalid;
+    }
+}
+#endif
@@ -0,0 +1,32 @@
+#ifndef AVFRAMEVIDEOBUFFER_H
+#define AVFRAMEVIDEOBUFFER_H
+
+#include <QtGlobal>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QAbstractVideoBuffer>
+#include <QVideoFrameFormat>
+
+#include "ffmpegutils.h"
+
+// 直接把 AVFrame 的平面交給 QVideoFrame，不複製像素
+// 只持有 AVFrame 的參考，QVideoFrame 放掉後緩衝才回到解碼器或轉換用的緩衝池
+class AVFrameVideoBuffer : public QAbstractVideoBuffer {
+public:
+    // 接管 frame（之後由這個物件釋放）；格式必須是 pixelFormatFor() 認得的
+    AVFrameVideoBuffer(AVFrame *frame, const QVideoFrameFormat &format);
+    ~AVFrameVideoBuffer() override;
+
+    MapData map(QVideoFrame::MapMode mode) override;
+    QVideoFrameFormat format() const override { return m_format; }
+
+    // 可直接顯示的格式；其他格式回傳 Format_Invalid，要先轉成 YUV420P
+    static QVideoFrameFormat::PixelFormat pixelFormatFor(int avFormat);
+
+private:
+    AVFrame *m_frame;
+    QVideoFrameFormat m_format;
+};
+#endif
+
+#endif // AVFRAMEVIDEOBUFFER_H
@@ -0,0 +1,388 @@
+#include "clipexporter.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QScopeGuard>
+#include <QDebug>
+#include <cstring>
+
+#include "keyframeindex.h"
+
+enum ClipTrack { VideoTrack = 0, AudioTrack = 1 };
+
+// 轉碼器輸出的 Annex B（起始碼）改成 MP4 的長度前綴格式
+static QByteArray annexBToLengthPrefixed(const uint8_t *data, int size, int lengthSize) {
+    auto findStart = [data, size](int from) {
+        for (int i = from; i + 3 <= size; ++i)
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) return i;
+        return size;
+    };
+
+    QByteArray out;
+    int start = findStart(0);
+    while (start < size) {
+        const int nal = start + 3;
+        const int next = findStart(nal);
+        int end = next;
+        while (end > nal && data[end - 1] == 0) --end;     // 4 bytes 起始碼多出的 0
+        const int length = end - nal;
+        for (int b = lengthSize - 1; b >= 0; --b) out.append(char((length >> (8 * b)) & 0xFF));
+        out.append(reinterpret_cast<const char *>(data + nal), length);
+        start = next;
+    }
+    return out;
+}
+
+// 來源的 SPS/PPS 換成與封包相同的格式：avcC 拆成長度前綴，Annex B 的 extradata 原樣使用
+static QByteArray sourceParameterSets(const AVCodecParameters *par, int lengthSize) {
+    const uint8_t *data = par->extradata;
+    const int size = par->extradata_size;
+    if (!data || size <= 0) return QByteArray();
+    if (lengthSize == 0) return QByteArray(reinterpret_cast<const char *>(data), size);
+
+    // avcC：5 bytes 表頭，接著 SPS 個數與各 SPS、PPS 個數與各 PPS，每個前面 2 bytes 長度
+    QByteArray out;
+    int pos = 5;
+    for (int list = 0; list < 2; ++list) {
+        if (pos >= size) return QByteArray();
+        const int count = list == 0 ? (data[pos] & 0x1F) : data[pos];
+        ++pos;
+        for (int i = 0; i < count; ++i) {
+            if (pos + 2 > size) return QByteArray();
+            const int length = (data[pos] << 8) | data[pos + 1];
+            pos += 2;
+            if (pos + length > size) return QByteArray();
+            for (int b = lengthSize - 1; b >= 0; --b) out.append(char((length >> (8 * b)) & 0xFF));
+            out.append(reinterpret_cast<const char *>(data + pos), length);
+            pos += length;
+        }
+    }
+    return out;
+}
+
+static bool prependToPacket(AVPacket *packet, const QByteArray &prefix) {
+    AVPacket *merged = av_packet_alloc();
+    if (!merged || av_new_packet(merged, int(prefix.size()) + packet->size) < 0) {
+        av_packet_free(&merged);
+        return false;
+    }
+    std::memcpy(merged->data, prefix.constData(), size_t(prefix.size()));
+    std::memcpy(merged->data + prefix.size(), packet->data, size_t(packet->size));
+    av_packet_copy_props(merged, packet);
+    av_packet_unref(packet);
+    av_packet_move_ref(packet, merged);
+    av_packet_free(&merged);
+    return true;
+}
+
+ClipExporter::ClipExporter(const ClipRequest &request, QObject *parent)
+    : QThread(parent), m_request(request) {
+}
+
+ClipExporter::~ClipExporter() {
+    cancel();
+    wait();
+}
+
+void ClipExporter::run() {
+    m_packet = av_packet_alloc();
+
+    QString error;
+    const bool ok = exportClip(&error);
+
+    m_headTranscoder.reset();
+    if (m_output) {
+        if (m_output->pb) avio_closep(&m_output->pb);
+        avformat_free_context(m_output);
+        m_output = nullptr;
+    }
+    av_packet_free(&m_packet);
+
+    if (!ok) {
+        QFile::remove(m_request.outputPath);
+        emit failed(error);
+        return;
+    }
+    emit exported(m_request.outputPath, QFileInfo(m_request.outputPath).size(), m_lastWrittenMs - m_originMs);
+}
+
+bool ClipExporter::exportClip(QString *error) {
+    QVector<int> parts;
+    for (int i = 0; i < m_request.segments.size(); ++i) {
+        if (m_request.segments[i].startMs < m_request.outMs
+            && segmentEndMs(m_request.segments, i) > m_request.inMs) parts.append(i);
+    }
+    if (parts.isEmpty()) {
+        *error = "選擇的區間內沒有錄影";
+        return false;
+    }
+
+    for (int i = 0; i < parts.size(); ++i) {
+        if (m_cancelled) {
+            *error = "已取消";
+            return false;
+        }
+        if (!copySegment(parts[i], i == 0, error)) return false;
+    }
+
+    if (!m_clipStarted) {
+        *error = "區間內找不到可用的關鍵幀";
+        return false;
+    }
+    int ret = av_write_trailer(m_output);
+    if (ret < 0) {
+        *error = "寫入檔尾失敗: " + avErrorString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool ClipExporter::openInput(int segment, Input *input, QString *error) {
+    const QString path = recordingFilePath(m_request.directory, m_request.segments[segment].fileName);
+    int ret = avformat_open_input(&input->format, path.toUtf8().constData(), nullptr, nullptr);
+    if (ret < 0 || avformat_find_stream_info(input->format, nullptr) < 0) {
+        *error = QString("無法開啟 %1: %2").arg(m_request.segments[segment].fileName, avErrorString(ret));
+        return false;
+    }
+    input->video = av_find_best_stream(input->format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    input->audio = av_find_best_stream(input->format, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (input->video < 0) {
+        *error = QString("%1 沒有影像軌").arg(m_request.segments[segment].fileName);
+        return false;
+    }
+    return true;
+}
+
+bool ClipExporter::openOutput(const Input &input, QString *error) {
+    int ret = avformat_alloc_output_context2(&m_output, nullptr, "mp4", m_request.outputPath.toUtf8().constData());
+    if (ret < 0 || !m_output) {
+        *error = "無法建立輸出: " + avErrorString(ret);
+        return false;
+    }
+
+    const int sources[2] = {input.video, input.audio};
+    for (int track = VideoTrack; track <= AudioTrack; ++track) {
+        if (sources[track] < 0) continue;
+        AVStream *in = input.format->streams[sources[track]];
+        AVStream *out = avformat_new_stream(m_output, nullptr);
+        avcodec_parameters_copy(out->codecpar, in->codecpar);
+        out->codecpar->codec_tag = 0;
+        out->time_base = in->time_base;
+        m_outputIndex[track] = out->index;
+    }
+
+    // 來源是 MP4 時參數集在 avcC 裡，轉碼出來的封包也要用同樣的長度前綴
+    const AVCodecParameters *video = input.format->streams[input.video]->codecpar;
+    if (video->codec_id == AV_CODEC_ID_H264 && video->extradata_size > 4 && video->extradata[0] == 1)
+        m_nalLengthSize = (video->extradata[4] & 0x03) + 1;
+
+    ret = avio_open(&m_output->pb, m_request.outputPath.toUtf8().constData(), AVIO_FLAG_WRITE);
+    if (ret < 0) {
+        *error = "無法寫入檔案: " + avErrorString(ret);
+        return false;
+    }
+    ret = avformat_write_header(m_output, nullptr);
+    if (ret < 0) {
+        *error = "寫入檔頭失敗: " + avErrorString(ret);
+        return false;
+    }
+    return true;
+}
+
+bool ClipExporter::copySegment(int segment, bool first, QString *error) {
+    const RecordingEntry &entry = m_request.segments[segment];
+    Input input;
+    if (!openInput(segment, &input, error)) {
+        avformat_close_input(&input.format);
+        // 中間某段壞掉就跳過，第一段開不了才算失敗
+        if (first) return false;
+        qDebug() << "匯出略過無法開啟的分段:" << *error;
+        return true;
+    }
+    auto closeInput = qScopeGuard([&input]() { avformat_close_input(&input.format); });
+
+    AVStream *videoStream = input.format->streams[input.video];
+    if (!m_output) {
+        if (!openOutput(input, error)) return false;
+    } else {
+        const AVCodecParameters *now = videoStream->codecpar;
+        const AVCodecParameters *was = m_output->streams[m_outputIndex[VideoTrack]]->codecpar;
+        if (now->codec_id != was->codec_id || now->width != was->width || now->height != was->height) {
+            *error = QString("%1 的影像格式與前面不同，無法無損接合").arg(entry.fileName);
+            return false;
+        }
+    }
+    if (m_outputIndex[AudioTrack] < 0) input.audio = -1;
+
+    const AVRational msBase{1, 1000};
+    const int64_t videoStart = videoStream->start_time != AV_NOPTS_VALUE ? videoStream->start_time : 0;
+    const qint64 fromMs = first ? qMax<qint64>(0, m_request.inMs - entry.startMs) : 0;
+    const int64_t fromPts = videoStart + av_rescale_q(fromMs, msBase, videoStream->time_base);
+
+    if (first && fromMs > 0) {
+        // 依關鍵幀索引直接跳到開頭之前的關鍵幀
+        const QString path = recordingFilePath(m_request.directory, entry.fileName);
+        KeyframeIndex index = KeyframeIndex::load(path);
+        int key = index.floor(fromMs);
+        if (key >= 0 && qstrcmp(input.format->iformat->name, "mpegts") == 0 && index.entries()[key].position >= 0) {
+            av_seek_frame(input.format, -1, index.entries()[key].position, AVSEEK_FLAG_BYTE);
+        } else {
+            qint64 target = key >= 0 ? index.entries()[key].timeMs : fromMs;
+            av_seek_frame(input.format, input.video,
+                          videoStart + av_rescale_q(target, msBase, videoStream->time_base), AVSEEK_FLAG_BACKWARD);
+        }
+    }
+
+    bool started = false;
+    bool transcoding = false;
+    int64_t headKeyPts = AV_NOPTS_VALUE;
+    int lastPercent = -1;
+
+    while (!m_cancelled && av_read_frame(input.format, m_packet) >= 0) {
+        const int track = m_packet->stream_index == input.video ? VideoTrack
+                        : m_packet->stream_index == input.audio ? AudioTrack : -1;
+        if (track < 0) {
+            av_packet_unref(m_packet);
+            continue;
+        }
+
+        AVStream *stream = input.format->streams[m_packet->stream_index];
+        const int64_t streamStart = av_rescale_q(videoStart, videoStream->time_base, stream->time_base);
+        const int64_t pts = m_packet->pts != AV_NOPTS_VALUE ? m_packet->pts : m_packet->dts;
+        const int64_t dts = m_packet->dts != AV_NOPTS_VALUE ? m_packet->dts : pts;
+        const qint64 packetMs = entry.startMs + av_rescale_q(pts - streamStart, stream->time_base, msBase);
+        const qint64 decodeMs = entry.startMs + av_rescale_q(dts - streamStart, stream->time_base, msBase);
+
+        if (decodeMs > m_request.outMs) {
+            av_packet_unref(m_packet);
+            if (track == VideoTrack) break;
+            continue;
+        }
+
+        if (!started) {
+            // 從第一個影像關鍵幀開始
+            if (track != VideoTrack || !(m_packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(m_packet);
+                continue;
+            }
+            started = true;
+            if (!m_clipStarted) {
+                m_clipStarted = true;
+                if (first && m_request.smartStart && pts < fromPts) {
+                    IngestLayout layout = makeIngestLayout(input.format);
+                    QString transcodeError;
+                    m_headTranscoder = std::make_unique<TrackTranscoder>();
+                    // 編碼器的 SPS/PPS 放在封包裡，id 與來源相同會蓋掉檔頭的參數集；
+                    // 接回直接複製時要再送一次來源的，拿不到就不做
+                    m_parameterSets = sourceParameterSets(videoStream->codecpar, m_nalLengthSize);
+                    if (m_parameterSets.isEmpty()) transcodeError = "來源沒有可用的 SPS/PPS";
+                    if (!m_parameterSets.isEmpty() && videoStream->codecpar->codec_id == AV_CODEC_ID_H264
+                        && m_headTranscoder->open(layout[input.video], false, &transcodeError)) {
+                        m_headTranscoder->setVideoStartPts(fromPts);
+                        transcoding = true;
+                        headKeyPts = pts;
+                    } else {
+                        qDebug() << "無法重新編碼開頭，改從關鍵幀開始:" << transcodeError;
+                        m_headTranscoder.reset();
+                    }
+                }
+                m_originMs = transcoding ? entry.startMs + fromMs : packetMs;
+            }
+            input.offset[VideoTrack] = videoStart + av_rescale_q(m_originMs - entry.startMs, msBase, videoStream->time_base);
+            if (input.audio >= 0) {
+                AVStream *audioStream = input.format->streams[input.audio];
+                input.offset[AudioTrack] = av_rescale_q(videoStart, videoStream->time_base, audioStream->time_base)
+                    + av_rescale_q(m_originMs - entry.startMs, msBase, audioStream->time_base);
+            }
+        }
+
+        if (transcoding && track == VideoTrack) {
+            if (!(m_packet->flags & AV_PKT_FLAG_KEY) || pts == headKeyPts) {
+                // 第一個不完整的 GOP：解碼後只編碼開頭之後的畫面
+                m_headTranscoder->transcode(m_packet, [&](const AVPacket *encoded) {
+                    writeTranscoded(encoded, videoStream->time_base, input.offset[VideoTrack]);
+                });
+                av_packet_unref(m_packet);
+                continue;
+            }
+            // 到下一個關鍵幀，之後直接複製
+            m_headTranscoder->flush([&](const AVPacket *encoded) {
+                writeTranscoded(encoded, videoStream->time_base, input.offset[VideoTrack]);
+            });
+            m_headTranscoder.reset();
+            transcoding = false;
+            // 第一個直接複製的關鍵幀前面補上來源的參數集，後面的畫面才不會用到編碼器的
+            if (!prependToPacket(m_packet, m_parameterSets)) {
+                av_packet_unref(m_packet);
+                *error = "無法接合重新編碼的開頭";
+                return false;
+            }
+        }
+
+        if (packetMs < m_originMs && track == AudioTrack) {
+            av_packet_unref(m_packet);
+            continue;
+        }
+        writePacket(track, m_packet, stream->time_base, input.offset[track]);
+
+        const qint64 span = qMax<qint64>(1, m_request.outMs - m_originMs);
+        const int percent = int(qBound<qint64>(0, (packetMs - m_originMs) * 100 / span, 100));
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit progress(percent);
+        }
+    }
+
+    // 整個片段都在第一個 GOP 裡
+    if (transcoding) {
+        m_headTranscoder->flush([&](const AVPacket *encoded) {
+            writeTranscoded(encoded, videoStream->time_base, input.offset[VideoTrack]);
+        });
+        m_headTranscoder.reset();
+    }
+    if (m_cancelled) {
+        *error = "已取消";
+        return false;
+    }
+    return true;
+}
+
+void ClipExporter::writePacket(int track, AVPacket *packet, AVRational inputTimeBase, int64_t offset) {
+    if (packet->pts != AV_NOPTS_VALUE) packet->pts -= offset;
+    if (packet->dts != AV_NOPTS_VALUE) packet->dts -= offset;
+
+    AVStream *stream = m_output->streams[m_outputIndex[track]];
+    av_packet_rescale_ts(packet, inputTimeBase, stream->time_base);
+
+    // 跨分段時 dts 必須遞增
+    if (packet->dts != AV_NOPTS_VALUE) {
+        if (m_lastDts[track] != AV_NOPTS_VALUE && packet->dts <= m_lastDts[track]) packet->dts = m_lastDts[track] + 1;
+        if (packet->pts != AV_NOPTS_VALUE && packet->pts < packet->dts) packet->pts = packet->dts;
+        m_lastDts[track] = packet->dts;
+    }
+    if (track == VideoTrack && packet->pts != AV_NOPTS_VALUE) {
+        m_lastWrittenMs = qMax(m_lastWrittenMs,
+                               m_originMs + av_rescale_q(packet->pts + packet->duration, stream->time_base, AVRational{1, 1000}));
+    }
+
+    packet->stream_index = m_outputIndex[track];
+    packet->pos = -1;
+    int ret = av_interleaved_write_frame(m_output, packet);
+    if (ret < 0) qDebug() << "匯出寫入封包失敗:" << avErrorString(ret);
+}
+
+void ClipExporter::writeTranscoded(const AVPacket *packet, AVRational inputTimeBase, int64_t offset) {
+    AVPacket *copy = av_packet_alloc();
+    if (m_nalLengthSize > 0) {
+        const QByteArray data = annexBToLengthPrefixed(packet->data, packet->size, m_nalLengthSize);
+        if (av_new_packet(copy, int(data.size())) < 0) {
+            av_packet_free(&copy);
+            return;
+        }
+        std::memcpy(copy->data, data.constData(), size_t(data.size()));
+        av_packet_copy_props(copy, packet);
+    } else {
+        av_packet_ref(copy, packet);
+    }
+    writePacket(VideoTrack, copy, inputTimeBase, offset);
+    av_packet_free(&copy);
+}
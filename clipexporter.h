@@ -0,0 +1,72 @@
+#ifndef CLIPEXPORTER_H
+#define CLIPEXPORTER_H
+
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+#include "ffmpegutils.h"
+#include "recordingindex.h"
+#include "tracktranscoder.h"
+
+// 匯出的片段：同一台攝影機的分段，實際時間區間可以跨分段
+struct ClipRequest {
+    QString directory;
+    QVector<RecordingEntry> segments;   // 依開始時間排序
+    qint64 inMs = 0;                    // epoch 毫秒
+    qint64 outMs = 0;
+    QString outputPath;
+    // 開頭不在關鍵幀上時，只把第一個不完整的 GOP 重新編碼；否則從前一個關鍵幀開始
+    bool smartStart = false;
+};
+
+// 無損匯出片段：直接複製封包 remux 成一個 MP4，不解碼，速度接近複製檔案
+// 開頭對齊到關鍵幀，跨分段時時間戳接續；選擇 smartStart 時只有開頭那一小段經過轉碼
+class ClipExporter : public QThread {
+    Q_OBJECT
+public:
+    explicit ClipExporter(const ClipRequest &request, QObject *parent = nullptr);
+    ~ClipExporter() override;
+
+    void cancel() { m_cancelled = true; }
+
+signals:
+    void progress(int percent);
+    void exported(const QString &filePath, qint64 bytes, qint64 durationMs);
+    void failed(const QString &error);
+
+protected:
+    void run() override;
+
+private:
+    struct Input {
+        AVFormatContext *format = nullptr;
+        int video = -1;
+        int audio = -1;
+        int64_t offset[2] = {0, 0};     // 各軌道（影像、音訊）換算到片段時間的位移，輸入時間基準
+    };
+
+    bool exportClip(QString *error);
+    bool openInput(int segment, Input *input, QString *error);
+    bool openOutput(const Input &input, QString *error);
+    bool copySegment(int segment, bool first, QString *error);
+    void writePacket(int track, AVPacket *packet, AVRational inputTimeBase, int64_t offset);
+    void writeTranscoded(const AVPacket *packet, AVRational inputTimeBase, int64_t offset);
+
+    ClipRequest m_request;
+    std::atomic_bool m_cancelled{false};
+
+    AVFormatContext *m_output = nullptr;
+    AVPacket *m_packet = nullptr;
+    int m_outputIndex[2] = {-1, -1};    // 影像、音訊的輸出軌道
+    int64_t m_lastDts[2] = {AV_NOPTS_VALUE, AV_NOPTS_VALUE};   // 輸出時間基準
+    bool m_clipStarted = false;
+    qint64 m_originMs = 0;              // 片段第一張畫面的實際時間
+    qint64 m_lastWrittenMs = 0;
+    int m_nalLengthSize = 0;            // 輸出為 avcC 時轉碼封包要改成長度前綴
+    std::unique_ptr<TrackTranscoder> m_headTranscoder;
+    QByteArray m_parameterSets;         // 來源的 SPS/PPS，接在重新編碼的開頭之後的第一個關鍵幀前面
+};
+
+#endif // CLIPEXPORTER_H
@@ -0,0 +1,117 @@
+#include "decodescheduler.h"
+#include <QScrollArea>
+#include <QScrollBar>
+#include <QStackedWidget>
+#include <QEvent>
+
+// 頁面索引與 MainWindow::setupUi 的順序一致
+static const int kGridPage = 0;
+static const int kFocusPage = 1;
+
+DecodeScheduler::DecodeScheduler(QWidget *window, QScrollArea *gridArea, QStackedWidget *pages, QObject *parent)
+    : QObject(parent), m_window(window), m_gridArea(gridArea), m_pages(pages) {
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(100);
+    connect(&m_timer, &QTimer::timeout, this, &DecodeScheduler::update);
+
+    connect(m_pages, &QStackedWidget::currentChanged, this, &DecodeScheduler::schedule);
+    connect(m_gridArea->verticalScrollBar(), &QScrollBar::valueChanged, this, &DecodeScheduler::schedule);
+    connect(m_gridArea->horizontalScrollBar(), &QScrollBar::valueChanged, this, &DecodeScheduler::schedule);
+
+    m_window->installEventFilter(this);
+    m_gridArea->viewport()->installEventFilter(this);
+}
+
+void DecodeScheduler::addTile(QWidget *tile, const std::shared_ptr<LiveDecoder> &gridDecoder,
+                              const std::shared_ptr<LiveDecoder> &focusDecoder) {
+    m_tiles.append(Tile{tile, gridDecoder, focusDecoder});
+    tile->installEventFilter(this);
+    schedule();
+}
+
+void DecodeScheduler::removeTile(QWidget *tile) {
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        if (m_tiles[i].widget == tile) {
+            m_tiles.removeAt(i);
+            break;
+        }
+    }
+    if (m_focusedTile == tile) m_focusedTile = nullptr;
+    schedule();
+}
+
+void DecodeScheduler::setMosaic(QWidget *mosaic) {
+    m_mosaic = mosaic;
+    m_mosaic->installEventFilter(this);
+    schedule();
+}
+
+void DecodeScheduler::setGridFrameRate(double fps) {
+    m_gridFrameRate = fps;
+    schedule();
+}
+
+void DecodeScheduler::setGridKeyFramesOnly(bool enabled) {
+    m_gridKeyFramesOnly = enabled;
+    schedule();
+}
+
+void DecodeScheduler::setFocusedTile(QWidget *tile) {
+    m_focusedTile = tile;
+    schedule();
+}
+
+void DecodeScheduler::schedule() {
+    if (!m_timer.isActive()) m_timer.start();
+}
+
+bool DecodeScheduler::eventFilter(QObject *watched, QEvent *event) {
+    switch (event->type()) {
+    case QEvent::Resize:
+    case QEvent::Move:
+    case QEvent::Show:
+    case QEvent::Hide:
+    case QEvent::WindowStateChange:
+        schedule();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+bool DecodeScheduler::isOnScreen(QWidget *tile) const {
+    QWidget *viewport = m_gridArea->viewport();
+    if (!tile->isVisible() || !viewport->isAncestorOf(tile)) return false;
+
+    QRect rect(tile->mapTo(viewport, QPoint(0, 0)), tile->size());
+    return rect.intersects(viewport->rect());
+}
+
+void DecodeScheduler::update() {
+    const bool minimized = m_window->isMinimized() || !m_window->isVisible();
+    const int page = m_pages->currentIndex();
+    const bool mosaic = m_mosaic && !m_mosaic->isHidden();
+
+    for (const Tile &tile : std::as_const(m_tiles)) {
+        if (!tile.widget) continue;
+
+        const bool focused = !minimized && page == kFocusPage && tile.widget == m_focusedTile;
+        const bool gridVisible = !minimized && page == kGridPage && (mosaic || isOnScreen(tile.widget));
+
+        if (tile.gridDecoder == tile.focusDecoder) {
+            LiveDecoder *decoder = tile.gridDecoder.get();
+            decoder->setActive(focused || gridVisible);
+            decoder->setReducedDecode(!focused);
+            decoder->setKeyFramesOnly(!focused && m_gridKeyFramesOnly);
+            decoder->setMaxFrameRate(focused ? 0 : m_gridFrameRate);
+            decoder->setMaxOutputSize(focused ? QSize() : tile.widget->size() * tile.widget->devicePixelRatioF());
+        } else {
+            // 子碼流本身就小，照常解碼；主碼流只在放大時解
+            tile.gridDecoder->setActive(gridVisible);
+            tile.gridDecoder->setMaxFrameRate(m_gridFrameRate);
+            tile.gridDecoder->setMaxOutputSize(tile.widget->size() * tile.widget->devicePixelRatioF());
+            tile.focusDecoder->setActive(focused);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QList>
+#include <memory>
+
+#include "livedecoder.h"
+
+class QScrollArea;
+class QStackedWidget;
+
+// 依畫面可見度開關即時解碼：捲出畫面、被放大頁或管理頁蓋住的格子不解碼
+// 九宮格只解到格子大小，全解析度只留給放大的那一格；只影響顯示，錄影走另一個接收端不受影響
+class DecodeScheduler : public QObject {
+    Q_OBJECT
+public:
+    DecodeScheduler(QWidget *window, QScrollArea *gridArea, QStackedWidget *pages, QObject *parent = nullptr);
+
+    // gridDecoder 在九宮格顯示（有子碼流時解子碼流），focusDecoder 只在放大時解碼；
+    // 沒有子碼流時兩者相同，九宮格改用省電解碼
+    void addTile(QWidget *tile, const std::shared_ptr<LiveDecoder> &gridDecoder,
+                 const std::shared_ptr<LiveDecoder> &focusDecoder);
+    void removeTile(QWidget *tile);
+    // 九宮格改用合成牆時，所有格子都在畫面內
+    void setMosaic(QWidget *mosaic);
+    // 九宮格每格的顯示幀率上限，放大的那一格不受限；0 表示不限
+    void setGridFrameRate(double fps);
+    // 沒有子碼流的格子只解關鍵幀（一個 GOP 更新一次），CPU 不夠時才開
+    void setGridKeyFramesOnly(bool enabled);
+    // 放大畫面時指定該格，回到九宮格時傳 nullptr
+    void setFocusedTile(QWidget *tile);
+
+    // 合併短時間內的多次變動，只重新計算一次
+    void schedule();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    struct Tile {
+        QPointer<QWidget> widget;
+        std::shared_ptr<LiveDecoder> gridDecoder;
+        std::shared_ptr<LiveDecoder> focusDecoder;
+    };
+
+    void update();
+    bool isOnScreen(QWidget *tile) const;
+
+    QWidget *m_window;
+    QScrollArea *m_gridArea;
+    QStackedWidget *m_pages;
+    QPointer<QWidget> m_mosaic;
+    QPointer<QWidget> m_focusedTile;
+    QList<Tile> m_tiles;
+    double m_gridFrameRate = 0;
+    bool m_gridKeyFramesOnly = false;
+    QTimer m_timer;
+};
+
+#endif // DECODESCHEDULER_H
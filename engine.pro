@@ -0,0 +1,61 @@
+# 擷取/錄影引擎：不含任何介面，背景服務與視窗程式都連結它
+TEMPLATE = lib
+TARGET = recorderengine
+CONFIG += staticlib c++17
+QT = core gui network
+DESTDIR = $$OUT_PWD
+
+include(ffmpeg.pri)
+
+SOURCES += recorderengine.cpp \
+           streamingest.cpp \
+           packetringbuffer.cpp \
+           streamrecorder.cpp \
+           streamprobe.cpp \
+           tracktranscoder.cpp \
+           transcodepool.cpp \
+           recordingcontroller.cpp \
+           recordingindex.cpp \
+           thumbnailstore.cpp \
+           keyframeindex.cpp \
+           clipexporter.cpp \
+           motiondetector.cpp \
+           motionrecorder.cpp \
+           eventindex.cpp \
+           segmentfile.cpp \
+           storagecleaner.cpp \
+           storagemanager.cpp \
+           sinkqueue.cpp \
+           relaychannel.cpp \
+           relaysink.cpp \
+           relayserver.cpp \
+           streammetrics.cpp \
+           metricssampler.cpp
+
+HEADERS += recorderengine.h \
+           ffmpegutils.h \
+           streamingest.h \
+           packetringbuffer.h \
+           streamrecorder.h \
+           streamprobe.h \
+           tracktranscoder.h \
+           transcodepool.h \
+           recordingcontroller.h \
+           recordingindex.h \
+           thumbnailstore.h \
+           keyframeindex.h \
+           clipexporter.h \
+           motiondetector.h \
+           motionrecorder.h \
+           eventindex.h \
+           segmentfile.h \
+           storagecleaner.h \
+           storagemanager.h \
+           packetsink.h \
+           spscqueue.h \
+           sinkqueue.h \
+           relaychannel.h \
+           relaysink.h \
+           relayserver.h \
+           streammetrics.h \
+           metricssampler.h
@@ -0,0 +1,211 @@
+#include "eventindex.h"
+#include "motiondetector.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QScopeGuard>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+// 檔頭之後是網址（UTF-8），紀錄從 dataOffset 開始；全部以本機位元組序寫入
+struct EventFileHeader {
+    quint32 magic;
+    quint16 version;
+    quint16 recordSize;
+    quint32 dataOffset;     // 對齊到紀錄大小，mmap 後可以直接當陣列用
+    quint32 urlBytes;
+};
+
+struct EventRecord {
+    enum Type : quint8 { Activity = 0, Motion = 1 };
+
+    qint64 startMs;
+    qint64 endMs;
+    quint64 regions;
+    quint8 type;
+    quint8 peak;
+    quint8 reserved[6];
+};
+
+static_assert(sizeof(EventRecord) == 32, "事件紀錄必須是固定 32 位元組");
+
+static const quint32 kEventMagic = 0x31495645;   // "EVI1"
+static const quint16 kEventVersion = 1;
+static const char *kEventsDirName = "events";
+// 偵測端會把長事件切段，單筆紀錄不超過這個長度；搜尋時往後多看這麼多才不會漏掉
+static const qint64 kMaxRecordSpanMs = 15 * 60 * 1000;
+// 紀錄依寫入順序排列，結束時間最多亂這麼多（活動量時間格晚一點才寫）
+static const qint64 kOrderSlackMs = 60 * 1000;
+
+EventIndex::EventIndex(const QString &directory, QObject *parent)
+    : QObject(parent), m_directory(directory) {
+}
+
+QString EventIndex::eventsPath() const {
+    return m_directory + "/" + kEventsDirName;
+}
+
+QString EventIndex::filePath(const QString &camera) const {
+    const QByteArray hash = QCryptographicHash::hash(camera.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return eventsPath() + "/" + QString::fromLatin1(hash.left(16)) + ".evi";
+}
+
+void EventIndex::appendMotion(const QString &camera, qint64 startMs, qint64 endMs, int peak, quint64 regions) {
+    EventRecord record = {};
+    record.type = EventRecord::Motion;
+    // 只是保險：正常情況下偵測端已經切好段
+    record.startMs = qMax(startMs, endMs - kMaxRecordSpanMs);
+    record.endMs = endMs;
+    record.regions = regions;
+    record.peak = quint8(qBound(0, peak, 100));
+    appendRecord(camera, record);
+}
+
+void EventIndex::appendActivity(const QString &camera, qint64 bucketStartMs, int peak, quint64 regions) {
+    EventRecord record = {};
+    record.type = EventRecord::Activity;
+    record.startMs = bucketStartMs;
+    record.endMs = bucketStartMs + MotionDetector::kActivityBucketMs;
+    record.regions = regions;
+    record.peak = quint8(qBound(0, peak, 100));
+    appendRecord(camera, record);
+}
+
+bool EventIndex::appendRecord(const QString &camera, const EventRecord &record) {
+    QDir().mkpath(eventsPath());
+    const QString path = filePath(camera);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qDebug() << "無法寫入事件索引:" << path << file.errorString();
+        return false;
+    }
+
+    if (file.size() == 0) {
+        const QByteArray url = camera.toUtf8();
+        EventFileHeader header = {};
+        header.magic = kEventMagic;
+        header.version = kEventVersion;
+        header.recordSize = quint16(sizeof(EventRecord));
+        header.urlBytes = quint32(url.size());
+        const qint64 headerBytes = qint64(sizeof(header)) + url.size();
+        header.dataOffset = quint32((headerBytes + sizeof(EventRecord) - 1) / sizeof(EventRecord) * sizeof(EventRecord));
+
+        QByteArray head(int(header.dataOffset), '\0');
+        std::memcpy(head.data(), &header, sizeof(header));
+        std::memcpy(head.data() + sizeof(header), url.constData(), size_t(url.size()));
+        if (file.write(head) != head.size()) return false;
+        m_fileCameras.insert(path, camera);
+    } else {
+        EventFileHeader header = {};
+        if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+            || header.magic != kEventMagic || header.recordSize != sizeof(EventRecord)) {
+            qDebug() << "事件索引格式不符:" << path;
+            return false;
+        }
+        // 當機時只寫了一半的紀錄丟掉
+        const qint64 records = (file.size() - header.dataOffset) / qint64(sizeof(EventRecord));
+        const qint64 end = header.dataOffset + records * qint64(sizeof(EventRecord));
+        if (end != file.size()) file.resize(end);
+    }
+
+    file.seek(file.size());
+    return file.write(reinterpret_cast<const char *>(&record), sizeof(record)) == qint64(sizeof(record));
+}
+
+QStringList EventIndex::cameras() const {
+    QStringList cameras;
+    const QFileInfoList files = QDir(eventsPath()).entryInfoList(QStringList() << "*.evi", QDir::Files);
+    for (const QFileInfo &info : files) {
+        const QString path = info.absoluteFilePath();
+        auto it = m_fileCameras.constFind(path);
+        if (it == m_fileCameras.constEnd()) {
+            QFile file(path);
+            EventFileHeader header = {};
+            if (!file.open(QIODevice::ReadOnly)
+                || file.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header))
+                || header.magic != kEventMagic)
+                continue;
+            it = m_fileCameras.insert(path, QString::fromUtf8(file.read(header.urlBytes)));
+        }
+        cameras << it.value();
+    }
+    cameras.sort();
+    return cameras;
+}
+
+QVector<EventHit> EventIndex::search(const QStringList &cameras, qint64 fromMs, qint64 toMs,
+                                     quint64 regions, int minPeak) const {
+    QVector<EventHit> hits;
+    if (cameras.isEmpty()) {
+        const QFileInfoList files = QDir(eventsPath()).entryInfoList(QStringList() << "*.evi", QDir::Files);
+        for (const QFileInfo &info : files) searchFile(info.absoluteFilePath(), fromMs, toMs, regions, minPeak, &hits);
+    } else {
+        for (const QString &camera : cameras) searchFile(filePath(camera), fromMs, toMs, regions, minPeak, &hits);
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const EventHit &a, const EventHit &b) {
+        return a.jumpMs < b.jumpMs;
+    });
+    return hits;
+}
+
+void EventIndex::searchFile(const QString &path, qint64 fromMs, qint64 toMs, quint64 regions, int minPeak,
+                            QVector<EventHit> *hits) const {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(EventFileHeader))) return;
+
+    // 整個檔案 mmap 進來，只碰到二分搜尋與查詢區間內的頁面
+    uchar *data = file.map(0, file.size());
+    if (!data) return;
+    auto unmap = qScopeGuard([&]() { file.unmap(data); });
+
+    EventFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != kEventMagic || header.recordSize != sizeof(EventRecord)
+        || header.dataOffset > file.size() || sizeof(header) + header.urlBytes > header.dataOffset)
+        return;
+
+    const QString camera = QString::fromUtf8(reinterpret_cast<const char *>(data + sizeof(header)), int(header.urlBytes));
+    const EventRecord *begin = reinterpret_cast<const EventRecord *>(data + header.dataOffset);
+    const EventRecord *end = begin + (file.size() - header.dataOffset) / qint64(sizeof(EventRecord));
+
+    // 紀錄依結束時間大致排序：往前多退一點找起點，往後多看一點才停
+    const EventRecord *first = std::lower_bound(begin, end, fromMs - kOrderSlackMs,
+                                                [](const EventRecord &record, qint64 time) { return record.endMs < time; });
+    const qint64 scanEnd = toMs + kMaxRecordSpanMs + kOrderSlackMs;
+
+    QVector<EventHit> found;
+    QVector<const EventRecord *> buckets;
+    for (const EventRecord *record = first; record != end && record->endMs <= scanEnd; ++record) {
+        if (record->startMs > toMs || record->endMs < fromMs) continue;
+        if (regions && !(record->regions & regions)) continue;
+
+        if (record->type == EventRecord::Activity) {
+            buckets.append(record);
+        } else if (record->peak >= minPeak) {
+            EventHit hit;
+            hit.camera = camera;
+            hit.startMs = record->startMs;
+            hit.endMs = record->endMs;
+            hit.jumpMs = record->startMs;
+            hit.peak = record->peak;
+            hit.regions = record->regions;
+            found.append(hit);
+        }
+    }
+
+    // 有指定區域時，從事件內第一個在該區域有變動的時間格開始播
+    if (regions) {
+        for (EventHit &hit : found) {
+            qint64 jump = -1;
+            for (const EventRecord *bucket : std::as_const(buckets)) {
+                if (bucket->endMs > hit.startMs && bucket->startMs <= hit.endMs
+                    && (jump < 0 || bucket->startMs < jump))
+                    jump = bucket->startMs;
+            }
+            if (jump >= 0) hit.jumpMs = qMax(hit.startMs, jump);
+        }
+    }
+    *hits += found;
+}
@@ -0,0 +1,50 @@
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+
+struct EventRecord;
+
+// 搜尋結果：一段移動事件
+struct EventHit {
+    QString camera;
+    qint64 startMs = 0;
+    qint64 endMs = 0;
+    qint64 jumpMs = 0;      // 第一次在搜尋區域內出現變動的時間，播放從這裡開始
+    int peak = 0;
+    quint64 regions = 0;    // 8x8 區域遮罩，見 MotionDetector::kRegionColumns
+};
+
+// 移動事件索引：錄影資料夾下 events/ 裡每台攝影機一個 .evi 檔
+// 檔頭之後是固定 32 位元組的紀錄，依結束時間附加，只往後寫；搜尋時直接 mmap 二分搜尋
+// 紀錄分兩種：移動事件（開始、結束、區域）與每 10 秒一格的活動量
+class EventIndex : public QObject {
+    Q_OBJECT
+public:
+    explicit EventIndex(const QString &directory, QObject *parent = nullptr);
+
+    void appendMotion(const QString &camera, qint64 startMs, qint64 endMs, int peak, quint64 regions);
+    void appendActivity(const QString &camera, qint64 bucketStartMs, int peak, quint64 regions);
+
+    // 有事件紀錄的攝影機
+    QStringList cameras() const;
+
+    // 在 [fromMs, toMs] 之間、變動區域和 regions 有交集的移動事件；cameras 為空表示全部
+    // regions 為 0 表示不限區域
+    QVector<EventHit> search(const QStringList &cameras, qint64 fromMs, qint64 toMs,
+                             quint64 regions, int minPeak = 0) const;
+
+private:
+    QString eventsPath() const;
+    QString filePath(const QString &camera) const;
+    bool appendRecord(const QString &camera, const EventRecord &record);
+    void searchFile(const QString &path, qint64 fromMs, qint64 toMs, quint64 regions, int minPeak,
+                    QVector<EventHit> *hits) const;
+
+    QString m_directory;
+    mutable QHash<QString, QString> m_fileCameras;  // 檔案路徑 -> 攝影機網址，讀過檔頭就快取
+};
+
+#endif // EVENTINDEX_H
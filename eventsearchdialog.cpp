@@ -0,0 +1,109 @@
+#include "eventsearchdialog.h"
+#include "motiondetector.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QGridLayout>
+#include <QFormLayout>
+#include <QPushButton>
+#include <QElapsedTimer>
+
+EventSearchDialog::EventSearchDialog(EventIndex *index, const QDateTime &from, const QDateTime &to, QWidget *parent)
+    : QDialog(parent), m_index(index) {
+    setWindowTitle("搜尋移動事件");
+
+    m_cameraCombo = new QComboBox();
+    m_cameraCombo->addItem("全部攝影機");
+    m_cameraCombo->addItems(m_index->cameras());
+
+    m_fromEdit = new QDateTimeEdit(from);
+    m_toEdit = new QDateTimeEdit(to);
+    m_fromEdit->setDisplayFormat("yyyy-MM-dd HH:mm");
+    m_toEdit->setDisplayFormat("yyyy-MM-dd HH:mm");
+    m_fromEdit->setCalendarPopup(true);
+    m_toEdit->setCalendarPopup(true);
+
+    m_minPeakSpin = new QSpinBox();
+    m_minPeakSpin->setRange(0, 100);
+    m_minPeakSpin->setSuffix(" %");
+
+    QFormLayout *form = new QFormLayout();
+    form->addRow("攝影機:", m_cameraCombo);
+    form->addRow("從:", m_fromEdit);
+    form->addRow("到:", m_toEdit);
+    form->addRow("最小變動:", m_minPeakSpin);
+
+    // 畫面區域：8x8 格，沒選任何一格表示整個畫面
+    QGridLayout *regionGrid = new QGridLayout();
+    regionGrid->setSpacing(1);
+    for (int row = 0; row < MotionDetector::kRegionRows; ++row) {
+        for (int column = 0; column < MotionDetector::kRegionColumns; ++column) {
+            QToolButton *button = new QToolButton();
+            button->setCheckable(true);
+            button->setFixedSize(24, 14);
+            button->setStyleSheet("QToolButton { background: #333; border: none; }"
+                                  "QToolButton:checked { background: #ff9900; }");
+            regionGrid->addWidget(button, row, column);
+            m_regionButtons.append(button);
+        }
+    }
+    QPushButton *clearRegionBtn = new QPushButton("整個畫面");
+    connect(clearRegionBtn, &QPushButton::clicked, this, [this](){
+        for (QToolButton *button : std::as_const(m_regionButtons)) button->setChecked(false);
+    });
+
+    QVBoxLayout *regionLayout = new QVBoxLayout();
+    regionLayout->addWidget(new QLabel("區域:"));
+    regionLayout->addLayout(regionGrid);
+    regionLayout->addWidget(clearRegionBtn);
+    regionLayout->addStretch();
+
+    QHBoxLayout *criteriaLayout = new QHBoxLayout();
+    criteriaLayout->addLayout(form, 1);
+    criteriaLayout->addLayout(regionLayout);
+
+    QPushButton *searchBtn = new QPushButton("搜尋");
+    m_resultList = new QListWidget();
+    m_statusLabel = new QLabel();
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(criteriaLayout);
+    layout->addWidget(searchBtn);
+    layout->addWidget(m_resultList, 1);
+    layout->addWidget(m_statusLabel);
+    resize(520, 560);
+
+    connect(searchBtn, &QPushButton::clicked, this, &EventSearchDialog::search);
+    connect(m_resultList, &QListWidget::itemDoubleClicked, this, [this](QListWidgetItem *item){
+        const int row = m_resultList->row(item);
+        if (row >= 0 && row < m_hits.size()) emit hitActivated(m_hits[row].camera, m_hits[row].jumpMs);
+    });
+}
+
+quint64 EventSearchDialog::selectedRegions() const {
+    quint64 regions = 0;
+    for (int i = 0; i < m_regionButtons.size(); ++i)
+        if (m_regionButtons[i]->isChecked()) regions |= quint64(1) << i;
+    return regions;
+}
+
+void EventSearchDialog::search() {
+    QStringList cameras;
+    if (m_cameraCombo->currentIndex() > 0) cameras << m_cameraCombo->currentText();
+
+    QElapsedTimer timer;
+    timer.start();
+    m_hits = m_index->search(cameras, m_fromEdit->dateTime().toMSecsSinceEpoch(),
+                             m_toEdit->dateTime().toMSecsSinceEpoch(), selectedRegions(), m_minPeakSpin->value());
+    const qint64 elapsed = timer.elapsed();
+
+    m_resultList->clear();
+    for (const EventHit &hit : std::as_const(m_hits)) {
+        const QDateTime start = QDateTime::fromMSecsSinceEpoch(hit.startMs);
+        const QDateTime end = QDateTime::fromMSecsSinceEpoch(hit.endMs);
+        m_resultList->addItem(QString("%1 ~ %2  (%3%)  %4")
+                                  .arg(start.toString("yyyy-MM-dd HH:mm:ss"), end.toString("HH:mm:ss"))
+                                  .arg(hit.peak)
+                                  .arg(hit.camera));
+    }
+    m_statusLabel->setText(QString("找到 %1 筆，耗時 %2 ms").arg(m_hits.size()).arg(elapsed));
+}
@@ -0,0 +1,38 @@
+#ifndef EVENTSEARCHDIALOG_H
+#define EVENTSEARCHDIALOG_H
+
+#include <QDialog>
+#include <QComboBox>
+#include <QDateTimeEdit>
+#include <QSpinBox>
+#include <QToolButton>
+#include <QListWidget>
+#include <QLabel>
+
+#include "eventindex.h"
+
+// 移動事件搜尋：選攝影機、時間區間與畫面區域，雙擊結果直接跳到該處播放
+class EventSearchDialog : public QDialog {
+    Q_OBJECT
+public:
+    EventSearchDialog(EventIndex *index, const QDateTime &from, const QDateTime &to, QWidget *parent = nullptr);
+
+signals:
+    void hitActivated(const QString &camera, qint64 timeMs);
+
+private:
+    void search();
+    quint64 selectedRegions() const;
+
+    EventIndex *m_index;
+    QComboBox *m_cameraCombo;
+    QDateTimeEdit *m_fromEdit;
+    QDateTimeEdit *m_toEdit;
+    QSpinBox *m_minPeakSpin;
+    QList<QToolButton *> m_regionButtons;   // 依 row * 8 + col 排列，對應區域遮罩的位元
+    QListWidget *m_resultList;
+    QLabel *m_statusLabel;
+    QVector<EventHit> m_hits;
+};
+
+#endif // EVENTSEARCHDIALOG_H
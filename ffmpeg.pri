@@ -0,0 +1,10 @@
+# FFmpeg 8.0.1 路徑配置，引擎、背景服務與視窗程式共用
+FFMPEG_PATH = "C:/Users/ccsto/Downloads/ffmpeg-8.0.1-full_build-shared"
+
+INCLUDEPATH += $${FFMPEG_PATH}/include
+LIBS += -L$${FFMPEG_PATH}/lib \
+        -lavformat \
+        -lavcodec \
+        -lavutil \
+        -lswscale \
+        -lswresample
@@ -0,0 +1,60 @@
+#ifndef FFMPEGUTILS_H
+#define FFMPEGUTILS_H
+
+#include <QString>
+#include <QVector>
+#include <memory>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/error.h>
+}
+
+// av_err2str 是 C 的複合字面值巨集，C++ 無法直接使用
+inline QString avErrorString(int errnum) {
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(errnum, buf, sizeof(buf));
+    return QString::fromUtf8(buf);
+}
+
+// 來源中單一軌道的參數快照（開啟後唯讀，可跨執行緒共用）
+struct IngestTrack {
+    int index = -1;
+    AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    AVRational timeBase{0, 1};
+    AVRational frameRate{0, 1};
+    std::shared_ptr<const AVCodecParameters> codecpar;
+};
+
+using IngestLayout = QVector<IngestTrack>;
+
+// 從已開啟的輸入建立快照，讓各接收端不必碰擷取執行緒的 AVFormatContext
+inline IngestLayout makeIngestLayout(AVFormatContext *input) {
+    IngestLayout layout;
+    for (unsigned i = 0; i < input->nb_streams; ++i) {
+        AVStream *stream = input->streams[i];
+        AVCodecParameters *par = avcodec_parameters_alloc();
+        avcodec_parameters_copy(par, stream->codecpar);
+
+        IngestTrack track;
+        track.index = int(i);
+        track.type = stream->codecpar->codec_type;
+        track.timeBase = stream->time_base;
+        track.frameRate = av_guess_frame_rate(input, stream, nullptr);
+        track.codecpar = std::shared_ptr<const AVCodecParameters>(par, [](AVCodecParameters *p) {
+            avcodec_parameters_free(&p);
+        });
+        layout.append(track);
+    }
+    return layout;
+}
+
+// 找出第一條指定類型的軌道，沒有時回傳 -1
+inline int findTrack(const IngestLayout &layout, AVMediaType type) {
+    for (const IngestTrack &track : layout)
+        if (track.type == type) return track.index;
+    return -1;
+}
+
+#endif // FFMPEGUTILS_H
@@ -0,0 +1,307 @@
+#include "frameseeker.h"
+#include <QMutexLocker>
+#include <QDebug>
+#include <limits>
+
+// 沒有索引時，往後超過這個距離就直接 seek，不一路解過去
+static const qint64 kForwardDecodeLimitMs = 2000;
+
+FrameSeeker::FrameSeeker(QObject *parent) : QThread(parent) {
+}
+
+FrameSeeker::~FrameSeeker() {
+    stop();
+    wait();
+}
+
+void FrameSeeker::setVideoSink(QVideoSink *sink) {
+    m_videoSink = sink;
+}
+
+void FrameSeeker::setMaxOutputSize(const QSize &size) {
+    m_maxWidth = size.isValid() ? size.width() : 0;
+    m_maxHeight = size.isValid() ? size.height() : 0;
+}
+
+void FrameSeeker::open(const QString &filePath) {
+    QMutexLocker locker(&m_mutex);
+    m_openPending = true;
+    m_pendingPath = filePath;
+    m_pendingSeek = -1;
+    m_wake.wakeOne();
+}
+
+void FrameSeeker::close() {
+    open(QString());
+}
+
+void FrameSeeker::seek(qint64 positionMs) {
+    QMutexLocker locker(&m_mutex);
+    m_pendingSeek = qMax<qint64>(0, positionMs);
+    m_wake.wakeOne();
+}
+
+void FrameSeeker::stop() {
+    QMutexLocker locker(&m_mutex);
+    m_stopRequested = true;
+    m_wake.wakeOne();
+}
+
+bool FrameSeeker::hasNewerRequest() {
+    QMutexLocker locker(&m_mutex);
+    return m_stopRequested || m_openPending || m_pendingSeek >= 0;
+}
+
+qint64 FrameSeeker::toMs(int64_t pts) const {
+    return av_rescale_q(pts - m_startTime, m_timeBase, AVRational{1, 1000});
+}
+
+int64_t FrameSeeker::toPts(qint64 ms) const {
+    return m_startTime + av_rescale_q(ms, AVRational{1, 1000}, m_timeBase);
+}
+
+bool FrameSeeker::openFile(const QString &path) {
+    int ret = avformat_open_input(&m_input, path.toUtf8().constData(), nullptr, nullptr);
+    if (ret < 0) {
+        qDebug() << "無法開啟錄影檔:" << path << avErrorString(ret);
+        return false;
+    }
+    if (avformat_find_stream_info(m_input, nullptr) < 0) {
+        closeFile();
+        return false;
+    }
+
+    m_videoIndex = av_find_best_stream(m_input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    const AVCodec *codec = m_videoIndex >= 0
+        ? avcodec_find_decoder(m_input->streams[m_videoIndex]->codecpar->codec_id) : nullptr;
+    if (!codec) {
+        closeFile();
+        return false;
+    }
+
+    AVStream *stream = m_input->streams[m_videoIndex];
+    m_timeBase = stream->time_base;
+    m_startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+    m_codec = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codec, stream->codecpar);
+    m_codec->pkt_timebase = stream->time_base;
+    // 只用 slice 多執行緒，frame 多執行緒會讓每次 seek 多等好幾張
+    m_codec->thread_type = FF_THREAD_SLICE;
+    if (avcodec_open2(m_codec, codec, nullptr) < 0) {
+        closeFile();
+        return false;
+    }
+
+    m_index = KeyframeIndex::load(path);
+    m_byteSeek = qstrcmp(m_input->iformat->name, "mpegts") == 0;
+    if (m_index.isEmpty()) qDebug() << "沒有關鍵幀索引，改用 demuxer 搜尋:" << path;
+    return true;
+}
+
+void FrameSeeker::closeFile() {
+    avcodec_free_context(&m_codec);
+    avformat_close_input(&m_input);
+    m_videoIndex = -1;
+    m_index = KeyframeIndex();
+    m_converter.reset();
+    m_gops.clear();
+    m_cacheBytes = 0;
+    m_currentGop = -1;
+    m_decodedMs = -1;
+    m_waitingForKey = true;
+    m_lastPresentedMs = -1;
+}
+
+void FrameSeeker::run() {
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+
+    forever {
+        bool openPending = false;
+        QString path;
+        qint64 position = -1;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_stopRequested && !m_openPending && m_pendingSeek < 0) m_wake.wait(&m_mutex);
+            if (m_stopRequested) break;
+            openPending = m_openPending;
+            path = m_pendingPath;
+            position = m_pendingSeek;
+            m_openPending = false;
+            m_pendingSeek = -1;
+        }
+
+        if (openPending) {
+            closeFile();
+            if (!path.isEmpty()) openFile(path);
+        }
+        if (position >= 0 && m_codec) serve(position);
+    }
+
+    closeFile();
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+}
+
+bool FrameSeeker::findCached(qint64 positionMs, QVideoFrame *frame, qint64 *frameMs) {
+    auto gop = m_gops.upperBound(positionMs);
+    if (gop == m_gops.begin()) return false;
+    --gop;
+
+    Gop &cached = gop.value();
+    if (cached.frames.isEmpty()) return false;
+    if (positionMs > cached.lastMs && (cached.nextKeyMs < 0 || positionMs >= cached.nextKeyMs)) return false;
+
+    auto it = cached.frames.upperBound(positionMs);
+    if (it != cached.frames.begin()) --it;
+    *frame = it.value();
+    *frameMs = it.key();
+    cached.lastUsed = ++m_useCounter;
+    return true;
+}
+
+bool FrameSeeker::needsSeek(qint64 positionMs) const {
+    if (m_currentGop < 0 || m_decodedMs >= positionMs) return true;
+    if (m_index.isEmpty()) return positionMs - m_decodedMs > kForwardDecodeLimitMs;
+
+    // 目標在後面的 GOP：直接跳過去比一路解過去快
+    int key = m_index.floor(positionMs);
+    return key >= 0 && m_index.entries()[key].timeMs > m_currentGop;
+}
+
+void FrameSeeker::seekTo(qint64 positionMs) {
+    int key = m_index.floor(positionMs);
+    if (key < 0 && !m_index.isEmpty()) key = 0;
+
+    if (key >= 0 && m_byteSeek && m_index.entries()[key].position >= 0) {
+        av_seek_frame(m_input, -1, m_index.entries()[key].position, AVSEEK_FLAG_BYTE);
+    } else {
+        // 有索引時給的就是關鍵幀本身的時間，demuxer 不必往前找
+        qint64 target = key >= 0 ? m_index.entries()[key].timeMs : positionMs;
+        av_seek_frame(m_input, m_videoIndex, toPts(target), AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(m_codec);
+    m_currentGop = -1;
+    m_decodedMs = -1;
+    m_waitingForKey = true;
+}
+
+bool FrameSeeker::decodeNext() {
+    int ret = av_read_frame(m_input, m_packet);
+    if (ret < 0) {
+        // 檔案結尾：把解碼器裡剩下的畫面取出來
+        avcodec_send_packet(m_codec, nullptr);
+        while (avcodec_receive_frame(m_codec, m_frame) == 0) {
+            storeFrame(m_frame);
+            av_frame_unref(m_frame);
+        }
+        avcodec_flush_buffers(m_codec);
+        // 最後一個 GOP 一路解到檔尾，之後的位置都顯示最後一張
+        if (m_currentGop >= 0) m_gops[m_currentGop].nextKeyMs = std::numeric_limits<qint64>::max();
+        m_currentGop = -1;
+        return false;
+    }
+    if (m_packet->stream_index != m_videoIndex) {
+        av_packet_unref(m_packet);
+        return true;
+    }
+
+    if (m_packet->flags & AV_PKT_FLAG_KEY) {
+        int64_t pts = m_packet->pts != AV_NOPTS_VALUE ? m_packet->pts : m_packet->dts;
+        qint64 keyMs = toMs(pts);
+        // 從上一個 GOP 連續解過來，上一個 GOP 就完整了
+        if (m_currentGop >= 0 && m_currentGop != keyMs) m_gops[m_currentGop].nextKeyMs = keyMs;
+        m_gops[keyMs];
+        m_currentGop = keyMs;
+        m_waitingForKey = false;
+    } else if (m_waitingForKey) {
+        av_packet_unref(m_packet);
+        return true;
+    }
+
+    avcodec_send_packet(m_codec, m_packet);
+    av_packet_unref(m_packet);
+    while (avcodec_receive_frame(m_codec, m_frame) == 0) {
+        storeFrame(m_frame);
+        av_frame_unref(m_frame);
+    }
+    return true;
+}
+
+void FrameSeeker::storeFrame(const AVFrame *frame) {
+    if (frame->best_effort_timestamp == AV_NOPTS_VALUE) return;
+    qint64 frameMs = toMs(frame->best_effort_timestamp);
+    m_decodedMs = qMax(m_decodedMs, frameMs);
+
+    // 依時間歸到所屬的 GOP（解碼延遲會讓上一個 GOP 的尾巴晚一點出來）
+    auto gop = m_gops.upperBound(frameMs);
+    if (gop == m_gops.begin()) return;
+    --gop;
+    if (gop.value().frames.contains(frameMs)) return;
+
+    QVideoFrame video = m_converter.convert(frame, QSize(m_maxWidth, m_maxHeight));
+    if (!video.isValid()) return;
+
+    qint64 bytes = qint64(video.width()) * video.height() * 3 / 2;
+    Gop &cached = gop.value();
+    cached.frames.insert(frameMs, video);
+    cached.lastMs = qMax(cached.lastMs, frameMs);
+    cached.bytes += bytes;
+    cached.lastUsed = ++m_useCounter;
+    m_cacheBytes += bytes;
+}
+
+void FrameSeeker::trimCache() {
+    // 超過上限就丟最久沒用到的 GOP，解碼器所在的那個保留
+    while (m_cacheBytes > m_cacheLimit && m_gops.size() > 1) {
+        auto oldest = m_gops.end();
+        for (auto it = m_gops.begin(); it != m_gops.end(); ++it) {
+            if (it.key() == m_currentGop) continue;
+            if (oldest == m_gops.end() || it.value().lastUsed < oldest.value().lastUsed) oldest = it;
+        }
+        if (oldest == m_gops.end()) break;
+        m_cacheBytes -= oldest.value().bytes;
+        m_gops.erase(oldest);
+    }
+}
+
+void FrameSeeker::serve(qint64 positionMs) {
+    QVideoFrame frame;
+    qint64 frameMs = -1;
+    if (findCached(positionMs, &frame, &frameMs)) {
+        present(frame, frameMs);
+        return;
+    }
+
+    if (needsSeek(positionMs)) seekTo(positionMs);
+
+    bool more = true;
+    while (more && m_decodedMs < positionMs) {
+        // 拖曳中又有新位置：先把目前解到的畫面顯示出來，改處理新的
+        if (hasNewerRequest()) break;
+        more = decodeNext();
+    }
+    trimCache();
+
+    if (findCached(positionMs, &frame, &frameMs)) {
+        present(frame, frameMs);
+    } else if (m_currentGop >= 0 || !more) {
+        // 還沒解到目標或已經到檔尾，顯示目前最接近的一張
+        auto gop = m_gops.upperBound(positionMs);
+        if (gop != m_gops.begin() && !(--gop).value().frames.isEmpty()) {
+            auto last = std::prev(gop.value().frames.end());
+            present(last.value(), last.key());
+        }
+    }
+}
+
+void FrameSeeker::present(const QVideoFrame &frame, qint64 frameMs) {
+    if (frameMs == m_lastPresentedMs) return;
+    m_lastPresentedMs = frameMs;
+
+    QMetaObject::invokeMethod(this, [this, frame, frameMs]() {
+        if (m_videoSink) m_videoSink->setVideoFrame(frame);
+        emit frameShown(frameMs);
+    }, Qt::QueuedConnection);
+}
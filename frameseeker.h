@@ -0,0 +1,100 @@
+#ifndef FRAMESEEKER_H
+#define FRAMESEEKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QPointer>
+#include <QVideoSink>
+#include <QVideoFrame>
+#include <QMap>
+#include <atomic>
+
+#include "ffmpegutils.h"
+#include "keyframeindex.h"
+#include "videoframeconverter.h"
+
+// 拖曳進度條用的畫面定位：在自己的執行緒解碼，畫面交回 GUI 執行緒顯示
+// 有關鍵幀索引時直接跳到該關鍵幀（TS 用檔案位置），連續的 seek 只處理最新一個
+// 解過的 GOP 留在快取裡，在附近來回拖曳不必重新解碼
+class FrameSeeker : public QThread {
+    Q_OBJECT
+public:
+    explicit FrameSeeker(QObject *parent = nullptr);
+    ~FrameSeeker() override;
+
+    // 以下方法只在 GUI 執行緒呼叫，不會阻塞
+    void setVideoSink(QVideoSink *sink);
+    void open(const QString &filePath);
+    void close();
+    // 顯示 positionMs（相對檔案開頭）的畫面
+    void seek(qint64 positionMs);
+    void stop();
+
+    // 快取的畫面縮到顯示大小，省記憶體也省複製；空的 QSize 表示原尺寸
+    void setMaxOutputSize(const QSize &size);
+    void setCacheLimit(qint64 bytes) { m_cacheLimit = bytes; }
+
+signals:
+    void frameShown(qint64 positionMs);
+
+protected:
+    void run() override;
+
+private:
+    struct Gop {
+        qint64 lastMs = -1;         // 已解到的最後一張
+        qint64 nextKeyMs = -1;      // 連續解到下一個關鍵幀時才設定，表示整個 GOP 都在快取裡
+        QMap<qint64, QVideoFrame> frames;
+        qint64 bytes = 0;
+        quint64 lastUsed = 0;
+    };
+
+    bool openFile(const QString &path);
+    void closeFile();
+    void serve(qint64 positionMs);
+    bool findCached(qint64 positionMs, QVideoFrame *frame, qint64 *frameMs);
+    bool needsSeek(qint64 positionMs) const;
+    void seekTo(qint64 positionMs);
+    bool decodeNext();
+    void storeFrame(const AVFrame *frame);
+    void trimCache();
+    void present(const QVideoFrame &frame, qint64 frameMs);
+    bool hasNewerRequest();
+    qint64 toMs(int64_t pts) const;
+    int64_t toPts(qint64 ms) const;
+
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    bool m_stopRequested = false;
+    bool m_openPending = false;
+    QString m_pendingPath;
+    qint64 m_pendingSeek = -1;
+
+    QPointer<QVideoSink> m_videoSink;   // 只在 GUI 執行緒使用
+    std::atomic<qint64> m_cacheLimit{192 * 1024 * 1024};
+    std::atomic_int m_maxWidth{0};
+    std::atomic_int m_maxHeight{0};
+
+    // 以下只在解碼執行緒使用
+    AVFormatContext *m_input = nullptr;
+    AVCodecContext *m_codec = nullptr;
+    AVPacket *m_packet = nullptr;
+    AVFrame *m_frame = nullptr;
+    int m_videoIndex = -1;
+    AVRational m_timeBase{1, 1000};
+    int64_t m_startTime = 0;
+    bool m_byteSeek = false;            // MPEG-TS 依索引的檔案位置跳轉
+    KeyframeIndex m_index;
+    VideoFrameConverter m_converter;
+
+    QMap<qint64, Gop> m_gops;           // 依關鍵幀時間
+    qint64 m_cacheBytes = 0;
+    quint64 m_useCounter = 0;
+    qint64 m_currentGop = -1;           // 解碼器目前所在的 GOP，-1 表示要先 seek
+    qint64 m_decodedMs = -1;            // 解碼器目前解到的位置
+    bool m_waitingForKey = true;
+    qint64 m_lastPresentedMs = -1;
+};
+
+#endif // FRAMESEEKER_H
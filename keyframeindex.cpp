@@ -0,0 +1,56 @@
+#include "keyframeindex.h"
+#include <QDataStream>
+#include <algorithm>
+
+// 檔頭 magic + 版本，之後每筆固定 16 bytes，寫到一半的最後一筆讀取時忽略
+static const quint32 kKeyframeMagic = 0x4B464958;   // "KFIX"
+static const quint32 kKeyframeVersion = 1;
+
+KeyframeIndex KeyframeIndex::load(const QString &recordingPath) {
+    KeyframeIndex index;
+    QFile file(sidecarPath(recordingPath));
+    if (!file.open(QIODevice::ReadOnly)) return index;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != kKeyframeMagic || version != kKeyframeVersion) return index;
+
+    index.m_entries.reserve(int((file.size() - 8) / 16));
+    while (!in.atEnd()) {
+        Entry entry;
+        in >> entry.timeMs >> entry.position;
+        if (in.status() != QDataStream::Ok) break;
+        index.m_entries.append(entry);
+    }
+    return index;
+}
+
+int KeyframeIndex::floor(qint64 timeMs) const {
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), timeMs,
+                               [](qint64 time, const Entry &entry) { return time < entry.timeMs; });
+    return int(it - m_entries.begin()) - 1;
+}
+
+bool KeyframeIndexWriter::open(const QString &recordingPath) {
+    close();
+    m_file.setFileName(KeyframeIndex::sidecarPath(recordingPath));
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QDataStream out(&m_file);
+    out << kKeyframeMagic << kKeyframeVersion;
+    return out.status() == QDataStream::Ok;
+}
+
+void KeyframeIndexWriter::append(qint64 timeMs, qint64 position) {
+    if (!m_file.isOpen()) return;
+    QDataStream out(&m_file);
+    out << timeMs << position;
+    // 錄影中途當機時，已寫的部分仍可用
+    m_file.flush();
+}
+
+void KeyframeIndexWriter::close() {
+    if (m_file.isOpen()) m_file.close();
+}
@@ -0,0 +1,43 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// 錄影檔旁的關鍵幀索引（<檔名>.kfi）：每個關鍵幀一筆 時間 + 檔案位置
+// 錄影時邊寫邊附加，播放端據此直接跳到關鍵幀，不必讓 demuxer 搜尋
+class KeyframeIndex {
+public:
+    struct Entry {
+        qint64 timeMs = 0;      // 相對檔案開頭
+        qint64 position = -1;   // 寫入前的檔案位置，關鍵幀一定在這之後
+    };
+
+    static QString sidecarPath(const QString &recordingPath) { return recordingPath + ".kfi"; }
+
+    // 讀入索引；檔案不存在或格式不符時回傳空索引
+    static KeyframeIndex load(const QString &recordingPath);
+
+    bool isEmpty() const { return m_entries.isEmpty(); }
+    const QVector<Entry> &entries() const { return m_entries; }
+    // 不晚於 timeMs 的最後一個關鍵幀；沒有時回傳 -1
+    int floor(qint64 timeMs) const;
+
+private:
+    QVector<Entry> m_entries;
+};
+
+// 錄影端使用：每寫一個關鍵幀附加一筆
+class KeyframeIndexWriter {
+public:
+    bool open(const QString &recordingPath);
+    void append(qint64 timeMs, qint64 position);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+private:
+    QFile m_file;
+};
+
+#endif // KEYFRAMEINDEX_H
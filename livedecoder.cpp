@@ -0,0 +1,236 @@
+#include "livedecoder.h"
+#include "mosaicwidget.h"
+#include <QDebug>
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+LiveDecoder::LiveDecoder(QObject *parent) : QObject(parent) {
+    m_frame = av_frame_alloc();
+}
+
+LiveDecoder::~LiveDecoder() {
+    releaseCodec();
+    av_frame_free(&m_frame);
+}
+
+void LiveDecoder::setVideoSink(QVideoSink *sink) {
+    m_videoSink = sink;
+}
+
+void LiveDecoder::setMosaicTile(const std::shared_ptr<MosaicTile> &tile) {
+    QMutexLocker locker(&m_tileMutex);
+    m_mosaicTile = tile;
+}
+
+std::shared_ptr<MosaicTile> LiveDecoder::mosaicTile() const {
+    QMutexLocker locker(&m_tileMutex);
+    return m_mosaicTile;
+}
+
+void LiveDecoder::setMaxOutputSize(const QSize &size) {
+    m_maxWidth = size.isValid() ? size.width() : 0;
+    m_maxHeight = size.isValid() ? size.height() : 0;
+}
+
+void LiveDecoder::setMaxFrameRate(double fps) {
+    m_minFrameIntervalUs = fps > 0 ? int64_t(AV_TIME_BASE / fps) : 0;
+}
+
+void LiveDecoder::releaseCodec() {
+    avcodec_free_context(&m_codec);
+    sws_freeContext(m_sws);
+    m_sws = nullptr;
+    m_converter.reset();
+    m_videoIndex = -1;
+    m_decoding = false;
+    m_codecMode = DecodeMode::Full;
+    m_mode = DecodeMode::Full;
+    m_lastShownUs = AV_NOPTS_VALUE;
+}
+
+void LiveDecoder::openSink(const IngestLayout &layout) {
+    m_layout = layout;
+    openCodec();
+}
+
+void LiveDecoder::openCodec() {
+    releaseCodec();
+
+    m_videoIndex = findTrack(m_layout, AVMEDIA_TYPE_VIDEO);
+    if (m_videoIndex < 0) {
+        qDebug() << "來源沒有影像軌道";
+        return;
+    }
+
+    const AVCodecParameters *par = m_layout[m_videoIndex].codecpar.get();
+    const AVCodec *codec = avcodec_find_decoder(par->codec_id);
+    if (!codec) {
+        qDebug() << "找不到解碼器:" << avcodec_get_name(par->codec_id);
+        m_videoIndex = -1;
+        return;
+    }
+
+    m_codec = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codec, par);
+    m_codec->pkt_timebase = m_layout[m_videoIndex].timeBase;
+    m_codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    // 封包的 opaque 帶著收到時間，讓解出來的畫面也帶著，才算得出延遲
+    m_codec->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+
+    const DecodeMode mode = wantedMode();
+    if (mode == DecodeMode::LowRes) m_codec->lowres = qMin<int>(2, codec->max_lowres);
+
+    int ret = avcodec_open2(m_codec, codec, nullptr);
+    if (ret < 0) {
+        qDebug() << "解碼器開啟失敗:" << avErrorString(ret);
+        releaseCodec();
+        return;
+    }
+    applyMode(mode);
+}
+
+LiveDecoder::DecodeMode LiveDecoder::wantedMode() const {
+    if (!m_reduced) return DecodeMode::Full;
+    if (m_codec->codec->max_lowres > 0) return DecodeMode::LowRes;
+
+    // 只解關鍵幀會讓畫面低於設定的幀率，只在明確開啟時使用
+    return m_keyFramesOnly ? DecodeMode::KeyFramesOnly : DecodeMode::SkipNonRef;
+}
+
+void LiveDecoder::applyMode(DecodeMode mode) {
+    m_codecMode = mode;
+    m_mode = mode;
+    m_codec->skip_loop_filter = mode == DecodeMode::Full ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    switch (mode) {
+    case DecodeMode::Full:
+        m_codec->skip_frame = AVDISCARD_DEFAULT;
+        break;
+    case DecodeMode::KeyFramesOnly:
+        m_codec->skip_frame = AVDISCARD_NONKEY;
+        break;
+    default:
+        m_codec->skip_frame = AVDISCARD_NONREF;
+        break;
+    }
+}
+
+void LiveDecoder::writePacket(const AVPacket *packet) {
+    if (!m_codec || packet->stream_index != m_videoIndex) return;
+
+    const DecodeMode mode = wantedMode();
+    if (mode != m_codecMode) {
+        if (mode == DecodeMode::LowRes || m_codecMode == DecodeMode::LowRes) {
+            // lowres 只能在開啟時設定，重開後等下一個關鍵幀
+            openCodec();
+            if (!m_codec) return;
+        } else {
+            // 只解關鍵幀時參考幀都沒解，改回來要從下一個關鍵幀開始
+            if (m_codecMode == DecodeMode::KeyFramesOnly && m_decoding) {
+                m_decoding = false;
+                avcodec_flush_buffers(m_codec);
+            }
+            applyMode(mode);
+        }
+    }
+
+    if (!m_active) {
+        if (m_decoding) {
+            m_decoding = false;
+            avcodec_flush_buffers(m_codec);
+        }
+        return;
+    }
+    if (!m_decoding) {
+        // 參考幀已丟掉，從關鍵幀重新開始才不會花屏
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) return;
+        m_decoding = true;
+    }
+
+    if (avcodec_send_packet(m_codec, packet) < 0) return;
+
+    std::shared_ptr<MosaicTile> tile = mosaicTile();
+    while (avcodec_receive_frame(m_codec, m_frame) == 0) {
+        StreamMetrics::add(m_metrics->decodedFrames, 1);
+        const int64_t receivedUs = int64_t(intptr_t(m_frame->opaque));
+        if (skipForFrameRate(m_frame)) {
+            // 只丟顯示，錄影走另一個接收端不受影響；這是設定的限制，不算掉幀
+        } else if (tile) {
+            // 合成牆只保留最新一張，不必排隊
+            renderToTile(tile.get(), m_frame);
+            recordDisplayed(receivedUs);
+        } else if (m_frames.size() < m_frames.capacity()) {
+            PendingFrame pending;
+            pending.frame = m_converter.convert(m_frame, QSize(m_maxWidth, m_maxHeight));
+            pending.receivedUs = receivedUs;
+            if (pending.frame.isValid() && m_frames.tryPush(std::move(pending)) && !m_presentQueued.exchange(true)) {
+                QMetaObject::invokeMethod(this, [this]() {
+                    presentFrames();
+                }, Qt::QueuedConnection);
+            }
+        } else {
+            // 畫面佇列滿了表示 GUI 來不及顯示，直接丟幀，連轉換都省下
+            StreamMetrics::add(m_metrics->droppedFrames, 1);
+        }
+        av_frame_unref(m_frame);
+    }
+}
+
+void LiveDecoder::closeSink() {
+    releaseCodec();
+}
+
+bool LiveDecoder::skipForFrameRate(const AVFrame *frame) {
+    const int64_t interval = m_minFrameIntervalUs;
+    if (interval <= 0 || frame->best_effort_timestamp == AV_NOPTS_VALUE) return false;
+
+    int64_t time = av_rescale_q(frame->best_effort_timestamp, m_codec->pkt_timebase, AV_TIME_BASE_Q);
+    // 容許少量時間戳抖動，避免 25fps 限 5fps 時偶爾多丟一張；時間倒退就重新計算
+    if (m_lastShownUs != AV_NOPTS_VALUE && time >= m_lastShownUs
+        && time - m_lastShownUs < interval - interval / 8)
+        return true;
+    m_lastShownUs = time;
+    return false;
+}
+
+void LiveDecoder::renderToTile(MosaicTile *tile, const AVFrame *src) {
+    QSize target = tile->targetSize();
+    if (target.isEmpty()) return;
+
+    // 色彩轉換與縮放一次完成，直接寫進格子的緩衝
+    QSize outSize = QSize(src->width, src->height).scaled(target, Qt::KeepAspectRatio);
+    outSize = QSize(qMax(2, outSize.width() & ~1), qMax(2, outSize.height() & ~1));
+    m_sws = sws_getCachedContext(m_sws, src->width, src->height, AVPixelFormat(src->format),
+                                 outSize.width(), outSize.height(), AV_PIX_FMT_RGB32,
+                                 SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_sws) return;
+
+    QImage *image = tile->backBuffer(outSize);
+    uint8_t *dst[4] = { image->bits(), nullptr, nullptr, nullptr };
+    int dstStride[4] = { int(image->bytesPerLine()), 0, 0, 0 };
+    sws_scale(m_sws, src->data, src->linesize, 0, src->height, dst, dstStride);
+    tile->publish();
+}
+
+void LiveDecoder::presentFrames() {
+    m_presentQueued = false;
+    // 一次取完，只顯示最新的一張，被蓋掉的算掉幀
+    PendingFrame pending;
+    PendingFrame latest;
+    int superseded = -1;
+    while (m_frames.tryPop(pending)) {
+        latest = std::move(pending);
+        ++superseded;
+    }
+    if (superseded > 0) StreamMetrics::add(m_metrics->droppedFrames, superseded);
+    if (latest.frame.isValid() && m_videoSink) {
+        m_videoSink->setVideoFrame(latest.frame);
+        recordDisplayed(latest.receivedUs);
+    }
+}
+
+void LiveDecoder::recordDisplayed(int64_t receivedUs) {
+    StreamMetrics::add(m_metrics->displayedFrames, 1);
+    if (receivedUs > 0) m_metrics->latencyUs.store(metricsClockUs() - receivedUs, std::memory_order_relaxed);
+}
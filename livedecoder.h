@@ -0,0 +1,109 @@
+#ifndef LIVEDECODER_H
+#define LIVEDECODER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVideoSink>
+#include <QVideoFrame>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+
+#include "streamingest.h"
+#include "spscqueue.h"
+#include "videoframeconverter.h"
+#include "streammetrics.h"
+
+struct SwsContext;
+class MosaicTile;
+
+// 即時畫面解碼：在自己的佇列執行緒上解碼，畫面經固定容量的畫面佇列交回 GUI 執行緒顯示
+// 封包佇列滿了丟最舊的非關鍵幀，畫面佇列滿了不再轉換，GUI 每次只顯示最新的一張
+class LiveDecoder : public QObject, public PacketSink {
+    Q_OBJECT
+public:
+    // 實際採用的解碼方式
+    enum class DecodeMode {
+        Full,           // 完整解碼
+        LowRes,         // 解碼器直接降解析度（MJPEG 等支援 lowres 的編碼）
+        SkipNonRef,     // 略過去區塊濾波與非參考幀
+        KeyFramesOnly,  // 只解關鍵幀，要明確開啟
+    };
+
+    explicit LiveDecoder(QObject *parent = nullptr);
+    ~LiveDecoder() override;
+
+    // 只能在 GUI 執行緒呼叫（放大畫面時改綁到另一個 widget）
+    void setVideoSink(QVideoSink *sink);
+
+    // 改畫到合成牆的一格（設定後優先於 video sink），傳 nullptr 回到 video sink；任何執行緒皆可
+    void setMosaicTile(const std::shared_ptr<MosaicTile> &tile);
+
+    // 畫面看不到時停止解碼，可在任何執行緒呼叫；恢復後從下一個關鍵幀開始
+    void setActive(bool active) { m_active = active; }
+    bool isActive() const { return m_active; }
+
+    // 九宮格用的省電解碼：編碼器支援 lowres 就降解析度，H.264/H.265 沒有 lowres 就略過濾波與非參考幀，
+    // 輸出再縮到格子大小。有子碼流時應改解子碼流
+    void setReducedDecode(bool reduced) { m_reduced = reduced; }
+    // 省電解碼時改成只解關鍵幀（沒有 lowres 的編碼才有效），畫面一個 GOP 才更新一次；
+    // 只給很小的格子或 CPU 不夠時用，預設關閉
+    void setKeyFramesOnly(bool enabled) { m_keyFramesOnly = enabled; }
+    // 目前實際生效的解碼方式，任何執行緒皆可
+    DecodeMode decodeMode() const { return m_mode; }
+    // 輸出畫面上限（通常是格子大小），超過就先縮小再交給畫面；空的 QSize 表示原尺寸
+    void setMaxOutputSize(const QSize &size);
+    // 顯示幀率上限，超過的畫面在轉換前就丟掉；0 表示不限
+    void setMaxFrameRate(double fps);
+    // 解碼/顯示/丟幀與延遲累加到這裡；要在掛上擷取之前設定
+    void setMetrics(const std::shared_ptr<StreamMetrics> &metrics) { m_metrics = metrics; }
+
+    void openSink(const IngestLayout &layout) override;
+    void writePacket(const AVPacket *packet) override;
+    void closeSink() override;
+    QueuePolicy queuePolicy() const override { return QueuePolicy::DropOldest; }
+    QString sinkName() const override { return "顯示"; }
+
+private:
+    void openCodec();
+    void releaseCodec();
+    DecodeMode wantedMode() const;
+    void applyMode(DecodeMode mode);
+    std::shared_ptr<MosaicTile> mosaicTile() const;
+    bool skipForFrameRate(const AVFrame *frame);
+    void renderToTile(MosaicTile *tile, const AVFrame *frame);
+    void presentFrames();
+    void recordDisplayed(int64_t receivedUs);
+
+    struct PendingFrame {
+        QVideoFrame frame;
+        int64_t receivedUs = 0;     // 對應封包收到的時間，0 表示不知道
+    };
+
+    QPointer<QVideoSink> m_videoSink;
+    mutable QMutex m_tileMutex;
+    std::shared_ptr<MosaicTile> m_mosaicTile;
+    SpscQueue<PendingFrame> m_frames{2};    // 解碼執行緒放、GUI 執行緒取
+    std::atomic_bool m_presentQueued{false};
+    std::atomic_bool m_active{true};
+    std::atomic_bool m_reduced{false};
+    std::atomic_bool m_keyFramesOnly{false};
+    std::atomic<DecodeMode> m_mode{DecodeMode::Full};
+    std::atomic_int m_maxWidth{0};
+    std::atomic_int m_maxHeight{0};
+    std::atomic<int64_t> m_minFrameIntervalUs{0};
+    std::shared_ptr<StreamMetrics> m_metrics = std::make_shared<StreamMetrics>();
+
+    // 以下只在佇列執行緒使用
+    IngestLayout m_layout;
+    AVCodecContext *m_codec = nullptr;
+    DecodeMode m_codecMode = DecodeMode::Full;
+    AVFrame *m_frame = nullptr;
+    VideoFrameConverter m_converter;
+    SwsContext *m_sws = nullptr;        // 合成牆用的 RGB 轉換
+    int m_videoIndex = -1;
+    bool m_decoding = false;    // 目前是否在解碼（停用後要等關鍵幀才恢復）
+    int64_t m_lastShownUs = AV_NOPTS_VALUE;
+};
+
+#endif // LIVEDECODER_H
@@ -9,34 +9,60 @@
 #include <QDesktopServices>
 #include <QUrl>
 #include <QTimer>
-#include <QProcess>
 #include <QFileInfo>
 #include <QDebug>
 #include <QThread>
+#include <QSignalBlocker>
+#include <QMouseEvent>
+#include <QStyle>
+#include <QMap>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QPointer>
+#include <QHeaderView>
+#include <climits>
+#include <algorithm>
+
+// 同步回放最多同時幾格
+static const int kMaxSyncViews = 16;
+// 從搜尋結果跳轉時，提早幾毫秒開始播
+static const qint64 kEventLeadMs = 2000;
+// 本機轉播的 HTTP 埠
+static const quint16 kRelayPort = 8554;
+// 設備清單項目的資料：子碼流網址與個別的預錄設定
+static const int kSubUrlRole = Qt::UserRole;
+static const int kPreRollSecondsRole = Qt::UserRole + 1;   // -1 或沒有表示用預設值
+static const int kPreRollMaxMbRole = Qt::UserRole + 2;     // 0 或沒有表示用預設值
+
+static QString decodeModeName(LiveDecoder::DecodeMode mode) {
+    switch (mode) {
+    case LiveDecoder::DecodeMode::LowRes: return "降解析度解碼";
+    case LiveDecoder::DecodeMode::SkipNonRef: return "略過非參考幀";
+    case LiveDecoder::DecodeMode::KeyFramesOnly: return "只解關鍵幀";
+    default: return "完整解碼";
+    }
+}
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+    // 擷取與錄影都在引擎裡，視窗只負責顯示與操作；同一個引擎也能由 recorderd 單獨執行
+    m_engine = new RecorderEngine(getRecordingsPath(), this);
     setupUi();
     resize(1200, 800);
     setWindowTitle("Qt6 專業多路監控錄影系統");
 
-    // 啟動時檢查 FFmpeg
-    QTimer::singleShot(500, this, [this](){
-        QProcess process;
-        process.start("ffmpeg", QStringList() << "-version");
-        process.waitForFinished(3000);
-
-        if (process.error() == QProcess::FailedToStart) {
-            QMessageBox::warning(this, "警告",
-                                 "未偵測到 FFmpeg！\n\n"
-                                 "錄影功能需要 FFmpeg 才能運作。\n"
-                                 "請下載並安裝 FFmpeg：\n"
-                                 "https://www.gyan.dev/ffmpeg/builds/\n\n"
-                                 "下載後請將 ffmpeg.exe 放到程式目錄或加入系統 PATH。");
-        }
+    // 佇列深度隨時在變，每次效能取樣時一併更新提示
+    connect(m_engine->metricsSampler(), &MetricsSampler::sampled, this, [this](const QVector<CameraMetrics> &metrics){
+        for (PlayerUnit *unit : std::as_const(m_playerUnits)) updateUnitToolTip(unit);
+        if (m_metricsTable->isVisible()) updateMetricsPanel(metrics);
     });
 }
 
 MainWindow::~MainWindow() {
+    // 等各路錄影寫完檔尾，再放掉即時畫面的解碼端
+    m_engine->shutdown();
     qDeleteAll(m_playerUnits);
 }
 
@@ -53,15 +79,63 @@ void MainWindow::setupUi() {
     QPushButton *addBtn = new QPushButton("新增來源");
     QPushButton *playBtn = new QPushButton("開始播放");
     QPushButton *delBtn = new QPushButton("移除選定");
+    QPushButton *preRollBtn = new QPushButton("預錄設定");
 
     m_recordBtn = new QPushButton("開啟全域錄影");
     m_recordBtn->setCheckable(true);
     m_recordBtn->setMinimumHeight(50);
 
+    // 分段錄影設定：每段固定長度，在關鍵幀切檔
+    m_segmentMinutesSpin = new QSpinBox();
+    m_segmentMinutesSpin->setRange(1, 60);
+    m_segmentMinutesSpin->setValue(5);
+    m_segmentMinutesSpin->setSuffix(" 分鐘/段");
+    m_containerCombo = new QComboBox();
+    m_containerCombo->addItem("分段 MP4 (fMP4)", RecorderOptions::FragmentedMp4);
+    m_containerCombo->addItem("MPEG-TS", RecorderOptions::MpegTs);
+
+    // 預錄：開始錄影時先寫入觸發前幾秒的畫面
+    m_preRollSpin = new QSpinBox();
+    m_preRollSpin->setRange(0, 30);
+    m_preRollSpin->setValue(5);
+    m_preRollSpin->setPrefix("預錄 ");
+    m_preRollSpin->setSuffix(" 秒");
+
+    // 移動觸發錄影：有移動才開檔，前段用預錄，移動停止後再錄幾秒
+    m_motionCheck = new QCheckBox("移動偵測錄影");
+    m_postRollSpin = new QSpinBox();
+    m_postRollSpin->setRange(0, 120);
+    m_postRollSpin->setValue(10);
+    m_postRollSpin->setPrefix("後錄 ");
+    m_postRollSpin->setSuffix(" 秒");
+    m_sensitivitySpin = new QSpinBox();
+    m_sensitivitySpin->setRange(1, 100);
+    m_sensitivitySpin->setValue(50);
+    m_sensitivitySpin->setPrefix("靈敏度 ");
+
     m_globalProgressBar = new QProgressBar();
     m_globalProgressBar->setVisible(false);
     m_globalProgressBar->setTextVisible(false);
 
+    // 合成牆：所有畫面畫在同一個 widget，路數多時比一格一個 QVideoWidget 省
+    m_mosaicCheck = new QCheckBox("合成九宮格");
+
+    // 九宮格顯示幀率上限，放大畫面時恢復原幀率；錄影不受影響
+    m_gridFpsSpin = new QSpinBox();
+    m_gridFpsSpin->setRange(0, 30);
+    m_gridFpsSpin->setValue(5);
+    m_gridFpsSpin->setPrefix("九宮格 ");
+    m_gridFpsSpin->setSuffix(" fps");
+    m_gridFpsSpin->setSpecialValueText("九宮格不限幀率");
+    // CPU 不夠時的退路：沒有子碼流的格子只解關鍵幀，畫面一個 GOP 才更新一次
+    m_gridKeyFrameCheck = new QCheckBox("九宮格只解關鍵幀");
+    m_gridKeyFrameCheck->setToolTip("沒有子碼流的攝影機在九宮格只解關鍵幀，最省 CPU，但畫面約每秒才更新一次以下");
+
+    // 本機轉播：其他工作站或外部播放器改看這裡，不再各自連攝影機
+    m_relayCheck = new QCheckBox(QString("本機轉播 (埠 %1)").arg(kRelayPort));
+    // 效能面板：各攝影機的碼率、幀率、延遲、佇列與各階段 CPU
+    m_metricsCheck = new QCheckBox("效能面板");
+    QPushButton *storageBtn = new QPushButton("儲存空間設定");
     QPushButton *mgrBtn = new QPushButton("檔案管理");
 
     leftLayout->addWidget(new QLabel("設備清單:"));
@@ -69,10 +143,24 @@ void MainWindow::setupUi() {
     leftLayout->addWidget(addBtn);
     leftLayout->addWidget(playBtn);
     leftLayout->addWidget(delBtn);
+    leftLayout->addWidget(preRollBtn);
+    leftLayout->addWidget(m_mosaicCheck);
+    leftLayout->addWidget(m_gridFpsSpin);
+    leftLayout->addWidget(m_gridKeyFrameCheck);
     leftLayout->addSpacing(20);
+    leftLayout->addWidget(new QLabel("錄影分段:"));
+    leftLayout->addWidget(m_segmentMinutesSpin);
+    leftLayout->addWidget(m_containerCombo);
+    leftLayout->addWidget(m_preRollSpin);
     leftLayout->addWidget(m_recordBtn);
     leftLayout->addWidget(m_globalProgressBar);
+    leftLayout->addWidget(m_motionCheck);
+    leftLayout->addWidget(m_postRollSpin);
+    leftLayout->addWidget(m_sensitivitySpin);
     leftLayout->addStretch();
+    leftLayout->addWidget(m_relayCheck);
+    leftLayout->addWidget(m_metricsCheck);
+    leftLayout->addWidget(storageBtn);
     leftLayout->addWidget(mgrBtn);
     leftPanel->setFixedWidth(200);
 
@@ -82,10 +170,17 @@ void MainWindow::setupUi() {
     // 頁面 0: 九宮格
     m_gridPage = new QWidget();
     m_gridLayout = new QGridLayout(m_gridPage);
-    QScrollArea *scroll = new QScrollArea();
-    scroll->setWidget(m_gridPage);
-    scroll->setWidgetResizable(true);
-    m_stackedWidget->addWidget(scroll);
+    m_gridScroll = new QScrollArea();
+    m_gridScroll->setWidget(m_gridPage);
+    m_gridScroll->setWidgetResizable(true);
+    m_mosaicWidget = new MosaicWidget();
+    m_mosaicWidget->hide();
+    QWidget *gridContainer = new QWidget();
+    QVBoxLayout *gridContainerLayout = new QVBoxLayout(gridContainer);
+    gridContainerLayout->setContentsMargins(0, 0, 0, 0);
+    gridContainerLayout->addWidget(m_gridScroll);
+    gridContainerLayout->addWidget(m_mosaicWidget);
+    m_stackedWidget->addWidget(gridContainer);
 
     // 頁面 1: 放大畫面
     m_focusVideoWidget = new ClickableVideoWidget();
@@ -96,9 +191,46 @@ void MainWindow::setupUi() {
     m_managerPage = new QWidget();
     QVBoxLayout *manLayout = new QVBoxLayout(m_managerPage);
 
-    // 上半部：影片列表
-    m_fileListWidget = new QListWidget();
-    m_fileListWidget->setMaximumHeight(200);
+    // 上半部：影片列表，資料來自錄影索引，不掃描資料夾
+    m_recordingIndex = m_engine->recordingIndex();
+    m_recordingModel = new RecordingListModel(m_recordingIndex, this);
+    m_eventIndex = m_engine->eventIndex();
+    m_storageManager = m_engine->storageManager();
+
+    m_fileListView = new QListView();
+    m_fileListView->setModel(m_recordingModel);
+    m_fileListView->setUniformItemSizes(true);
+    m_fileListView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_fileListView->setMaximumHeight(260);
+
+    // 縮圖在背景產生，清單捲到哪裡才載入到哪裡
+    m_thumbnailStore = m_engine->thumbnailStore();
+    m_recordingModel->setThumbnailStore(m_thumbnailStore);
+    m_fileListView->setIconSize(ThumbnailStore::thumbnailSize() * 0.6);
+    m_recordingCountLabel = new QLabel();
+
+    // 篩選：攝影機與時間區間
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    m_cameraFilterCombo = new QComboBox();
+    m_cameraFilterCombo->setMinimumWidth(200);
+    m_timeFilterCheck = new QCheckBox("時間:");
+    m_fromEdit = new QDateTimeEdit(QDateTime::currentDateTime().addDays(-1));
+    m_toEdit = new QDateTimeEdit(QDateTime::currentDateTime());
+    m_fromEdit->setDisplayFormat("yyyy-MM-dd HH:mm");
+    m_toEdit->setDisplayFormat("yyyy-MM-dd HH:mm");
+    m_fromEdit->setCalendarPopup(true);
+    m_toEdit->setCalendarPopup(true);
+    m_fromEdit->setEnabled(false);
+    m_toEdit->setEnabled(false);
+    filterLayout->addWidget(new QLabel("攝影機:"));
+    filterLayout->addWidget(m_cameraFilterCombo);
+    filterLayout->addSpacing(10);
+    filterLayout->addWidget(m_timeFilterCheck);
+    filterLayout->addWidget(m_fromEdit);
+    filterLayout->addWidget(new QLabel("~"));
+    filterLayout->addWidget(m_toEdit);
+    filterLayout->addStretch();
+    filterLayout->addWidget(m_recordingCountLabel);
 
     // 中間：內建播放器
     QWidget *playerContainer = new QWidget();
@@ -108,10 +240,13 @@ void MainWindow::setupUi() {
     m_playbackVideoWidget->setStyleSheet("background: black;");
     m_playbackVideoWidget->setMinimumHeight(400);
 
-    m_playbackPlayer = new QMediaPlayer(this);
-    m_playbackAudioOutput = new QAudioOutput(this);
-    m_playbackPlayer->setVideoOutput(m_playbackVideoWidget);
-    m_playbackPlayer->setAudioOutput(m_playbackAudioOutput);
+    // 同攝影機的分段接成一條時間軸，換段不重新初始化畫面
+    m_timelinePlayer = new TimelinePlayer(m_playbackVideoWidget->videoSink(), this);
+
+    // 拖曳進度條時由 FrameSeeker 直接出畫面，放開後才交回播放器
+    m_frameSeeker = new FrameSeeker(this);
+    m_frameSeeker->setVideoSink(m_playbackVideoWidget->videoSink());
+    m_frameSeeker->start();
 
     // 播放控制欄
     QHBoxLayout *controlLayout = new QHBoxLayout();
@@ -120,6 +255,11 @@ void MainWindow::setupUi() {
     m_stopBtn = new QPushButton("■");
     m_stopBtn->setFixedSize(40, 40);
     m_positionSlider = new QSlider(Qt::Horizontal);
+    m_positionSlider->setMouseTracking(true);
+    m_positionSlider->installEventFilter(this);
+    m_previewPopup = new QLabel(this, Qt::ToolTip);
+    m_previewPopup->setStyleSheet("border: 1px solid #333; background: black;");
+    m_previewPopup->hide();
     m_timeLabel = new QLabel("00:00 / 00:00");
     m_timeLabel->setMinimumWidth(120);
     m_volumeSlider = new QSlider(Qt::Horizontal);
@@ -135,38 +275,107 @@ void MainWindow::setupUi() {
     controlLayout->addWidget(volumeIcon);
     controlLayout->addWidget(m_volumeSlider);
 
+    // 時間軸：整天連續播放與依實際時間跳轉
+    QHBoxLayout *timelineLayout = new QHBoxLayout();
+    m_timelineCheck = new QCheckBox("同攝影機整天連續播放");
+    m_timelineCheck->setChecked(true);
+    m_jumpTimeEdit = new QTimeEdit();
+    m_jumpTimeEdit->setDisplayFormat("HH:mm:ss");
+    QPushButton *jumpBtn = new QPushButton("跳至");
+    timelineLayout->addWidget(m_timelineCheck);
+    timelineLayout->addStretch();
+    timelineLayout->addWidget(new QLabel("時間:"));
+    timelineLayout->addWidget(m_jumpTimeEdit);
+    timelineLayout->addWidget(jumpBtn);
+
     playerLayout->addWidget(m_playbackVideoWidget);
     playerLayout->addLayout(controlLayout);
+    playerLayout->addLayout(timelineLayout);
 
     // 下半部：按鈕
     QHBoxLayout *btnLayout = new QHBoxLayout();
     QPushButton *openInExternalBtn = new QPushButton("用外部播放器開啟");
     QPushButton *openFolderBtn = new QPushButton("開啟錄影資料夾");
     QPushButton *deleteFileBtn = new QPushButton("刪除選定影片");
+    QPushButton *syncPlayBtn = new QPushButton("多攝影機同步回放");
+    QPushButton *exportClipBtn = new QPushButton("匯出片段");
+    QPushButton *searchEventsBtn = new QPushButton("搜尋移動事件");
     QPushButton *backBtn = new QPushButton("返回監控畫面");
 
     btnLayout->addWidget(openInExternalBtn);
     btnLayout->addWidget(openFolderBtn);
     btnLayout->addWidget(deleteFileBtn);
+    btnLayout->addWidget(syncPlayBtn);
+    btnLayout->addWidget(exportClipBtn);
+    btnLayout->addWidget(searchEventsBtn);
 
     manLayout->addWidget(new QLabel("已儲存影片 (雙擊播放):"));
-    manLayout->addWidget(m_fileListWidget);
+    manLayout->addLayout(filterLayout);
+    manLayout->addWidget(m_fileListView);
     manLayout->addWidget(playerContainer);
     manLayout->addLayout(btnLayout);
     manLayout->addWidget(backBtn);
     m_stackedWidget->addWidget(m_managerPage);
 
+    // 頁面 3：多攝影機同步回放
+    m_syncPage = new SyncPlaybackPage();
+    m_stackedWidget->addWidget(m_syncPage);
+
+    m_metricsTable = new QTableWidget(0, 10);
+    m_metricsTable->setHorizontalHeaderLabels({"攝影機", "碼率 kbps", "收到 fps", "解碼 fps", "顯示 fps", "丟幀 fps",
+                                               "延遲 ms", "錄影 KB/s", "佇列", "CPU %"});
+    m_metricsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_metricsTable->horizontalHeader()->setStretchLastSection(true);
+    m_metricsTable->verticalHeader()->hide();
+    m_metricsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_metricsTable->setSelectionMode(QAbstractItemView::NoSelection);
+    m_metricsTable->setMaximumHeight(180);
+    m_metricsTable->hide();
+
+    QVBoxLayout *rightLayout = new QVBoxLayout();
+    rightLayout->addWidget(m_stackedWidget, 1);
+    rightLayout->addWidget(m_metricsTable);
+
     mainLayout->addWidget(leftPanel);
-    mainLayout->addWidget(m_stackedWidget);
+    mainLayout->addLayout(rightLayout);
+
+    // 只解碼看得到的格子
+    m_decodeScheduler = new DecodeScheduler(this, m_gridScroll, m_stackedWidget, this);
+    m_decodeScheduler->setMosaic(m_mosaicWidget);
+    m_decodeScheduler->setGridFrameRate(m_gridFpsSpin->value());
 
     // 連結
     connect(addBtn, &QPushButton::clicked, this, &MainWindow::onAddStream);
     connect(playBtn, &QPushButton::clicked, this, &MainWindow::onPlaySelectedLive);
     connect(delBtn, &QPushButton::clicked, this, &MainWindow::onDeleteCamera);
+    connect(preRollBtn, &QPushButton::clicked, this, &MainWindow::onCameraPreRollSettings);
     connect(m_recordBtn, &QPushButton::toggled, this, &MainWindow::onToggleGlobalRecording);
+    connect(storageBtn, &QPushButton::clicked, this, &MainWindow::onStorageSettings);
+    connect(m_relayCheck, &QCheckBox::toggled, this, [this](bool checked){
+        if (checked) m_engine->startRelay(kRelayPort);
+        else m_engine->stopRelay();
+        for (PlayerUnit *unit : std::as_const(m_playerUnits)) updateUnitToolTip(unit);
+    });
+    connect(m_metricsCheck, &QCheckBox::toggled, this, [this](bool checked){
+        m_metricsTable->setVisible(checked);
+        if (checked) updateMetricsPanel(m_engine->metricsSampler()->latest());
+    });
     connect(mgrBtn, &QPushButton::clicked, this, &MainWindow::switchToManagerPage);
+    connect(m_gridFpsSpin, &QSpinBox::valueChanged, m_decodeScheduler, &DecodeScheduler::setGridFrameRate);
+    connect(m_gridKeyFrameCheck, &QCheckBox::toggled, m_decodeScheduler, &DecodeScheduler::setGridKeyFramesOnly);
+    connect(m_mosaicCheck, &QCheckBox::toggled, this, [this](bool mosaic){
+        m_gridScroll->setVisible(!mosaic);
+        m_mosaicWidget->setVisible(mosaic);
+        for (PlayerUnit *unit : m_playerUnits) bindLiveOutputs(unit);
+        m_decodeScheduler->schedule();
+    });
+    connect(m_mosaicWidget, &MosaicWidget::tileClicked, this, [this](const QString &url){
+        if (PlayerUnit *unit = findUnit(url)) toggleFocus(unit);
+    });
+    m_engine->setPreRollSeconds(m_preRollSpin->value());
+    connect(m_preRollSpin, &QSpinBox::valueChanged, m_engine, &RecorderEngine::setPreRollSeconds);
     connect(backBtn, &QPushButton::clicked, this, [this](){
-        m_playbackPlayer->stop();
+        m_timelinePlayer->stop();
         m_stackedWidget->setCurrentIndex(0);
     });
     connect(openFolderBtn, &QPushButton::clicked, this, [this](){
@@ -174,82 +383,355 @@ void MainWindow::setupUi() {
     });
     connect(openInExternalBtn, &QPushButton::clicked, this, &MainWindow::onOpenInExternalPlayer);
     connect(deleteFileBtn, &QPushButton::clicked, this, &MainWindow::onDeleteRecordedVideo);
-    connect(m_fileListWidget, &QListWidget::itemDoubleClicked, this, [this](){
+    connect(syncPlayBtn, &QPushButton::clicked, this, &MainWindow::onSyncPlayback);
+    connect(exportClipBtn, &QPushButton::clicked, this, &MainWindow::onExportClip);
+    connect(searchEventsBtn, &QPushButton::clicked, this, &MainWindow::onSearchEvents);
+    connect(m_syncPage, &SyncPlaybackPage::backRequested, this, [this](){
+        m_stackedWidget->setCurrentIndex(2);
+    });
+    connect(m_fileListView, &QListView::doubleClicked, this, [this](){
         onPlayRecordedVideo();
     });
+    connect(m_cameraFilterCombo, &QComboBox::currentIndexChanged, this, &MainWindow::applyRecordingFilter);
+    connect(m_timeFilterCheck, &QCheckBox::toggled, this, [this](bool checked){
+        m_fromEdit->setEnabled(checked);
+        m_toEdit->setEnabled(checked);
+        applyRecordingFilter();
+    });
+    connect(m_fromEdit, &QDateTimeEdit::dateTimeChanged, this, &MainWindow::applyRecordingFilter);
+    connect(m_toEdit, &QDateTimeEdit::dateTimeChanged, this, &MainWindow::applyRecordingFilter);
+    auto updateCount = [this](){
+        int count = m_recordingModel->rowCount();
+        m_recordingCountLabel->setText(count > 0 ? QString("共 %1 個檔案").arg(count) : "（尚無錄影檔案）");
+    };
+    connect(m_recordingModel, &QAbstractItemModel::modelReset, this, updateCount);
+    connect(m_recordingModel, &QAbstractItemModel::rowsInserted, this, updateCount);
+    updateCount();
 
     // 播放器控制
     connect(m_playBtn, &QPushButton::clicked, this, [this](){
-        if (m_playbackPlayer->playbackState() == QMediaPlayer::PlayingState) {
-            m_playbackPlayer->pause();
-            m_playBtn->setText("▶");
+        if (m_timelinePlayer->playbackState() == QMediaPlayer::PlayingState) {
+            m_timelinePlayer->pause();
         } else {
-            m_playbackPlayer->play();
-            m_playBtn->setText("⏸");
+            m_timelinePlayer->play();
         }
     });
 
     connect(m_stopBtn, &QPushButton::clicked, this, [this](){
-        m_playbackPlayer->stop();
-        m_playBtn->setText("▶");
+        m_timelinePlayer->stop();
+    });
+
+    connect(m_positionSlider, &QSlider::sliderPressed, this, [this](){
+        m_resumeAfterScrub = m_timelinePlayer->playbackState() == QMediaPlayer::PlayingState;
+        if (m_resumeAfterScrub) m_timelinePlayer->pause();
     });
 
     connect(m_positionSlider, &QSlider::sliderMoved, this, [this](int position){
-        m_playbackPlayer->setPosition(position);
+        // 拖到哪一段就讓 FrameSeeker 開哪一段
+        qint64 offset = 0;
+        int segment = m_timelinePlayer->locate(m_timelinePlayer->startMs() + position, &offset);
+        if (segment < 0) return;
+        const QString filePath = m_timelinePlayer->filePathAt(segment);
+        if (filePath != m_scrubFilePath) {
+            m_scrubFilePath = filePath;
+            m_frameSeeker->open(filePath);
+        }
+        m_frameSeeker->seek(offset);
+        updateTimeLabel();
+    });
+
+    connect(m_positionSlider, &QSlider::sliderReleased, this, [this](){
+        m_timelinePlayer->seek(m_timelinePlayer->startMs() + m_positionSlider->value());
+        if (m_resumeAfterScrub) m_timelinePlayer->play();
+    });
+
+    connect(jumpBtn, &QPushButton::clicked, this, [this](){
+        if (m_timelinePlayer->isEmpty()) return;
+        QDateTime target(QDateTime::fromMSecsSinceEpoch(m_timelinePlayer->startMs()).date(), m_jumpTimeEdit->time());
+        m_timelinePlayer->seek(qBound(m_timelinePlayer->startMs(), target.toMSecsSinceEpoch(), m_timelinePlayer->endMs()));
     });
 
     connect(m_volumeSlider, &QSlider::valueChanged, this, [this](int value){
-        m_playbackAudioOutput->setVolume(value / 100.0);
+        m_timelinePlayer->setVolume(value / 100.0);
     });
 
-    connect(m_playbackPlayer, &QMediaPlayer::positionChanged, this, [this](qint64 position){
-        m_positionSlider->setValue(position);
+    // 進度條以時間軸開頭為 0，一整天的毫秒數放得進 int
+    connect(m_timelinePlayer, &TimelinePlayer::positionChanged, this, [this](qint64 position){
+        if (!m_positionSlider->isSliderDown()) m_positionSlider->setValue(position - m_timelinePlayer->startMs());
         updateTimeLabel();
     });
 
-    connect(m_playbackPlayer, &QMediaPlayer::durationChanged, this, [this](qint64 duration){
-        m_positionSlider->setRange(0, duration);
+    connect(m_timelinePlayer, &TimelinePlayer::rangeChanged, this, [this](qint64 start, qint64 end){
+        m_positionSlider->setRange(0, int(qMin<qint64>(end - start, INT_MAX)));
         updateTimeLabel();
     });
 
-    connect(m_playbackPlayer, &QMediaPlayer::playbackStateChanged, this, [this](QMediaPlayer::PlaybackState state){
-        if (state == QMediaPlayer::StoppedState) {
-            m_playBtn->setText("▶");
-        }
+    connect(m_timelinePlayer, &TimelinePlayer::playbackStateChanged, this, [this](QMediaPlayer::PlaybackState state){
+        m_playBtn->setText(state == QMediaPlayer::PlayingState ? "⏸" : "▶");
     });
 
     connect(m_focusVideoWidget, &ClickableVideoWidget::clicked, this, [this](){
         if (m_currentFocusedUnit) toggleFocus(m_currentFocusedUnit);
     });
+
+    // 錄影控制
+    m_recordingController = m_engine->recordingController();
+    connect(m_recordingController, &RecordingController::startCompleted, this, &MainWindow::onRecordingStartCompleted);
+    connect(m_recordingController, &RecordingController::stopCompleted, this, &MainWindow::onRecordingStopCompleted);
+    connect(m_recordingController, &RecordingController::recordingStarted, this, [](const QString &url, const QString &file){
+        qDebug() << "開始寫入:" << url << file;
+    });
+    connect(m_recordingController, &RecordingController::recordingFailed, this, [this](const QString &url, const QString &error){
+        qDebug() << "錄影錯誤:" << url << error;
+        m_recordingErrors << url + ": " + error;
+    });
+    connect(m_recordingController, &RecordingController::profileSelected, this, [this](const QString &url, const QString &summary){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->recordingProfile = summary;
+            unit->transcodeLoad = -1;
+            updateUnitToolTip(unit);
+        }
+    });
+    connect(m_recordingController, &RecordingController::transcodeLoad, this, [this](const QString &url, double percent){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->transcodeLoad = percent;
+            updateUnitToolTip(unit);
+        }
+    });
+    connect(m_recordingController, &RecordingController::recordingGap, this, [](const QString &url, const QDateTime &start, const QDateTime &end){
+        qDebug() << "錄影中斷後已恢復:" << url << start.toString("HH:mm:ss") << "~" << end.toString("HH:mm:ss");
+    });
+
+    // 移動觸發錄影；全域錄影進行中時只偵測，事件標在全域錄影的分段上
+    m_motionRecorder = m_engine->motionRecorder();
+    m_engine->setMotionPostRoll(m_postRollSpin->value());
+    m_engine->setMotionSensitivity(m_sensitivitySpin->value());
+    connect(m_motionCheck, &QCheckBox::toggled, this, &MainWindow::onToggleMotionRecording);
+    connect(m_postRollSpin, &QSpinBox::valueChanged, m_engine, &RecorderEngine::setMotionPostRoll);
+    connect(m_sensitivitySpin, &QSpinBox::valueChanged, m_engine, &RecorderEngine::setMotionSensitivity);
+    connect(m_segmentMinutesSpin, &QSpinBox::valueChanged, this, [this](){
+        m_engine->setMotionOptions(recorderOptions());
+    });
+    connect(m_containerCombo, &QComboBox::currentIndexChanged, this, [this](){
+        m_engine->setMotionOptions(recorderOptions());
+    });
+    connect(m_motionRecorder, &MotionRecorder::motionStarted, this, [this](const QString &url){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->motion = true;
+            updateUnitStyle(unit);
+        }
+    });
+    connect(m_motionRecorder, &MotionRecorder::motionStopped, this, [this](const QString &url){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->motion = false;
+            updateUnitStyle(unit);
+        }
+    });
+    connect(m_motionRecorder, &MotionRecorder::recordingStarted, this, [](const QString &url, const QString &file){
+        qDebug() << "移動錄影開始寫入:" << url << file;
+    });
+    connect(m_motionRecorder, &MotionRecorder::recordingFailed, this, [](const QString &url, const QString &error){
+        qDebug() << "移動錄影錯誤:" << url << error;
+    });
+
+    // 攝影機連線狀態；以網址查找，攝影機被移除後遲到的結果直接忽略
+    connect(m_engine, &RecorderEngine::cameraProbed, this, [this](const QString &url, const StreamProbe &probe){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->probe = probe;
+            updateUnitToolTip(unit);
+        }
+    });
+    connect(m_engine, &RecorderEngine::cameraReconnecting, this, [this](const QString &url, int attempt, int delayMs){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->connectionState = QString("斷線，%1 秒後第 %2 次重連").arg(delayMs / 1000.0, 0, 'f', 0).arg(attempt);
+            updateUnitToolTip(unit);
+        }
+    });
+    connect(m_engine, &RecorderEngine::cameraOpened, this, [this](const QString &url){
+        if (PlayerUnit *unit = findUnit(url)) {
+            unit->connectionState.clear();
+            updateUnitToolTip(unit);
+        }
+    });
+}
+
+RecorderOptions MainWindow::recorderOptions() const {
+    RecorderOptions options;
+    options.container = RecorderOptions::Container(m_containerCombo->currentData().toInt());
+    options.segmentSeconds = m_segmentMinutesSpin->value() * 60;
+    return options;
+}
+
+void MainWindow::onToggleMotionRecording(bool checked) {
+    if (!checked) {
+        m_engine->setMotionRecording(false);
+        for (PlayerUnit *unit : m_playerUnits) {
+            unit->motion = false;
+            updateUnitStyle(unit);
+        }
+        return;
+    }
+
+    m_engine->setMotionOptions(recorderOptions());
+    m_engine->setMotionRecording(true);
+}
+
+void MainWindow::onStorageSettings() {
+    static const qint64 kGiB = 1024LL * 1024 * 1024;
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("儲存空間設定");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    // 第一個是主要錄影資料夾，不能移除；新加入的攝影機分到攝影機最少的位置
+    QListWidget *volumeList = new QListWidget();
+    for (const QString &volume : m_storageManager->volumes()) {
+        const qint64 available = m_storageManager->availableBytes(volume);
+        QListWidgetItem *item = new QListWidgetItem(available < 0 ? volume
+                                                    : QString("%1  (可用 %2 GB)").arg(volume).arg(available / double(kGiB), 0, 'f', 1));
+        item->setData(Qt::UserRole, volume);
+        volumeList->addItem(item);
+    }
+    QPushButton *addVolumeBtn = new QPushButton("新增儲存位置");
+    QPushButton *removeVolumeBtn = new QPushButton("移除選定位置");
+    connect(addVolumeBtn, &QPushButton::clicked, &dialog, [&dialog, volumeList](){
+        const QString path = QFileDialog::getExistingDirectory(&dialog, "選擇錄影儲存位置");
+        if (path.isEmpty()) return;
+        QListWidgetItem *item = new QListWidgetItem(path);
+        item->setData(Qt::UserRole, path);
+        volumeList->addItem(item);
+    });
+    connect(removeVolumeBtn, &QPushButton::clicked, &dialog, [volumeList](){
+        if (volumeList->currentRow() > 0) delete volumeList->takeItem(volumeList->currentRow());
+    });
+    QHBoxLayout *volumeButtons = new QHBoxLayout();
+    volumeButtons->addWidget(addVolumeBtn);
+    volumeButtons->addWidget(removeVolumeBtn);
+
+    auto gigabyteSpin = [](qint64 bytes, const QString &specialText) {
+        QSpinBox *spin = new QSpinBox();
+        spin->setRange(0, 1000000);
+        spin->setSuffix(" GB");
+        spin->setSpecialValueText(specialText);
+        spin->setValue(int(bytes / kGiB));
+        return spin;
+    };
+    QSpinBox *globalSpin = gigabyteSpin(m_storageManager->globalQuota(), "不限");
+    QSpinBox *cameraSpin = gigabyteSpin(m_storageManager->cameraQuota(), "不限");
+    QSpinBox *minFreeSpin = gigabyteSpin(m_storageManager->minFreeBytes(), "不保留");
+
+    // 預錄緩衝放在記憶體：每路預設上限與所有攝影機合計上限
+    static const qint64 kMiB = 1024LL * 1024;
+    QSpinBox *preRollMaxSpin = new QSpinBox();
+    preRollMaxSpin->setRange(1, 4096);
+    preRollMaxSpin->setSuffix(" MB");
+    preRollMaxSpin->setValue(int(m_engine->preRollMaxBytes() / kMiB));
+    QSpinBox *preRollBudgetSpin = new QSpinBox();
+    preRollBudgetSpin->setRange(1, 65536);
+    preRollBudgetSpin->setSuffix(" MB");
+    preRollBudgetSpin->setValue(int(m_engine->preRollBudget() / kMiB));
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(new QLabel("儲存位置（第一個為主要錄影資料夾）:"));
+    form->addRow(volumeList);
+    form->addRow(volumeButtons);
+    form->addRow("全部錄影上限:", globalSpin);
+    form->addRow("每台攝影機上限:", cameraSpin);
+    form->addRow("每個位置至少保留:", minFreeSpin);
+    form->addRow(new QLabel("超過上限時自動從最舊的錄影開始刪除。"));
+    form->addRow("每台預錄記憶體上限:", preRollMaxSpin);
+    form->addRow("預錄記憶體總量:", preRollBudgetSpin);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    QStringList volumes;
+    for (int i = 0; i < volumeList->count(); ++i) volumes << volumeList->item(i)->data(Qt::UserRole).toString();
+    m_storageManager->setVolumes(volumes);
+    m_storageManager->setGlobalQuota(globalSpin->value() * kGiB);
+    m_storageManager->setCameraQuota(cameraSpin->value() * kGiB);
+    m_storageManager->setMinFreeBytes(minFreeSpin->value() * kGiB);
+    m_engine->setPreRollMaxBytes(preRollMaxSpin->value() * kMiB);
+    m_engine->setPreRollBudget(preRollBudgetSpin->value() * kMiB);
+    m_storageManager->save();
+    m_storageManager->scheduleCleanup();
+}
+
+void MainWindow::onCameraPreRollSettings() {
+    QListWidgetItem *item = m_streamList->currentItem();
+    if (!item) return;
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("預錄設定");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    // 最小值代表沿用左側的預錄秒數與儲存空間設定裡的每台上限
+    QSpinBox *secondsSpin = new QSpinBox();
+    secondsSpin->setRange(-1, 60);
+    secondsSpin->setSuffix(" 秒");
+    secondsSpin->setSpecialValueText("使用預設");
+    secondsSpin->setValue(item->data(kPreRollSecondsRole).isValid() ? item->data(kPreRollSecondsRole).toInt() : -1);
+    QSpinBox *maxSpin = new QSpinBox();
+    maxSpin->setRange(0, 4096);
+    maxSpin->setSuffix(" MB");
+    maxSpin->setSpecialValueText("使用預設");
+    maxSpin->setValue(item->data(kPreRollMaxMbRole).toInt());
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(new QLabel(item->text()));
+    form->addRow("預錄長度:", secondsSpin);
+    form->addRow("記憶體上限:", maxSpin);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    item->setData(kPreRollSecondsRole, secondsSpin->value());
+    item->setData(kPreRollMaxMbRole, maxSpin->value());
+    // 已經在播放的攝影機立刻套用
+    m_engine->setCameraPreRoll(item->text(), secondsSpin->value(), maxSpin->value() * 1024LL * 1024);
+}
+
+void MainWindow::updateUnitStyle(PlayerUnit *unit) {
+    unit->videoWidget->setStyleSheet(unit->motion ? "background: black; border: 2px solid #ff9900;"
+                                                  : "background: black; border: 2px solid #333;");
 }
 
 void MainWindow::onPlaySelectedLive() {
     QListWidgetItem *item = m_streamList->currentItem();
     if (!item) return;
-    PlayerUnit* unit = new PlayerUnit();
 
-    // 防止重複添加相同串流
-    if (!m_playerUnits.isEmpty())
-        for(PlayerUnit* a : m_playerUnits)
-            if(a -> streamUrl == item->text())
-                return;
+    // 擷取由引擎負責，即時畫面與錄影共用同一條連線；已在播放的攝影機不重複加入
+    CameraConfig camera;
+    camera.url = item->text();
+    camera.subUrl = item->data(kSubUrlRole).toString();
+    camera.preRollSeconds = item->data(kPreRollSecondsRole).isValid() ? item->data(kPreRollSecondsRole).toInt() : -1;
+    camera.preRollMaxBytes = item->data(kPreRollMaxMbRole).toLongLong() * 1024 * 1024;
+    if (!m_engine->addCamera(camera)) return;
 
-    // 播放用的 Player
-    unit->streamUrl = item->text();
-    unit->player = new QMediaPlayer(this);
-    unit->audioOutput = new QAudioOutput(this);
+    PlayerUnit* unit = new PlayerUnit();
+    unit->streamUrl = camera.url;
+    unit->ingest = m_engine->ingest(camera.url);
     unit->videoWidget = new ClickableVideoWidget();
 
-    unit->player->setVideoOutput(unit->videoWidget);
-    unit->player->setAudioOutput(unit->audioOutput);
-    unit->player->setSource(QUrl(unit->streamUrl));
-
-    // FFmpeg 錄影進程
-    unit->ffmpegProcess = nullptr;
-    unit->recordingFilePath = "";
+    unit->decoder = makeSink<LiveDecoder>();
+    unit->decoder->setMetrics(unit->ingest->metrics());
+    unit->ingest->addSink(unit->decoder);
+
+    // 有子碼流時九宮格解子碼流，主碼流只在放大時才解
+    unit->subStreamUrl = camera.subUrl;
+    unit->subIngest = m_engine->subIngest(camera.url);
+    if (unit->subIngest) {
+        unit->subDecoder = makeSink<LiveDecoder>();
+        unit->subDecoder->setMetrics(unit->subIngest->metrics());
+        unit->subIngest->addSink(unit->subDecoder);
+    }
+    unit->mosaicTile = std::make_shared<MosaicTile>(unit->streamUrl);
+    bindLiveOutputs(unit);
 
     unit->videoWidget->setMinimumSize(320, 180);
-    unit->videoWidget->setStyleSheet("background: black; border: 2px solid #333;");
+    updateUnitStyle(unit);
 
     connect(unit->videoWidget, &ClickableVideoWidget::clicked, this, [this, unit](){
         toggleFocus(unit);
@@ -258,259 +740,214 @@ void MainWindow::onPlaySelectedLive() {
     m_playerUnits.append(unit);
     int idx = m_playerUnits.size() - 1;
     m_gridLayout->addWidget(unit->videoWidget, idx / 3, idx % 3);
-    unit->player->play();
+    m_mosaicWidget->addTile(unit->mosaicTile);
+    m_decodeScheduler->addTile(unit->videoWidget, unit->subDecoder ? unit->subDecoder : unit->decoder,
+                               unit->decoder);
 }
 
 void MainWindow::onToggleGlobalRecording(bool checked) {
-    QString path = getRecordingsPath();
-
     if (checked) {
         if (m_playerUnits.isEmpty()) {
             QMessageBox::warning(this, "警告", "請先新增並播放至少一個串流來源！");
+            QSignalBlocker blocker(m_recordBtn);
             m_recordBtn->setChecked(false);
             return;
         }
 
-        // 開始錄影 - 使用 FFmpeg
-        int successCount = 0;
-        QString errorLog;
-
-        for (PlayerUnit* unit : m_playerUnits) {
-            // 為每個串流生成唯一檔名
-            QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss");
-            QString fileName = path + "/REC_" + timestamp + "_" + QString::number(successCount) + ".mp4";
-
-            unit->recordingFilePath = fileName;
-
-            // 建立 FFmpeg 進程
-            unit->ffmpegProcess = new QProcess(this);
-
-            // 設定工作目錄
-            unit->ffmpegProcess->setWorkingDirectory(path);
-
-            // FFmpeg 命令 - 根據串流類型調整
-            QStringList args;
-
-            // 判斷串流類型
-            bool isRTSP = unit->streamUrl.startsWith("rtsp://", Qt::CaseInsensitive);
-            bool isHTTP = unit->streamUrl.startsWith("http://", Qt::CaseInsensitive) ||
-                          unit->streamUrl.startsWith("https://", Qt::CaseInsensitive);
-            bool isMJPEG = isHTTP && (unit->streamUrl.contains("8081") ||
-                                      unit->streamUrl.contains("mjpeg", Qt::CaseInsensitive) ||
-                                      unit->streamUrl.contains("mpjpeg", Qt::CaseInsensitive));
-
-            if (isRTSP) {
-                // RTSP 串流設定
-                args << "-rtsp_transport" << "tcp"
-                     << "-i" << unit->streamUrl;
-
-                // 嘗試直接複製（更快）
-                args << "-c:v" << "copy"
-                     << "-c:a" << "aac";
-
-            } else if (isMJPEG) {
-                // MJPEG over HTTP 串流設定
-                args << "-f" << "mjpeg"               // 指定輸入格式
-                     << "-i" << unit->streamUrl;
-
-                // MJPEG 必須重新編碼
-                args << "-c:v" << "libx264"
-                     << "-preset" << "ultrafast"
-                     << "-crf" << "23"
-                     << "-pix_fmt" << "yuv420p"       // 像素格式轉換
-                     << "-r" << "25";                 // 設定輸出幀率
-
-                // 檢查是否有音訊
-                args << "-c:a" << "aac"
-                     << "-b:a" << "128k";
-
-            } else if (isHTTP) {
-                // HTTP/HTTPS 一般串流 (MPEG-TS, HLS 等)
-                args << "-i" << unit->streamUrl;
-
-                // 嘗試重新編碼
-                args << "-c:v" << "libx264"
-                     << "-preset" << "ultrafast"
-                     << "-crf" << "23";
-
-                // 如果有音訊就編碼
-                args << "-c:a" << "aac"
-                     << "-b:a" << "128k";
-            } else {
-                // 本地檔案或其他
-                args << "-i" << unit->streamUrl;
-                args << "-c:v" << "libx264"
-                     << "-preset" << "ultrafast"
-                     << "-crf" << "23"
-                     << "-c:a" << "aac";
-            }
-
-            // 通用設定
-            args << "-movflags" << "+faststart"
-                 << "-f" << "mp4"
-                 << "-t" << "3600"                    // 最長 1 小時
-                 << "-y"
-                 << fileName;
-
-            qDebug() << "啟動 FFmpeg:";
-            qDebug() << "串流類型:" << (isRTSP ? "RTSP" : (isMJPEG ? "MJPEG" : "HTTP"));
-            qDebug() << "命令:" << "ffmpeg" << args.join(" ");
-            qDebug() << "輸出檔案:" << fileName;
-
-            // 連接輸出以便除錯
-            connect(unit->ffmpegProcess, &QProcess::readyReadStandardOutput, this, [unit](){
-                qDebug() << "FFmpeg 輸出:" << unit->ffmpegProcess->readAllStandardOutput();
-            });
-
-            connect(unit->ffmpegProcess, &QProcess::readyReadStandardError, this, [unit](){
-                qDebug() << "FFmpeg 錯誤:" << unit->ffmpegProcess->readAllStandardError();
-            });
-
-            // 錯誤處理
-            connect(unit->ffmpegProcess, &QProcess::errorOccurred, this, [this, &errorLog](QProcess::ProcessError error){
-                QString errorMsg;
-                switch(error) {
-                case QProcess::FailedToStart:
-                    errorMsg = "FFmpeg 啟動失敗！請確認已安裝 FFmpeg。\n";
-                    break;
-                case QProcess::Crashed:
-                    errorMsg = "FFmpeg 錄影過程中崩潰！\n";
-                    break;
-                default:
-                    errorMsg = "FFmpeg 發生未知錯誤！\n";
-                }
-                errorLog += errorMsg;
-                qDebug() << errorMsg;
-            });
-
-            unit->ffmpegProcess->start("ffmpeg", args);
-
-            // 等待啟動並檢查狀態
-            if (unit->ffmpegProcess->waitForStarted(5000)) {
-                // 等待一下確認 FFmpeg 真的在工作
-                QThread::msleep(1000);
-
-                if (unit->ffmpegProcess->state() == QProcess::Running) {
-                    successCount++;
-                    qDebug() << "FFmpeg 成功啟動，錄影中...";
-                } else {
-                    qDebug() << "FFmpeg 啟動後立即停止！";
-                    errorLog += "串流 " + QString::number(successCount) + " 連接失敗\n";
-                }
-            } else {
-                qDebug() << "FFmpeg 啟動逾時！";
-                errorLog += "FFmpeg 啟動逾時\n";
-            }
-        }
-
-        if (successCount == 0) {
-            QString fullError = "所有錄影進程都啟動失敗！\n\n";
-            fullError += errorLog.isEmpty() ? "未知錯誤" : errorLog;
-            fullError += "\n請檢查：\n";
-            fullError += "1. FFmpeg 是否已安裝\n";
-            fullError += "2. 串流來源是否可連接\n";
-            fullError += "3. 網址格式是否正確\n\n";
-            fullError += "建議測試網址：\n";
-            fullError += "https://commondatastorage.googleapis.com/gtv-videos-bucket/sample/BigBuckBunny.mp4";
-
-            QMessageBox::critical(this, "錯誤", fullError);
-            m_recordBtn->setChecked(false);
-            return;
-        }
-
-        m_recordBtn->setText(QString("停止錄影 (%1 路)").arg(successCount));
-        m_recordBtn->setStyleSheet("background-color: #ff4d4d; color: white; font-weight: bold;");
+        m_recordingErrors.clear();
+        m_recordBtn->setEnabled(false);
+        m_recordBtn->setText("正在啟動錄影...");
         m_globalProgressBar->setVisible(true);
         m_globalProgressBar->setRange(0, 0);
 
+        m_segmentMinutesSpin->setEnabled(false);
+        m_containerCombo->setEnabled(false);
+
+        // 開始錄影 - 所有攝影機同時掛上錄影端，結果由 RecordingController 回報
+        m_engine->startRecording(recorderOptions());
     } else {
-        // 停止錄影
+        // 停止錄影：各路在自己的佇列執行緒寫完檔尾後回報
         qDebug() << "停止錄影...";
+        m_recordBtn->setEnabled(false);
+        m_recordBtn->setText("正在儲存...");
+        m_engine->stopRecording();
+    }
+}
 
-        QStringList savedFiles;
-
-        for (PlayerUnit* unit : m_playerUnits) {
-            if (unit->ffmpegProcess && unit->ffmpegProcess->state() == QProcess::Running) {
-                qDebug() << "正在停止錄影:" << unit->recordingFilePath;
-
-                // 發送 'q' 給 FFmpeg 正常結束
-                unit->ffmpegProcess->write("q\n");
-                unit->ffmpegProcess->closeWriteChannel();
-
-                if (unit->ffmpegProcess->waitForFinished(8000)) {
-                    qDebug() << "FFmpeg 已正常結束";
-
-                    // 等待檔案系統同步
-                    QThread::msleep(1000);
-
-                    // 檢查檔案是否存在
-                    QFileInfo fileInfo(unit->recordingFilePath);
-                    if (fileInfo.exists() && fileInfo.size() > 1024) { // 至少 1KB
-                        savedFiles << fileInfo.fileName();
-                        qDebug() << "檔案已儲存:" << unit->recordingFilePath
-                                 << "大小:" << (fileInfo.size() / 1024.0 / 1024.0) << "MB";
-                    } else {
-                        qDebug() << "警告：檔案不存在或太小 (<1KB)";
-                        qDebug() << "檔案路徑:" << unit->recordingFilePath;
-                        qDebug() << "檔案存在:" << fileInfo.exists();
-                        qDebug() << "檔案大小:" << fileInfo.size() << "bytes";
-                    }
-                } else {
-                    qDebug() << "FFmpeg 未能正常結束，強制終止";
-                    unit->ffmpegProcess->kill();
-                    unit->ffmpegProcess->waitForFinished(1000);
-                }
-
-                unit->ffmpegProcess->deleteLater();
-                unit->ffmpegProcess = nullptr;
-            }
-        }
+void MainWindow::onRecordingStartCompleted(int startedCount, int failedCount) {
+    m_recordBtn->setEnabled(true);
 
+    if (startedCount == 0) {
+        m_segmentMinutesSpin->setEnabled(true);
+        m_containerCombo->setEnabled(true);
+        QSignalBlocker blocker(m_recordBtn);
+        m_recordBtn->setChecked(false);
         m_recordBtn->setText("開啟全域錄影");
-        m_recordBtn->setStyleSheet("");
         m_globalProgressBar->setVisible(false);
 
-        // 顯示結果
-        if (savedFiles.isEmpty()) {
-            QMessageBox::warning(this, "警告",
-                                 "錄影已停止，但沒有檢測到有效的檔案！\n\n"
-                                 "可能原因：\n"
-                                 "1. 錄影時間太短（建議至少錄 5 秒）\n"
-                                 "2. 串流連接在錄影過程中斷\n"
-                                 "3. 串流格式不相容\n"
-                                 "4. 磁碟空間不足或無寫入權限\n\n"
-                                 "建議：\n"
-                                 "• 先用測試影片網址驗證功能\n"
-                                 "• 檢查 Qt Creator 的「應用程式輸出」視窗的 FFmpeg 訊息\n"
-                                 "• 手動檢查 recordings 資料夾");
-        } else {
-            qint64 totalSize = 0;
-            for (const QString &file : savedFiles) {
-                QFileInfo info(getRecordingsPath() + "/" + file);
-                totalSize += info.size();
-            }
+        QString fullError = "所有錄影都啟動失敗！\n\n";
+        fullError += m_recordingErrors.isEmpty() ? "未知錯誤" : m_recordingErrors.join("\n");
+        fullError += "\n\n請檢查：\n";
+        fullError += "1. 串流來源是否可連接\n";
+        fullError += "2. 網址格式是否正確\n\n";
+        fullError += "建議測試網址：\n";
+        fullError += "https://commondatastorage.googleapis.com/gtv-videos-bucket/sample/BigBuckBunny.mp4";
+
+        QMessageBox::critical(this, "錯誤", fullError);
+        return;
+    }
+
+    if (failedCount > 0) qDebug() << "部分攝影機未能開始錄影:" << m_recordingErrors;
+
+    m_recordBtn->setText(QString("停止錄影 (%1 路)").arg(startedCount));
+    m_recordBtn->setStyleSheet("background-color: #ff4d4d; color: white; font-weight: bold;");
+}
+
+void MainWindow::onRecordingStopCompleted(const QStringList &savedFiles) {
+    m_recordBtn->setEnabled(true);
+    m_segmentMinutesSpin->setEnabled(true);
+    m_containerCombo->setEnabled(true);
+    m_recordBtn->setText("開啟全域錄影");
+    m_recordBtn->setStyleSheet("");
+    m_globalProgressBar->setVisible(false);
+    showRecordingSummary(savedFiles);
+}
+
+void MainWindow::showRecordingSummary(const QStringList &savedFiles) {
+    // 顯示結果
+    if (savedFiles.isEmpty()) {
+        QMessageBox::warning(this, "警告",
+                             "錄影已停止，但沒有檢測到有效的檔案！\n\n"
+                             "可能原因：\n"
+                             "1. 錄影時間太短（建議至少錄 5 秒）\n"
+                             "2. 串流連接在錄影過程中斷\n"
+                             "3. 串流格式不相容\n"
+                             "4. 磁碟空間不足或無寫入權限\n\n"
+                             "建議：\n"
+                             "• 先用測試影片網址驗證功能\n"
+                             "• 檢查 Qt Creator 的「應用程式輸出」視窗的錄影訊息\n"
+                             "• 手動檢查 recordings 資料夾");
+    } else {
+        qint64 totalSize = 0;
+        for (const QString &file : savedFiles) {
+            QFileInfo info(file);
+            totalSize += info.size();
+        }
+
+        QMessageBox::information(this, "成功",
+                                 QString("成功儲存 %1 個影片檔案\n\n總大小：%2 MB\n\n儲存位置：\n%3")
+                                     .arg(savedFiles.size())
+                                     .arg(totalSize / 1024.0 / 1024.0, 0, 'f', 2)
+                                     .arg(getRecordingsPath()));
+    }
+}
+
+PlayerUnit *MainWindow::findUnit(const QString &url) const {
+    for (PlayerUnit *unit : m_playerUnits)
+        if (unit->streamUrl == url) return unit;
+    return nullptr;
+}
+
+void MainWindow::updateUnitToolTip(PlayerUnit *unit) {
+    QString tip = unit->streamUrl + "\n" + unit->probe.summary();
+    if (!unit->connectionState.isEmpty()) tip += "\n" + unit->connectionState;
+    const QString relayUrl = m_engine->relayUrl(unit->streamUrl);
+    if (!relayUrl.isEmpty()) tip += "\n轉播: " + relayUrl;
+    // 九宮格實際生效的解碼方式
+    const LiveDecoder *grid = unit->subDecoder ? unit->subDecoder.get() : unit->decoder.get();
+    tip += QString("\n畫面: %1%2").arg(unit->subDecoder ? "子碼流，" : "", decodeModeName(grid->decodeMode()));
+    if (!unit->recordingProfile.isEmpty()) {
+        tip += "\n錄影: " + unit->recordingProfile;
+        if (unit->transcodeLoad >= 0)
+            tip += QString(" (轉碼佔用 %1%)").arg(unit->transcodeLoad, 0, 'f', 1);
+    }
+    // 各接收端佇列：深度固定有上限，看得出哪一段跟不上
+    QVector<SinkQueueStats> queues = unit->ingest->queueStats();
+    if (unit->subIngest) queues += unit->subIngest->queueStats();
+    for (const SinkQueueStats &queue : std::as_const(queues)) {
+        tip += QString("\n佇列 %1: %2/%3 (%4 MB)").arg(queue.name).arg(queue.depth).arg(queue.capacity)
+                   .arg(queue.bytes / 1048576.0, 0, 'f', 1);
+        if (queue.dropped > 0) tip += QString("，已丟 %1").arg(queue.dropped);
+        if (queue.stalls > 0) tip += QString("，塞滿 %1 次").arg(queue.stalls);
+    }
+    unit->videoWidget->setToolTip(tip);
+}
 
-            QMessageBox::information(this, "成功",
-                                     QString("成功儲存 %1 個影片檔案\n\n總大小：%2 MB\n\n儲存位置：\n%3")
-                                         .arg(savedFiles.size())
-                                         .arg(totalSize / 1024.0 / 1024.0, 0, 'f', 2)
-                                         .arg(path));
+void MainWindow::updateMetricsPanel(const QVector<CameraMetrics> &metrics) {
+    m_metricsTable->setRowCount(metrics.size());
+    for (int row = 0; row < metrics.size(); ++row) {
+        const CameraMetrics &camera = metrics[row];
+
+        // 佇列欄只列名稱與深度，細節在提示裡
+        QStringList queueText;
+        QString queueTip;
+        for (const SinkQueueStats &queue : camera.queues + camera.subQueues) {
+            queueText << QString("%1 %2").arg(queue.name).arg(queue.depth);
+            queueTip += QString("%1: %2/%3，已丟 %4，塞滿 %5 次\n").arg(queue.name).arg(queue.depth).arg(queue.capacity)
+                            .arg(queue.dropped).arg(queue.stalls);
         }
+        QStringList cpuText;
+        for (const auto &stage : camera.cpuPercent)
+            cpuText << QString("%1 %2").arg(stage.first).arg(stage.second, 0, 'f', 1);
+
+        const QStringList cells = {
+            camera.camera,
+            QString::number(camera.bitrateKbps, 'f', 0),
+            QString::number(camera.receivedFps, 'f', 1),
+            QString::number(camera.decodedFps, 'f', 1),
+            QString::number(camera.displayedFps, 'f', 1),
+            QString::number(camera.droppedFps, 'f', 1),
+            camera.latencyMs >= 0 ? QString::number(camera.latencyMs, 'f', 0) : QString("-"),
+            QString::number(camera.recordKBps, 'f', 0),
+            queueText.join("  "),
+            cpuText.join("  "),
+        };
+        for (int column = 0; column < cells.size(); ++column) {
+            QTableWidgetItem *item = m_metricsTable->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem();
+                m_metricsTable->setItem(row, column, item);
+            }
+            item->setText(cells[column]);
+        }
+        m_metricsTable->item(row, 8)->setToolTip(queueTip.trimmed());
     }
 }
 
 void MainWindow::toggleFocus(PlayerUnit* unit) {
     if (m_stackedWidget->currentIndex() == 0) {
         m_currentFocusedUnit = unit;
-        unit->player->setVideoOutput(m_focusVideoWidget);
+        bindLiveOutputs(unit);
+        m_decodeScheduler->setFocusedTile(unit->videoWidget);
         m_stackedWidget->setCurrentIndex(1);
     } else {
-        unit->player->setVideoOutput(unit->videoWidget);
         m_currentFocusedUnit = nullptr;
+        bindLiveOutputs(unit);
+        m_decodeScheduler->setFocusedTile(nullptr);
         m_stackedWidget->setCurrentIndex(0);
     }
 }
 
+void MainWindow::bindLiveOutputs(PlayerUnit *unit) {
+    const bool mosaic = m_mosaicCheck->isChecked();
+    const bool focused = unit == m_currentFocusedUnit;
+    LiveDecoder *mainDecoder = unit->decoder.get();
+    LiveDecoder *grid = unit->subDecoder ? unit->subDecoder.get() : mainDecoder;
+
+    // 九宮格畫面：合成牆或各自的 QVideoWidget
+    grid->setMosaicTile(mosaic ? unit->mosaicTile : nullptr);
+    grid->setVideoSink(mosaic ? nullptr : unit->videoWidget->videoSink());
+
+    // 主碼流放大時畫到放大頁，有子碼流時不放大就不輸出
+    if (focused) {
+        mainDecoder->setMosaicTile(nullptr);
+        mainDecoder->setVideoSink(m_focusVideoWidget->videoSink());
+    } else if (mainDecoder != grid) {
+        mainDecoder->setMosaicTile(nullptr);
+        mainDecoder->setVideoSink(nullptr);
+    }
+}
+
 void MainWindow::onDeleteCamera() {
     if (m_playerUnits.isEmpty()) return;
     // PlayerUnit* unit = m_playerUnits.takeLast();
@@ -529,14 +966,10 @@ void MainWindow::onDeleteCamera() {
     // 如果沒找到就返回
     if(unit == nullptr) return;
 
-    // 停止錄影
-    if (unit->ffmpegProcess && unit->ffmpegProcess->state() == QProcess::Running) {
-        unit->ffmpegProcess->write("q\n");
-        unit->ffmpegProcess->waitForFinished(2000);
-        unit->ffmpegProcess->kill();
-    }
+    m_engine->removeCamera(unit->streamUrl);
 
-    unit->player->stop();
+    m_decodeScheduler->removeTile(unit->videoWidget);
+    m_mosaicWidget->removeTile(unit->mosaicTile);
     m_gridLayout->removeWidget(unit->videoWidget);
     unit->videoWidget->deleteLater();
     m_playerUnits.removeOne(unit);
@@ -553,64 +986,268 @@ QString MainWindow::getRecordingsPath() {
 void MainWindow::onAddStream() {
     bool ok;
     QString url = QInputDialog::getText(this, "新增串流", "請輸入網址或拖入檔案路徑:", QLineEdit::Normal, "", &ok);
-    if (ok && !url.isEmpty()) m_streamList->addItem(url.trimmed());
+    if (!ok || url.trimmed().isEmpty()) return;
+
+    // 攝影機通常另有低解析度子碼流，九宮格用它可省下大半解碼量
+    QString subUrl = QInputDialog::getText(this, "新增串流", "子碼流網址（選填，九宮格顯示用）:",
+                                           QLineEdit::Normal, "", &ok);
+    QListWidgetItem *item = new QListWidgetItem(url.trimmed());
+    if (ok && !subUrl.trimmed().isEmpty()) {
+        item->setData(kSubUrlRole, subUrl.trimmed());
+        item->setToolTip("子碼流: " + subUrl.trimmed());
+    }
+    m_streamList->addItem(item);
 }
 
-void MainWindow::switchToManagerPage() {
-    m_fileListWidget->clear();
-    QDir dir(getRecordingsPath());
-    QStringList files = dir.entryList(QStringList() << "*.mp4", QDir::Files, QDir::Time);
-
-    if (files.isEmpty()) {
-        QListWidgetItem *item = new QListWidgetItem("（尚無錄影檔案）");
-        item->setFlags(item->flags() & ~Qt::ItemIsEnabled); // 禁用該項目
-        m_fileListWidget->addItem(item);
-    } else {
-        for (const QString &file : files) {
-            QFileInfo info(dir.filePath(file));
-            QString displayText = QString("%1 (%2 MB)")
-                                      .arg(file)
-                                      .arg(info.size() / 1024.0 / 1024.0, 0, 'f', 2);
-            QListWidgetItem *item = new QListWidgetItem(displayText);
-            item->setData(Qt::UserRole, file); // 儲存實際檔名
-            m_fileListWidget->addItem(item);
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == m_positionSlider) {
+        if (event->type() == QEvent::MouseMove && !m_timelinePlayer->isEmpty()) {
+            // 滑過進度條時顯示該時間點附近的預覽縮圖
+            int x = static_cast<QMouseEvent *>(event)->position().toPoint().x();
+            int position = QStyle::sliderValueFromPosition(m_positionSlider->minimum(), m_positionSlider->maximum(),
+                                                           x, m_positionSlider->width());
+            qint64 offset = 0;
+            int segment = m_timelinePlayer->locate(m_timelinePlayer->startMs() + position, &offset);
+            QImage preview = segment >= 0
+                ? m_thumbnailStore->previewAt(m_timelinePlayer->fileNameAt(segment), offset) : QImage();
+            if (preview.isNull()) {
+                m_previewPopup->hide();
+            } else {
+                m_previewPopup->setPixmap(QPixmap::fromImage(preview));
+                m_previewPopup->adjustSize();
+                QPoint anchor = m_positionSlider->mapToGlobal(QPoint(x, 0));
+                m_previewPopup->move(anchor.x() - m_previewPopup->width() / 2, anchor.y() - m_previewPopup->height() - 4);
+                m_previewPopup->show();
+            }
+        } else if (event->type() == QEvent::Leave || event->type() == QEvent::Hide) {
+            m_previewPopup->hide();
         }
     }
+    return QMainWindow::eventFilter(watched, event);
+}
 
+void MainWindow::switchToManagerPage() {
+    // 清單直接來自索引，開頁不碰檔案系統
+    updateCameraFilter();
     m_stackedWidget->setCurrentIndex(2);
 }
 
+void MainWindow::updateCameraFilter() {
+    QString current = m_cameraFilterCombo->currentData().toString();
+    QSignalBlocker blocker(m_cameraFilterCombo);
+    m_cameraFilterCombo->clear();
+    m_cameraFilterCombo->addItem("全部", QString());
+    for (const QString &camera : m_recordingIndex->cameras())
+        m_cameraFilterCombo->addItem(camera, camera);
+    m_cameraFilterCombo->setCurrentIndex(qMax(0, m_cameraFilterCombo->findData(current)));
+}
+
+void MainWindow::applyRecordingFilter() {
+    m_recordingModel->setCameraFilter(m_cameraFilterCombo->currentData().toString());
+    if (m_timeFilterCheck->isChecked())
+        m_recordingModel->setTimeRange(m_fromEdit->dateTime(), m_toEdit->dateTime());
+    else
+        m_recordingModel->setTimeRange(QDateTime(), QDateTime());
+}
+
+QString MainWindow::selectedRecordingFile() const {
+    return m_recordingModel->fileNameAt(m_fileListView->currentIndex().row());
+}
+
 void MainWindow::onPlayRecordedVideo() {
-    QListWidgetItem *item = m_fileListWidget->currentItem();
-    if (!item || !item->data(Qt::UserRole).isValid()) {
+    QString fileName = selectedRecordingFile();
+    if (fileName.isEmpty()) {
         QMessageBox::information(this, "提示", "請先選擇要播放的影片！");
         return;
     }
 
-    QString fileName = item->data(Qt::UserRole).toString();
-    QString filePath = getRecordingsPath() + "/" + fileName;
+    QString filePath = recordingFilePath(getRecordingsPath(), fileName);
 
     // 檢查檔案是否存在
     if (!QFile::exists(filePath)) {
+        // 在外部被刪掉的檔案順便從索引移除
+        m_recordingIndex->remove(fileName);
         QMessageBox::warning(this, "錯誤", "影片檔案不存在！");
         return;
     }
 
-    // 在內建播放器中播放
-    m_playbackPlayer->setSource(QUrl::fromLocalFile(filePath));
-    m_playbackPlayer->play();
-    m_playBtn->setText("⏸");
+    // 索引裡找不到時（剛從外部放進來）以檔案時間當開頭
+    RecordingEntry selected;
+    if (const RecordingEntry *entry = m_recordingIndex->find(fileName)) {
+        selected = *entry;
+    } else {
+        QFileInfo info(filePath);
+        selected.fileName = fileName;
+        selected.startMs = (info.birthTime().isValid() ? info.birthTime() : info.lastModified()).toMSecsSinceEpoch();
+    }
+
+    // 時間軸模式：同攝影機當天所有分段接起來，從選定的分段開始播
+    QVector<RecordingEntry> segments;
+    if (m_timelineCheck->isChecked() && !selected.camera.isEmpty()) {
+        const QDate day = selected.start().date();
+        for (const RecordingEntry &entry : m_recordingIndex->entries()) {
+            if (entry.camera == selected.camera && entry.start().date() == day) segments.append(entry);
+        }
+    }
+    if (segments.isEmpty()) segments.append(selected);
+    m_timelineMode = segments.size() > 1;
+
+    m_frameSeeker->setMaxOutputSize(m_playbackVideoWidget->size() * m_playbackVideoWidget->devicePixelRatio());
+    m_frameSeeker->close();
+    m_scrubFilePath.clear();
+    m_timelinePlayer->setSegments(getRecordingsPath(), segments);
+    m_jumpTimeEdit->setTime(selected.start().time());
+    m_timelinePlayer->seek(selected.startMs);
+    m_timelinePlayer->play();
+}
+
+void MainWindow::onSyncPlayback() {
+    // 以選定影片的時間為準，沒有選時用篩選的開始時間
+    QDateTime start = m_fromEdit->dateTime();
+    if (const RecordingEntry *entry = m_recordingIndex->find(selectedRecordingFile())) start = entry->start();
+
+    QMap<QString, QVector<RecordingEntry>> byCamera;
+    for (const RecordingEntry &entry : m_recordingIndex->entries()) {
+        if (!entry.camera.isEmpty() && entry.start().date() == start.date()) byCamera[entry.camera].append(entry);
+    }
+    if (byCamera.isEmpty()) {
+        QMessageBox::information(this, "提示", "這一天沒有可同步回放的錄影！");
+        return;
+    }
+
+    QList<QVector<RecordingEntry>> cameras;
+    for (QVector<RecordingEntry> &segments : byCamera) {
+        std::sort(segments.begin(), segments.end(), [](const RecordingEntry &a, const RecordingEntry &b) {
+            return a.startMs < b.startMs;
+        });
+        cameras.append(segments);
+        if (cameras.size() == kMaxSyncViews) break;
+    }
+
+    m_timelinePlayer->pause();
+    m_stackedWidget->setCurrentIndex(3);
+    m_syncPage->load(getRecordingsPath(), cameras, start.toMSecsSinceEpoch());
+}
+
+void MainWindow::onSearchEvents() {
+    // 預設沿用檔案清單的時間篩選
+    EventSearchDialog *dialog = new EventSearchDialog(m_eventIndex, m_fromEdit->dateTime(), m_toEdit->dateTime(), this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dialog, &EventSearchDialog::hitActivated, this, &MainWindow::playRecordingAt);
+    dialog->show();
+}
+
+void MainWindow::playRecordingAt(const QString &camera, qint64 timeMs) {
+    // 該攝影機當天的分段接成時間軸，從事件前一點開始播
+    const QDate day = QDateTime::fromMSecsSinceEpoch(timeMs).date();
+    QVector<RecordingEntry> segments;
+    for (const RecordingEntry &entry : m_recordingIndex->entries())
+        if (entry.camera == camera && entry.start().date() == day) segments.append(entry);
+
+    qint64 offset = 0;
+    std::sort(segments.begin(), segments.end(), [](const RecordingEntry &a, const RecordingEntry &b) {
+        return a.startMs < b.startMs;
+    });
+    if (locateSegment(segments, timeMs, &offset) < 0) {
+        QMessageBox::information(this, "提示", "這個事件沒有對應的錄影檔（可能未錄影或已刪除）！");
+        return;
+    }
+
+    m_timelineMode = segments.size() > 1;
+    m_frameSeeker->setMaxOutputSize(m_playbackVideoWidget->size() * m_playbackVideoWidget->devicePixelRatio());
+    m_frameSeeker->close();
+    m_scrubFilePath.clear();
+    m_timelinePlayer->setSegments(getRecordingsPath(), segments);
+    m_jumpTimeEdit->setTime(QDateTime::fromMSecsSinceEpoch(timeMs).time());
+    m_timelinePlayer->seek(qMax(m_timelinePlayer->startMs(), timeMs - kEventLeadMs));
+    m_timelinePlayer->play();
+}
+
+void MainWindow::onExportClip() {
+    const QString fileName = selectedRecordingFile();
+    const RecordingEntry *selected = m_recordingIndex->find(fileName);
+    if (!selected) {
+        QMessageBox::information(this, "提示", "請先選擇要匯出的影片！");
+        return;
+    }
+
+    // 同攝影機的所有分段，區間可以跨檔
+    QVector<RecordingEntry> segments;
+    for (const RecordingEntry &entry : m_recordingIndex->entries()) {
+        if (entry.fileName == fileName || (!selected->camera.isEmpty() && entry.camera == selected->camera))
+            segments.append(entry);
+    }
+    std::sort(segments.begin(), segments.end(), [](const RecordingEntry &a, const RecordingEntry &b) {
+        return a.startMs < b.startMs;
+    });
+
+    // 正在播放這個檔案時從目前位置開始，預設一分鐘
+    const qint64 in = m_timelinePlayer->contains(fileName) ? m_timelinePlayer->position() : selected->startMs;
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("匯出片段");
+    QFormLayout *form = new QFormLayout(&dialog);
+    QDateTimeEdit *inEdit = new QDateTimeEdit(QDateTime::fromMSecsSinceEpoch(in));
+    QDateTimeEdit *outEdit = new QDateTimeEdit(QDateTime::fromMSecsSinceEpoch(in + 60000));
+    inEdit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
+    outEdit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
+    QCheckBox *smartCheck = new QCheckBox("開頭不在關鍵幀時只重新編碼第一段（起點較精準）");
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow("開始:", inEdit);
+    form->addRow("結束:", outEdit);
+    form->addRow(smartCheck);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    if (outEdit->dateTime() <= inEdit->dateTime()) {
+        QMessageBox::warning(this, "錯誤", "結束時間必須晚於開始時間！");
+        return;
+    }
+
+    const QString defaultName = QString("CLIP_%1.mp4").arg(inEdit->dateTime().toString("yyyyMMdd_HHmmss"));
+    const QString outputPath = QFileDialog::getSaveFileName(this, "匯出片段", QDir::homePath() + "/" + defaultName,
+                                                            "MP4 影片 (*.mp4)");
+    if (outputPath.isEmpty()) return;
+
+    ClipRequest request;
+    request.directory = getRecordingsPath();
+    request.segments = segments;
+    request.inMs = inEdit->dateTime().toMSecsSinceEpoch();
+    request.outMs = outEdit->dateTime().toMSecsSinceEpoch();
+    request.outputPath = outputPath;
+    request.smartStart = smartCheck->isChecked();
+
+    // 直接複製封包，大小接近原始資料，背景執行不擋畫面
+    ClipExporter *exporter = new ClipExporter(request, this);
+    QPointer<QProgressDialog> progress = new QProgressDialog("正在匯出片段...", "取消", 0, 100, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    connect(exporter, &ClipExporter::progress, progress, &QProgressDialog::setValue);
+    connect(progress, &QProgressDialog::canceled, exporter, &ClipExporter::cancel);
+    connect(exporter, &ClipExporter::exported, this, [this, progress](const QString &path, qint64 bytes, qint64 durationMs){
+        if (progress) progress->close();
+        QMessageBox::information(this, "匯出完成", QString("已匯出片段：\n%1\n\n長度 %2，%3 MB")
+                                 .arg(path, formatTime(durationMs)).arg(bytes / 1048576.0, 0, 'f', 1));
+    });
+    connect(exporter, &ClipExporter::failed, this, [this, progress](const QString &error){
+        if (progress) progress->close();
+        if (error != "已取消") QMessageBox::warning(this, "匯出失敗", error);
+    });
+    connect(exporter, &QThread::finished, exporter, &QObject::deleteLater);
+    exporter->start(QThread::LowPriority);
+    progress->show();
 }
 
 void MainWindow::onOpenInExternalPlayer() {
-    QListWidgetItem *item = m_fileListWidget->currentItem();
-    if (!item || !item->data(Qt::UserRole).isValid()) {
+    QString fileName = selectedRecordingFile();
+    if (fileName.isEmpty()) {
         QMessageBox::information(this, "提示", "請先選擇要播放的影片！");
         return;
     }
 
-    QString fileName = item->data(Qt::UserRole).toString();
-    QString filePath = getRecordingsPath() + "/" + fileName;
+    QString filePath = recordingFilePath(getRecordingsPath(), fileName);
 
     // 檢查檔案是否存在
     if (!QFile::exists(filePath)) {
@@ -629,11 +1266,20 @@ void MainWindow::onOpenInExternalPlayer() {
 }
 
 void MainWindow::updateTimeLabel() {
-    qint64 position = m_playbackPlayer->position();
-    qint64 duration = m_playbackPlayer->duration();
+    // 拖曳中顯示進度條的位置，播放器要放開後才跟上
+    qint64 start = m_timelinePlayer->startMs();
+    qint64 position = m_positionSlider->isSliderDown() ? start + m_positionSlider->value() : m_timelinePlayer->position();
+    qint64 end = m_timelinePlayer->endMs();
+
+    if (m_timelineMode) {
+        // 時間軸模式顯示實際時間
+        m_timeLabel->setText(QDateTime::fromMSecsSinceEpoch(position).toString("HH:mm:ss") + " / "
+                             + QDateTime::fromMSecsSinceEpoch(end).toString("HH:mm:ss"));
+        return;
+    }
 
-    QString posStr = formatTime(position);
-    QString durStr = formatTime(duration);
+    QString posStr = formatTime(position - start);
+    QString durStr = formatTime(end - start);
 
     m_timeLabel->setText(posStr + " / " + durStr);
 }
@@ -656,14 +1302,13 @@ QString MainWindow::formatTime(qint64 milliseconds) {
 }
 
 void MainWindow::onDeleteRecordedVideo() {
-    QListWidgetItem *item = m_fileListWidget->currentItem();
-    if (!item || !item->data(Qt::UserRole).isValid()) {
+    QString fileName = selectedRecordingFile();
+    if (fileName.isEmpty()) {
         QMessageBox::information(this, "提示", "請先選擇要刪除的影片！");
         return;
     }
 
-    QString fileName = item->data(Qt::UserRole).toString();
-    QString filePath = getRecordingsPath() + "/" + fileName;
+    QString filePath = recordingFilePath(getRecordingsPath(), fileName);
 
     // 確認刪除
     QMessageBox::StandardButton reply = QMessageBox::question(this, "確認刪除",
@@ -671,9 +1316,17 @@ void MainWindow::onDeleteRecordedVideo() {
                                                               QMessageBox::Yes | QMessageBox::No);
 
     if (reply == QMessageBox::Yes) {
+        if (m_timelinePlayer->contains(fileName)) {
+            // 播放中的檔案先放掉，否則 Windows 上刪不掉
+            m_timelinePlayer->clear();
+            m_frameSeeker->close();
+            m_scrubFilePath.clear();
+        }
         if (QFile::remove(filePath)) {
+            QFile::remove(KeyframeIndex::sidecarPath(filePath));
+            m_recordingIndex->remove(fileName);
+            m_thumbnailStore->remove(fileName);
             QMessageBox::information(this, "成功", "影片已刪除！");
-            switchToManagerPage(); // 重新整理列表
         } else {
             QMessageBox::warning(this, "錯誤", "刪除失敗！檔案可能正在使用中。");
         }
@@ -14,8 +14,31 @@
 #include <QProgressBar>
 #include <QScrollArea>
 #include <QLabel>
-#include <QProcess>
 #include <QSlider>
+#include <QSpinBox>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QListView>
+#include <QDateTimeEdit>
+#include <QTimeEdit>
+#include <QTableWidget>
+#include <memory>
+
+#include "recorderengine.h"
+#include "livedecoder.h"
+#include "decodescheduler.h"
+#include "mosaicwidget.h"
+#include "recordingindex.h"
+#include "recordinglistmodel.h"
+#include "thumbnailstore.h"
+#include "frameseeker.h"
+#include "timelineplayer.h"
+#include "syncplaybackpage.h"
+#include "clipexporter.h"
+#include "motionrecorder.h"
+#include "eventindex.h"
+#include "eventsearchdialog.h"
+#include "storagemanager.h"
 
 // 自訂可點擊的 VideoWidget
 class ClickableVideoWidget : public QVideoWidget {
@@ -31,11 +54,18 @@ protected:
 // 播放器單元結構
 struct PlayerUnit {
     QString streamUrl;
-    QString recordingFilePath;
-    QMediaPlayer *player;
-    QAudioOutput *audioOutput;
+    StreamIngest *ingest;                       // 每個攝影機只連線一次，由引擎持有
+    std::shared_ptr<LiveDecoder> decoder;       // 即時畫面（主碼流，有子碼流時只在放大時解碼）
+    QString subStreamUrl;                       // 選填的低解析度子碼流，只給九宮格用
+    StreamIngest *subIngest = nullptr;
+    std::shared_ptr<LiveDecoder> subDecoder;
     ClickableVideoWidget *videoWidget;
-    QProcess *ffmpegProcess;
+    std::shared_ptr<MosaicTile> mosaicTile;     // 合成牆模式下九宮格畫在這裡
+    StreamProbe probe;                          // 連線時探測一次後快取
+    QString recordingProfile;                   // 錄影時選用的複製/轉碼方式
+    double transcodeLoad = -1;                  // 轉碼佔用比例，-1 表示沒有轉碼
+    QString connectionState;                    // 斷線重連中的狀態，連上時清空
+    bool motion = false;                        // 移動偵測目前是否觸發中
 };
 
 class MainWindow : public QMainWindow {
@@ -45,47 +75,105 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     void onAddStream();
     void onPlaySelectedLive();
     void onDeleteCamera();
     void onToggleGlobalRecording(bool checked);
+    void onRecordingStartCompleted(int startedCount, int failedCount);
+    void onRecordingStopCompleted(const QStringList &savedFiles);
+    void onToggleMotionRecording(bool checked);
+    void onStorageSettings();
+    void onCameraPreRollSettings();
     void switchToManagerPage();
     void toggleFocus(PlayerUnit* unit);
     void onPlayRecordedVideo();
     void onOpenInExternalPlayer();      // 新增
+    void onSyncPlayback();
+    void onExportClip();
+    void onSearchEvents();
     void onDeleteRecordedVideo();
     void updateTimeLabel();             // 新增
 
 private:
     void setupUi();
     QString getRecordingsPath();
+    RecorderOptions recorderOptions() const;
+    void updateUnitStyle(PlayerUnit *unit);
     QString formatTime(qint64 milliseconds);  // 新增
+    void showRecordingSummary(const QStringList &savedFiles);
+    PlayerUnit *findUnit(const QString &url) const;
+    void updateUnitToolTip(PlayerUnit *unit);
+    void updateMetricsPanel(const QVector<CameraMetrics> &metrics);
+    void bindLiveOutputs(PlayerUnit *unit);
+    QString selectedRecordingFile() const;
+    void updateCameraFilter();
+    void applyRecordingFilter();
+    void playRecordingAt(const QString &camera, qint64 timeMs);
 
     // 監控相關
     QListWidget *m_streamList;
     QStackedWidget *m_stackedWidget;
     QWidget *m_gridPage;
     QGridLayout *m_gridLayout;
+    QScrollArea *m_gridScroll;
+    MosaicWidget *m_mosaicWidget;
+    QCheckBox *m_mosaicCheck;
+    QSpinBox *m_gridFpsSpin;
+    QCheckBox *m_gridKeyFrameCheck;
     ClickableVideoWidget *m_focusVideoWidget;
     QPushButton *m_recordBtn;
+    QSpinBox *m_segmentMinutesSpin;
+    QComboBox *m_containerCombo;
+    QSpinBox *m_preRollSpin;
+    QCheckBox *m_motionCheck;
+    QSpinBox *m_postRollSpin;
+    QSpinBox *m_sensitivitySpin;
+    QCheckBox *m_relayCheck;
+    QCheckBox *m_metricsCheck;
+    QTableWidget *m_metricsTable;       // 各攝影機效能，放在畫面下方
     QProgressBar *m_globalProgressBar;
     QList<PlayerUnit*> m_playerUnits;
     PlayerUnit *m_currentFocusedUnit = nullptr;
+    RecorderEngine *m_engine;
+    RecordingController *m_recordingController;
+    MotionRecorder *m_motionRecorder;
+    DecodeScheduler *m_decodeScheduler;
+    QStringList m_recordingErrors;
 
     // 檔案管理相關
     QWidget *m_managerPage;
-    QListWidget *m_fileListWidget;
+    QListView *m_fileListView;
+    QLabel *m_recordingCountLabel;
+    QComboBox *m_cameraFilterCombo;
+    QCheckBox *m_timeFilterCheck;
+    QDateTimeEdit *m_fromEdit;
+    QDateTimeEdit *m_toEdit;
+    RecordingIndex *m_recordingIndex;
+    RecordingListModel *m_recordingModel;
+    ThumbnailStore *m_thumbnailStore;
+    EventIndex *m_eventIndex;
+    StorageManager *m_storageManager;
 
     // 內建播放器相關 (新增)
-    QMediaPlayer *m_playbackPlayer;
-    QAudioOutput *m_playbackAudioOutput;
+    TimelinePlayer *m_timelinePlayer;
+    SyncPlaybackPage *m_syncPage;
     QVideoWidget *m_playbackVideoWidget;
     QPushButton *m_playBtn;
     QPushButton *m_stopBtn;
     QSlider *m_positionSlider;
     QSlider *m_volumeSlider;
     QLabel *m_timeLabel;
+    QLabel *m_previewPopup;             // 進度條上的預覽縮圖
+    QCheckBox *m_timelineCheck;
+    QTimeEdit *m_jumpTimeEdit;
+    bool m_timelineMode = false;        // 多個分段接成時間軸，時間顯示實際時刻
+    QString m_scrubFilePath;            // FrameSeeker 目前開著的分段
+    FrameSeeker *m_frameSeeker;
+    bool m_resumeAfterScrub = false;    // 拖曳前正在播放，放開後繼續
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,246 @@
+#include "metricssampler.h"
+#include <QFile>
+#include <QUrl>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QDebug>
+
+// 預設取樣間隔：面板看得到變化，又不必每一張畫面都算
+static const int kDefaultIntervalMs = 2000;
+
+// 管線各階段：名稱與接收端的 sinkName() 相同，key 用在 /metrics 標籤與 CSV 欄位
+struct Stage {
+    const char *name;
+    const char *key;
+};
+static const Stage kStages[] = {
+    { "擷取", "ingest" },
+    { "顯示", "display" },
+    { "移動偵測", "motion" },
+    { "錄影", "record" },
+    { "轉碼", "transcode" },
+    { "轉播", "relay" },
+};
+
+static QByteArray stageKey(const QString &name) {
+    for (const Stage &stage : kStages)
+        if (name == QString::fromUtf8(stage.name)) return stage.key;
+    return name.toUtf8();
+}
+
+static double perSecond(qint64 delta, qint64 elapsedNs) {
+    return elapsedNs > 0 ? qMax<qint64>(0, delta) * 1e9 / elapsedNs : 0;
+}
+
+MetricsSampler::MetricsSampler(QObject *parent) : QObject(parent) {
+    m_timer.setInterval(kDefaultIntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &MetricsSampler::sample);
+    m_timer.start();
+    m_clock.start();
+}
+
+void MetricsSampler::addCamera(const QString &camera, StreamIngest *ingest, StreamIngest *subIngest) {
+    Source source;
+    source.camera = camera;
+    source.label = QUrl(camera).toString(QUrl::RemoveUserInfo);
+    source.ingest = ingest;
+    source.subIngest = subIngest;
+    // 從現在的累計值算起，第一次取樣不會把之前的量全部算進去
+    source.previous = readTotals(source, nullptr);
+    m_sources.append(source);
+}
+
+void MetricsSampler::removeCamera(const QString &camera) {
+    m_sources.removeIf([&camera](const Source &source) { return source.camera == camera; });
+}
+
+MetricsSampler::Totals MetricsSampler::readTotals(const Source &source, CameraMetrics *metrics) {
+    Totals totals;
+    for (StreamIngest *ingest : {source.ingest.data(), source.subIngest.data()}) {
+        if (!ingest) continue;
+        const bool main = ingest == source.ingest;
+        const StreamMetrics &counters = *ingest->metrics();
+        totals.receivedBytes += counters.receivedBytes.load(std::memory_order_relaxed);
+        if (main) totals.receivedFrames = counters.receivedFrames.load(std::memory_order_relaxed);
+        totals.decodedFrames += counters.decodedFrames.load(std::memory_order_relaxed);
+        const qint64 displayed = counters.displayedFrames.load(std::memory_order_relaxed);
+        totals.displayedFrames += displayed;
+        if (main) totals.mainDisplayedFrames = displayed;
+        totals.droppedFrames += counters.droppedFrames.load(std::memory_order_relaxed);
+        totals.recordedBytes += counters.recordedBytes.load(std::memory_order_relaxed);
+        totals.cpuNs["擷取"] += counters.ingestCpuNs.load(std::memory_order_relaxed);
+        totals.cpuNs["轉碼"] += counters.transcodeCpuNs.load(std::memory_order_relaxed);
+
+        const QVector<SinkQueueStats> queues = ingest->queueStats();
+        for (const SinkQueueStats &queue : queues) totals.cpuNs[queue.name] += queue.cpuNs;
+        if (metrics) (main ? metrics->queues : metrics->subQueues) = queues;
+    }
+    return totals;
+}
+
+void MetricsSampler::sample() {
+    const qint64 elapsedNs = m_clock.nsecsElapsed();
+    m_clock.restart();
+
+    QVector<CameraMetrics> results;
+    for (Source &source : m_sources) {
+        CameraMetrics metrics;
+        metrics.camera = source.label;
+        const Totals now = readTotals(source, &metrics);
+        const Totals &before = source.previous;
+
+        metrics.bitrateKbps = perSecond(now.receivedBytes - before.receivedBytes, elapsedNs) * 8 / 1000;
+        metrics.receivedFps = perSecond(now.receivedFrames - before.receivedFrames, elapsedNs);
+        metrics.decodedFps = perSecond(now.decodedFrames - before.decodedFrames, elapsedNs);
+        metrics.displayedFps = perSecond(now.displayedFrames - before.displayedFrames, elapsedNs);
+        metrics.droppedFps = perSecond(now.droppedFrames - before.droppedFrames, elapsedNs);
+        metrics.recordKBps = perSecond(now.recordedBytes - before.recordedBytes, elapsedNs) / 1024;
+
+        // 延遲只留最後一張的值，這段時間有顯示才算數；主碼流優先
+        const qint64 mainShown = now.mainDisplayedFrames - before.mainDisplayedFrames;
+        const qint64 subShown = (now.displayedFrames - now.mainDisplayedFrames)
+                                - (before.displayedFrames - before.mainDisplayedFrames);
+        StreamIngest *shown = mainShown > 0 ? source.ingest.data() : subShown > 0 ? source.subIngest.data() : nullptr;
+        if (shown) {
+            const qint64 latencyUs = shown->metrics()->latencyUs.load(std::memory_order_relaxed);
+            if (latencyUs >= 0) metrics.latencyMs = latencyUs / 1000.0;
+        }
+
+        // 接收端移除後它的累計時間跟著消失，差值為負就當作 0
+        for (const Stage &stage : kStages) {
+            const QString name = QString::fromUtf8(stage.name);
+            if (!now.cpuNs.contains(name)) continue;
+            const qint64 delta = now.cpuNs.value(name) - before.cpuNs.value(name);
+            metrics.cpuPercent.append({name, perSecond(delta, elapsedNs) / 1e7});
+        }
+
+        source.previous = now;
+        results.append(metrics);
+    }
+
+    m_latest = results;
+    const QByteArray text = formatPrometheus(results);
+    {
+        QMutexLocker locker(&m_textMutex);
+        m_prometheusText = text;
+    }
+    if (!m_csvPath.isEmpty()) writeCsv(results);
+    emit sampled(results);
+}
+
+QByteArray MetricsSampler::prometheusText() const {
+    QMutexLocker locker(&m_textMutex);
+    return m_prometheusText;
+}
+
+static QByteArray escapeLabel(const QByteArray &value) {
+    QByteArray escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return escaped;
+}
+
+QByteArray MetricsSampler::formatPrometheus(const QVector<CameraMetrics> &metrics) {
+    QByteArray text;
+    auto family = [&text](const char *name, const char *type, const char *help) {
+        text += QByteArray("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+    };
+    auto line = [&text](const char *name, const QByteArray &labels, double value) {
+        text += QByteArray(name) + "{" + labels + "} " + QByteArray::number(value, 'f', 3) + "\n";
+    };
+    auto cameraLabel = [](const CameraMetrics &camera) {
+        return "camera=\"" + escapeLabel(camera.camera.toUtf8()) + "\"";
+    };
+
+    const struct {
+        const char *name;
+        const char *help;
+        double CameraMetrics::*field;
+    } gauges[] = {
+        { "recorder_ingest_bitrate_kbps", "Ingest bitrate (main + sub stream)", &CameraMetrics::bitrateKbps },
+        { "recorder_received_fps", "Video packets received on the main stream", &CameraMetrics::receivedFps },
+        { "recorder_decoded_fps", "Frames decoded for live view", &CameraMetrics::decodedFps },
+        { "recorder_displayed_fps", "Frames shown in live view", &CameraMetrics::displayedFps },
+        { "recorder_dropped_fps", "Decoded frames never shown", &CameraMetrics::droppedFps },
+        { "recorder_record_write_kbytes_per_second", "Recording bytes written to disk", &CameraMetrics::recordKBps },
+    };
+    for (const auto &gauge : gauges) {
+        family(gauge.name, "gauge", gauge.help);
+        for (const CameraMetrics &camera : metrics) line(gauge.name, cameraLabel(camera), camera.*gauge.field);
+    }
+
+    family("recorder_latency_ms", "gauge", "Packet receipt to display for the latest shown frame");
+    for (const CameraMetrics &camera : metrics)
+        if (camera.latencyMs >= 0) line("recorder_latency_ms", cameraLabel(camera), camera.latencyMs);
+
+    family("recorder_cpu_percent", "gauge", "CPU time per pipeline stage, percent of one core");
+    for (const CameraMetrics &camera : metrics)
+        for (const auto &stage : camera.cpuPercent)
+            line("recorder_cpu_percent", cameraLabel(camera) + ",stage=\"" + escapeLabel(stageKey(stage.first)) + "\"",
+                 stage.second);
+
+    // 同一個指標的樣本要排在一起，三個指標各跑一次
+    const struct {
+        const char *name;
+        const char *type;
+        const char *help;
+        qint64 SinkQueueStats::*field;
+    } queueFamilies[] = {
+        { "recorder_queue_depth", "gauge", "Packets waiting in a sink queue", nullptr },
+        { "recorder_queue_dropped_total", "counter", "Packets dropped by a sink queue", &SinkQueueStats::dropped },
+        { "recorder_queue_stalls_total", "counter", "Times the ingest waited on a full lossless queue",
+          &SinkQueueStats::stalls },
+    };
+    for (const auto &queueFamily : queueFamilies) {
+        family(queueFamily.name, queueFamily.type, queueFamily.help);
+        for (const CameraMetrics &camera : metrics) {
+            for (const auto &stream : {std::make_pair("main", &camera.queues), std::make_pair("sub", &camera.subQueues)}) {
+                for (const SinkQueueStats &queue : *stream.second) {
+                    const QByteArray labels = cameraLabel(camera) + ",stream=\"" + stream.first + "\",sink=\""
+                                              + escapeLabel(stageKey(queue.name)) + "\"";
+                    line(queueFamily.name, labels, queueFamily.field ? queue.*queueFamily.field : queue.depth);
+                }
+            }
+        }
+    }
+    return text;
+}
+
+void MetricsSampler::writeCsv(const QVector<CameraMetrics> &metrics) {
+    QFile file(m_csvPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qDebug() << "無法寫入效能紀錄:" << m_csvPath << file.errorString();
+        m_csvPath.clear();
+        return;
+    }
+
+    if (file.size() == 0) {
+        QByteArray header = "time,camera,bitrate_kbps,received_fps,decoded_fps,displayed_fps,dropped_fps,"
+                            "latency_ms,record_kbytes_per_second,queue_packets,queue_dropped";
+        for (const Stage &stage : kStages) header += QByteArray(",cpu_") + stage.key;
+        file.write(header + "\n");
+    }
+
+    const QByteArray time = QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8();
+    for (const CameraMetrics &camera : metrics) {
+        qint64 depth = 0;
+        qint64 dropped = 0;
+        for (const SinkQueueStats &queue : camera.queues + camera.subQueues) {
+            depth += queue.depth;
+            dropped += queue.dropped;
+        }
+
+        QByteArray row = time + ",\"" + camera.camera.toUtf8().replace('"', "\"\"") + "\"";
+        for (double value : {camera.bitrateKbps, camera.receivedFps, camera.decodedFps, camera.displayedFps,
+                             camera.droppedFps})
+            row += "," + QByteArray::number(value, 'f', 2);
+        row += "," + (camera.latencyMs >= 0 ? QByteArray::number(camera.latencyMs, 'f', 1) : QByteArray());
+        row += "," + QByteArray::number(camera.recordKBps, 'f', 1);
+        row += "," + QByteArray::number(depth) + "," + QByteArray::number(dropped);
+        for (const Stage &stage : kStages) {
+            row += ",";
+            for (const auto &cpu : camera.cpuPercent)
+                if (cpu.first == QString::fromUtf8(stage.name)) row += QByteArray::number(cpu.second, 'f', 1);
+        }
+        file.write(row + "\n");
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef METRICSSAMPLER_H
+#define METRICSSAMPLER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+#include <memory>
+#include <utility>
+
+#include "streamingest.h"
+#include "streammetrics.h"
+
+// 一台攝影機一次取樣的結果；速率都是取樣區間內的每秒平均
+// 有子碼流時碼率、解碼/顯示/丟幀與各階段 CPU 為兩路合計，收到的幀率只看主碼流
+struct CameraMetrics {
+    QString camera;                     // 攝影機網址，已去掉帳號密碼（會出現在 /metrics 與 CSV）
+    double bitrateKbps = 0;
+    double receivedFps = 0;
+    double decodedFps = 0;
+    double displayedFps = 0;
+    double droppedFps = 0;
+    double latencyMs = -1;              // 收到封包到顯示；這段時間沒顯示畫面時為 -1
+    double recordKBps = 0;              // 錄影寫進磁碟的速度
+    QVector<SinkQueueStats> queues;     // 主碼流各接收端佇列的目前狀態
+    QVector<SinkQueueStats> subQueues;  // 子碼流的
+    QVector<std::pair<QString, double>> cpuPercent;   // 各階段佔一顆核心的百分比，依管線順序
+};
+
+// 定時讀各路 StreamMetrics 與佇列狀態換算成速率：GUI 面板、/metrics 與 CSV 都用這份結果
+// 計數器本身只有原子累加，取樣端才做除法與格式化，擷取與解碼路徑上沒有額外負擔
+class MetricsSampler : public QObject {
+    Q_OBJECT
+public:
+    explicit MetricsSampler(QObject *parent = nullptr);
+
+    void addCamera(const QString &camera, StreamIngest *ingest, StreamIngest *subIngest);
+    void removeCamera(const QString &camera);
+
+    void setInterval(int ms) { m_timer.setInterval(ms); }
+    // 每次取樣附加到這個 CSV 檔，空字串表示不寫
+    void setCsvPath(const QString &path) { m_csvPath = path; }
+
+    QVector<CameraMetrics> latest() const { return m_latest; }
+    // Prometheus 文字格式的最新結果；任何執行緒皆可
+    QByteArray prometheusText() const;
+
+signals:
+    void sampled(const QVector<CameraMetrics> &metrics);
+
+private:
+    // 累計值的快照，兩次相減得到區間內的量
+    struct Totals {
+        qint64 receivedBytes = 0;
+        qint64 receivedFrames = 0;
+        qint64 decodedFrames = 0;
+        qint64 displayedFrames = 0;
+        qint64 mainDisplayedFrames = 0; // 只算主碼流，判斷延遲要看哪一路
+        qint64 droppedFrames = 0;
+        qint64 recordedBytes = 0;
+        QHash<QString, qint64> cpuNs;   // 階段 -> 累計 CPU 時間
+    };
+    struct Source {
+        QString camera;
+        QString label;                  // 對外顯示用，不含帳號密碼
+        QPointer<StreamIngest> ingest;
+        QPointer<StreamIngest> subIngest;
+        Totals previous;
+    };
+
+    void sample();
+    static Totals readTotals(const Source &source, CameraMetrics *metrics);
+    void writeCsv(const QVector<CameraMetrics> &metrics);
+    static QByteArray formatPrometheus(const QVector<CameraMetrics> &metrics);
+
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    QVector<Source> m_sources;
+    QVector<CameraMetrics> m_latest;
+    QString m_csvPath;
+
+    mutable QMutex m_textMutex;
+    QByteArray m_prometheusText;
+};
+
+#endif // METRICSSAMPLER_H
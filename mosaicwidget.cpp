@@ -0,0 +1,136 @@
+#include "mosaicwidget.h"
+#include <QPainter>
+#include <QMouseEvent>
+#include <QScreen>
+#include <QtMath>
+
+void MosaicTile::setTargetSize(const QSize &size) {
+    QMutexLocker locker(&m_mutex);
+    m_targetSize = size;
+}
+
+QSize MosaicTile::targetSize() const {
+    QMutexLocker locker(&m_mutex);
+    return m_targetSize;
+}
+
+QImage *MosaicTile::backBuffer(const QSize &size) {
+    // 寫入中的緩衝只有解碼端會碰，不必上鎖
+    QImage &image = m_buffers[m_back];
+    if (image.size() != size) image = QImage(size, QImage::Format_RGB32);
+    return &image;
+}
+
+void MosaicTile::publish() {
+    QMutexLocker locker(&m_mutex);
+    std::swap(m_back, m_pending);
+    m_dirty = true;
+}
+
+const QImage &MosaicTile::takeFront() {
+    QMutexLocker locker(&m_mutex);
+    if (m_dirty) {
+        std::swap(m_pending, m_front);
+        m_dirty = false;
+    }
+    return m_buffers[m_front];
+}
+
+bool MosaicTile::hasNewFrame() const {
+    QMutexLocker locker(&m_mutex);
+    return m_dirty;
+}
+
+MosaicWidget::MosaicWidget(QWidget *parent) : QWidget(parent) {
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(320, 180);
+
+    // 跟著螢幕更新率檢查，有新畫面才重畫
+    connect(&m_refreshTimer, &QTimer::timeout, this, &MosaicWidget::refresh);
+}
+
+void MosaicWidget::addTile(const std::shared_ptr<MosaicTile> &tile) {
+    m_tiles.append(tile);
+    updateLayout();
+}
+
+void MosaicWidget::removeTile(const std::shared_ptr<MosaicTile> &tile) {
+    m_tiles.removeOne(tile);
+    updateLayout();
+}
+
+void MosaicWidget::updateLayout() {
+    // 盡量排成正方形，全部格子一次放進畫面
+    const int count = qMax(1, int(m_tiles.size()));
+    m_columns = qCeil(qSqrt(count));
+    m_rows = (count + m_columns - 1) / m_columns;
+
+    const qreal ratio = devicePixelRatioF();
+    for (int i = 0; i < m_tiles.size(); ++i)
+        m_tiles[i]->setTargetSize(tileRect(i).size() * ratio);
+    update();
+}
+
+QRect MosaicWidget::tileRect(int index) const {
+    const int column = index % m_columns;
+    const int row = index / m_columns;
+    const int left = width() * column / m_columns;
+    const int top = height() * row / m_rows;
+    const int right = width() * (column + 1) / m_columns;
+    const int bottom = height() * (row + 1) / m_rows;
+    return QRect(left, top, right - left, bottom - top).adjusted(1, 1, -1, -1);
+}
+
+void MosaicWidget::refresh() {
+    for (const auto &tile : std::as_const(m_tiles)) {
+        if (tile->hasNewFrame()) {
+            update();
+            return;
+        }
+    }
+}
+
+void MosaicWidget::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor("#333"));
+
+    const qreal ratio = devicePixelRatioF();
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        QRect cell = tileRect(i);
+        painter.fillRect(cell, Qt::black);
+
+        // 畫面已經縮放到格子的實際像素大小，這裡只是置中貼上，不再縮放
+        const QImage &image = m_tiles[i]->takeFront();
+        if (image.isNull()) continue;
+        QSizeF size = QSizeF(image.size()) / ratio;
+        QPointF topLeft(cell.x() + (cell.width() - size.width()) / 2,
+                        cell.y() + (cell.height() - size.height()) / 2);
+        painter.drawImage(QRectF(topLeft, size), image);
+    }
+}
+
+void MosaicWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    updateLayout();
+}
+
+void MosaicWidget::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+    const qreal rate = screen() ? screen()->refreshRate() : 60.0;
+    m_refreshTimer.start(qMax(1, qRound(1000.0 / qMax<qreal>(rate, 1.0))));
+    updateLayout();
+}
+
+void MosaicWidget::hideEvent(QHideEvent *event) {
+    QWidget::hideEvent(event);
+    m_refreshTimer.stop();
+}
+
+void MosaicWidget::mouseReleaseEvent(QMouseEvent *event) {
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        if (tileRect(i).contains(event->position().toPoint())) {
+            emit tileClicked(m_tiles[i]->key());
+            return;
+        }
+    }
+}
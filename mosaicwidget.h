@@ -0,0 +1,73 @@
+#ifndef MOSAICWIDGET_H
+#define MOSAICWIDGET_H
+
+#include <QWidget>
+#include <QMutex>
+#include <QImage>
+#include <QTimer>
+#include <QList>
+#include <memory>
+
+// 合成畫面裡的一格：解碼端直接把畫面縮放到格子大小寫進來
+// 三個緩衝輪流使用（寫入中/待顯示/顯示中），尺寸不變就不重新配置
+class MosaicTile {
+public:
+    explicit MosaicTile(const QString &key) : m_key(key) {}
+
+    QString key() const { return m_key; }
+
+    // GUI 執行緒在排版時設定，解碼端依此決定縮放大小（實際像素）
+    void setTargetSize(const QSize &size);
+    QSize targetSize() const;
+
+    // 以下兩個只在解碼執行緒呼叫
+    QImage *backBuffer(const QSize &size);
+    void publish();
+
+    // GUI 執行緒：有新畫面就換到前景，回傳目前要畫的畫面
+    const QImage &takeFront();
+    bool hasNewFrame() const;
+
+private:
+    const QString m_key;
+    mutable QMutex m_mutex;
+    QSize m_targetSize;
+    QImage m_buffers[3];
+    int m_back = 0;
+    int m_pending = 1;
+    int m_front = 2;
+    bool m_dirty = false;
+};
+
+// 多路監看的合成牆：所有格子畫在同一個 widget，每次螢幕更新只畫一次
+// 取代一格一個 QVideoWidget，路數多時省下大量合成與縮放成本
+class MosaicWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit MosaicWidget(QWidget *parent = nullptr);
+
+    void addTile(const std::shared_ptr<MosaicTile> &tile);
+    void removeTile(const std::shared_ptr<MosaicTile> &tile);
+
+signals:
+    void tileClicked(const QString &key);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    void updateLayout();
+    QRect tileRect(int index) const;
+    void refresh();
+
+    QList<std::shared_ptr<MosaicTile>> m_tiles;
+    int m_columns = 1;
+    int m_rows = 1;
+    QTimer m_refreshTimer;
+};
+
+#endif // MOSAICWIDGET_H
@@ -0,0 +1,265 @@
+#include "motiondetector.h"
+#include <QDateTime>
+#include <QDebug>
+#include <cstdlib>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+// 每區塊 4x4 格，共 16x9 區塊
+static const int kBlockSize = 4;
+static const int kBlocksX = MotionDetector::kGridWidth / kBlockSize;
+static const int kBlocksY = MotionDetector::kGridHeight / kBlockSize;
+static const int kBlocks = kBlocksX * kBlocksY;
+// 分析頻率上限；移動偵測不需要每張都看
+static const int64_t kAnalysisIntervalUs = 200000;
+// 連續幾張有變動才算開始移動（只解關鍵幀時一張就算）
+static const int kConfirmFrames = 2;
+// 這麼多區塊同時變動視為開關燈或鏡頭移動，直接換背景
+static const int kGlobalChangePercent = 70;
+// 安靜這麼久才算移動結束
+static const qint64 kQuietMs = 4000;
+// 移動持續太久就切成多個事件，事件索引的紀錄才不會跨太長
+static const qint64 kMaxEventMs = 10 * 60 * 1000;
+// 背景每次往目前畫面靠近 1/16
+static const int kBackgroundShift = 4;
+
+MotionDetector::MotionDetector(QObject *parent) : QObject(parent) {
+    m_frame = av_frame_alloc();
+}
+
+MotionDetector::~MotionDetector() {
+    releaseCodec();
+    av_frame_free(&m_frame);
+}
+
+void MotionDetector::releaseCodec() {
+    avcodec_free_context(&m_codec);
+    m_videoIndex = -1;
+    m_decoding = false;
+    m_lastAnalysisUs = AV_NOPTS_VALUE;
+}
+
+void MotionDetector::openSink(const IngestLayout &layout) {
+    m_layout = layout;
+    openCodec();
+}
+
+void MotionDetector::openCodec() {
+    releaseCodec();
+
+    m_videoIndex = findTrack(m_layout, AVMEDIA_TYPE_VIDEO);
+    if (m_videoIndex < 0) return;
+
+    const AVCodecParameters *par = m_layout[m_videoIndex].codecpar.get();
+    const AVCodec *codec = avcodec_find_decoder(par->codec_id);
+    if (!codec) {
+        qDebug() << "移動偵測找不到解碼器:" << avcodec_get_name(par->codec_id);
+        m_videoIndex = -1;
+        return;
+    }
+
+    m_codec = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codec, par);
+    m_codec->pkt_timebase = m_layout[m_videoIndex].timeBase;
+    m_codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    // 只看亮度平均，畫質無所謂：盡量降解析度、略過濾波與用不到的幀
+    // 降到格子大小就好，再小 reduce() 就算不出來（CIF/QCIF 的子碼流）；不知道尺寸時不降
+    int lowres = 0;
+    while (lowres < codec->max_lowres && (par->width >> (lowres + 1)) >= kGridWidth
+           && (par->height >> (lowres + 1)) >= kGridHeight)
+        ++lowres;
+    m_codec->lowres = lowres;
+    m_reduceWarned = false;
+    m_codec->skip_loop_filter = AVDISCARD_ALL;
+    m_codec->skip_idct = AVDISCARD_NONREF;
+    m_codec->skip_frame = m_keyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_NONREF;
+    // 一路一個執行緒就夠，32 路同時跑時不要每路都開一組
+    m_codec->thread_count = 1;
+
+    int ret = avcodec_open2(m_codec, codec, nullptr);
+    if (ret < 0) {
+        qDebug() << "移動偵測解碼器開啟失敗:" << avErrorString(ret);
+        releaseCodec();
+    }
+}
+
+void MotionDetector::writePacket(const AVPacket *packet) {
+    if (!m_codec || packet->stream_index != m_videoIndex) return;
+
+    const bool key = packet->flags & AV_PKT_FLAG_KEY;
+    if (m_keyframesOnly && !key) return;
+    if (!m_decoding) {
+        if (!key) return;
+        m_decoding = true;
+    }
+
+    if (avcodec_send_packet(m_codec, packet) < 0) return;
+    while (avcodec_receive_frame(m_codec, m_frame) == 0) {
+        int64_t time = m_frame->best_effort_timestamp;
+        if (time != AV_NOPTS_VALUE) time = av_rescale_q(time, m_codec->pkt_timebase, AV_TIME_BASE_Q);
+
+        // 時間倒退（重連、來源重播）就重新計算間隔
+        const bool due = time == AV_NOPTS_VALUE || m_lastAnalysisUs == AV_NOPTS_VALUE
+                         || time < m_lastAnalysisUs || time - m_lastAnalysisUs >= kAnalysisIntervalUs;
+        if (due) {
+            m_lastAnalysisUs = time;
+            analyze(m_frame);
+        }
+        av_frame_unref(m_frame);
+    }
+}
+
+void MotionDetector::closeSink() {
+    if (m_inMotion) endMotion();
+    flushActivity();
+    releaseCodec();
+}
+
+void MotionDetector::sinkInterrupted() {
+    // 斷線期間看不到畫面，先結束目前的移動；重連後背景重新建立
+    if (m_inMotion) endMotion();
+    flushActivity();
+    m_hasBackground = false;
+    m_consecutive = 0;
+}
+
+// 一列連續的像素加總：沒有跨列相依，編譯器會展開成 SIMD 指令
+static inline uint32_t sumRow(const uint8_t *pixels, int count) {
+    uint32_t sum = 0;
+    for (int i = 0; i < count; ++i) sum += pixels[i];
+    return sum;
+}
+
+bool MotionDetector::reduce(const AVFrame *frame) {
+    // 只接受 8 位元的平面亮度（YUV420P/NV12/YUVJ 等）
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))
+        || desc->comp[0].depth != 8 || desc->comp[0].step != 1)
+        return false;
+
+    const int cellWidth = frame->width / kGridWidth;
+    const int cellHeight = frame->height / kGridHeight;
+    if (cellWidth < 1 || cellHeight < 1) return false;
+
+    // 格子夠高就隔列取樣，平均值差不多但少讀一半記憶體
+    const int rowStep = cellHeight >= 4 ? 2 : 1;
+    const uint32_t samples = uint32_t(cellWidth) * ((cellHeight + rowStep - 1) / rowStep);
+
+    for (int cy = 0; cy < kGridHeight; ++cy) {
+        uint32_t sums[kGridWidth] = {};
+        for (int y = cy * cellHeight; y < (cy + 1) * cellHeight; y += rowStep) {
+            const uint8_t *row = frame->data[0] + ptrdiff_t(y) * frame->linesize[0];
+            for (int cx = 0; cx < kGridWidth; ++cx) sums[cx] += sumRow(row + cx * cellWidth, cellWidth);
+        }
+        uint8_t *out = m_grid.data() + cy * kGridWidth;
+        for (int cx = 0; cx < kGridWidth; ++cx) out[cx] = uint8_t(sums[cx] / samples);
+    }
+    return true;
+}
+
+int MotionDetector::changedBlocks(quint64 *regions) const {
+    // 靈敏度 100 時平均每格差 2 就算變動，靈敏度 1 時要差約 18
+    const int cellThreshold = 2 + (100 - m_sensitivity) / 6;
+    const int blockThreshold = cellThreshold * kBlockSize * kBlockSize;
+
+    int changed = 0;
+    *regions = 0;
+    for (int by = 0; by < kBlocksY; ++by) {
+        for (int bx = 0; bx < kBlocksX; ++bx) {
+            int sad = 0;
+            for (int y = 0; y < kBlockSize; ++y) {
+                const int offset = (by * kBlockSize + y) * kGridWidth + bx * kBlockSize;
+                for (int x = 0; x < kBlockSize; ++x)
+                    sad += std::abs(int(m_grid[offset + x]) - int(m_background[offset + x]));
+            }
+            if (sad >= blockThreshold) {
+                ++changed;
+                const int column = bx * kRegionColumns / kBlocksX;
+                const int row = by * kRegionRows / kBlocksY;
+                *regions |= quint64(1) << (row * kRegionColumns + column);
+            }
+        }
+    }
+    return changed;
+}
+
+void MotionDetector::updateBackground() {
+    for (int i = 0; i < kCells; ++i) {
+        const int diff = int(m_grid[i]) - int(m_background[i]);
+        m_background[i] = uint8_t(int(m_background[i]) + diff / (1 << kBackgroundShift));
+    }
+}
+
+void MotionDetector::analyze(const AVFrame *frame) {
+    if (!reduce(frame)) {
+        if (!m_reduceWarned) {
+            qDebug() << "移動偵測無法分析這個畫面格式，偵測停用:" << frame->width << "x" << frame->height
+                     << av_get_pix_fmt_name(AVPixelFormat(frame->format));
+            m_reduceWarned = true;
+        }
+        return;
+    }
+    if (!m_hasBackground) {
+        m_background = m_grid;
+        m_hasBackground = true;
+        return;
+    }
+
+    quint64 regions = 0;
+    const int percent = changedBlocks(&regions) * 100 / kBlocks;
+    const bool moving = percent > 0 && percent < kGlobalChangePercent;
+    if (percent >= kGlobalChangePercent) m_background = m_grid;
+    else updateBackground();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (m_bucketStartMs >= 0 && now - m_bucketStartMs >= kActivityBucketMs) flushActivity();
+    if (moving) {
+        addActivity(now, percent, regions);
+        if (!m_inMotion && m_consecutive == 0) {
+            // 候選的開始：確認前的變動也算進事件
+            m_motionStartMs = now;
+            m_peak = 0;
+            m_regions = 0;
+        }
+        m_peak = qMax(m_peak, percent);
+        m_regions |= regions;
+        m_lastMotionMs = now;
+        if (!m_inMotion && ++m_consecutive >= (m_keyframesOnly ? 1 : kConfirmFrames)) {
+            m_inMotion = true;
+            emit motionStarted(m_motionStartMs);
+        } else if (m_inMotion && now - m_motionStartMs >= kMaxEventMs) {
+            endMotion();
+            m_inMotion = true;
+            m_motionStartMs = now;
+            emit motionStarted(now);
+        }
+        return;
+    }
+
+    m_consecutive = 0;
+    if (m_inMotion && now - m_lastMotionMs >= kQuietMs) endMotion();
+}
+
+void MotionDetector::endMotion() {
+    m_inMotion = false;
+    m_consecutive = 0;
+    emit motionStopped(m_motionStartMs, m_lastMotionMs, m_peak, m_regions);
+    m_peak = 0;
+    m_regions = 0;
+}
+
+void MotionDetector::addActivity(qint64 timeMs, int percent, quint64 regions) {
+    if (m_bucketStartMs < 0) m_bucketStartMs = timeMs - timeMs % kActivityBucketMs;
+    m_bucketPeak = qMax(m_bucketPeak, percent);
+    m_bucketRegions |= regions;
+}
+
+void MotionDetector::flushActivity() {
+    if (m_bucketStartMs < 0) return;
+    emit activity(m_bucketStartMs, m_bucketPeak, m_bucketRegions);
+    m_bucketStartMs = -1;
+    m_bucketPeak = 0;
+    m_bucketRegions = 0;
+}
@@ -0,0 +1,86 @@
+#ifndef MOTIONDETECTOR_H
+#define MOTIONDETECTOR_H
+
+#include <QObject>
+#include <array>
+#include <atomic>
+
+#include "streamingest.h"
+
+// 移動偵測接收端：在自己的佇列執行緒上以最省的方式解碼，只看縮小後的灰階畫面
+// 亮度先平均成 64x36 的格子，再以 4x4 格為一區塊和背景比 SAD（絕對差總和）
+// 有子碼流時掛在子碼流上；只有主碼流時只解關鍵幀，一路的負擔約等於每 GOP 解一張圖
+class MotionDetector : public QObject, public PacketSink {
+    Q_OBJECT
+public:
+    static const int kGridWidth = 64;
+    static const int kGridHeight = 36;
+    // 移動區域以 8x8 的位元遮罩表示，第 row * 8 + col 位
+    static const int kRegionColumns = 8;
+    static const int kRegionRows = 8;
+    // 活動量以這個長度為一格彙整
+    static const qint64 kActivityBucketMs = 10000;
+
+    explicit MotionDetector(QObject *parent = nullptr);
+    ~MotionDetector() override;
+
+    // 只解關鍵幀（沒有子碼流時用），要在加入擷取端前設定
+    void setKeyframesOnly(bool keyframesOnly) { m_keyframesOnly = keyframesOnly; }
+    // 靈敏度 1~100，越高越小的變動就算移動；任何執行緒皆可
+    void setSensitivity(int sensitivity) { m_sensitivity = qBound(1, sensitivity, 100); }
+
+    void openSink(const IngestLayout &layout) override;
+    void writePacket(const AVPacket *packet) override;
+    void closeSink() override;
+    void sinkInterrupted() override;
+    // 來不及分析時跳過一段沒關係，不能拖慢擷取
+    QueuePolicy queuePolicy() const override { return QueuePolicy::DropOldest; }
+    QString sinkName() const override { return "移動偵測"; }
+
+signals:
+    // 時間為 epoch 毫秒；peak 為變動區塊的最大比例（%），regions 為期間變動過的區域
+    void motionStarted(qint64 timeMs);
+    void motionStopped(qint64 startMs, qint64 endMs, int peak, quint64 regions);
+    // 每個有變動的時間格結束時發出一次（未達移動門檻的小變動也算）
+    void activity(qint64 bucketStartMs, int peak, quint64 regions);
+
+private:
+    static const int kCells = kGridWidth * kGridHeight;
+
+    void openCodec();
+    void releaseCodec();
+    void analyze(const AVFrame *frame);
+    bool reduce(const AVFrame *frame);
+    int changedBlocks(quint64 *regions) const;
+    void updateBackground();
+    void endMotion();
+    void addActivity(qint64 timeMs, int percent, quint64 regions);
+    void flushActivity();
+
+    bool m_keyframesOnly = false;
+    std::atomic_int m_sensitivity{50};
+
+    // 以下只在佇列執行緒使用
+    IngestLayout m_layout;
+    AVCodecContext *m_codec = nullptr;
+    AVFrame *m_frame = nullptr;
+    int m_videoIndex = -1;
+    bool m_decoding = false;            // 等到第一個關鍵幀才開始送解碼器
+    bool m_reduceWarned = false;        // 畫面無法縮成格子時只記錄一次
+    int64_t m_lastAnalysisUs = AV_NOPTS_VALUE;
+
+    std::array<uint8_t, kCells> m_grid{};
+    std::array<uint8_t, kCells> m_background{};
+    bool m_hasBackground = false;
+    bool m_inMotion = false;
+    int m_consecutive = 0;              // 連續幾張有變動，用來濾掉單張雜訊
+    int m_peak = 0;
+    quint64 m_regions = 0;
+    qint64 m_motionStartMs = 0;
+    qint64 m_lastMotionMs = 0;
+    qint64 m_bucketStartMs = -1;        // 目前活動量時間格，-1 表示沒有變動
+    int m_bucketPeak = 0;
+    quint64 m_bucketRegions = 0;
+};
+
+#endif // MOTIONDETECTOR_H
@@ -0,0 +1,150 @@
+#include "motionrecorder.h"
+#include <QDateTime>
+#include <QDebug>
+
+MotionRecorder::MotionRecorder(QObject *parent) : QObject(parent) {
+}
+
+MotionRecorder::~MotionRecorder() {
+    clear();
+}
+
+void MotionRecorder::setPostRoll(int seconds) {
+    m_postRollMs = qMax(0, seconds) * 1000;
+    for (Camera &camera : m_cameras) camera.postRollTimer->setInterval(m_postRollMs);
+}
+
+void MotionRecorder::setSensitivity(int sensitivity) {
+    m_sensitivity = sensitivity;
+    for (Camera &camera : m_cameras) camera.detector->setSensitivity(sensitivity);
+}
+
+void MotionRecorder::setRecordingEnabled(bool enabled) {
+    m_recordingEnabled = enabled;
+    if (enabled) return;
+    for (Camera &camera : m_cameras) {
+        camera.postRollTimer->stop();
+        stopRecording(camera);
+    }
+}
+
+void MotionRecorder::addCamera(StreamIngest *ingest, StreamIngest *detectIngest, const QString &directory) {
+    const QString url = ingest->url();
+    if (m_cameras.contains(url)) return;
+
+    Camera camera;
+    camera.ingest = ingest;
+    camera.detectIngest = detectIngest;
+    camera.tag = "M" + QString::number(m_nextTag++);
+    camera.directory = directory;
+    camera.detector = makeSink<MotionDetector>();
+    camera.detector->setKeyframesOnly(detectIngest == ingest);
+    camera.detector->setSensitivity(m_sensitivity);
+
+    camera.postRollTimer = new QTimer(this);
+    camera.postRollTimer->setSingleShot(true);
+    camera.postRollTimer->setInterval(m_postRollMs);
+    connect(camera.postRollTimer, &QTimer::timeout, this, [this, url](){
+        auto it = m_cameras.find(url);
+        if (it != m_cameras.end()) stopRecording(it.value());
+    });
+
+    // 偵測在自己的佇列執行緒上跑，結果排隊回來
+    MotionDetector *detector = camera.detector.get();
+    connect(detector, &MotionDetector::motionStarted, this, [this, url](qint64 timeMs){
+        onMotionStarted(url, timeMs);
+    }, Qt::QueuedConnection);
+    connect(detector, &MotionDetector::motionStopped, this, [this, url](qint64 startMs, qint64 endMs, int peak, quint64 regions){
+        onMotionStopped(url, startMs, endMs, peak, regions);
+    }, Qt::QueuedConnection);
+    connect(detector, &MotionDetector::activity, this, [this, url](qint64 bucketStartMs, int peak, quint64 regions){
+        emit activity(url, bucketStartMs, peak, regions);
+    }, Qt::QueuedConnection);
+
+    detectIngest->addSink(camera.detector);
+    m_cameras.insert(url, camera);
+}
+
+void MotionRecorder::removeCamera(const QString &url) {
+    auto it = m_cameras.find(url);
+    if (it == m_cameras.end()) return;
+    detach(it.value());
+    m_cameras.erase(it);
+}
+
+void MotionRecorder::clear() {
+    for (Camera &camera : m_cameras) detach(camera);
+    m_cameras.clear();
+}
+
+void MotionRecorder::detach(Camera &camera) {
+    stopRecording(camera);
+    if (camera.detectIngest) camera.detectIngest->removeSink(camera.detector);
+    camera.detector.reset();
+    delete camera.postRollTimer;
+    camera.postRollTimer = nullptr;
+}
+
+bool MotionRecorder::isRecording(const QString &url) const {
+    auto it = m_cameras.constFind(url);
+    return it != m_cameras.constEnd() && it->recorder;
+}
+
+void MotionRecorder::onMotionStarted(const QString &url, qint64 timeMs) {
+    auto it = m_cameras.find(url);
+    if (it == m_cameras.end()) return;
+
+    Camera &camera = it.value();
+    camera.motion = true;
+    camera.postRollTimer->stop();
+    if (camera.recorder) camera.recorder->beginMotionEvent(timeMs);
+    else if (m_recordingEnabled) startRecording(url, camera, timeMs);
+    emit motionStarted(url, timeMs);
+}
+
+void MotionRecorder::onMotionStopped(const QString &url, qint64 startMs, qint64 endMs, int peak, quint64 regions) {
+    auto it = m_cameras.find(url);
+    if (it == m_cameras.end()) return;
+
+    Camera &camera = it.value();
+    camera.motion = false;
+    if (camera.recorder) {
+        camera.recorder->endMotionEvent(endMs, peak);
+        camera.postRollTimer->start();
+    }
+    emit motionStopped(url, startMs, endMs, peak, regions);
+}
+
+void MotionRecorder::startRecording(const QString &url, Camera &camera, qint64 motionStartMs) {
+    if (!camera.ingest || camera.directory.isEmpty()) return;
+
+    camera.recorder = makeSink<StreamRecorder>(camera.directory, camera.tag, m_options);
+    camera.recorder->setMetrics(camera.ingest->metrics());
+    camera.recorder->beginMotionEvent(motionStartMs);
+
+    // addSink/removeSink 可能當場收尾並發出 signal，一律排隊處理
+    StreamRecorder *recorder = camera.recorder.get();
+    connect(recorder, &StreamRecorder::started, this, [this, url](const QString &filePath){
+        emit recordingStarted(url, filePath);
+    }, Qt::QueuedConnection);
+    connect(recorder, &StreamRecorder::segmentFinished, this, [this, url](const RecordedSegment &segment){
+        emit segmentSaved(url, segment);
+    }, Qt::QueuedConnection);
+    connect(recorder, &StreamRecorder::failed, this, [this, url, recorder](const QString &error){
+        auto it = m_cameras.find(url);
+        if (it != m_cameras.end() && it->recorder.get() == recorder) stopRecording(it.value());
+        emit recordingFailed(url, error);
+    }, Qt::QueuedConnection);
+
+    // 預錄緩衝裡觸發前的畫面會先寫進去
+    camera.ingest->addSink(camera.recorder);
+    qDebug() << "移動觸發錄影:" << url;
+}
+
+void MotionRecorder::stopRecording(Camera &camera) {
+    if (!camera.recorder) return;
+    // 移動還沒結束就被叫停（例如改成全域錄影），事件記到收尾為止
+    if (camera.motion) camera.recorder->endMotionEvent(QDateTime::currentMSecsSinceEpoch(), 0);
+    if (camera.ingest) camera.ingest->removeSink(camera.recorder);
+    camera.recorder.reset();
+}
@@ -0,0 +1,70 @@
+#ifndef MOTIONRECORDER_H
+#define MOTIONRECORDER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QHash>
+#include <memory>
+
+#include "streamingest.h"
+#include "streamrecorder.h"
+#include "motiondetector.h"
+
+// 移動觸發錄影：每台攝影機掛一個 MotionDetector，偵測到移動才掛上錄影端
+// 觸發前的畫面來自擷取端的預錄緩衝；移動停止後再多錄 postRoll 秒，期間再有移動就接著錄
+class MotionRecorder : public QObject {
+    Q_OBJECT
+public:
+    explicit MotionRecorder(QObject *parent = nullptr);
+    ~MotionRecorder() override;
+
+    void setOptions(const RecorderOptions &options) { m_options = options; }
+    void setPostRoll(int seconds);
+    void setSensitivity(int sensitivity);
+    // 關掉時只偵測不開檔（例如全域錄影已在錄），進行中的移動錄影會收尾
+    void setRecordingEnabled(bool enabled);
+
+    // detectIngest 為偵測用的來源：有子碼流就給子碼流，否則給主碼流（只解關鍵幀）
+    // directory 為這台攝影機的錄影位置
+    void addCamera(StreamIngest *ingest, StreamIngest *detectIngest, const QString &directory);
+    void removeCamera(const QString &url);
+    void clear();
+
+    bool isRecording(const QString &url) const;
+
+signals:
+    void motionStarted(const QString &url, qint64 timeMs);
+    void motionStopped(const QString &url, qint64 startMs, qint64 endMs, int peak, quint64 regions);
+    void activity(const QString &url, qint64 bucketStartMs, int peak, quint64 regions);
+    void recordingStarted(const QString &url, const QString &filePath);
+    void segmentSaved(const QString &url, const RecordedSegment &segment);
+    void recordingFailed(const QString &url, const QString &error);
+
+private:
+    struct Camera {
+        QPointer<StreamIngest> ingest;
+        QPointer<StreamIngest> detectIngest;
+        std::shared_ptr<MotionDetector> detector;
+        std::shared_ptr<StreamRecorder> recorder;
+        QTimer *postRollTimer = nullptr;
+        bool motion = false;
+        QString tag;            // 檔名用，每台攝影機固定
+        QString directory;
+    };
+
+    void onMotionStarted(const QString &url, qint64 timeMs);
+    void onMotionStopped(const QString &url, qint64 startMs, qint64 endMs, int peak, quint64 regions);
+    void startRecording(const QString &url, Camera &camera, qint64 motionStartMs);
+    void stopRecording(Camera &camera);
+    void detach(Camera &camera);
+
+    RecorderOptions m_options;
+    int m_postRollMs = 10000;
+    int m_sensitivity = 50;
+    bool m_recordingEnabled = true;
+    QHash<QString, Camera> m_cameras;   // 攝影機網址 -> 狀態
+    int m_nextTag = 0;
+};
+
+#endif // MOTIONRECORDER_H
@@ -0,0 +1,88 @@
+#include "packetringbuffer.h"
+
+PreRollBudget &PreRollBudget::global() {
+    static PreRollBudget budget;
+    return budget;
+}
+
+bool PreRollBudget::reserve(qint64 bytes) {
+    qint64 used = m_used.load();
+    do {
+        if (used + bytes > m_limit.load()) return false;
+    } while (!m_used.compare_exchange_weak(used, used + bytes));
+    return true;
+}
+
+PacketRingBuffer::PacketRingBuffer(PreRollBudget *budget) : m_budget(budget) {
+}
+
+PacketRingBuffer::~PacketRingBuffer() {
+    clear();
+}
+
+void PacketRingBuffer::setLimits(int64_t durationUs, qint64 maxBytes) {
+    m_durationLimit = durationUs;
+    m_byteLimit = maxBytes;
+    if (m_durationLimit <= 0 || m_byteLimit <= 0) clear();
+    else trim();
+}
+
+void PacketRingBuffer::clear() {
+    while (!m_entries.empty()) dropFront();
+}
+
+void PacketRingBuffer::dropFront() {
+    Entry entry = m_entries.front();
+    m_entries.pop_front();
+    m_bytes -= entry.packet->size;
+    m_budget->release(entry.packet->size);
+    av_packet_free(&entry.packet);
+}
+
+bool PacketRingBuffer::dropOldestGop() {
+    if (m_entries.empty()) return false;
+    // 丟掉開頭的關鍵幀，一路丟到下一個關鍵幀為止
+    do {
+        dropFront();
+    } while (!m_entries.empty() && !m_entries.front().cutPoint);
+    return true;
+}
+
+void PacketRingBuffer::push(const AVPacket *packet, int64_t timeUs, bool cutPoint) {
+    if (m_durationLimit <= 0 || m_byteLimit <= 0) return;
+
+    // 緩衝一律從關鍵幀開始，之前的封包沒辦法單獨解碼
+    if (m_entries.empty() && !cutPoint) return;
+
+    // 全域額度不夠時先犧牲自己最舊的 GOP
+    while (!m_budget->reserve(packet->size)) {
+        if (!dropOldestGop()) return;
+        if (!cutPoint && m_entries.empty()) return;
+    }
+
+    AVPacket *copy = av_packet_clone(packet);
+    if (!copy) {
+        m_budget->release(packet->size);
+        return;
+    }
+
+    m_entries.push_back(Entry{copy, timeUs, cutPoint});
+    m_bytes += packet->size;
+    trim();
+}
+
+void PacketRingBuffer::trim() {
+    if (m_entries.empty()) return;
+    const int64_t newest = m_entries.back().time;
+
+    // 只要從下一個關鍵幀開始仍涵蓋足夠秒數，就丟掉最舊的 GOP
+    for (;;) {
+        auto next = m_entries.begin() + 1;
+        while (next != m_entries.end() && !next->cutPoint) ++next;
+        if (next == m_entries.end() || newest - next->time < m_durationLimit) break;
+        dropOldestGop();
+    }
+
+    while (m_bytes > m_byteLimit && dropOldestGop()) {
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef PACKETRINGBUFFER_H
+#define PACKETRINGBUFFER_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <deque>
+
+extern "C" {
+#include <libavcodec/packet.h>
+}
+
+// 所有攝影機預錄緩衝共用的記憶體上限
+class PreRollBudget {
+public:
+    static PreRollBudget &global();
+
+    void setLimit(qint64 bytes) { m_limit = bytes; }
+    qint64 limit() const { return m_limit; }
+    qint64 used() const { return m_used; }
+
+    // 超過上限時回傳 false，不佔用
+    bool reserve(qint64 bytes);
+    void release(qint64 bytes) { m_used -= bytes; }
+
+private:
+    std::atomic<qint64> m_limit{256LL * 1024 * 1024};
+    std::atomic<qint64> m_used{0};
+};
+
+// 預錄用的封包環形緩衝：保留最近 N 秒的壓縮封包，開頭一定是關鍵幀
+// 只在擷取執行緒使用，不需要鎖
+class PacketRingBuffer {
+public:
+    explicit PacketRingBuffer(PreRollBudget *budget = &PreRollBudget::global());
+    ~PacketRingBuffer();
+
+    void setLimits(int64_t durationUs, qint64 maxBytes);
+    int64_t durationLimit() const { return m_durationLimit; }
+    qint64 byteLimit() const { return m_byteLimit; }
+
+    // timeUs 為封包 DTS（微秒），cutPoint 表示可以從這個封包開始解碼
+    void push(const AVPacket *packet, int64_t timeUs, bool cutPoint);
+    void clear();
+
+    bool isEmpty() const { return m_entries.empty(); }
+    qint64 bytes() const { return m_bytes; }
+
+    template <typename Func>
+    void forEach(Func func) const {
+        for (const Entry &entry : m_entries) func(entry.packet);
+    }
+
+private:
+    struct Entry {
+        AVPacket *packet;
+        int64_t time;
+        bool cutPoint;
+    };
+
+    void dropFront();
+    bool dropOldestGop();
+    void trim();
+
+    PreRollBudget *m_budget;
+    std::deque<Entry> m_entries;
+    int64_t m_durationLimit = 0;
+    qint64 m_byteLimit = 0;
+    qint64 m_bytes = 0;
+};
+
+#endif // PACKETRINGBUFFER_H
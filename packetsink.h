@@ -0,0 +1,40 @@
+#ifndef PACKETSINK_H
+#define PACKETSINK_H
+
+#include <QString>
+#include <memory>
+#include <utility>
+
+#include "ffmpegutils.h"
+
+// 封包接收端：即時解碼、錄影等都實作這個介面
+// 每個接收端有自己的佇列與執行緒，方法都在該執行緒上依序被呼叫，慢的接收端不會拖住擷取
+class PacketSink {
+public:
+    // 佇列滿了怎麼辦：Lossless 讓擷取端等（錄影，一個封包都不能少）；
+    // DropOldest 丟掉最舊的非關鍵幀，下一個送出的一定是關鍵幀（顯示、偵測，寧可跳格也不要延遲）
+    enum class QueuePolicy { Lossless, DropOldest };
+
+    virtual ~PacketSink() = default;
+    // 開始收封包前呼叫，layout 描述來源各軌道；斷線重連後會以新的 layout 再呼叫一次
+    virtual void openSink(const IngestLayout &layout) = 0;
+    // packet->stream_index 對應 layout 中的軌道，時間戳為該軌道的 timeBase
+    virtual void writePacket(const AVPacket *packet) = 0;
+    // 從擷取端移除或來源結束時呼叫；之後不會再收到封包
+    virtual void closeSink() = 0;
+    // 來源斷線，重連成功前不會再收到封包；時間戳在重連後不連續
+    virtual void sinkInterrupted() {}
+    // 回傳 true 時，加入後會先收到預錄緩衝裡的封包
+    virtual bool wantsPreRoll() const { return false; }
+    virtual QueuePolicy queuePolicy() const { return QueuePolicy::Lossless; }
+    // 佇列統計顯示用
+    virtual QString sinkName() const { return QString(); }
+};
+
+// QObject 型的接收端可能在擷取或佇列執行緒放掉最後一個參考，交給所屬執行緒刪除
+template <typename T, typename... Args>
+std::shared_ptr<T> makeSink(Args &&...args) {
+    return std::shared_ptr<T>(new T(std::forward<Args>(args)...), [](T *sink) { sink->deleteLater(); });
+}
+
+#endif // PACKETSINK_H
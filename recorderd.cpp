@@ -0,0 +1,152 @@
+// 背景錄影服務：不開視窗，從設定檔讀攝影機清單後一直錄到收到結束訊號
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QFileInfo>
+#include <QTimer>
+#include <QDebug>
+#include <atomic>
+#include <csignal>
+
+#include "recorderengine.h"
+
+// 全域錄影沒有任何一路起來時，隔一段時間再試（攝影機可能還沒開機）
+static const int kRetryDelayMs = 30000;
+
+static std::atomic<bool> g_quitRequested{false};
+
+static void requestQuit(int) {
+    g_quitRequested = true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("recorderd");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("多路監控背景錄影服務");
+    parser.addHelpOption();
+    QCommandLineOption configOption(QStringList() << "c" << "config", "設定檔路徑", "file",
+                                    QCoreApplication::applicationDirPath() + "/recorderd.ini");
+    parser.addOption(configOption);
+    parser.process(app);
+
+    const QString configPath = parser.value(configOption);
+    if (!QFileInfo::exists(configPath)) {
+        qDebug() << "找不到設定檔:" << configPath;
+        return 1;
+    }
+    QSettings settings(configPath, QSettings::IniFormat);
+
+    settings.beginGroup("recorder");
+    const QString recordingsPath = settings.value("recordingsPath",
+                                                  QCoreApplication::applicationDirPath() + "/recordings").toString();
+    RecorderOptions options;
+    options.segmentSeconds = settings.value("segmentMinutes", 5).toInt() * 60;
+    options.container = settings.value("container", "fmp4").toString() == "ts" ? RecorderOptions::MpegTs
+                                                                               : RecorderOptions::FragmentedMp4;
+    // 預錄：秒數與每路記憶體上限為預設值，個別攝影機可以另外設定；preRollBudgetMB 為全部合計的上限
+    const int preRoll = settings.value("preRoll", 5).toInt();
+    const qint64 preRollMaxMB = settings.value("preRollMaxMB", 32).toLongLong();
+    const qint64 preRollBudgetMB = settings.value("preRollBudgetMB", 256).toLongLong();
+    const bool motionMode = settings.value("mode", "continuous").toString() == "motion";
+    const int postRoll = settings.value("postRoll", 10).toInt();
+    const int sensitivity = settings.value("sensitivity", 50).toInt();
+    // 本機轉播的埠，0 表示不轉播
+    const quint16 relayPort = quint16(settings.value("relayPort", 0).toUInt());
+    // 轉播聽的位址，預設只有本機；0.0.0.0 表示所有介面（沒有驗證，區網內都看得到）
+    const QHostAddress relayBind(settings.value("relayBind", "127.0.0.1").toString());
+    // 效能統計：每隔幾秒附加一列到 CSV，空的表示不寫；轉播開著時另外有 /metrics
+    const QString metricsCsv = settings.value("metricsCsv").toString();
+    const int metricsInterval = settings.value("metricsInterval", 10).toInt();
+    settings.endGroup();
+    if (relayPort > 0 && relayBind.isNull()) {
+        qDebug() << "relayBind 不是有效的位址:" << settings.value("recorder/relayBind").toString();
+        return 1;
+    }
+
+    QList<CameraConfig> cameras;
+    const int count = settings.beginReadArray("cameras");
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex(i);
+        CameraConfig camera;
+        camera.url = settings.value("url").toString().trimmed();
+        camera.subUrl = settings.value("subUrl").toString().trimmed();
+        camera.preRollSeconds = settings.value("preRoll", -1).toInt();
+        camera.preRollMaxBytes = settings.value("preRollMaxMB", 0).toLongLong() * 1024 * 1024;
+        if (!camera.url.isEmpty()) cameras << camera;
+    }
+    settings.endArray();
+    if (cameras.isEmpty()) {
+        qDebug() << "設定檔沒有任何攝影機:" << configPath;
+        return 1;
+    }
+
+    RecorderEngine engine(recordingsPath);
+    engine.setPreRollSeconds(preRoll);
+    engine.setPreRollMaxBytes(preRollMaxMB * 1024 * 1024);
+    engine.setPreRollBudget(preRollBudgetMB * 1024 * 1024);
+    engine.setMotionOptions(options);
+    engine.setMotionPostRoll(postRoll);
+    engine.setMotionSensitivity(sensitivity);
+    engine.metricsSampler()->setInterval(qMax(1, metricsInterval) * 1000);
+    engine.metricsSampler()->setCsvPath(metricsCsv);
+
+    QObject::connect(&engine, &RecorderEngine::cameraOpened, [](const QString &url){
+        qDebug() << "已連線:" << url;
+    });
+    QObject::connect(&engine, &RecorderEngine::cameraReconnecting, [](const QString &url, int attempt, int delayMs){
+        qDebug() << "斷線，" << delayMs / 1000 << "秒後第" << attempt << "次重連:" << url;
+    });
+    RecordingController *controller = engine.recordingController();
+    QObject::connect(controller, &RecordingController::recordingStarted, [](const QString &url, const QString &file){
+        qDebug() << "開始寫入:" << url << file;
+    });
+    QObject::connect(controller, &RecordingController::recordingFailed, [](const QString &url, const QString &error){
+        qDebug() << "錄影錯誤:" << url << error;
+    });
+    QObject::connect(controller, &RecordingController::recordingGap, [](const QString &url, const QDateTime &start, const QDateTime &end){
+        qDebug() << "錄影中斷後已恢復:" << url << start.toString("HH:mm:ss") << "~" << end.toString("HH:mm:ss");
+    });
+    QObject::connect(engine.motionRecorder(), &MotionRecorder::recordingFailed, [](const QString &url, const QString &error){
+        qDebug() << "移動錄影錯誤:" << url << error;
+    });
+
+    if (relayPort > 0) engine.startRelay(relayPort, relayBind);
+    for (const CameraConfig &camera : std::as_const(cameras)) {
+        engine.addCamera(camera);
+        if (relayPort > 0) qDebug() << "轉播:" << camera.url << "->" << engine.relayUrl(camera.url);
+    }
+
+    if (motionMode) {
+        engine.setMotionRecording(true);
+    } else {
+        QObject::connect(controller, &RecordingController::startCompleted, &engine, [&engine, options](int startedCount, int failedCount){
+            if (startedCount > 0) {
+                qDebug() << "全域錄影已開始:" << startedCount << "路，失敗" << failedCount << "路";
+                return;
+            }
+            qDebug() << "所有錄影都啟動失敗，" << kRetryDelayMs / 1000 << "秒後重試";
+            QTimer::singleShot(kRetryDelayMs, &engine, [&engine, options](){
+                if (!g_quitRequested) engine.startRecording(options);
+            });
+        });
+        engine.startRecording(options);
+    }
+    qDebug() << "背景錄影已啟動:" << cameras.size() << "台攝影機，" << (motionMode ? "移動觸發" : "連續") << "錄影，"
+            << "錄影資料夾" << recordingsPath;
+
+    // 訊號處理函式裡只設旗標，由事件迴圈定時檢查後正常結束，讓錄影寫完檔尾
+    std::signal(SIGINT, requestQuit);
+    std::signal(SIGTERM, requestQuit);
+    QTimer quitPoll;
+    QObject::connect(&quitPoll, &QTimer::timeout, &app, [](){
+        if (g_quitRequested) QCoreApplication::quit();
+    });
+    quitPoll.start(200);
+
+    const int result = app.exec();
+    qDebug() << "正在停止錄影...";
+    engine.shutdown();
+    return result;
+}
@@ -0,0 +1,10 @@
+# 背景錄影服務：不需要視窗環境，從設定檔讀攝影機清單
+TEMPLATE = app
+TARGET = recorderd
+CONFIG += console c++17
+CONFIG -= app_bundle
+QT = core gui network
+
+include(recorderengine.pri)
+
+SOURCES += recorderd.cpp
@@ -0,0 +1,317 @@
+#include "recorderengine.h"
+#include <QDir>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThread>
+
+// 每路預錄緩衝預設的記憶體上限；所有攝影機合計另受 PreRollBudget 限制
+static const qint64 kDefaultPreRollBytesPerCamera = 32LL * 1024 * 1024;
+
+RecorderEngine::RecorderEngine(const QString &recordingsPath, QObject *parent)
+    : QObject(parent), m_recordingsPath(recordingsPath), m_preRollMaxBytes(kDefaultPreRollBytesPerCamera) {
+    QDir().mkpath(m_recordingsPath);
+
+    // 錄影索引與事件索引；容量上限與多個儲存位置由 StorageManager 在背景從最舊的分段開始刪
+    m_recordingIndex = new RecordingIndex(m_recordingsPath, this);
+    m_eventIndex = new EventIndex(m_recordingsPath, this);
+    m_storageManager = new StorageManager(m_recordingsPath, m_recordingIndex, this);
+    // 儲存位置要先讀出來，索引壞掉重建時其他位置的分段才不會漏掉
+    m_recordingIndex->load(m_storageManager->volumes());
+    m_thumbnailStore = new ThumbnailStore(m_recordingsPath, this);
+    connect(m_storageManager, &StorageManager::segmentsRemoved, this, [this](const QStringList &fileNames){
+        for (const QString &fileName : fileNames) m_thumbnailStore->evict(fileName);
+    });
+
+    // 錄影控制與移動錄影跑在自己的執行緒：視窗開著對話框或忙著重畫時，
+    // 開始/停止錄影、等關鍵幀與後錄的計時不會跟著卡住
+    m_controlThread = new QThread(this);
+    m_controlThread->setObjectName("錄影控制");
+    m_recordingController = new RecordingController();
+    m_motionRecorder = new MotionRecorder();
+    m_recordingController->moveToThread(m_controlThread);
+    m_motionRecorder->moveToThread(m_controlThread);
+    connect(m_controlThread, &QThread::finished, m_recordingController, &QObject::deleteLater);
+    connect(m_controlThread, &QThread::finished, m_motionRecorder, &QObject::deleteLater);
+
+    connect(m_recordingController, &RecordingController::segmentSaved, this, &RecorderEngine::onSegmentSaved);
+    // 全域錄影沒起來或已停止，移動錄影恢復自己開檔；兩者同一條執行緒，直接呼叫
+    MotionRecorder *motion = m_motionRecorder;
+    connect(m_recordingController, &RecordingController::startCompleted, motion, [motion](int startedCount){
+        if (startedCount == 0) motion->setRecordingEnabled(true);
+    });
+    connect(m_recordingController, &RecordingController::stopCompleted, motion, [motion](){
+        motion->setRecordingEnabled(true);
+    });
+
+    RecordingController *controller = m_recordingController;
+    connect(m_motionRecorder, &MotionRecorder::motionStarted, m_recordingController, &RecordingController::beginMotionEvent);
+    connect(m_motionRecorder, &MotionRecorder::motionStopped, controller, [controller](const QString &url, qint64,
+                                                                                       qint64 endMs, int peak){
+        controller->endMotionEvent(url, endMs, peak);
+    });
+    connect(m_motionRecorder, &MotionRecorder::motionStopped, m_eventIndex, &EventIndex::appendMotion);
+    connect(m_motionRecorder, &MotionRecorder::activity, m_eventIndex, &EventIndex::appendActivity);
+    connect(m_motionRecorder, &MotionRecorder::segmentSaved, this, &RecorderEngine::onSegmentSaved);
+
+    m_metricsSampler = new MetricsSampler(this);
+    m_controlThread->start();
+}
+
+RecorderEngine::~RecorderEngine() {
+    shutdown();
+}
+
+void RecorderEngine::setPreRollSeconds(int seconds) {
+    m_preRollSeconds = seconds;
+    for (const Camera &camera : std::as_const(m_cameras)) applyPreRoll(camera);
+}
+
+void RecorderEngine::setPreRollMaxBytes(qint64 bytes) {
+    m_preRollMaxBytes = bytes;
+    for (const Camera &camera : std::as_const(m_cameras)) applyPreRoll(camera);
+}
+
+void RecorderEngine::setCameraPreRoll(const QString &url, int seconds, qint64 maxBytes) {
+    for (Camera &camera : m_cameras) {
+        if (camera.config.url != url) continue;
+        camera.config.preRollSeconds = seconds;
+        camera.config.preRollMaxBytes = maxBytes;
+        applyPreRoll(camera);
+        return;
+    }
+}
+
+void RecorderEngine::setPreRollBudget(qint64 bytes) {
+    PreRollBudget::global().setLimit(bytes);
+}
+
+qint64 RecorderEngine::preRollBudget() const {
+    return PreRollBudget::global().limit();
+}
+
+void RecorderEngine::applyPreRoll(const Camera &camera) const {
+    const int seconds = camera.config.preRollSeconds >= 0 ? camera.config.preRollSeconds : m_preRollSeconds;
+    const qint64 maxBytes = camera.config.preRollMaxBytes > 0 ? camera.config.preRollMaxBytes : m_preRollMaxBytes;
+    camera.ingest->setPreRoll(seconds, maxBytes);
+}
+
+bool RecorderEngine::addCamera(const CameraConfig &config) {
+    if (config.url.isEmpty() || findCamera(config.url)) return false;
+
+    // 擷取：即時畫面、錄影與移動偵測共用同一條連線
+    Camera camera;
+    camera.config = config;
+    camera.relayName = QString::number(m_nextCameraId++);
+    camera.ingest = new StreamIngest(config.url, this);
+    applyPreRoll(camera);
+    if (!config.subUrl.isEmpty()) {
+        camera.subIngest = new StreamIngest(config.subUrl, this);
+        connect(camera.subIngest, &StreamIngest::failed, this, [url = config.subUrl](const QString &error){
+            qDebug() << "子碼流錯誤:" << url << error;
+        });
+    }
+
+    const QString url = config.url;
+    connect(camera.ingest, &StreamIngest::opened, this, [this, url](){ emit cameraOpened(url); });
+    connect(camera.ingest, &StreamIngest::probed, this, [this, url](const StreamProbe &probe){ emit cameraProbed(url, probe); });
+    connect(camera.ingest, &StreamIngest::failed, this, [this, url](const QString &error){
+        qDebug() << "串流錯誤:" << url << error;
+        emit cameraFailed(url, error);
+    });
+    connect(camera.ingest, &StreamIngest::reconnecting, this, [this, url](int attempt, int delayMs){
+        emit cameraReconnecting(url, attempt, delayMs);
+    });
+
+    if (m_relay) attachRelay(camera);
+    m_cameras.append(camera);
+    m_metricsSampler->addCamera(url, camera.ingest, camera.subIngest);
+    camera.ingest->start();
+    if (camera.subIngest) camera.subIngest->start();
+    if (m_motionEnabled) addMotionCamera(camera);
+    return true;
+}
+
+void RecorderEngine::removeCamera(const QString &url) {
+    for (int i = 0; i < m_cameras.size(); ++i) {
+        if (m_cameras[i].config.url != url) continue;
+        Camera camera = m_cameras.takeAt(i);
+        // 等移動錄影先卸下接收端，再停這一路的擷取
+        MotionRecorder *motion = m_motionRecorder;
+        QMetaObject::invokeMethod(motion, [motion, url](){ motion->removeCamera(url); },
+                                  Qt::BlockingQueuedConnection);
+        m_metricsSampler->removeCamera(url);
+        detachRelay(camera);
+
+        // 停止擷取：擷取執行緒結束前會等錄影端寫完檔尾
+        for (StreamIngest *ingest : {camera.ingest, camera.subIngest}) {
+            if (!ingest) continue;
+            connect(ingest, &QThread::finished, ingest, &QObject::deleteLater);
+            ingest->stop();
+            if (ingest->isFinished()) ingest->deleteLater();
+        }
+        return;
+    }
+}
+
+QStringList RecorderEngine::cameras() const {
+    QStringList urls;
+    for (const Camera &camera : m_cameras) urls << camera.config.url;
+    return urls;
+}
+
+StreamIngest *RecorderEngine::ingest(const QString &url) const {
+    const Camera *camera = findCamera(url);
+    return camera ? camera->ingest : nullptr;
+}
+
+StreamIngest *RecorderEngine::subIngest(const QString &url) const {
+    const Camera *camera = findCamera(url);
+    return camera ? camera->subIngest : nullptr;
+}
+
+const RecorderEngine::Camera *RecorderEngine::findCamera(const QString &url) const {
+    for (const Camera &camera : m_cameras)
+        if (camera.config.url == url) return &camera;
+    return nullptr;
+}
+
+void RecorderEngine::startRecording(const RecorderOptions &options) {
+    QList<StreamIngest *> ingests;
+    QStringList directories;
+    for (const Camera &camera : std::as_const(m_cameras)) {
+        ingests << camera.ingest;
+        directories << m_storageManager->directoryFor(camera.config.url);
+    }
+
+    // 全域錄影期間移動偵測只標事件，不另外開檔
+    MotionRecorder *motion = m_motionRecorder;
+    RecordingController *controller = m_recordingController;
+    QMetaObject::invokeMethod(controller, [motion, controller, ingests, directories, options](){
+        motion->setOptions(options);
+        motion->setRecordingEnabled(false);
+        controller->startAll(ingests, directories, options);
+    });
+}
+
+void RecorderEngine::stopRecording() {
+    QMetaObject::invokeMethod(m_recordingController, &RecordingController::stopAll);
+}
+
+void RecorderEngine::setMotionOptions(const RecorderOptions &options) {
+    MotionRecorder *motion = m_motionRecorder;
+    QMetaObject::invokeMethod(motion, [motion, options](){ motion->setOptions(options); });
+}
+
+void RecorderEngine::setMotionPostRoll(int seconds) {
+    MotionRecorder *motion = m_motionRecorder;
+    QMetaObject::invokeMethod(motion, [motion, seconds](){ motion->setPostRoll(seconds); });
+}
+
+void RecorderEngine::setMotionSensitivity(int sensitivity) {
+    MotionRecorder *motion = m_motionRecorder;
+    QMetaObject::invokeMethod(motion, [motion, sensitivity](){ motion->setSensitivity(sensitivity); });
+}
+
+void RecorderEngine::setMotionRecording(bool enabled) {
+    if (enabled == m_motionEnabled) return;
+    m_motionEnabled = enabled;
+    MotionRecorder *motion = m_motionRecorder;
+    if (!enabled) {
+        QMetaObject::invokeMethod(motion, &MotionRecorder::clear);
+        return;
+    }
+
+    // 全域錄影的狀態只在控制執行緒上讀
+    RecordingController *controller = m_recordingController;
+    QMetaObject::invokeMethod(motion, [motion, controller](){
+        motion->setRecordingEnabled(controller->state() == RecordingController::Idle);
+    });
+    for (const Camera &camera : std::as_const(m_cameras)) addMotionCamera(camera);
+}
+
+void RecorderEngine::addMotionCamera(const Camera &camera) {
+    MotionRecorder *motion = m_motionRecorder;
+    StreamIngest *ingest = camera.ingest;
+    StreamIngest *detectIngest = camera.subIngest ? camera.subIngest : camera.ingest;
+    const QString directory = m_storageManager->directoryFor(camera.config.url);
+    QMetaObject::invokeMethod(motion, [motion, ingest, detectIngest, directory](){
+        motion->addCamera(ingest, detectIngest, directory);
+    });
+}
+
+void RecorderEngine::startRelay(quint16 port, const QHostAddress &address) {
+    if (m_relay) return;
+    m_relay = new RelayServer(port, address, this);
+    MetricsSampler *sampler = m_metricsSampler;
+    m_relay->setMetricsProvider([sampler]() { return sampler->prometheusText(); });
+    for (Camera &camera : m_cameras) attachRelay(camera);
+    m_relay->start();
+}
+
+void RecorderEngine::stopRelay() {
+    if (!m_relay) return;
+    for (Camera &camera : m_cameras) detachRelay(camera);
+    m_relay->stop();
+    m_relay->wait();
+    delete m_relay;
+    m_relay = nullptr;
+}
+
+QString RecorderEngine::relayUrl(const QString &url) const {
+    const Camera *camera = findCamera(url);
+    return m_relay && camera ? m_relay->urlFor(camera->relayName) : QString();
+}
+
+void RecorderEngine::attachRelay(Camera &camera) {
+    camera.relaySink = std::make_shared<RelaySink>(m_relay->addChannel(camera.relayName));
+    camera.ingest->addSink(camera.relaySink);
+}
+
+void RecorderEngine::detachRelay(Camera &camera) {
+    if (!camera.relaySink) return;
+    camera.ingest->removeSink(camera.relaySink);
+    m_relay->removeChannel(camera.relayName);
+    camera.relaySink.reset();
+}
+
+void RecorderEngine::shutdown() {
+    stopRelay();
+    // 控制執行緒已經結束表示做過了；移動錄影的收尾要在它自己的執行緒上等它做完
+    if (!m_controlThread->isRunning()) return;
+    MotionRecorder *motion = m_motionRecorder;
+    QMetaObject::invokeMethod(motion, [motion](){ motion->clear(); }, Qt::BlockingQueuedConnection);
+    // 先全部要求停止再等待，讓各路錄影同時收尾
+    for (const Camera &camera : std::as_const(m_cameras)) {
+        camera.ingest->stop();
+        if (camera.subIngest) camera.subIngest->stop();
+    }
+    for (const Camera &camera : std::as_const(m_cameras)) {
+        camera.ingest->wait();
+        if (camera.subIngest) camera.subIngest->wait();
+    }
+    // 擷取結束時各錄影端的收尾 signal 都已排進控制執行緒，控制物件再轉成 segmentSaved 排回這裡；
+    // 程式結束時兩邊的事件迴圈都不會再跑，手動送完，最後一段才會進索引與容量管理
+    QMetaObject::invokeMethod(m_recordingController, [](){ QCoreApplication::sendPostedEvents(); },
+                              Qt::BlockingQueuedConnection);
+    QCoreApplication::sendPostedEvents();
+    // 控制物件在執行緒結束時隨之刪除
+    m_controlThread->quit();
+    m_controlThread->wait();
+}
+
+void RecorderEngine::onSegmentSaved(const QString &url, const RecordedSegment &segment) {
+    qDebug() << "檔案已儲存:" << segment.filePath << "大小:" << (segment.bytes / 1024.0 / 1024.0) << "MB";
+    if (segment.bytes <= 1024) return;
+
+    RecordingEntry entry;
+    entry.fileName = recordingFileName(m_recordingsPath, segment.filePath);
+    entry.camera = url;
+    entry.startMs = segment.startMs;
+    entry.durationMs = segment.durationMs;
+    entry.bytes = segment.bytes;
+    entry.codec = segment.codec;
+    entry.motion = segment.motion;
+    m_recordingIndex->append(entry);
+    m_thumbnailStore->generate(entry.fileName);
+    m_storageManager->scheduleCleanup();
+}
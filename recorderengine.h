@@ -0,0 +1,128 @@
+#ifndef RECORDERENGINE_H
+#define RECORDERENGINE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QList>
+
+#include "streamingest.h"
+#include "recordingcontroller.h"
+#include "motionrecorder.h"
+#include "recordingindex.h"
+#include "eventindex.h"
+#include "storagemanager.h"
+#include "thumbnailstore.h"
+#include "relayserver.h"
+#include "relaysink.h"
+#include "metricssampler.h"
+
+// 一台攝影機：主碼流與選填的子碼流（移動偵測優先用子碼流）
+struct CameraConfig {
+    QString url;
+    QString subUrl;
+    int preRollSeconds = -1;        // 這一路的預錄秒數，-1 表示用引擎的預設值
+    qint64 preRollMaxBytes = 0;     // 這一路預錄緩衝的記憶體上限，0 表示用引擎的預設值
+};
+
+// 擷取/錄影引擎：攝影機連線、全域錄影、移動觸發錄影，以及錄影索引、事件索引與儲存空間管理
+// 不含任何介面：背景服務 recorderd 直接跑它，視窗程式在它上面加即時畫面與回放
+class RecorderEngine : public QObject {
+    Q_OBJECT
+public:
+    explicit RecorderEngine(const QString &recordingsPath, QObject *parent = nullptr);
+    ~RecorderEngine() override;
+
+    QString recordingsPath() const { return m_recordingsPath; }
+
+    // 預錄的預設秒數與每路記憶體上限，套用到沒有個別設定的攝影機（已加入的也會更新）
+    void setPreRollSeconds(int seconds);
+    void setPreRollMaxBytes(qint64 bytes);
+    int preRollSeconds() const { return m_preRollSeconds; }
+    qint64 preRollMaxBytes() const { return m_preRollMaxBytes; }
+    // 個別攝影機的預錄設定，意義同 CameraConfig 的欄位
+    void setCameraPreRoll(const QString &url, int seconds, qint64 maxBytes);
+    // 所有攝影機預錄緩衝合計的記憶體上限；不夠時各路先丟自己最舊的 GOP，錄影照常
+    void setPreRollBudget(qint64 bytes);
+    qint64 preRollBudget() const;
+
+    // 加入攝影機並開始擷取；網址已存在時回傳 false
+    bool addCamera(const CameraConfig &camera);
+    void removeCamera(const QString &url);
+    QStringList cameras() const;
+    StreamIngest *ingest(const QString &url) const;
+    StreamIngest *subIngest(const QString &url) const;
+
+    // 全域錄影：所有攝影機同時開始，結果由 recordingController() 的 signal 回報
+    void startRecording(const RecorderOptions &options);
+    void stopRecording();
+
+    // 移動觸發錄影；全域錄影進行中時只偵測，事件標在全域錄影的分段上
+    void setMotionRecording(bool enabled);
+    bool isMotionRecording() const { return m_motionEnabled; }
+    // 移動錄影設定，排到控制執行緒上套用
+    void setMotionOptions(const RecorderOptions &options);
+    void setMotionPostRoll(int seconds);
+    void setMotionSensitivity(int sensitivity);
+
+    // 本機轉播：其他看的人改從這裡拉，不再各自連攝影機；沒有驗證，預設只聽本機
+    void startRelay(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+    void stopRelay();
+    bool isRelaying() const { return m_relay != nullptr; }
+    // 這台攝影機的轉播網址；沒有轉播時為空
+    QString relayUrl(const QString &url) const;
+    int relayClientCount() const { return m_relay ? m_relay->clientCount() : 0; }
+
+    // 停止所有擷取，等錄影寫完檔尾才回來（程式結束時呼叫）
+    void shutdown();
+
+    // 這兩個物件住在錄影控制執行緒：外面只接它們的 signal，操作一律經過引擎
+    RecordingController *recordingController() const { return m_recordingController; }
+    MotionRecorder *motionRecorder() const { return m_motionRecorder; }
+    RecordingIndex *recordingIndex() const { return m_recordingIndex; }
+    EventIndex *eventIndex() const { return m_eventIndex; }
+    StorageManager *storageManager() const { return m_storageManager; }
+    ThumbnailStore *thumbnailStore() const { return m_thumbnailStore; }
+    // 各攝影機的效能統計；轉播開著時也從 /metrics 提供
+    MetricsSampler *metricsSampler() const { return m_metricsSampler; }
+
+signals:
+    void cameraOpened(const QString &url);
+    void cameraProbed(const QString &url, const StreamProbe &probe);
+    void cameraFailed(const QString &url, const QString &error);
+    void cameraReconnecting(const QString &url, int attempt, int delayMs);
+
+private:
+    struct Camera {
+        CameraConfig config;
+        StreamIngest *ingest = nullptr;
+        StreamIngest *subIngest = nullptr;
+        QString relayName;                  // 轉播頻道名稱，加入時依序編號
+        std::shared_ptr<RelaySink> relaySink;
+    };
+
+    const Camera *findCamera(const QString &url) const;
+    void applyPreRoll(const Camera &camera) const;
+    void addMotionCamera(const Camera &camera);
+    void attachRelay(Camera &camera);
+    void detachRelay(Camera &camera);
+    void onSegmentSaved(const QString &url, const RecordedSegment &segment);
+
+    QString m_recordingsPath;
+    int m_preRollSeconds = 5;
+    qint64 m_preRollMaxBytes;
+    bool m_motionEnabled = false;
+    QList<Camera> m_cameras;        // 依加入順序
+    int m_nextCameraId = 1;
+    RelayServer *m_relay = nullptr;
+
+    QThread *m_controlThread;
+    RecordingController *m_recordingController;
+    MotionRecorder *m_motionRecorder;
+    RecordingIndex *m_recordingIndex;
+    EventIndex *m_eventIndex;
+    StorageManager *m_storageManager;
+    ThumbnailStore *m_thumbnailStore;
+    MetricsSampler *m_metricsSampler;
+};
+
+#endif // RECORDERENGINE_H
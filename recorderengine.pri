@@ -0,0 +1,6 @@
+# 連結擷取/錄影引擎靜態庫；背景服務與視窗程式共用
+include(ffmpeg.pri)
+
+LIBS = -L$$OUT_PWD -lrecorderengine $$LIBS
+win32-msvc*: PRE_TARGETDEPS += $$OUT_PWD/recorderengine.lib
+else: PRE_TARGETDEPS += $$OUT_PWD/librecorderengine.a
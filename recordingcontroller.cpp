@@ -0,0 +1,169 @@
+#include "recordingcontroller.h"
+#include <QDebug>
+
+RecordingController::RecordingController(QObject *parent) : QObject(parent), m_startTimer(this) {
+    // 等第一個關鍵幀的上限，超過就先回報，錄影端仍保留等待
+    m_startTimer.setSingleShot(true);
+    m_startTimer.setInterval(10000);
+    connect(&m_startTimer, &QTimer::timeout, this, [this](){
+        checkStartCompleted(true);
+    });
+}
+
+void RecordingController::startAll(const QList<StreamIngest *> &ingests, const QStringList &directories,
+                                   const RecorderOptions &options) {
+    if (m_state != Idle) return;
+
+    ++m_generation;
+    m_sessions.clear();
+    m_state = Starting;
+
+    const int generation = m_generation;
+
+    for (StreamIngest *ingest : ingests) {
+        const int id = m_sessions.size();
+
+        Session session;
+        session.ingest = ingest;
+        session.url = ingest->url();
+        session.recorder = makeSink<StreamRecorder>(directories.value(id), QString::number(id), options);
+        session.recorder->setMetrics(ingest->metrics());
+        m_sessions.append(session);
+
+        // 一律排隊處理：addSink/removeSink 可能當場收尾並發出 signal
+        StreamRecorder *recorder = session.recorder.get();
+        const QString url = session.url;
+        connect(recorder, &StreamRecorder::profileSelected, this, [this, url](const QString &summary){
+            emit profileSelected(url, summary);
+        }, Qt::QueuedConnection);
+        connect(recorder, &StreamRecorder::transcodeLoad, this, [this, url](double percent){
+            emit transcodeLoad(url, percent);
+        }, Qt::QueuedConnection);
+        connect(recorder, &StreamRecorder::gapRecorded, this, [this, url](const QDateTime &start, const QDateTime &end){
+            emit recordingGap(url, start, end);
+        }, Qt::QueuedConnection);
+        connect(recorder, &StreamRecorder::started, this, [this, generation, id](const QString &filePath){
+            if (generation == m_generation) onRecorderStarted(id, filePath);
+        }, Qt::QueuedConnection);
+        connect(recorder, &StreamRecorder::segmentFinished, this, [this, generation, id](const RecordedSegment &segment){
+            if (generation == m_generation) onSegmentFinished(id, segment);
+        }, Qt::QueuedConnection);
+        connect(recorder, &StreamRecorder::finished, this, [this, generation, id](const QStringList &, qint64 bytes){
+            if (generation == m_generation) onRecorderClosed(id, bytes, QString());
+        }, Qt::QueuedConnection);
+        connect(recorder, &StreamRecorder::failed, this, [this, generation, id](const QString &error){
+            if (generation == m_generation) onRecorderClosed(id, 0, error);
+        }, Qt::QueuedConnection);
+    }
+
+    // 先全部建好再一起掛上，各路同時開始等關鍵幀
+    for (const Session &session : std::as_const(m_sessions))
+        session.ingest->addSink(session.recorder);
+
+    m_startTimer.start();
+    checkStartCompleted(false);
+}
+
+void RecordingController::stopAll() {
+    if (m_state != Starting && m_state != Recording) return;
+
+    m_startTimer.stop();
+    m_state = Stopping;
+    detachAll();
+    checkStopCompleted();
+}
+
+void RecordingController::detachAll() {
+    for (Session &session : m_sessions) {
+        // 擷取已結束的話，錄影端早已收尾，結果會由 signal 帶回
+        if (!session.closed && session.ingest)
+            session.ingest->removeSink(session.recorder);
+        session.recorder.reset();
+    }
+}
+
+void RecordingController::beginMotionEvent(const QString &url, qint64 timeMs) {
+    for (const Session &session : std::as_const(m_sessions))
+        if (session.url == url && session.recorder) session.recorder->beginMotionEvent(timeMs);
+}
+
+void RecordingController::endMotionEvent(const QString &url, qint64 timeMs, int peak) {
+    for (const Session &session : std::as_const(m_sessions))
+        if (session.url == url && session.recorder) session.recorder->endMotionEvent(timeMs, peak);
+}
+
+void RecordingController::onRecorderStarted(int id, const QString &filePath) {
+    Session &session = m_sessions[id];
+    session.started = true;
+    session.filePath = filePath;
+    emit recordingStarted(session.url, session.filePath);
+
+    if (m_state == Starting) checkStartCompleted(false);
+}
+
+void RecordingController::onSegmentFinished(int id, const RecordedSegment &segment) {
+    Session &session = m_sessions[id];
+    if (segment.bytes > 1024) session.files << segment.filePath; // 至少 1KB
+    emit segmentSaved(session.url, segment);
+}
+
+void RecordingController::onRecorderClosed(int id, qint64 bytes, const QString &error) {
+    Session &session = m_sessions[id];
+    session.closed = true;
+    session.bytes = bytes;
+    session.error = error;
+
+    if (error.isEmpty())
+        emit recordingFinished(session.url, bytes);
+    else
+        emit recordingFailed(session.url, error);
+
+    if (m_state == Starting) checkStartCompleted(false);
+    else if (m_state == Stopping) checkStopCompleted();
+}
+
+void RecordingController::checkStartCompleted(bool timedOut) {
+    if (m_state != Starting) return;
+
+    int startedCount = 0;
+    int failedCount = 0;
+    for (const Session &session : std::as_const(m_sessions)) {
+        if (session.started) ++startedCount;
+        else if (session.closed) ++failedCount;
+    }
+
+    int pending = m_sessions.size() - startedCount - failedCount;
+    if (pending > 0 && !timedOut) return;
+
+    m_startTimer.stop();
+    if (timedOut) {
+        for (const Session &session : std::as_const(m_sessions))
+            if (!session.started && !session.closed)
+                emit recordingFailed(session.url, "等待畫面逾時");
+    }
+
+    if (startedCount == 0) {
+        // 沒有任何一路成功，整輪作廢
+        detachAll();
+        ++m_generation;
+        m_sessions.clear();
+        m_state = Idle;
+        emit startCompleted(0, failedCount + pending);
+        return;
+    }
+
+    m_state = Recording;
+    emit startCompleted(startedCount, failedCount + pending);
+}
+
+void RecordingController::checkStopCompleted() {
+    QStringList savedFiles;
+    for (const Session &session : std::as_const(m_sessions)) {
+        if (!session.closed) return;
+        savedFiles << session.files;   // 中途出錯的話，已寫完的分段仍然保留
+    }
+
+    m_sessions.clear();
+    m_state = Idle;
+    emit stopCompleted(savedFiles);
+}
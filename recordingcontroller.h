@@ -0,0 +1,71 @@
+#ifndef RECORDINGCONTROLLER_H
+#define RECORDINGCONTROLLER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+#include <memory>
+
+#include "streamingest.h"
+#include "streamrecorder.h"
+
+// 全域錄影控制：所有攝影機同時啟動/停止，結果逐路以 signal 回報，不阻塞事件迴圈
+class RecordingController : public QObject {
+    Q_OBJECT
+public:
+    enum State { Idle, Starting, Recording, Stopping };
+
+    explicit RecordingController(QObject *parent = nullptr);
+
+    State state() const { return m_state; }
+    void setStartTimeout(int msecs) { m_startTimer.setInterval(msecs); }
+
+    // directories 與 ingests 一一對應：各攝影機寫到分配給它的儲存位置
+    void startAll(const QList<StreamIngest *> &ingests, const QStringList &directories,
+                  const RecorderOptions &options = RecorderOptions());
+    void stopAll();
+
+    // 把移動事件標到該攝影機正在錄的分段；沒在錄影時忽略
+    void beginMotionEvent(const QString &url, qint64 timeMs);
+    void endMotionEvent(const QString &url, qint64 timeMs, int peak);
+
+signals:
+    void recordingStarted(const QString &url, const QString &filePath);
+    void recordingFailed(const QString &url, const QString &error);
+    void profileSelected(const QString &url, const QString &summary);
+    void transcodeLoad(const QString &url, double percent);
+    void segmentSaved(const QString &url, const RecordedSegment &segment);
+    void recordingGap(const QString &url, const QDateTime &start, const QDateTime &end);
+    void recordingFinished(const QString &url, qint64 bytes);
+    // 每一路都已開始寫入、失敗或逾時後發出；startedCount 為 0 時已自動回到 Idle
+    void startCompleted(int startedCount, int failedCount);
+    void stopCompleted(const QStringList &savedFiles);
+
+private:
+    struct Session {
+        QPointer<StreamIngest> ingest;
+        QString url;
+        QString filePath;       // 第一個分段
+        QStringList files;      // 已寫完的分段
+        std::shared_ptr<StreamRecorder> recorder;
+        bool started = false;
+        bool closed = false;
+        QString error;
+        qint64 bytes = 0;
+    };
+
+    void onRecorderStarted(int id, const QString &filePath);
+    void onSegmentFinished(int id, const RecordedSegment &segment);
+    void onRecorderClosed(int id, qint64 bytes, const QString &error);
+    void checkStartCompleted(bool timedOut);
+    void checkStopCompleted();
+    void detachAll();
+
+    State m_state = Idle;
+    QVector<Session> m_sessions;
+    int m_generation = 0;   // 舊一輪錄影遲到的 signal 直接忽略
+    QTimer m_startTimer;    // 子物件，跟著控制器搬到錄影控制執行緒
+};
+
+#endif // RECORDINGCONTROLLER_H
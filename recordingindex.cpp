@@ -0,0 +1,298 @@
+#include "recordingindex.h"
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDir>
+#include <QThread>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+
+// 檔頭：magic + 版本；之後每筆紀錄為 型別 + 欄位，新增與刪除都只往後附加
+static const quint32 kIndexMagic = 0x52494458;   // "RIDX"
+// 版本 2 起每筆紀錄附帶移動事件；版本 1 的索引讀入後改寫成新版
+static const quint32 kIndexVersion = 2;
+static const char *kIndexFileName = "recordings.idx";
+
+enum RecordType : quint8 { AddRecord = 0, RemoveRecord = 1 };
+
+static void writeEntry(QDataStream &out, const RecordingEntry &entry) {
+    out << entry.fileName << entry.camera << entry.startMs << entry.durationMs << entry.bytes << entry.codec;
+    out << quint32(entry.motion.size());
+    for (const MotionEvent &event : entry.motion) out << event.startMs << event.endMs << qint32(event.peak);
+}
+
+static void readEntry(QDataStream &in, RecordingEntry &entry, quint32 version) {
+    in >> entry.fileName >> entry.camera >> entry.startMs >> entry.durationMs >> entry.bytes >> entry.codec;
+    if (version < 2) return;
+
+    quint32 count = 0;
+    in >> count;
+    // 數量明顯不合理時當作損壞的尾巴
+    if (count > 100000) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return;
+    }
+    entry.motion.resize(count);
+    for (MotionEvent &event : entry.motion) {
+        qint32 peak = 0;
+        in >> event.startMs >> event.endMs >> peak;
+        event.peak = peak;
+    }
+}
+
+// 沒有索引時的一次性重建：只看檔名與大小，時長與編碼留白
+// 主要資料夾的檔案記檔名，其他儲存位置的記完整路徑，與錄影時寫進索引的一樣
+static QVector<RecordingEntry> scanDirectories(const QString &directory, const QStringList &volumes) {
+    QVector<RecordingEntry> entries;
+    QStringList folders = QStringList() << directory;
+    for (const QString &volume : volumes)
+        if (QFileInfo(volume) != QFileInfo(directory)) folders << volume;
+
+    for (const QString &folder : std::as_const(folders)) {
+        const QFileInfoList files = QDir(folder).entryInfoList(QStringList() << "*.mp4" << "*.ts", QDir::Files);
+        for (const QFileInfo &info : files) {
+            RecordingEntry entry;
+            entry.fileName = recordingFileName(directory, info.absoluteFilePath());
+            entry.bytes = info.size();
+
+            // REC_yyyyMMdd_HHmmss_<tag>.<ext>
+            QDateTime start = QDateTime::fromString(info.fileName().mid(4, 15), "yyyyMMdd_HHmmss");
+            if (!start.isValid()) start = info.lastModified();
+            entry.startMs = start.toMSecsSinceEpoch();
+            entries.append(entry);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const RecordingEntry &a, const RecordingEntry &b) {
+        return a.startMs < b.startMs;
+    });
+    return entries;
+}
+
+QString recordingFilePath(const QString &directory, const QString &fileName) {
+    return QDir(directory).filePath(fileName);
+}
+
+QString recordingFileName(const QString &directory, const QString &filePath) {
+    const QFileInfo info(filePath);
+    if (QFileInfo(info.absolutePath()) == QFileInfo(directory)) return info.fileName();
+    return info.absoluteFilePath();
+}
+
+qint64 segmentEndMs(const QVector<RecordingEntry> &segments, int segment) {
+    const RecordingEntry &entry = segments[segment];
+    if (entry.durationMs > 0) return entry.startMs + entry.durationMs;
+    return segment + 1 < segments.size() ? segments[segment + 1].startMs : entry.startMs;
+}
+
+int locateSegment(const QVector<RecordingEntry> &segments, qint64 timeMs, qint64 *offsetMs) {
+    if (segments.isEmpty() || timeMs > segmentEndMs(segments, segments.size() - 1)) return -1;
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), timeMs,
+                               [](qint64 time, const RecordingEntry &entry) { return time < entry.startMs; });
+    int segment = int(it - segments.begin()) - 1;
+    if (segment < 0) {
+        *offsetMs = 0;
+        return 0;
+    }
+    if (timeMs < segmentEndMs(segments, segment) || segment + 1 == segments.size()) {
+        *offsetMs = qMax<qint64>(0, timeMs - segments[segment].startMs);
+        return segment;
+    }
+    // 落在兩段之間沒錄到的空檔
+    *offsetMs = 0;
+    return segment + 1;
+}
+
+RecordingIndex::RecordingIndex(const QString &directory, QObject *parent)
+    : QObject(parent), m_directory(directory) {
+}
+
+QString RecordingIndex::indexPath() const {
+    return m_directory + "/" + kIndexFileName;
+}
+
+void RecordingIndex::load(const QStringList &volumes) {
+    m_entries.clear();
+    m_positions.clear();
+
+    QFile file(indexPath());
+    bool valid = file.open(QIODevice::ReadOnly);
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    if (valid) {
+        in >> magic >> version;
+        valid = magic == kIndexMagic && version >= 1 && version <= kIndexVersion;
+    }
+
+    if (!valid) {
+        if (file.exists()) qDebug() << "錄影索引格式不符，重新建立:" << indexPath();
+        file.close();
+
+        // 掃描放到背景，檔案多時不卡住畫面
+        auto result = std::make_shared<QVector<RecordingEntry>>();
+        QThread *thread = QThread::create([result, directory = m_directory, volumes]() {
+            *result = scanDirectories(directory, volumes);
+        });
+        connect(thread, &QThread::finished, this, [this, result]() {
+            importEntries(*result);
+        });
+        connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        thread->start(QThread::LowPriority);
+        emit reset();
+        return;
+    }
+
+    // 刪除紀錄先標記，讀完再一次清掉，避免每筆都搬移整個陣列
+    QVector<bool> removedFlags;
+    int removed = 0;
+    qint64 goodEnd = file.pos();
+    while (!in.atEnd()) {
+        quint8 type = 0;
+        RecordingEntry entry;
+        in >> type;
+        readEntry(in, entry, version);
+        // 最後一筆可能在當機時只寫了一半，丟掉
+        if (in.status() != QDataStream::Ok) break;
+        goodEnd = file.pos();
+
+        auto it = m_positions.constFind(entry.fileName);
+        if (type == AddRecord) {
+            if (it != m_positions.constEnd()) {
+                m_entries[it.value()] = entry;
+            } else {
+                m_positions.insert(entry.fileName, m_entries.size());
+                m_entries.append(entry);
+                removedFlags.append(false);
+            }
+        } else if (it != m_positions.constEnd()) {
+            removedFlags[it.value()] = true;
+            m_positions.erase(it);
+            ++removed;
+        }
+    }
+    const bool truncated = goodEnd < file.size();
+    file.close();
+
+    if (removed > 0) {
+        QVector<RecordingEntry> alive;
+        alive.reserve(m_entries.size() - removed);
+        for (int i = 0; i < m_entries.size(); ++i)
+            if (!removedFlags[i]) alive.append(m_entries[i]);
+        m_entries = alive;
+        rebuildPositions();
+    }
+
+    // 整理掉刪除紀錄與不完整的尾巴
+    if (truncated || removed > 0 || version != kIndexVersion) rewrite();
+    qDebug() << "錄影索引:" << m_entries.size() << "個分段";
+    emit reset();
+}
+
+const RecordingEntry *RecordingIndex::find(const QString &fileName) const {
+    auto it = m_positions.constFind(fileName);
+    return it != m_positions.constEnd() ? &m_entries[it.value()] : nullptr;
+}
+
+QStringList RecordingIndex::cameras() const {
+    QStringList cameras;
+    for (const RecordingEntry &entry : m_entries)
+        if (!entry.camera.isEmpty() && !cameras.contains(entry.camera)) cameras << entry.camera;
+    cameras.sort();
+    return cameras;
+}
+
+void RecordingIndex::append(const RecordingEntry &entry) {
+    writeRecord(AddRecord, entry);
+
+    auto it = m_positions.constFind(entry.fileName);
+    if (it != m_positions.constEnd()) {
+        m_entries[it.value()] = entry;
+        emit reset();
+        return;
+    }
+    m_positions.insert(entry.fileName, m_entries.size());
+    m_entries.append(entry);
+    emit entryAdded(m_entries.size() - 1);
+}
+
+void RecordingIndex::remove(const QString &fileName) {
+    auto it = m_positions.constFind(fileName);
+    if (it == m_positions.constEnd()) return;
+
+    writeRecord(RemoveRecord, m_entries[it.value()]);
+    m_entries.removeAt(it.value());
+    rebuildPositions();
+    emit reset();
+}
+
+void RecordingIndex::remove(const QStringList &fileNames) {
+    QSet<QString> removed;
+    for (const QString &fileName : fileNames) {
+        auto it = m_positions.constFind(fileName);
+        if (it == m_positions.constEnd()) continue;
+        writeRecord(RemoveRecord, m_entries[it.value()]);
+        removed.insert(fileName);
+    }
+    if (removed.isEmpty()) return;
+
+    m_entries.removeIf([&removed](const RecordingEntry &entry) { return removed.contains(entry.fileName); });
+    rebuildPositions();
+    emit reset();
+}
+
+bool RecordingIndex::writeRecord(quint8 type, const RecordingEntry &entry) {
+    QFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qDebug() << "無法寫入錄影索引:" << indexPath() << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    if (file.size() == 0) out << kIndexMagic << kIndexVersion;
+    out << type;
+    writeEntry(out, entry);
+    return out.status() == QDataStream::Ok;
+}
+
+void RecordingIndex::rewrite() {
+    QSaveFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "無法重寫錄影索引:" << indexPath() << file.errorString();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kIndexMagic << kIndexVersion;
+    for (const RecordingEntry &entry : std::as_const(m_entries)) {
+        out << quint8(AddRecord);
+        writeEntry(out, entry);
+    }
+    if (!file.commit()) qDebug() << "錄影索引寫入失敗:" << file.errorString();
+}
+
+void RecordingIndex::importEntries(const QVector<RecordingEntry> &entries) {
+    // 重建期間可能已經有新分段寫進來，以索引裡的為準
+    QVector<RecordingEntry> merged = entries;
+    merged.erase(std::remove_if(merged.begin(), merged.end(), [this](const RecordingEntry &entry) {
+        return m_positions.contains(entry.fileName);
+    }), merged.end());
+    merged += m_entries;
+    m_entries = merged;
+    rebuildPositions();
+    rewrite();
+    qDebug() << "錄影索引已重建:" << m_entries.size() << "個分段";
+    emit reset();
+}
+
+void RecordingIndex::rebuildPositions() {
+    m_positions.clear();
+    for (int i = 0; i < m_entries.size(); ++i) m_positions.insert(m_entries[i].fileName, i);
+}
@@ -0,0 +1,77 @@
+#ifndef RECORDINGINDEX_H
+#define RECORDINGINDEX_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QVector>
+#include <QHash>
+
+// 分段內偵測到的一段移動（epoch 毫秒）
+struct MotionEvent {
+    qint64 startMs = 0;
+    qint64 endMs = 0;
+    int peak = 0;           // 最大變動比例（%）
+};
+
+// 索引裡的一個錄影分段
+struct RecordingEntry {
+    QString fileName;       // 相對於錄影資料夾
+    QString camera;         // 攝影機網址
+    qint64 startMs = 0;     // 分段開始的實際時間（epoch 毫秒）
+    qint64 durationMs = 0;
+    qint64 bytes = 0;
+    QString codec;          // 例如 "h264 / aac"
+    QVector<MotionEvent> motion;
+
+    QDateTime start() const { return QDateTime::fromMSecsSinceEpoch(startMs); }
+    QDateTime end() const { return QDateTime::fromMSecsSinceEpoch(startMs + durationMs); }
+};
+
+// 分段檔的完整路徑：fileName 是錄影資料夾裡的檔名，或其他儲存位置上的絕對路徑
+QString recordingFilePath(const QString &directory, const QString &fileName);
+// 反過來：在錄影資料夾裡的只記檔名，其他儲存位置記絕對路徑
+QString recordingFileName(const QString &directory, const QString &filePath);
+
+// 依開始時間排序的分段：時間點所在的分段與分段內偏移；落在空檔時取下一段開頭，超出範圍回傳 -1
+int locateSegment(const QVector<RecordingEntry> &segments, qint64 timeMs, qint64 *offsetMs);
+// 分段結束時間；沒有長度的分段（重建索引得到的）以下一段的開頭估計
+qint64 segmentEndMs(const QVector<RecordingEntry> &segments, int segment);
+
+// 錄影檔索引：錄影資料夾裡的 recordings.idx，只往後附加紀錄
+// 分段寫完就加一筆，檔案管理頁直接讀記憶體裡的索引，不再掃描資料夾
+class RecordingIndex : public QObject {
+    Q_OBJECT
+public:
+    explicit RecordingIndex(const QString &directory, QObject *parent = nullptr);
+
+    // 讀入索引；索引檔不存在時在背景掃描資料夾重建一次，完成後發出 reset
+    // volumes 是其他儲存位置（StorageManager::volumes()），重建時一起掃描
+    void load(const QStringList &volumes = QStringList());
+
+    const QVector<RecordingEntry> &entries() const { return m_entries; }
+    const RecordingEntry *find(const QString &fileName) const;
+    QStringList cameras() const;
+    QString directory() const { return m_directory; }
+
+    void append(const RecordingEntry &entry);
+    void remove(const QString &fileName);
+    // 一次移除多筆，只重排一次、只通知一次
+    void remove(const QStringList &fileNames);
+
+signals:
+    void entryAdded(int index);
+    void reset();
+
+private:
+    QString indexPath() const;
+    bool writeRecord(quint8 type, const RecordingEntry &entry);
+    void rewrite();
+    void importEntries(const QVector<RecordingEntry> &entries);
+    void rebuildPositions();
+
+    QString m_directory;
+    QVector<RecordingEntry> m_entries;      // 依加入順序，新的在後面
+    QHash<QString, int> m_positions;        // 檔名 -> m_entries 索引
+};
+
+#endif // RECORDINGINDEX_H
@@ -0,0 +1,121 @@
+#include "recordinglistmodel.h"
+#include <QFileInfo>
+#include <algorithm>
+
+static QString formatDuration(qint64 ms) {
+    if (ms <= 0) return "--:--";
+    qint64 seconds = ms / 1000;
+    QString text = QString("%1:%2").arg(seconds / 60 % 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+    return seconds >= 3600 ? QString::number(seconds / 3600) + ":" + text : text;
+}
+
+RecordingListModel::RecordingListModel(RecordingIndex *index, QObject *parent)
+    : QAbstractListModel(parent), m_index(index) {
+    connect(m_index, &RecordingIndex::reset, this, &RecordingListModel::rebuild);
+    connect(m_index, &RecordingIndex::entryAdded, this, &RecordingListModel::onEntryAdded);
+    rebuild();
+}
+
+void RecordingListModel::setCameraFilter(const QString &camera) {
+    if (camera == m_camera) return;
+    m_camera = camera;
+    rebuild();
+}
+
+void RecordingListModel::setTimeRange(const QDateTime &from, const QDateTime &to) {
+    if (from == m_from && to == m_to) return;
+    m_from = from;
+    m_to = to;
+    rebuild();
+}
+
+QString RecordingListModel::fileNameAt(int row) const {
+    if (row < 0 || row >= m_rows.size()) return QString();
+    return m_index->entries()[m_rows[row]].fileName;
+}
+
+void RecordingListModel::setThumbnailStore(ThumbnailStore *store) {
+    m_thumbnails = store;
+    connect(m_thumbnails, &ThumbnailStore::thumbnailsReady, this, &RecordingListModel::onThumbnailsReady);
+}
+
+void RecordingListModel::onThumbnailsReady(const QString &fileName) {
+    const QVector<RecordingEntry> &entries = m_index->entries();
+    for (int row = 0; row < m_rows.size(); ++row) {
+        if (entries[m_rows[row]].fileName == fileName) {
+            QModelIndex changed = index(row);
+            emit dataChanged(changed, changed, {Qt::DecorationRole});
+            return;
+        }
+    }
+}
+
+bool RecordingListModel::matches(const RecordingEntry &entry) const {
+    if (!m_camera.isEmpty() && entry.camera != m_camera) return false;
+    if (m_from.isValid() && entry.startMs + entry.durationMs < m_from.toMSecsSinceEpoch()) return false;
+    if (m_to.isValid() && entry.startMs > m_to.toMSecsSinceEpoch()) return false;
+    return true;
+}
+
+bool RecordingListModel::isNewer(int a, int b) const {
+    const QVector<RecordingEntry> &entries = m_index->entries();
+    if (entries[a].startMs != entries[b].startMs) return entries[a].startMs > entries[b].startMs;
+    return a > b;
+}
+
+void RecordingListModel::rebuild() {
+    beginResetModel();
+    m_rows.clear();
+    const QVector<RecordingEntry> &entries = m_index->entries();
+    for (int i = 0; i < entries.size(); ++i)
+        if (matches(entries[i])) m_rows.append(i);
+    std::sort(m_rows.begin(), m_rows.end(), [this](int a, int b) { return isNewer(a, b); });
+    endResetModel();
+}
+
+void RecordingListModel::onEntryAdded(int position) {
+    if (!matches(m_index->entries()[position])) return;
+
+    // 新分段通常最新，插在最上面；保險起見仍依時間找位置
+    auto it = std::lower_bound(m_rows.begin(), m_rows.end(), position,
+                               [this](int row, int value) { return isNewer(row, value); });
+    const int row = int(it - m_rows.begin());
+    beginInsertRows(QModelIndex(), row, row);
+    m_rows.insert(row, position);
+    endInsertRows();
+}
+
+int RecordingListModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+QVariant RecordingListModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_rows.size()) return QVariant();
+    const RecordingEntry &entry = m_index->entries()[m_rows[index.row()]];
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString("%1  %2  %3 (%4 MB)")
+            .arg(entry.start().toString("yyyy-MM-dd HH:mm:ss"), formatDuration(entry.durationMs), QFileInfo(entry.fileName).fileName())
+            .arg(entry.bytes / 1024.0 / 1024.0, 0, 'f', 2);
+    case Qt::ToolTipRole: {
+        QString tip = entry.fileName;
+        if (!entry.camera.isEmpty()) tip += "\n攝影機: " + entry.camera;
+        if (!entry.codec.isEmpty()) tip += "\n編碼: " + entry.codec;
+        if (entry.durationMs > 0)
+            tip += "\n" + entry.start().toString("yyyy-MM-dd HH:mm:ss") + " ~ " + entry.end().toString("HH:mm:ss");
+        return tip;
+    }
+    case Qt::DecorationRole:
+        // 只有捲到畫面上的列會來要縮圖，沒產生過的這時才排進背景
+        return m_thumbnails ? QVariant(m_thumbnails->thumbnail(entry.fileName)) : QVariant();
+    case FileNameRole:
+        return entry.fileName;
+    case CameraRole:
+        return entry.camera;
+    case StartRole:
+        return entry.start();
+    default:
+        return QVariant();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef RECORDINGLISTMODEL_H
+#define RECORDINGLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QVector>
+
+#include "recordingindex.h"
+#include "thumbnailstore.h"
+
+// 檔案管理頁的錄影清單：直接讀索引，依攝影機與時間篩選，新的排在最上面
+// 搭配 QListView::setUniformItemSizes，只有看得到的列會被讀取
+class RecordingListModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    enum Roles {
+        FileNameRole = Qt::UserRole,
+        CameraRole,
+        StartRole,
+    };
+
+    explicit RecordingListModel(RecordingIndex *index, QObject *parent = nullptr);
+
+    // 空字串表示全部攝影機
+    void setCameraFilter(const QString &camera);
+    // 與區間有重疊的分段都列出；無效的 QDateTime 表示不限
+    void setTimeRange(const QDateTime &from, const QDateTime &to);
+
+    QString fileNameAt(int row) const;
+
+    // 設定後清單會顯示縮圖；縮圖產生完成時更新該列
+    void setThumbnailStore(ThumbnailStore *store);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    bool matches(const RecordingEntry &entry) const;
+    bool isNewer(int a, int b) const;
+    void rebuild();
+    void onEntryAdded(int position);
+    void onThumbnailsReady(const QString &fileName);
+
+    RecordingIndex *m_index;
+    ThumbnailStore *m_thumbnails = nullptr;
+    QVector<int> m_rows;        // 索引中的位置，依開始時間新到舊
+    QString m_camera;
+    QDateTime m_from;
+    QDateTime m_to;
+};
+
+#endif // RECORDINGLISTMODEL_H
@@ -0,0 +1,90 @@
+#include "relaychannel.h"
+#include <QMutexLocker>
+
+// 每個用戶端最多排這麼多資料塊與位元組；約相當於幾秒的畫面，超過就是跟不上
+static const size_t kSubscriberCapacity = 512;
+static const qint64 kSubscriberBytes = 8LL * 1024 * 1024;
+
+RelaySubscriber::RelaySubscriber(std::function<void()> wake)
+    : m_wake(std::move(wake)), m_queue(kSubscriberCapacity) {
+}
+
+bool RelaySubscriber::pop(QByteArray &chunk) {
+    if (!m_queue.tryPop(chunk)) return false;
+    m_bytes -= chunk.size();
+    return true;
+}
+
+bool RelaySubscriber::push(const QByteArray &chunk) {
+    if (m_overflowed || m_finished) return false;
+    if (m_bytes + chunk.size() > kSubscriberBytes || !m_queue.tryPush(QByteArray(chunk))) {
+        overflow();
+        return false;
+    }
+    m_bytes += chunk.size();
+    m_wake();
+    return true;
+}
+
+void RelaySubscriber::overflow() {
+    m_overflowed = true;
+    m_wake();
+}
+
+void RelaySubscriber::finish() {
+    m_finished = true;
+    m_wake();
+}
+
+void RelayChannel::setHeader(const QByteArray &header) {
+    QMutexLocker locker(&m_mutex);
+    finishAll();
+    m_header = header;
+}
+
+void RelayChannel::publish(const QByteArray &chunk, bool syncPoint) {
+    QMutexLocker locker(&m_mutex);
+    for (int i = m_subscribers.size() - 1; i >= 0; --i) {
+        RelaySubscriber *subscriber = m_subscribers[i].get();
+        if (!subscriber->m_started) {
+            // 片段中途接上解不出來，等下一個以關鍵幀開頭的片段
+            if (!syncPoint || m_header.isEmpty()) continue;
+            subscriber->m_started = true;
+            if (!subscriber->push(m_header)) {
+                m_subscribers.removeAt(i);
+                continue;
+            }
+        }
+        // 跟不上的用戶端直接放掉，不拖住來源與其他用戶端
+        if (!subscriber->push(chunk)) m_subscribers.removeAt(i);
+    }
+}
+
+void RelayChannel::close() {
+    QMutexLocker locker(&m_mutex);
+    finishAll();
+    m_header.clear();
+    m_closed = true;
+}
+
+void RelayChannel::finishAll() {
+    for (const std::shared_ptr<RelaySubscriber> &subscriber : std::as_const(m_subscribers)) subscriber->finish();
+    m_subscribers.clear();
+}
+
+bool RelayChannel::subscribe(const std::shared_ptr<RelaySubscriber> &subscriber) {
+    QMutexLocker locker(&m_mutex);
+    if (m_closed) return false;
+    m_subscribers.append(subscriber);
+    return true;
+}
+
+void RelayChannel::unsubscribe(const std::shared_ptr<RelaySubscriber> &subscriber) {
+    QMutexLocker locker(&m_mutex);
+    m_subscribers.removeOne(subscriber);
+}
+
+int RelayChannel::subscriberCount() const {
+    QMutexLocker locker(&m_mutex);
+    return m_subscribers.size();
+}
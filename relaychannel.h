@@ -0,0 +1,73 @@
+#ifndef RELAYCHANNEL_H
+#define RELAYCHANNEL_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "spscqueue.h"
+
+// 一個轉播用戶端的固定容量佇列：頻道放資料塊、伺服器執行緒取出寫到 socket
+// 資料塊是共用的 QByteArray，放進多個佇列只增加參考計數；塞滿就標記溢位，由伺服器斷開這個用戶端
+class RelaySubscriber {
+public:
+    // wake 在生產端呼叫，通知伺服器執行緒有資料或狀態改變
+    explicit RelaySubscriber(std::function<void()> wake);
+
+    // 以下只在伺服器執行緒呼叫
+    bool pop(QByteArray &chunk);
+    bool overflowed() const { return m_overflowed; }
+    bool finished() const { return m_finished; }   // 頻道已結束或換了檔頭，送完就關
+    qint64 queuedBytes() const { return m_bytes; }
+
+private:
+    friend class RelayChannel;
+    // 以下只在頻道鎖內呼叫
+    bool push(const QByteArray &chunk);
+    void overflow();
+    void finish();
+
+    std::function<void()> m_wake;
+    SpscQueue<QByteArray> m_queue;
+    std::atomic<qint64> m_bytes{0};
+    std::atomic_bool m_overflowed{false};
+    std::atomic_bool m_finished{false};
+    bool m_started = false;     // 已從關鍵幀開始的片段接上
+};
+
+// 一台攝影機的轉播頻道：RelaySink 把 fMP4 切成資料塊發佈進來，分送給所有用戶端
+// 新用戶端先收到檔頭（ftyp+moov），再從下一個以關鍵幀開頭的片段接上
+class RelayChannel {
+public:
+    explicit RelayChannel(const QString &name) : m_name(name) {}
+
+    QString name() const { return m_name; }
+
+    // 以下由 RelaySink 呼叫
+    // 換了新的檔頭（例如重連後軌道不同），現有用戶端送完已排的資料後斷開
+    void setHeader(const QByteArray &header);
+    // syncPoint 表示這塊是以關鍵幀開頭的片段的開頭
+    void publish(const QByteArray &chunk, bool syncPoint);
+    // 來源結束，所有用戶端送完後斷開，之後不再接受新用戶端
+    void close();
+
+    // 以下由伺服器執行緒呼叫
+    bool subscribe(const std::shared_ptr<RelaySubscriber> &subscriber);
+    void unsubscribe(const std::shared_ptr<RelaySubscriber> &subscriber);
+    int subscriberCount() const;
+
+private:
+    void finishAll();
+
+    const QString m_name;
+    mutable QMutex m_mutex;
+    QByteArray m_header;
+    QList<std::shared_ptr<RelaySubscriber>> m_subscribers;
+    bool m_closed = false;
+};
+
+#endif // RELAYCHANNEL_H
@@ -0,0 +1,208 @@
+#include "relayserver.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QMutexLocker>
+#include <QDebug>
+
+// 請求標頭的長度上限，超過當作不是正常的播放器
+static const int kMaxRequestBytes = 8 * 1024;
+// socket 自己的寫入緩衝超過這麼多就先不從佇列取，讓佇列去判斷是否跟不上
+static const qint64 kSocketBufferBytes = 512 * 1024;
+
+// 一個 HTTP 用戶端，活在伺服器執行緒
+class RelayConnection : public QObject {
+public:
+    RelayConnection(RelayServer *server, QTcpSocket *socket)
+        : m_server(server), m_socket(socket) {
+        m_socket->setParent(this);
+        ++m_server->m_clientCount;
+        connect(m_socket, &QTcpSocket::readyRead, this, [this]() { readRequest(); });
+        connect(m_socket, &QTcpSocket::bytesWritten, this, [this]() { drain(); });
+        connect(m_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+    }
+
+    ~RelayConnection() override {
+        if (m_channel) m_channel->unsubscribe(m_subscriber);
+        --m_server->m_clientCount;
+    }
+
+private:
+    void readRequest() {
+        if (m_subscriber) {
+            m_socket->readAll();   // 直播開始後不再理會用戶端送來的資料
+            return;
+        }
+        m_request += m_socket->readAll();
+        if (!m_request.contains("\r\n\r\n")) {
+            if (m_request.size() > kMaxRequestBytes) m_socket->abort();
+            return;
+        }
+
+        // 只看請求列：GET <路徑> HTTP/1.x
+        const QList<QByteArray> parts = m_request.left(m_request.indexOf("\r\n")).split(' ');
+        if (parts.size() < 2 || parts[0] != "GET") {
+            reply("405 Method Not Allowed", "只支援 GET\n");
+            return;
+        }
+        const QString path = QString::fromUtf8(parts[1]);
+        if (path == "/") {
+            QString list;
+            for (const QString &name : m_server->channelNames()) list += m_server->urlFor(name) + "\n";
+            reply("200 OK", list.toUtf8());
+            return;
+        }
+        if (path == "/metrics") {
+            const QByteArray metrics = m_server->metrics();
+            if (metrics.isEmpty()) reply("404 Not Found", "沒有效能統計\n");
+            else reply("200 OK", metrics);
+            return;
+        }
+        if (!path.startsWith("/live/") || !path.endsWith(".mp4")) {
+            reply("404 Not Found", "找不到頻道\n");
+            return;
+        }
+        startStream(path.mid(6, path.size() - 10));
+    }
+
+    void startStream(const QString &name) {
+        m_channel = m_server->channel(name);
+        if (!m_channel) {
+            reply("404 Not Found", "找不到頻道\n");
+            return;
+        }
+
+        // 生產端在頻道鎖內呼叫 wake，這裡只排一次喚醒，取完才允許下一次
+        m_subscriber = std::make_shared<RelaySubscriber>([this]() {
+            if (!m_wakePending.exchange(true)) QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::QueuedConnection);
+        });
+        if (!m_channel->subscribe(m_subscriber)) {
+            m_channel.reset();
+            reply("503 Service Unavailable", "頻道已結束\n");
+            return;
+        }
+
+        m_socket->write("HTTP/1.1 200 OK\r\n"
+                        "Content-Type: video/mp4\r\n"
+                        "Cache-Control: no-cache\r\n"
+                        "Connection: close\r\n\r\n");
+        m_peer = m_socket->peerAddress().toString();
+        qDebug() << "轉播用戶端加入:" << name << m_peer;
+    }
+
+    void reply(const QByteArray &status, const QByteArray &body) {
+        m_socket->write("HTTP/1.1 " + status + "\r\n"
+                        "Content-Type: text/plain; charset=utf-8\r\n"
+                        "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n" + body);
+        m_socket->disconnectFromHost();
+    }
+
+    void drain() {
+        m_wakePending = false;
+        if (!m_subscriber) return;
+        if (m_subscriber->overflowed()) {
+            qDebug() << "轉播用戶端跟不上，已斷開:" << m_channel->name() << m_peer;
+            m_subscriber.reset();
+            m_socket->abort();
+            return;
+        }
+
+        QByteArray chunk;
+        while (m_socket->bytesToWrite() < kSocketBufferBytes && m_subscriber->pop(chunk))
+            m_socket->write(chunk);
+        if (m_subscriber->finished() && m_subscriber->queuedBytes() == 0) {
+            m_subscriber.reset();
+            m_socket->disconnectFromHost();
+        }
+    }
+
+    RelayServer *m_server;
+    QTcpSocket *m_socket;
+    QByteArray m_request;
+    QString m_peer;
+    std::shared_ptr<RelayChannel> m_channel;
+    std::shared_ptr<RelaySubscriber> m_subscriber;
+    std::atomic_bool m_wakePending{false};
+};
+
+RelayServer::RelayServer(quint16 port, const QHostAddress &address, QObject *parent)
+    : QThread(parent), m_port(port), m_address(address) {
+}
+
+RelayServer::~RelayServer() {
+    stop();
+    wait();
+}
+
+std::shared_ptr<RelayChannel> RelayServer::addChannel(const QString &name) {
+    QMutexLocker locker(&m_mutex);
+    auto channel = std::make_shared<RelayChannel>(name);
+    m_channels.insert(name, channel);
+    return channel;
+}
+
+void RelayServer::removeChannel(const QString &name) {
+    QMutexLocker locker(&m_mutex);
+    m_channels.remove(name);
+}
+
+std::shared_ptr<RelayChannel> RelayServer::channel(const QString &name) const {
+    QMutexLocker locker(&m_mutex);
+    return m_channels.value(name);
+}
+
+QStringList RelayServer::channelNames() const {
+    QMutexLocker locker(&m_mutex);
+    QStringList names = m_channels.keys();
+    names.sort();
+    return names;
+}
+
+void RelayServer::setMetricsProvider(const std::function<QByteArray()> &provider) {
+    QMutexLocker locker(&m_mutex);
+    m_metricsProvider = provider;
+}
+
+QByteArray RelayServer::metrics() const {
+    std::function<QByteArray()> provider;
+    {
+        QMutexLocker locker(&m_mutex);
+        provider = m_metricsProvider;
+    }
+    return provider ? provider() : QByteArray();
+}
+
+QString RelayServer::urlFor(const QString &name) const {
+    // 聽所有介面時本機仍用 127.0.0.1；只聽某個位址時就用那個位址
+    QString host = "127.0.0.1";
+    if (m_address != QHostAddress::Any && m_address != QHostAddress::AnyIPv4 && !m_address.isLoopback()) {
+        host = m_address.toString();
+        if (m_address.protocol() == QAbstractSocket::IPv6Protocol) host = "[" + host + "]";
+    }
+    return QString("http://%1:%2/live/%3.mp4").arg(host).arg(m_port).arg(name);
+}
+
+void RelayServer::stop() {
+    quit();
+}
+
+void RelayServer::run() {
+    QTcpServer server;
+    if (!server.listen(m_address, m_port)) {
+        qDebug() << "轉播伺服器無法啟動:" << m_address.toString() << m_port << server.errorString();
+        emit listenFailed(server.errorString());
+        return;
+    }
+    qDebug() << "轉播伺服器已啟動:" << m_address.toString() << m_port;
+
+    // 用戶端都掛在 clients 底下，事件迴圈結束時一起刪除並退訂
+    QObject clients;
+    connect(&server, &QTcpServer::newConnection, &clients, [this, &server, &clients]() {
+        while (QTcpSocket *socket = server.nextPendingConnection()) {
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            RelayConnection *connection = new RelayConnection(this, socket);
+            connection->setParent(&clients);
+        }
+    });
+    exec();
+}
@@ -0,0 +1,59 @@
+#ifndef RELAYSERVER_H
+#define RELAYSERVER_H
+
+#include <QThread>
+#include <QHostAddress>
+#include <QMutex>
+#include <QHash>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "relaychannel.h"
+
+// 本機轉播伺服器：每台攝影機一個頻道，以 HTTP 送出 fMP4 直播
+//   GET /live/<頻道>.mp4   直播（Connection: close，不帶長度）
+//   GET /                  頻道列表
+//   GET /metrics           效能統計（Prometheus 文字格式），有設定 setMetricsProvider 時才有
+// 所有用戶端在同一條執行緒的事件迴圈處理；每個用戶端各有固定容量的佇列，跟不上的直接斷開
+// 沒有驗證，預設只聽本機；要給其他主機拉流得明確指定位址（攝影機畫面與 /metrics 都會對外）
+class RelayServer : public QThread {
+    Q_OBJECT
+public:
+    explicit RelayServer(quint16 port, const QHostAddress &address = QHostAddress::LocalHost,
+                         QObject *parent = nullptr);
+    ~RelayServer() override;
+
+    quint16 port() const { return m_port; }
+    QHostAddress address() const { return m_address; }
+    // 以下任何執行緒皆可
+    std::shared_ptr<RelayChannel> addChannel(const QString &name);
+    void removeChannel(const QString &name);
+    std::shared_ptr<RelayChannel> channel(const QString &name) const;
+    QStringList channelNames() const;
+    QString urlFor(const QString &name) const;
+    int clientCount() const { return m_clientCount; }
+    // /metrics 的內容；在伺服器執行緒呼叫，必須是執行緒安全的
+    void setMetricsProvider(const std::function<QByteArray()> &provider);
+    void stop();
+
+signals:
+    void listenFailed(const QString &error);
+
+protected:
+    void run() override;
+
+private:
+    friend class RelayConnection;
+    QByteArray metrics() const;
+
+    const quint16 m_port;
+    const QHostAddress m_address;
+    mutable QMutex m_mutex;
+    QHash<QString, std::shared_ptr<RelayChannel>> m_channels;
+    std::function<QByteArray()> m_metricsProvider;
+    std::atomic_int m_clientCount{0};
+};
+
+#endif // RELAYSERVER_H
@@ -0,0 +1,153 @@
+#include "relaysink.h"
+#include <QDebug>
+
+static const int kIoBufferSize = 64 * 1024;
+
+RelaySink::RelaySink(const std::shared_ptr<RelayChannel> &channel)
+    : m_channel(channel), m_packet(av_packet_alloc()) {
+}
+
+RelaySink::~RelaySink() {
+    closeMuxer();
+    av_packet_free(&m_packet);
+}
+
+void RelaySink::openSink(const IngestLayout &layout) {
+    closeMuxer();
+    m_layout = layout;
+    if (!openMuxer()) closeMuxer();
+}
+
+void RelaySink::sinkInterrupted() {
+    // 重連後時間戳不連續、軌道也可能不同：現有用戶端斷開，重連後以新的檔頭重新開始
+    closeMuxer();
+    m_channel->setHeader(QByteArray());
+}
+
+void RelaySink::closeSink() {
+    closeMuxer();
+    m_channel->close();
+}
+
+bool RelaySink::openMuxer() {
+    int ret = avformat_alloc_output_context2(&m_output, nullptr, "mp4", nullptr);
+    if (ret < 0) {
+        qDebug() << "轉播無法建立輸出:" << m_channel->name() << avErrorString(ret);
+        return false;
+    }
+
+    m_outputIndex = QVector<int>(m_layout.size(), -1);
+    m_videoIndex = -1;
+    for (const IngestTrack &track : std::as_const(m_layout)) {
+        if (track.type != AVMEDIA_TYPE_VIDEO && track.type != AVMEDIA_TYPE_AUDIO) continue;
+        // 攝影機常見的 G.711 等音訊 mp4 放不下；轉播不轉碼，直接略過
+        if (avformat_query_codec(m_output->oformat, track.codecpar->codec_id, FF_COMPLIANCE_NORMAL) != 1) continue;
+        if (track.type == AVMEDIA_TYPE_VIDEO) {
+            if (m_videoIndex >= 0) continue;
+            m_videoIndex = track.index;
+        }
+        AVStream *out = avformat_new_stream(m_output, nullptr);
+        avcodec_parameters_copy(out->codecpar, track.codecpar.get());
+        out->codecpar->codec_tag = 0;
+        out->time_base = track.timeBase;
+        m_outputIndex[track.index] = out->index;
+    }
+    if (m_output->nb_streams == 0) {
+        qDebug() << "轉播沒有可封裝的軌道:" << m_channel->name();
+        return false;
+    }
+
+    unsigned char *buffer = static_cast<unsigned char *>(av_malloc(kIoBufferSize));
+    m_output->pb = avio_alloc_context(buffer, kIoBufferSize, 1, this, nullptr, nullptr, nullptr);
+    if (!m_output->pb) {
+        av_free(buffer);
+        return false;
+    }
+    // 依資料類型回呼：muxer 會標出檔頭與每個片段的開頭，用來讓新用戶端從關鍵幀接上
+    m_output->pb->write_data_type = &RelaySink::writeData;
+    m_output->pb->seekable = 0;
+    m_output->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    AVDictionary *options = nullptr;
+    av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    av_dict_set(&options, "frag_duration", "500000", 0);
+
+    m_header.clear();
+    m_writingHeader = true;
+    ret = avformat_write_header(m_output, &options);
+    av_dict_free(&options);
+    if (ret >= 0) avio_flush(m_output->pb);
+    m_writingHeader = false;
+    if (ret < 0) {
+        qDebug() << "轉播寫入檔頭失敗:" << m_channel->name() << avErrorString(ret);
+        return false;
+    }
+
+    m_channel->setHeader(m_header);
+    m_start = AV_NOPTS_VALUE;
+    m_lastDts = QVector<int64_t>(int(m_output->nb_streams), AV_NOPTS_VALUE);
+    return true;
+}
+
+void RelaySink::closeMuxer() {
+    if (!m_output) return;
+    // 直播沒有結尾，不寫 trailer
+    if (m_output->pb) {
+        av_freep(&m_output->pb->buffer);
+        avio_context_free(&m_output->pb);
+    }
+    avformat_free_context(m_output);
+    m_output = nullptr;
+}
+
+void RelaySink::writePacket(const AVPacket *packet) {
+    if (!m_output || packet->stream_index >= m_outputIndex.size()) return;
+    const int output = m_outputIndex[packet->stream_index];
+    if (output < 0 || packet->dts == AV_NOPTS_VALUE) return;
+
+    const AVRational inTb = m_layout[packet->stream_index].timeBase;
+    if (m_start == AV_NOPTS_VALUE) {
+        // 從第一個視訊關鍵幀開始
+        if (m_videoIndex >= 0 && (packet->stream_index != m_videoIndex || !(packet->flags & AV_PKT_FLAG_KEY))) return;
+        m_start = av_rescale_q(packet->dts, inTb, AV_TIME_BASE_Q);
+    }
+
+    const int64_t offset = av_rescale_q(m_start, AV_TIME_BASE_Q, inTb);
+    if (packet->dts < offset) return;
+    if (av_packet_ref(m_packet, packet) < 0) return;
+    m_packet->stream_index = output;
+    m_packet->pts = m_packet->pts != AV_NOPTS_VALUE ? m_packet->pts - offset : AV_NOPTS_VALUE;
+    m_packet->dts -= offset;
+    m_packet->pos = -1;
+
+    AVStream *stream = m_output->streams[output];
+    av_packet_rescale_ts(m_packet, inTb, stream->time_base);
+    int64_t &last = m_lastDts[output];
+    if (last != AV_NOPTS_VALUE && m_packet->dts <= last) {
+        m_packet->dts = last + 1;
+        if (m_packet->pts != AV_NOPTS_VALUE) m_packet->pts = qMax(m_packet->pts, m_packet->dts);
+    }
+    last = m_packet->dts;
+
+    int ret = av_interleaved_write_frame(m_output, m_packet);
+    if (ret < 0) {
+        av_packet_unref(m_packet);
+        qDebug() << "轉播寫入失敗:" << m_channel->name() << avErrorString(ret);
+        return;
+    }
+    // 片段寫出後馬上送出，不等緩衝滿
+    avio_flush(m_output->pb);
+}
+
+int RelaySink::writeData(void *opaque, const uint8_t *buf, int size, enum AVIODataMarkerType type, int64_t time) {
+    Q_UNUSED(time);
+    RelaySink *self = static_cast<RelaySink *>(opaque);
+    const QByteArray chunk(reinterpret_cast<const char *>(buf), size);
+    if (self->m_writingHeader) {
+        self->m_header += chunk;
+        return size;
+    }
+    // 片段開頭標為 SYNC_POINT（以關鍵幀開頭）或 BOUNDARY_POINT，之後的續寫為 UNKNOWN
+    self->m_channel->publish(chunk, type == AVIO_DATA_MARKER_SYNC_POINT);
+    return size;
+}
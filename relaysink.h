@@ -0,0 +1,45 @@
+#ifndef RELAYSINK_H
+#define RELAYSINK_H
+
+#include <QByteArray>
+#include <QVector>
+#include <memory>
+
+#include "packetsink.h"
+#include "relaychannel.h"
+
+// 轉播接收端：把攝影機的封包原樣（不轉碼）封裝成 fMP4，切成資料塊發佈到 RelayChannel
+// 每台攝影機只封裝一次，不論有多少用戶端；片段在關鍵幀或每 0.5 秒切一次，延遲約一個片段
+class RelaySink : public PacketSink {
+public:
+    explicit RelaySink(const std::shared_ptr<RelayChannel> &channel);
+    ~RelaySink() override;
+
+    const std::shared_ptr<RelayChannel> &channel() const { return m_channel; }
+
+    void openSink(const IngestLayout &layout) override;
+    void writePacket(const AVPacket *packet) override;
+    void closeSink() override;
+    void sinkInterrupted() override;
+    // 轉播寧可跳格也不能讓擷取端等
+    QueuePolicy queuePolicy() const override { return QueuePolicy::DropOldest; }
+    QString sinkName() const override { return "轉播"; }
+
+private:
+    static int writeData(void *opaque, const uint8_t *buf, int size, enum AVIODataMarkerType type, int64_t time);
+    bool openMuxer();
+    void closeMuxer();
+
+    const std::shared_ptr<RelayChannel> m_channel;
+    IngestLayout m_layout;
+    AVFormatContext *m_output = nullptr;
+    AVPacket *m_packet = nullptr;
+    QVector<int> m_outputIndex;         // 來源軌道 -> 輸出軌道，-1 表示 mp4 放不下而略過
+    QVector<int64_t> m_lastDts;
+    int m_videoIndex = -1;
+    int64_t m_start = AV_NOPTS_VALUE;   // 第一個封包的時間（AV_TIME_BASE），輸出從 0 開始
+    QByteArray m_header;                // 寫檔頭時累積的 ftyp+moov
+    bool m_writingHeader = false;
+};
+
+#endif // RELAYSINK_H
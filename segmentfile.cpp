@@ -0,0 +1,125 @@
+#include "segmentfile.h"
+#include <QDebug>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <linux/falloc.h>
+#endif
+
+// muxer 的寫入緩衝：一次寫一大塊，磁碟看到的是循序寫
+static const int kIoBufferSize = 256 * 1024;
+// 寫超過預留量時每次再預留這麼多
+static const qint64 kReserveChunk = 16LL * 1024 * 1024;
+
+// 預留空間但不改變檔案長度；Windows 上預留只在檔案開著時有效，關檔時自動收回沒用到的部分
+static bool reserveSpace(QFile &file, qint64 bytes) {
+#if defined(Q_OS_WIN)
+    HANDLE handle = HANDLE(_get_osfhandle(file.handle()));
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = bytes;
+    return SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info));
+#elif defined(Q_OS_LINUX)
+    return fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, bytes) == 0;
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(bytes);
+    return false;
+#endif
+}
+
+// 關檔前把檔尾之後沒用到的預留空間還回去：截到目前長度，檔尾之後配置的區塊一併釋放
+// （ext4 的 PUNCH_HOLE 碰到檔尾之後的範圍什麼都不做，不能用它）
+static void releaseSpace(QFile &file, qint64 size, qint64 reserved) {
+    if (reserved > size && !file.resize(size))
+        qDebug() << "無法釋放錄影檔預留空間:" << file.fileName() << file.errorString();
+}
+
+SegmentFile::~SegmentFile() {
+    close();
+}
+
+bool SegmentFile::open(const QString &path, qint64 reserveBytes, QString *error) {
+    close();
+
+    m_file.setFileName(path);
+    // avio 自己有緩衝，QFile 不必再緩衝一次
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        *error = m_file.errorString();
+        return false;
+    }
+
+    m_size = 0;
+    m_reserved = 0;
+    m_reserving = reserveBytes > 0;
+    if (m_reserving) reserve(reserveBytes);
+
+    unsigned char *buffer = static_cast<unsigned char *>(av_malloc(kIoBufferSize));
+    m_io = avio_alloc_context(buffer, kIoBufferSize, 1, this, nullptr, &SegmentFile::writePacket, &SegmentFile::seek);
+    if (!m_io) {
+        av_free(buffer);
+        m_file.close();
+        *error = "無法配置寫入緩衝";
+        return false;
+    }
+    return true;
+}
+
+void SegmentFile::close() {
+    if (m_io) {
+        avio_flush(m_io);
+        av_freep(&m_io->buffer);
+        avio_context_free(&m_io);
+    }
+    if (m_file.isOpen()) {
+        releaseSpace(m_file, m_size, m_reserved);
+        m_file.close();
+    }
+}
+
+void SegmentFile::reserve(qint64 bytes) {
+    if (!m_reserving || bytes <= m_reserved) return;
+    if (!reserveSpace(m_file, bytes)) {
+        // 檔案系統不支援（FAT、網路磁碟等）就照一般方式寫
+        qDebug() << "無法預留錄影檔空間:" << m_file.fileName();
+        m_reserving = false;
+        return;
+    }
+    m_reserved = bytes;
+}
+
+int SegmentFile::writePacket(void *opaque, const uint8_t *buf, int size) {
+    SegmentFile *self = static_cast<SegmentFile *>(opaque);
+    const qint64 end = self->m_file.pos() + size;
+    if (end > self->m_reserved) self->reserve(qMax(end, self->m_reserved + kReserveChunk));
+
+    const qint64 written = self->m_file.write(reinterpret_cast<const char *>(buf), size);
+    if (written != size) return AVERROR(EIO);
+    if (self->m_writeCounter) self->m_writeCounter->fetch_add(written, std::memory_order_relaxed);
+    self->m_size = qMax(self->m_size, self->m_file.pos());
+    return size;
+}
+
+int64_t SegmentFile::seek(void *opaque, int64_t offset, int whence) {
+    SegmentFile *self = static_cast<SegmentFile *>(opaque);
+    qint64 target = 0;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return self->m_size;
+    case SEEK_SET:
+        target = offset;
+        break;
+    case SEEK_CUR:
+        target = self->m_file.pos() + offset;
+        break;
+    case SEEK_END:
+        target = self->m_size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (target < 0 || !self->m_file.seek(target)) return AVERROR(EIO);
+    return target;
+}
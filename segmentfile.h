@@ -0,0 +1,45 @@
+#ifndef SEGMENTFILE_H
+#define SEGMENTFILE_H
+
+#include <QFile>
+#include <QString>
+#include <atomic>
+
+#include "ffmpegutils.h"
+
+// 錄影分段檔：自己開檔再以自訂 AVIOContext 交給 muxer 寫
+// 開檔時先向檔案系統預留空間（不改變檔案長度），寫超過預留量時再往後預留一塊
+// 檔案在磁碟上保持連續、寫入都是大塊循序寫；當機時檔尾也不會多出一段零
+class SegmentFile {
+public:
+    SegmentFile() = default;
+    ~SegmentFile();
+
+    SegmentFile(const SegmentFile &) = delete;
+    SegmentFile &operator=(const SegmentFile &) = delete;
+
+    // reserveBytes 為 0 表示不預留
+    bool open(const QString &path, qint64 reserveBytes, QString *error);
+    // 寫完緩衝、放掉沒用到的預留空間並關檔
+    void close();
+
+    // 實際寫進檔案的位元組另外累加到這裡（效能統計用），nullptr 表示不計
+    void setWriteCounter(std::atomic<qint64> *counter) { m_writeCounter = counter; }
+
+    AVIOContext *io() const { return m_io; }
+    bool isOpen() const { return m_io != nullptr; }
+
+private:
+    static int writePacket(void *opaque, const uint8_t *buf, int size);
+    static int64_t seek(void *opaque, int64_t offset, int whence);
+    void reserve(qint64 bytes);
+
+    QFile m_file;
+    AVIOContext *m_io = nullptr;
+    qint64 m_reserved = 0;      // 已向檔案系統預留到的位置
+    qint64 m_size = 0;          // 寫到的最大位置，即實際檔案長度
+    bool m_reserving = false;   // 檔案系統不支援預留時就不再嘗試
+    std::atomic<qint64> *m_writeCounter = nullptr;
+};
+
+#endif // SEGMENTFILE_H
@@ -0,0 +1,190 @@
+#include "sinkqueue.h"
+
+// 錄影佇列要撐得過磁碟短暫變慢，以及加入時預錄緩衝一次倒進來
+static const size_t kLosslessCapacity = 2048;
+static const qint64 kLosslessBytes = 64LL * 1024 * 1024;
+// 顯示與偵測只需要很短的緩衝，再多只是延遲
+static const size_t kDropOldestCapacity = 64;
+static const qint64 kDropOldestBytes = 8LL * 1024 * 1024;
+// 睡眠上限：萬一漏掉喚醒也不會卡住
+static const unsigned long kParkMs = 20;
+// 每處理這麼多個項目更新一次 CPU 時間，閒下來等封包前也會更新
+static const int kCpuSampleInterval = 32;
+
+std::shared_ptr<SinkQueue> SinkQueue::create(const std::shared_ptr<PacketSink> &sink) {
+    SinkQueue *queue = new SinkQueue(sink);
+    queue->start();
+    // 最後一個參考常在擷取執行緒放掉，不在那裡等接收端收尾：收尾完交給建立它的執行緒刪除
+    return std::shared_ptr<SinkQueue>(queue, [](SinkQueue *queue) {
+        QObject::connect(queue, &QThread::finished, queue, &QObject::deleteLater);
+        if (queue->m_finished) queue->deleteLater();
+        else queue->closeSink();
+    });
+}
+
+SinkQueue::SinkQueue(const std::shared_ptr<PacketSink> &sink)
+    : m_sink(sink), m_policy(sink->queuePolicy()),
+      m_byteLimit(m_policy == QueuePolicy::Lossless ? kLosslessBytes : kDropOldestBytes),
+      m_queue(m_policy == QueuePolicy::Lossless ? kLosslessCapacity : kDropOldestCapacity) {
+}
+
+SinkQueue::~SinkQueue() {
+    wait();
+    Item item;
+    while (m_queue.tryPop(item)) av_packet_free(&item.packet);
+}
+
+SinkQueueStats SinkQueue::stats() const {
+    SinkQueueStats stats;
+    stats.name = m_sink->sinkName();
+    stats.depth = int(m_queue.size());
+    stats.capacity = int(m_queue.capacity());
+    stats.bytes = m_bytes;
+    stats.byteLimit = m_byteLimit;
+    stats.dropped = m_dropped;
+    stats.stalls = m_stalls;
+    stats.cpuNs = m_cpuNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool SinkQueue::isKeyframe(const Item &item) {
+    return item.packet && (item.packet->flags & AV_PKT_FLAG_KEY);
+}
+
+void SinkQueue::openSink(const IngestLayout &layout) {
+    if (m_closeQueued) return;
+    Item item;
+    item.kind = Item::Open;
+    item.layout = layout;
+    push(std::move(item));
+}
+
+void SinkQueue::writePacket(const AVPacket *packet) {
+    if (m_closeQueued) return;
+    // 只多一個參考，不複製資料
+    Item item;
+    item.packet = av_packet_clone(packet);
+    if (item.packet) push(std::move(item));
+}
+
+void SinkQueue::sinkInterrupted() {
+    if (m_closeQueued) return;
+    Item item;
+    item.kind = Item::Interrupt;
+    push(std::move(item));
+}
+
+void SinkQueue::closeSink() {
+    if (m_closeQueued) return;
+    m_closeQueued = true;
+    Item item;
+    item.kind = Item::Close;
+    push(std::move(item));
+}
+
+bool SinkQueue::isFull(qint64 incomingBytes) const {
+    const size_t depth = m_queue.size();
+    // 單一封包比上限還大時，佇列空了就放行
+    return depth >= m_queue.capacity() || (depth > 0 && m_bytes + incomingBytes > m_byteLimit);
+}
+
+void SinkQueue::push(Item &&item) {
+    const qint64 bytes = item.packet ? item.packet->size : 0;
+    bool stalled = false;
+    while (isFull(bytes) && !m_finished) {
+        if (m_policy == QueuePolicy::DropOldest) {
+            // 叫消費端從頭丟；新來的非關鍵幀也丟，之後要從關鍵幀重新開始
+            m_shed = true;
+            if (item.kind == Item::Packet && !isKeyframe(item)) {
+                av_packet_free(&item.packet);
+                m_pendingGap = true;
+                ++m_dropped;
+                return;
+            }
+        } else if (!stalled) {
+            stalled = true;
+            ++m_stalls;
+        }
+        waitForSpace(bytes);
+    }
+    if (m_finished) {
+        av_packet_free(&item.packet);
+        return;
+    }
+
+    if (item.kind == Item::Packet) {
+        item.afterGap = m_pendingGap;
+        m_pendingGap = false;
+    }
+    m_bytes += bytes;
+    m_queue.tryPush(std::move(item));
+
+    // 先放好再看旗標；消費端是先設旗標再看佇列，兩邊不會同時錯過
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_consumerWaiting) {
+        QMutexLocker locker(&m_mutex);
+        m_itemAvailable.wakeOne();
+    }
+}
+
+void SinkQueue::waitForSpace(qint64 incomingBytes) {
+    QMutexLocker locker(&m_mutex);
+    m_producerWaiting = true;
+    if (isFull(incomingBytes) && !m_finished) m_spaceAvailable.wait(&m_mutex, kParkMs);
+    m_producerWaiting = false;
+}
+
+void SinkQueue::waitForItem() {
+    QMutexLocker locker(&m_mutex);
+    m_consumerWaiting = true;
+    if (m_queue.size() == 0) m_itemAvailable.wait(&m_mutex, kParkMs);
+    m_consumerWaiting = false;
+}
+
+void SinkQueue::run() {
+    bool skipping = false;
+    int processed = 0;
+    forever {
+        Item item;
+        if (!m_queue.tryPop(item)) {
+            m_cpuNs.store(threadCpuNanoseconds(), std::memory_order_relaxed);
+            waitForItem();
+            continue;
+        }
+        if (++processed % kCpuSampleInterval == 0)
+            m_cpuNs.store(threadCpuNanoseconds(), std::memory_order_relaxed);
+        if (item.packet) m_bytes -= item.packet->size;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_producerWaiting) {
+            QMutexLocker locker(&m_mutex);
+            m_spaceAvailable.wakeOne();
+        }
+
+        switch (item.kind) {
+        case Item::Packet:
+            // 被要求丟幀或前面有缺：丟到下一個關鍵幀為止，解碼器不會拿到缺參考的畫面
+            if (m_shed.exchange(false) || (item.afterGap && !isKeyframe(item))) skipping = true;
+            if (skipping && isKeyframe(item)) skipping = false;
+            if (skipping) ++m_dropped;
+            else m_sink->writePacket(item.packet);
+            av_packet_free(&item.packet);
+            break;
+        case Item::Open:
+            skipping = false;
+            m_sink->openSink(item.layout);
+            break;
+        case Item::Interrupt:
+            m_sink->sinkInterrupted();
+            break;
+        case Item::Close:
+            m_sink->closeSink();
+            m_finished = true;
+            {
+                QMutexLocker locker(&m_mutex);
+                m_spaceAvailable.wakeAll();
+            }
+            return;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SINKQUEUE_H
+#define SINKQUEUE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+#include "packetsink.h"
+#include "spscqueue.h"
+#include "streammetrics.h"
+
+// 一個接收端佇列的目前狀態
+struct SinkQueueStats {
+    QString name;
+    int depth = 0;              // 佇列裡的封包數
+    int capacity = 0;
+    qint64 bytes = 0;           // 佇列裡的封包總大小
+    qint64 byteLimit = 0;
+    qint64 dropped = 0;         // DropOldest：累計丟掉的封包
+    qint64 stalls = 0;          // Lossless：累計塞滿、擷取端必須等待的次數
+    qint64 cpuNs = 0;           // 佇列執行緒（即接收端）累計 CPU 時間
+};
+
+// 擷取執行緒與一個接收端之間的固定容量佇列：擷取端放、自己的執行緒取出交給接收端
+// 封包數與位元組都有上限，每路攝影機的記憶體用量可預期；滿了依接收端的 QueuePolicy 處理
+// 由 StreamIngest 建立，接收端收尾後自行刪除
+class SinkQueue : public QThread, public PacketSink {
+    Q_OBJECT
+public:
+    static std::shared_ptr<SinkQueue> create(const std::shared_ptr<PacketSink> &sink);
+    ~SinkQueue() override;
+
+    const std::shared_ptr<PacketSink> &sink() const { return m_sink; }
+    // 任何執行緒皆可
+    SinkQueueStats stats() const;
+
+    // 以下由擷取執行緒呼叫（擷取結束後可能由其他執行緒呼叫 closeSink），依序排進佇列
+    void openSink(const IngestLayout &layout) override;
+    void writePacket(const AVPacket *packet) override;
+    void closeSink() override;
+    void sinkInterrupted() override;
+    bool wantsPreRoll() const override { return m_sink->wantsPreRoll(); }
+
+protected:
+    void run() override;
+
+private:
+    struct Item {
+        enum Kind { Packet, Open, Interrupt, Close };
+        Kind kind = Packet;
+        AVPacket *packet = nullptr;
+        IngestLayout layout;
+        bool afterGap = false;      // 前面有封包被丟掉，不是關鍵幀就不能解
+    };
+
+    explicit SinkQueue(const std::shared_ptr<PacketSink> &sink);
+    void push(Item &&item);
+    bool isFull(qint64 incomingBytes) const;
+    void waitForSpace(qint64 incomingBytes);
+    void waitForItem();
+    static bool isKeyframe(const Item &item);
+
+    const std::shared_ptr<PacketSink> m_sink;
+    const PacketSink::QueuePolicy m_policy;
+    const qint64 m_byteLimit;
+    SpscQueue<Item> m_queue;
+
+    std::atomic<qint64> m_bytes{0};
+    std::atomic<qint64> m_dropped{0};
+    std::atomic<qint64> m_stalls{0};
+    std::atomic<qint64> m_cpuNs{0};
+    std::atomic_bool m_shed{false};             // 要求消費端從頭丟掉非關鍵幀
+    std::atomic_bool m_finished{false};         // 已處理完 Close，不再取出
+    std::atomic_bool m_consumerWaiting{false};
+    std::atomic_bool m_producerWaiting{false};
+    bool m_closeQueued = false;                 // 只在生產端使用
+    bool m_pendingGap = false;                  // 只在生產端使用
+
+    QMutex m_mutex;                             // 只用來睡眠與喚醒，佇列本身不上鎖
+    QWaitCondition m_itemAvailable;
+    QWaitCondition m_spaceAvailable;
+};
+
+#endif // SINKQUEUE_H
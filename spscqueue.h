@@ -0,0 +1,57 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 固定容量的單一生產者、單一消費者環形佇列，不上鎖
+// tryPush 只能在生產者執行緒、tryPop 只能在消費者執行緒呼叫；size 任何執行緒皆可（近似值）
+template <typename T>
+class SpscQueue {
+public:
+    // 容量進位到 2 的次方
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    size_t capacity() const { return m_slots.size(); }
+    size_t size() const {
+        // 先讀 head 再讀 tail，結果不會是負的
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+
+    bool tryPush(T &&value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) return false;
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &value) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+        value = std::move(m_slots[head & m_mask]);
+        m_slots[head & m_mask] = T();   // 共享資料（例如 layout）不留在槽裡
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_mask = 0;
+    // 生產者與消費者各寫各的索引，分開放在不同快取行
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,86 @@
+#include "storagecleaner.h"
+#include <QFile>
+#include <QStorageInfo>
+#include <QDebug>
+
+// 沒有新工作時多久量一次空間
+static const unsigned long kCheckIntervalMs = 60 * 1000;
+
+StorageCleaner::StorageCleaner(QObject *parent) : QThread(parent) {
+}
+
+StorageCleaner::~StorageCleaner() {
+    stop();
+    wait();
+}
+
+void StorageCleaner::setVolumes(const QStringList &volumes) {
+    QMutexLocker locker(&m_mutex);
+    m_volumes = volumes;
+    m_checkRequested = true;
+    m_wake.wakeOne();
+}
+
+void StorageCleaner::remove(const QString &fileName, const QStringList &paths) {
+    QMutexLocker locker(&m_mutex);
+    m_removals.append({fileName, paths});
+    m_wake.wakeOne();
+}
+
+void StorageCleaner::checkNow() {
+    QMutexLocker locker(&m_mutex);
+    m_checkRequested = true;
+    m_wake.wakeOne();
+}
+
+void StorageCleaner::stop() {
+    QMutexLocker locker(&m_mutex);
+    m_stopRequested = true;
+    m_wake.wakeOne();
+}
+
+void StorageCleaner::run() {
+    forever {
+        QList<Removal> removals;
+        QStringList volumes;
+        bool check = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            // 逾時就定時量一次
+            if (!m_stopRequested && !m_checkRequested && m_removals.isEmpty()
+                && !m_wake.wait(&m_mutex, kCheckIntervalMs))
+                m_checkRequested = true;
+            if (m_stopRequested) break;
+            removals.swap(m_removals);
+            volumes = m_volumes;
+            check = m_checkRequested || !removals.isEmpty();
+            m_checkRequested = false;
+        }
+
+        QStringList removedFiles;
+        QStringList failedFiles;
+        for (const Removal &removal : std::as_const(removals)) {
+            const QString path = removal.paths.value(0);
+            // 已經被外部刪掉的也算成功，索引照樣移除
+            const bool ok = QFile::remove(path) || !QFile::exists(path);
+            if (ok) {
+                for (int i = 1; i < removal.paths.size(); ++i) QFile::remove(removal.paths[i]);
+                removedFiles << removal.fileName;
+            } else {
+                qDebug() << "無法刪除錄影檔:" << path;
+                failedFiles << removal.fileName;
+            }
+        }
+        if (!removals.isEmpty()) emit removed(removedFiles, failedFiles);
+
+        // 刪完檔馬上重量，讓管理端知道空間是否已經夠了
+        if (check) {
+            QHash<QString, qint64> available;
+            for (const QString &volume : std::as_const(volumes)) {
+                QStorageInfo info(volume);
+                if (info.isValid() && info.isReady()) available.insert(volume, info.bytesAvailable());
+            }
+            emit spaceChecked(available);
+        }
+    }
+}
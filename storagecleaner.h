@@ -0,0 +1,50 @@
+#ifndef STORAGECLEANER_H
+#define STORAGECLEANER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+
+// 儲存空間的檔案系統工作：刪檔與量可用空間都在這條執行緒上做
+// 刪大檔、網路磁碟回應慢都不會卡住錄影寫入或畫面；結果以 signal 回報
+class StorageCleaner : public QThread {
+    Q_OBJECT
+public:
+    explicit StorageCleaner(QObject *parent = nullptr);
+    ~StorageCleaner() override;
+
+    // 以下方法任何執行緒皆可呼叫，不會阻塞
+    void setVolumes(const QStringList &volumes);
+    // paths 第一個是錄影檔，其餘為附屬檔（關鍵幀索引、縮圖）；錄影檔刪不掉時附屬檔保留
+    void remove(const QString &fileName, const QStringList &paths);
+    // 馬上量一次空間，不等下一次定時檢查
+    void checkNow();
+    void stop();
+
+signals:
+    // 每處理完一批回報一次，刪不掉的（例如正在播放）下次再試
+    void removed(const QStringList &removedFiles, const QStringList &failedFiles);
+    // 各儲存位置目前的可用空間（位元組）；量不到的位置不會出現
+    void spaceChecked(const QHash<QString, qint64> &available);
+
+protected:
+    void run() override;
+
+private:
+    struct Removal {
+        QString fileName;
+        QStringList paths;
+    };
+
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    bool m_stopRequested = false;
+    bool m_checkRequested = true;   // 啟動後先量一次
+    QStringList m_volumes;
+    QList<Removal> m_removals;
+};
+
+#endif // STORAGECLEANER_H
@@ -0,0 +1,191 @@
+#include "storagemanager.h"
+#include "keyframeindex.h"
+#include "thumbnailstore.h"
+#include <QSettings>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+static const char *kSettingsFileName = "storage.ini";
+// 每個儲存位置預設至少保留的空間，避免磁碟寫滿時所有錄影一起失敗
+static const qint64 kDefaultMinFreeBytes = 2LL * 1024 * 1024 * 1024;
+// 一次最多排進幾個刪除，其餘等刪完重新量過空間再說
+static const int kMaxRemovalsPerPass = 100;
+
+StorageManager::StorageManager(const QString &primaryDirectory, RecordingIndex *index, QObject *parent)
+    : QObject(parent), m_primary(normalized(primaryDirectory)), m_index(index),
+      m_minFreeBytes(kDefaultMinFreeBytes) {
+    m_cleaner = new StorageCleaner(this);
+    connect(m_cleaner, &StorageCleaner::removed, this, &StorageManager::onRemoved, Qt::QueuedConnection);
+    connect(m_cleaner, &StorageCleaner::spaceChecked, this, [this](const QHash<QString, qint64> &available){
+        m_available = available;
+        enforce();
+    }, Qt::QueuedConnection);
+
+    load();
+    m_cleaner->setVolumes(m_volumes);
+    m_cleaner->start(QThread::LowPriority);
+}
+
+StorageManager::~StorageManager() {
+    m_cleaner->stop();
+    m_cleaner->wait();
+}
+
+QString StorageManager::normalized(const QString &path) {
+    return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+}
+
+void StorageManager::load() {
+    QSettings settings(m_primary + "/" + kSettingsFileName, QSettings::IniFormat);
+    m_volumes = QStringList() << m_primary;
+    const QStringList extra = settings.value("volumes").toStringList();
+    for (const QString &volume : extra) {
+        const QString path = normalized(volume);
+        if (!m_volumes.contains(path)) m_volumes << path;
+    }
+    m_globalQuota = settings.value("globalQuota", 0).toLongLong();
+    m_cameraQuota = settings.value("cameraQuota", 0).toLongLong();
+    m_minFreeBytes = settings.value("minFreeBytes", kDefaultMinFreeBytes).toLongLong();
+
+    m_assignments.clear();
+    const int count = settings.beginReadArray("cameras");
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex(i);
+        m_assignments.insert(settings.value("url").toString(), settings.value("volume").toString());
+    }
+    settings.endArray();
+}
+
+void StorageManager::save() {
+    QSettings settings(m_primary + "/" + kSettingsFileName, QSettings::IniFormat);
+    settings.setValue("volumes", m_volumes.mid(1));
+    settings.setValue("globalQuota", m_globalQuota);
+    settings.setValue("cameraQuota", m_cameraQuota);
+    settings.setValue("minFreeBytes", m_minFreeBytes);
+
+    settings.remove("cameras");
+    settings.beginWriteArray("cameras", int(m_assignments.size()));
+    int i = 0;
+    for (auto it = m_assignments.constBegin(); it != m_assignments.constEnd(); ++it, ++i) {
+        settings.setArrayIndex(i);
+        settings.setValue("url", it.key());
+        settings.setValue("volume", it.value());
+    }
+    settings.endArray();
+}
+
+void StorageManager::setVolumes(const QStringList &volumes) {
+    m_volumes = QStringList() << m_primary;
+    for (const QString &volume : volumes) {
+        const QString path = normalized(volume);
+        if (!m_volumes.contains(path)) m_volumes << path;
+    }
+    m_cleaner->setVolumes(m_volumes);
+}
+
+QString StorageManager::directoryFor(const QString &camera) {
+    QString volume = m_assignments.value(camera);
+    if (!m_volumes.contains(volume)) {
+        // 分散到攝影機最少的位置，一樣多時挑可用空間大的
+        QHash<QString, int> cameras;
+        for (const QString &assigned : std::as_const(m_assignments))
+            if (m_volumes.contains(assigned)) ++cameras[assigned];
+
+        volume = m_volumes.first();
+        for (const QString &candidate : std::as_const(m_volumes)) {
+            const int count = cameras.value(candidate);
+            const int best = cameras.value(volume);
+            if (count < best || (count == best && availableBytes(candidate) > availableBytes(volume)))
+                volume = candidate;
+        }
+        m_assignments.insert(camera, volume);
+        save();
+        qDebug() << "錄影位置:" << camera << volume;
+    }
+    QDir().mkpath(volume);
+    return volume;
+}
+
+void StorageManager::scheduleCleanup() {
+    m_failed.clear();
+    m_cleaner->checkNow();
+}
+
+QString StorageManager::volumeOf(const QString &fileName) const {
+    // 只有檔名的就在主要錄影資料夾
+    if (QDir::isRelativePath(fileName)) return m_primary;
+    const QString path = normalized(recordingFilePath(m_primary, fileName));
+    QString volume;
+    for (const QString &candidate : m_volumes) {
+        if (candidate.size() > volume.size() && path.startsWith(candidate + "/")) volume = candidate;
+    }
+    return volume.isEmpty() ? QFileInfo(path).absolutePath() : volume;
+}
+
+void StorageManager::enforce() {
+    // 索引依加入順序排列，最舊的在前面
+    const QVector<RecordingEntry> &entries = m_index->entries();
+
+    QHash<QString, qint64> cameraBytes;
+    QHash<QString, qint64> pendingBytes;    // 各位置已排進刪除、量空間時還沒算到的部分
+    qint64 totalBytes = 0;
+    for (const RecordingEntry &entry : entries) {
+        if (m_pending.contains(entry.fileName)) {
+            pendingBytes[volumeOf(entry.fileName)] += entry.bytes;
+            continue;
+        }
+        cameraBytes[entry.camera] += entry.bytes;
+        totalBytes += entry.bytes;
+    }
+
+    qint64 globalExcess = m_globalQuota > 0 ? totalBytes - m_globalQuota : 0;
+    QHash<QString, qint64> shortage;        // 各位置還差多少才夠保留空間
+    for (auto it = m_available.constBegin(); it != m_available.constEnd(); ++it) {
+        const qint64 missing = m_minFreeBytes - it.value() - pendingBytes.value(it.key());
+        if (missing > 0) shortage.insert(it.key(), missing);
+    }
+    int camerasOver = 0;
+    if (m_cameraQuota > 0) {
+        for (qint64 bytes : std::as_const(cameraBytes))
+            if (bytes > m_cameraQuota) ++camerasOver;
+    }
+    if (globalExcess <= 0 && shortage.isEmpty() && camerasOver == 0) return;
+
+    int queued = 0;
+    for (const RecordingEntry &entry : entries) {
+        if (m_pending.contains(entry.fileName) || m_failed.contains(entry.fileName)) continue;
+
+        qint64 &camera = cameraBytes[entry.camera];
+        const bool cameraOver = m_cameraQuota > 0 && camera > m_cameraQuota;
+        const QString volume = volumeOf(entry.fileName);
+        auto missing = shortage.find(volume);
+        if (!cameraOver && globalExcess <= 0 && missing == shortage.end()) continue;
+
+        camera -= entry.bytes;
+        if (cameraOver && camera <= m_cameraQuota) --camerasOver;
+        globalExcess -= entry.bytes;
+        if (missing != shortage.end() && (*missing -= entry.bytes) <= 0) shortage.erase(missing);
+
+        const QString path = recordingFilePath(m_primary, entry.fileName);
+        m_cleaner->remove(entry.fileName, QStringList() << path << KeyframeIndex::sidecarPath(path)
+                                                         << ThumbnailStore::cachePath(m_primary, entry.fileName));
+        m_pending.insert(entry.fileName);
+
+        if (++queued >= kMaxRemovalsPerPass) break;
+        if (globalExcess <= 0 && shortage.isEmpty() && camerasOver == 0) break;
+    }
+    if (queued > 0) qDebug() << "儲存空間清理:" << queued << "個分段";
+}
+
+void StorageManager::onRemoved(const QStringList &removedFiles, const QStringList &failedFiles) {
+    for (const QString &fileName : removedFiles) m_pending.remove(fileName);
+    for (const QString &fileName : failedFiles) {
+        m_pending.remove(fileName);
+        m_failed.insert(fileName);
+    }
+    if (removedFiles.isEmpty()) return;
+
+    m_index->remove(removedFiles);
+    emit segmentsRemoved(removedFiles);
+}
@@ -0,0 +1,65 @@
+#ifndef STORAGEMANAGER_H
+#define STORAGEMANAGER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+#include "recordingindex.h"
+#include "storagecleaner.h"
+
+// 錄影儲存管理：多個儲存位置、全域與每台攝影機的容量上限、每個位置至少保留的空間
+// 超過時從最舊的分段開始刪；用量以錄影索引計算，刪檔與量空間都交給 StorageCleaner 在背景做
+// 設定存在主要錄影資料夾的 storage.ini
+class StorageManager : public QObject {
+    Q_OBJECT
+public:
+    StorageManager(const QString &primaryDirectory, RecordingIndex *index, QObject *parent = nullptr);
+    ~StorageManager() override;
+
+    // 第一個一定是主要錄影資料夾
+    QStringList volumes() const { return m_volumes; }
+    void setVolumes(const QStringList &volumes);
+    // 以下以位元組計，0 表示不限
+    qint64 globalQuota() const { return m_globalQuota; }
+    void setGlobalQuota(qint64 bytes) { m_globalQuota = bytes; }
+    qint64 cameraQuota() const { return m_cameraQuota; }
+    void setCameraQuota(qint64 bytes) { m_cameraQuota = bytes; }
+    qint64 minFreeBytes() const { return m_minFreeBytes; }
+    void setMinFreeBytes(qint64 bytes) { m_minFreeBytes = bytes; }
+    void save();
+
+    // 攝影機的錄影位置：第一次分配到攝影機最少、空間最多的位置，之後固定
+    QString directoryFor(const QString &camera);
+    // 最近量到的可用空間；還沒量過時回傳 -1
+    qint64 availableBytes(const QString &volume) const { return m_available.value(volume, -1); }
+
+    // 分段寫完或設定變更後呼叫：重新量空間，需要時清理
+    void scheduleCleanup();
+
+signals:
+    void segmentsRemoved(const QStringList &fileNames);
+
+private:
+    void load();
+    void enforce();
+    void onRemoved(const QStringList &removedFiles, const QStringList &failedFiles);
+    QString volumeOf(const QString &fileName) const;
+    static QString normalized(const QString &path);
+
+    QString m_primary;
+    RecordingIndex *m_index;
+    StorageCleaner *m_cleaner;
+
+    QStringList m_volumes;
+    qint64 m_globalQuota = 0;
+    qint64 m_cameraQuota = 0;
+    qint64 m_minFreeBytes;
+    QHash<QString, QString> m_assignments;  // 攝影機網址 -> 儲存位置
+    QHash<QString, qint64> m_available;     // 儲存位置 -> 最近量到的可用空間
+    QSet<QString> m_pending;                // 已排進刪除、還沒回報的檔案
+    QSet<QString> m_failed;                 // 刪不掉的檔案，下次排程清理前先略過
+};
+
+#endif // STORAGEMANAGER_H
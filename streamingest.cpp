@@ -0,0 +1,296 @@
+#include "streamingest.h"
+#include <QMutexLocker>
+#include <QDateTime>
+#include <QDebug>
+
+// 重連間隔：1 秒起跳每次加倍，最多 30 秒；連線撐過 30 秒才重新從 1 秒算
+static const int kInitialBackoffMs = 1000;
+static const int kMaxBackoffMs = 30000;
+static const qint64 kStableSessionMs = 30000;
+// 每收這麼多個封包更新一次擷取執行緒的 CPU 時間
+static const qint64 kCpuSampleInterval = 64;
+
+qint64 packetReceivedMs(const AVPacket *packet) {
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    const qint64 receivedUs = qint64(intptr_t(packet->opaque));
+    if (receivedUs <= 0) return nowMs;
+    return nowMs - qMax<qint64>(0, metricsClockUs() - receivedUs) / 1000;
+}
+
+StreamIngest::StreamIngest(const QString &url, QObject *parent)
+    : QThread(parent), m_url(url) {
+}
+
+StreamIngest::~StreamIngest() {
+    stop();
+    wait();
+}
+
+void StreamIngest::addSink(const std::shared_ptr<PacketSink> &sink) {
+    QMutexLocker locker(&m_sinkMutex);
+    if (m_closed) {
+        // 擷取已結束，直接讓接收端收尾（錄影端會回報失敗）
+        locker.unlock();
+        sink->closeSink();
+        return;
+    }
+    if (m_queues.contains(sink.get())) return;
+    // 正在移除中的同一個接收端，舊佇列照樣收尾，這裡另開一個新的
+    std::shared_ptr<SinkQueue> queue = SinkQueue::create(sink);
+    m_queues.insert(sink.get(), queue);
+    m_pendingAdds.append(queue);
+}
+
+void StreamIngest::removeSink(const std::shared_ptr<PacketSink> &sink) {
+    QMutexLocker locker(&m_sinkMutex);
+    if (m_closed) return;
+    std::shared_ptr<SinkQueue> queue = m_queues.take(sink.get());
+    if (!queue) return;
+    if (m_pendingAdds.removeAll(queue) > 0) {
+        // 還沒開始收封包，不必等擷取執行緒
+        locker.unlock();
+        queue->closeSink();
+        return;
+    }
+    m_pendingRemoves.append(queue);
+}
+
+QVector<SinkQueueStats> StreamIngest::queueStats() const {
+    QMutexLocker locker(&m_sinkMutex);
+    QVector<SinkQueueStats> stats;
+    for (const auto &queue : m_queues) stats.append(queue->stats());
+    return stats;
+}
+
+void StreamIngest::stop() {
+    m_stopRequested = true;
+}
+
+void StreamIngest::setPreRoll(int seconds, qint64 maxBytes) {
+    m_preRollSeconds = seconds;
+    m_preRollMaxBytes = maxBytes;
+}
+
+int StreamIngest::interruptCallback(void *opaque) {
+    // 只在擷取執行緒的 FFmpeg I/O 內被呼叫
+    StreamIngest *self = static_cast<StreamIngest *>(opaque);
+    if (self->m_stopRequested) return 1;
+    // 看門狗：讀取卡住太久（攝影機沒斷線但不再送資料）就中斷，交給重連處理
+    return self->m_watchdogArmed && self->m_clock.elapsed() - self->m_readStartMs > self->m_stallTimeoutMs;
+}
+
+AVFormatContext *StreamIngest::openInput() {
+    AVFormatContext *input = avformat_alloc_context();
+    input->interrupt_callback.callback = &StreamIngest::interruptCallback;
+    input->interrupt_callback.opaque = this;
+
+    AVDictionary *options = nullptr;
+    if (m_url.startsWith("rtsp://", Qt::CaseInsensitive)) {
+        av_dict_set(&options, "rtsp_transport", "tcp", 0);
+        av_dict_set(&options, "timeout", "5000000", 0);      // 微秒
+    } else {
+        av_dict_set(&options, "rw_timeout", "10000000", 0);  // 微秒
+    }
+
+    int ret = avformat_open_input(&input, m_url.toUtf8().constData(), nullptr, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        // 失敗時 avformat_open_input 會自行釋放 input
+        emit failed("無法開啟串流: " + avErrorString(ret));
+        return nullptr;
+    }
+
+    ret = avformat_find_stream_info(input, nullptr);
+    if (ret < 0) {
+        emit failed("無法讀取串流資訊: " + avErrorString(ret));
+        avformat_close_input(&input);
+        return nullptr;
+    }
+
+    return input;
+}
+
+void StreamIngest::applyPendingSinks(bool connected) {
+    QList<std::shared_ptr<SinkQueue>> adds;
+    QList<std::shared_ptr<SinkQueue>> removes;
+    {
+        // 斷線期間只處理移除（停止錄影不必等攝影機回來），新加入的等連上再開始
+        QMutexLocker locker(&m_sinkMutex);
+        if (connected) adds.swap(m_pendingAdds);
+        removes.swap(m_pendingRemoves);
+    }
+
+    for (const auto &sink : removes) {
+        if (m_sinks.removeAll(sink) > 0) sink->closeSink();
+    }
+    for (const auto &sink : adds) {
+        sink->openSink(m_layout);
+        // 錄影從預錄緩衝開始寫，觸發前的畫面也會進檔案
+        if (sink->wantsPreRoll())
+            m_preRoll.forEach([&sink](const AVPacket *packet) { sink->writePacket(packet); });
+        m_sinks.append(sink);
+    }
+}
+
+void StreamIngest::fixTimestamps(AVPacket *packet, const AVStream *stream) {
+    // MJPEG over HTTP 等來源沒有時間戳，用收到的時間補上
+    if (packet->pts == AV_NOPTS_VALUE && packet->dts == AV_NOPTS_VALUE) {
+        packet->dts = av_rescale_q(m_clock.nsecsElapsed() / 1000, AVRational{1, 1000000}, stream->time_base);
+        packet->pts = packet->dts;
+    } else if (packet->pts == AV_NOPTS_VALUE) {
+        packet->pts = packet->dts;
+    } else if (packet->dts == AV_NOPTS_VALUE) {
+        packet->dts = packet->pts;
+    }
+
+    // 確保 DTS 單調遞增，否則 muxer 會拒收
+    int64_t &last = m_lastDts[packet->stream_index];
+    if (last != AV_NOPTS_VALUE && packet->dts <= last) {
+        int64_t shift = last + 1 - packet->dts;
+        packet->dts += shift;
+        packet->pts = qMax(packet->pts, packet->dts);
+    }
+    last = packet->dts;
+}
+
+void StreamIngest::paceTo(const AVPacket *packet, const AVStream *stream) {
+    // 檔案或 VOD 來源依時間戳播放，模擬即時串流
+    int64_t ts = av_rescale_q(packet->dts, stream->time_base, AVRational{1, 1000});
+    if (m_paceStart == AV_NOPTS_VALUE) m_paceStart = ts - m_clock.elapsed();
+
+    qint64 ahead = ts - m_paceStart - m_clock.elapsed();
+    while (ahead > 0 && !m_stopRequested) {
+        msleep(qMin<qint64>(ahead, 50));
+        ahead = ts - m_paceStart - m_clock.elapsed();
+    }
+}
+
+void StreamIngest::bufferPreRoll(const AVPacket *packet, const AVStream *stream) {
+    int64_t duration = m_preRollSeconds * int64_t(AV_TIME_BASE);
+    qint64 maxBytes = m_preRollMaxBytes;
+    if (duration != m_preRoll.durationLimit() || maxBytes != m_preRoll.byteLimit())
+        m_preRoll.setLimits(duration, maxBytes);
+    if (duration <= 0) return;
+
+    AVMediaType type = m_layout[packet->stream_index].type;
+    if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO) return;
+
+    bool cutPoint = (m_videoIndex < 0 || packet->stream_index == m_videoIndex)
+                    && (packet->flags & AV_PKT_FLAG_KEY);
+    m_preRoll.push(packet, av_rescale_q(packet->dts, stream->time_base, AV_TIME_BASE_Q), cutPoint);
+}
+
+void StreamIngest::countPacket(AVPacket *packet) {
+    // 收到的時間跟著封包走（佇列複製時一併帶過去），顯示端用來算延遲
+    packet->opaque = reinterpret_cast<void *>(intptr_t(metricsClockUs()));
+
+    StreamMetrics::add(m_metrics->receivedBytes, packet->size);
+    StreamMetrics::add(m_metrics->receivedPackets, 1);
+    if (packet->stream_index == m_videoIndex) StreamMetrics::add(m_metrics->receivedFrames, 1);
+    if (m_metrics->receivedPackets.load(std::memory_order_relaxed) % kCpuSampleInterval == 0)
+        m_metrics->ingestCpuNs.store(threadCpuNanoseconds(), std::memory_order_relaxed);
+}
+
+bool StreamIngest::readSession() {
+    AVFormatContext *input = openInput();
+    if (!input) return false;
+
+    m_layout = makeIngestLayout(input);
+    m_lastDts = QVector<int64_t>(m_layout.size(), AV_NOPTS_VALUE);
+    m_videoIndex = findTrack(m_layout, AVMEDIA_TYPE_VIDEO);
+    // 有固定長度的來源（本地檔案、HTTP 上的 MP4）不是即時串流
+    m_paced = input->duration != AV_NOPTS_VALUE && input->duration > 0;
+    m_paceStart = AV_NOPTS_VALUE;
+    emit opened();
+    emit probed(probeLayout(m_layout, QString::fromUtf8(input->iformat->name)));
+    qDebug() << "擷取已連線:" << m_url << "軌道數:" << m_layout.size();
+
+    // 重連：已掛上的接收端以新的 layout 重新開始
+    for (const auto &sink : m_sinks) sink->openSink(m_layout);
+
+    bool ended = false;
+    AVPacket *packet = av_packet_alloc();
+    m_watchdogArmed = true;
+    while (!m_stopRequested) {
+        applyPendingSinks(true);
+
+        m_readStartMs = m_clock.elapsed();
+        int ret = av_read_frame(input, packet);
+        if (ret == AVERROR(EAGAIN)) continue;
+        if (ret < 0) {
+            if (m_stopRequested) break;
+            if (ret == AVERROR_EXIT)
+                emit failed(QString("超過 %1 秒沒有收到畫面").arg(m_stallTimeoutMs / 1000));
+            else
+                emit failed(ret == AVERROR_EOF ? "串流已結束" : "讀取串流失敗: " + avErrorString(ret));
+            // 檔案播完是正常結束，不重連
+            ended = ret == AVERROR_EOF && m_paced;
+            break;
+        }
+
+        if (packet->stream_index < m_layout.size()) {
+            const AVStream *stream = input->streams[packet->stream_index];
+            fixTimestamps(packet, stream);
+            if (m_paced) paceTo(packet, stream);
+            countPacket(packet);
+            bufferPreRoll(packet, stream);
+
+            for (const auto &sink : m_sinks) sink->writePacket(packet);
+        }
+        av_packet_unref(packet);
+    }
+    m_watchdogArmed = false;
+    m_metrics->ingestCpuNs.store(threadCpuNanoseconds(), std::memory_order_relaxed);
+    av_packet_free(&packet);
+    avformat_close_input(&input);
+
+    // 斷線前後的時間戳接不起來，預錄從重連後重新累積
+    m_preRoll.clear();
+    if (!ended && !m_stopRequested)
+        for (const auto &sink : m_sinks) sink->sinkInterrupted();
+    return ended;
+}
+
+void StreamIngest::waitBeforeReconnect(int delayMs) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!m_stopRequested && timer.elapsed() < delayMs) {
+        applyPendingSinks(false);
+        msleep(50);
+    }
+}
+
+void StreamIngest::run() {
+    m_clock.start();
+
+    int backoffMs = kInitialBackoffMs;
+    int attempt = 0;
+    while (!m_stopRequested) {
+        const qint64 sessionStart = m_clock.elapsed();
+        if (readSession() || m_stopRequested) break;
+
+        if (m_clock.elapsed() - sessionStart >= kStableSessionMs) {
+            backoffMs = kInitialBackoffMs;
+            attempt = 0;
+        }
+        emit reconnecting(++attempt, backoffMs);
+        qDebug() << "擷取將重新連線:" << m_url << "第" << attempt << "次，等待" << backoffMs << "ms";
+        waitBeforeReconnect(backoffMs);
+        backoffMs = qMin(backoffMs * 2, kMaxBackoffMs);
+    }
+
+    // 收尾：之後加入的接收端會在 addSink 直接關閉
+    {
+        QMutexLocker locker(&m_sinkMutex);
+        m_closed = true;
+        m_sinks.append(m_pendingAdds);
+        m_pendingAdds.clear();
+        m_pendingRemoves.clear();
+        m_queues.clear();
+    }
+    for (const auto &sink : m_sinks) sink->closeSink();
+    // 各接收端在自己的執行緒上同時收尾；全部寫完檔尾才結束，wait() 回來時檔案都已完整
+    for (const auto &sink : m_sinks) sink->wait();
+    m_sinks.clear();
+    qDebug() << "擷取已結束:" << m_url;
+}
@@ -0,0 +1,96 @@
+#ifndef STREAMINGEST_H
+#define STREAMINGEST_H
+
+#include <QThread>
+#include <QMutex>
+#include <QList>
+#include <QHash>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "ffmpegutils.h"
+#include "packetringbuffer.h"
+#include "streamprobe.h"
+#include "packetsink.h"
+#include "sinkqueue.h"
+#include "streammetrics.h"
+
+// 封包被擷取收到的實際時間（epoch 毫秒）：擷取在 opaque 記下收到時間，預錄緩衝重放的封包也帶著
+// 沒有記錄的封包（例如轉碼後的）回傳目前時間
+qint64 packetReceivedMs(const AVPacket *packet);
+
+// 每個攝影機一條擷取執行緒：只連線一次，把封包分送給所有接收端
+// 斷線或停滯時自動重連（間隔指數遞增），接收端保持掛著；檔案來源播完就結束
+class StreamIngest : public QThread {
+    Q_OBJECT
+public:
+    explicit StreamIngest(const QString &url, QObject *parent = nullptr);
+    ~StreamIngest() override;
+
+    QString url() const { return m_url; }
+
+    // 以下三個方法可在任何執行緒呼叫，且不會阻塞
+    // 每個接收端各自掛一個 SinkQueue，慢的接收端只影響自己的佇列
+    void addSink(const std::shared_ptr<PacketSink> &sink);
+    void removeSink(const std::shared_ptr<PacketSink> &sink);
+    void stop();
+
+    // 各接收端佇列目前的深度與丟棄/等待次數；任何執行緒皆可
+    QVector<SinkQueueStats> queueStats() const;
+    // 這一路的效能計數器，接收端可一併累加；任何執行緒皆可
+    const std::shared_ptr<StreamMetrics> &metrics() const { return m_metrics; }
+
+    // 預錄緩衝長度與單路記憶體上限，0 秒表示不預錄
+    void setPreRoll(int seconds, qint64 maxBytes);
+    // 連續幾秒沒有收到封包就視為斷線
+    void setStallTimeout(int seconds) { m_stallTimeoutMs = seconds * 1000; }
+
+signals:
+    void opened();
+    void probed(const StreamProbe &probe);   // 開啟來源時附帶的探測結果
+    void failed(const QString &error);
+    void reconnecting(int attempt, int delayMs);   // 斷線後等待 delayMs 再重連
+
+protected:
+    void run() override;
+
+private:
+    static int interruptCallback(void *opaque);
+    AVFormatContext *openInput();
+    bool readSession();
+    void waitBeforeReconnect(int delayMs);
+    void applyPendingSinks(bool connected);
+    void fixTimestamps(AVPacket *packet, const AVStream *stream);
+    void paceTo(const AVPacket *packet, const AVStream *stream);
+    void countPacket(AVPacket *packet);
+    void bufferPreRoll(const AVPacket *packet, const AVStream *stream);
+
+    QString m_url;
+    std::atomic_bool m_stopRequested{false};
+    std::atomic_int m_preRollSeconds{0};
+    std::atomic<qint64> m_preRollMaxBytes{0};
+    std::atomic_int m_stallTimeoutMs{10000};
+    const std::shared_ptr<StreamMetrics> m_metrics = std::make_shared<StreamMetrics>();
+
+    mutable QMutex m_sinkMutex;
+    QHash<PacketSink *, std::shared_ptr<SinkQueue>> m_queues;   // 目前掛著的接收端 -> 它的佇列
+    QList<std::shared_ptr<SinkQueue>> m_pendingAdds;
+    QList<std::shared_ptr<SinkQueue>> m_pendingRemoves;
+    bool m_closed = false;
+
+    // 以下只在擷取執行緒使用
+    QList<std::shared_ptr<SinkQueue>> m_sinks;
+    IngestLayout m_layout;
+    QElapsedTimer m_clock;
+    bool m_paced = false;
+    int64_t m_paceStart = AV_NOPTS_VALUE;
+    QVector<int64_t> m_lastDts;
+    PacketRingBuffer m_preRoll;
+    int m_videoIndex = -1;
+    bool m_watchdogArmed = false;
+    qint64 m_readStartMs = 0;
+};
+
+#endif // STREAMINGEST_H
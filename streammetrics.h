@@ -0,0 +1,32 @@
+#ifndef STREAMMETRICS_H
+#define STREAMMETRICS_H
+
+#include <QtGlobal>
+#include <atomic>
+
+// 一路串流的效能計數器：各執行緒只做 relaxed 累加，不上鎖
+// 全部是單調遞增的累計值（latencyUs 除外），由 MetricsSampler 定時取差值換算成速率
+// 由 StreamIngest 擁有，接收端以 shared_ptr 持有，擷取先結束也不會懸空
+struct StreamMetrics {
+    std::atomic<qint64> receivedBytes{0};
+    std::atomic<qint64> receivedPackets{0};
+    std::atomic<qint64> receivedFrames{0};      // 影像軌道的封包數
+    std::atomic<qint64> decodedFrames{0};
+    std::atomic<qint64> displayedFrames{0};
+    std::atomic<qint64> droppedFrames{0};       // 解出來卻沒顯示：畫面佇列滿或被更新的一張蓋掉
+    std::atomic<qint64> latencyUs{-1};          // 最近一張畫面從收到封包到顯示的時間，-1 表示還沒有
+    std::atomic<qint64> recordedBytes{0};       // 錄影實際寫進磁碟的位元組
+    std::atomic<qint64> ingestCpuNs{0};         // 擷取執行緒累計 CPU 時間
+    std::atomic<qint64> transcodeCpuNs{0};      // 錄影轉碼工作累計 CPU 時間
+
+    static void add(std::atomic<qint64> &counter, qint64 value) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+};
+
+// 單調時鐘（微秒），收到封包與顯示畫面用同一個時鐘計算延遲
+qint64 metricsClockUs();
+// 目前執行緒累計使用的 CPU 時間（奈秒）；平台不支援時回傳 0
+qint64 threadCpuNanoseconds();
+
+#endif // STREAMMETRICS_H
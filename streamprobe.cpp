@@ -0,0 +1,108 @@
+#include "streamprobe.h"
+#include <QStringList>
+
+QString StreamProbe::summary() const {
+    if (!valid) return "尚未連線";
+
+    QStringList parts;
+    if (videoCodec != AV_CODEC_ID_NONE)
+        parts << QString("%1 %2x%3 %4fps").arg(avcodec_get_name(videoCodec))
+                     .arg(width).arg(height).arg(frameRate, 0, 'f', 1);
+    if (audioCodec != AV_CODEC_ID_NONE)
+        parts << QString("%1 %2Hz %3ch").arg(avcodec_get_name(audioCodec))
+                     .arg(sampleRate).arg(channels);
+    return formatName + ": " + parts.join(" / ");
+}
+
+StreamProbe probeLayout(const IngestLayout &layout, const QString &formatName) {
+    StreamProbe probe;
+    probe.valid = true;
+    probe.formatName = formatName;
+
+    int videoIndex = findTrack(layout, AVMEDIA_TYPE_VIDEO);
+    if (videoIndex >= 0) {
+        const IngestTrack &track = layout[videoIndex];
+        probe.videoCodec = track.codecpar->codec_id;
+        probe.width = track.codecpar->width;
+        probe.height = track.codecpar->height;
+        if (track.frameRate.num > 0 && track.frameRate.den > 0)
+            probe.frameRate = av_q2d(track.frameRate);
+    }
+
+    int audioIndex = findTrack(layout, AVMEDIA_TYPE_AUDIO);
+    if (audioIndex >= 0) {
+        const IngestTrack &track = layout[audioIndex];
+        probe.audioCodec = track.codecpar->codec_id;
+        probe.sampleRate = track.codecpar->sample_rate;
+        probe.channels = track.codecpar->ch_layout.nb_channels;
+    }
+    return probe;
+}
+
+RecordingProfile::Mode RecordingProfile::modeFor(int trackIndex) const {
+    if (trackIndex < 0) return Drop;
+    if (trackIndex == videoIndex) return video;
+    if (trackIndex == audioIndex) return audio;
+    return Drop;
+}
+
+QString RecordingProfile::summary() const {
+    auto describe = [](Mode mode, const char *transcodeTarget) -> QString {
+        switch (mode) {
+        case Copy: return "複製";
+        case Transcode: return QString("轉 %1").arg(transcodeTarget);
+        case Drop: break;
+        }
+        return "不錄";
+    };
+    return "影像" + describe(video, "H.264") + " / 音訊" + describe(audio, "AAC");
+}
+
+// 容器能否直接放入此編碼
+static bool fitsContainer(const AVOutputFormat *format, AVCodecID codecId) {
+    // MJPEG、原始畫面雖然某些容器收得下，但檔案過大且多數播放器不支援，一律轉碼
+    if (codecId == AV_CODEC_ID_MJPEG || codecId == AV_CODEC_ID_RAWVIDEO) return false;
+
+    int supported = avformat_query_codec(format, codecId, FF_COMPLIANCE_NORMAL);
+    if (supported >= 0) return supported == 1;
+
+    // 沒有提供查詢的 muxer（例如 mpegts）只收常見的廣播編碼
+    switch (codecId) {
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_HEVC:
+    case AV_CODEC_ID_MPEG2VIDEO:
+    case AV_CODEC_ID_AAC:
+    case AV_CODEC_ID_MP2:
+    case AV_CODEC_ID_MP3:
+    case AV_CODEC_ID_AC3:
+        return true;
+    default:
+        return false;
+    }
+}
+
+RecordingProfile chooseRecordingProfile(const IngestLayout &layout, const char *containerFormat) {
+    RecordingProfile profile;
+    const AVOutputFormat *format = av_guess_format(containerFormat, nullptr, nullptr);
+    if (!format) return profile;
+
+    profile.videoIndex = findTrack(layout, AVMEDIA_TYPE_VIDEO);
+    if (profile.videoIndex >= 0) {
+        AVCodecID codecId = layout[profile.videoIndex].codecpar->codec_id;
+        if (fitsContainer(format, codecId))
+            profile.video = RecordingProfile::Copy;
+        else if (avcodec_find_decoder(codecId))
+            profile.video = RecordingProfile::Transcode;
+    }
+
+    profile.audioIndex = findTrack(layout, AVMEDIA_TYPE_AUDIO);
+    if (profile.audioIndex >= 0) {
+        AVCodecID codecId = layout[profile.audioIndex].codecpar->codec_id;
+        if (fitsContainer(format, codecId))
+            profile.audio = RecordingProfile::Copy;
+        else if (avcodec_find_decoder(codecId))
+            profile.audio = RecordingProfile::Transcode;
+    }
+
+    return profile;
+}
@@ -0,0 +1,43 @@
+#ifndef STREAMPROBE_H
+#define STREAMPROBE_H
+
+#include <QString>
+
+#include "ffmpegutils.h"
+
+// 來源探測結果：擷取開啟時順便取得，不另外連線
+struct StreamProbe {
+    bool valid = false;
+    QString formatName;
+
+    AVCodecID videoCodec = AV_CODEC_ID_NONE;
+    int width = 0;
+    int height = 0;
+    double frameRate = 0;
+
+    AVCodecID audioCodec = AV_CODEC_ID_NONE;
+    int sampleRate = 0;
+    int channels = 0;
+
+    QString summary() const;
+};
+
+StreamProbe probeLayout(const IngestLayout &layout, const QString &formatName);
+
+// 錄影方式：能直接複製就複製，容器放不進去才轉碼
+struct RecordingProfile {
+    enum Mode { Copy, Transcode, Drop };
+
+    Mode video = Drop;
+    Mode audio = Drop;
+    int videoIndex = -1;
+    int audioIndex = -1;
+
+    Mode modeFor(int trackIndex) const;
+    QString summary() const;
+};
+
+// containerFormat 為 libavformat 的 muxer 名稱，例如 "mp4"、"mpegts"
+RecordingProfile chooseRecordingProfile(const IngestLayout &layout, const char *containerFormat);
+
+#endif // STREAMPROBE_H
@@ -0,0 +1,455 @@
+#include "streamrecorder.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDebug>
+
+// 還不知道碼率時（第一段）先預留這麼多
+static const qint64 kInitialReserveBytes = 32LL * 1024 * 1024;
+// 每路最多排這麼多個封包等轉碼，再多就讓佇列執行緒等，錄影不能丟封包
+static const int kMaxPendingTranscodes = 32;
+// 切分段時最多等其他軌道多久越過切點，超過就直接切（例如音訊停了）
+static const int64_t kMaxCutWaitUs = AV_TIME_BASE;
+
+StreamRecorder::StreamRecorder(const QString &directory, const QString &tag,
+                               const RecorderOptions &options, QObject *parent)
+    : QObject(parent), m_directory(directory), m_tag(tag), m_options(options) {
+    m_packet = av_packet_alloc();
+    m_segmentFile.setWriteCounter(&m_metrics->recordedBytes);
+}
+
+StreamRecorder::~StreamRecorder() {
+    m_transcodeStrand.waitIdle();
+    discardEncoded();
+    discardCutBacklog();
+    releaseOutput();
+    av_packet_free(&m_packet);
+}
+
+void StreamRecorder::setMetrics(const std::shared_ptr<StreamMetrics> &metrics) {
+    m_metrics = metrics;
+    m_segmentFile.setWriteCounter(&m_metrics->recordedBytes);
+}
+
+QString StreamRecorder::nextFilePath(qint64 startMs) const {
+    const QString base = m_directory + "/REC_" + QDateTime::fromMSecsSinceEpoch(startMs).toString("yyyyMMdd_HHmmss")
+                         + "_" + m_tag;
+    // 移動錄影的預錄可能和上一段落在同一秒，不覆蓋已有的檔案
+    QString path = base + m_options.fileExtension();
+    for (int i = 1; QFileInfo::exists(path); ++i) path = base + "_" + QString::number(i) + m_options.fileExtension();
+    return path;
+}
+
+void StreamRecorder::releaseOutput() {
+    m_keyframes.close();
+    if (!m_output) return;
+    m_output->pb = nullptr;
+    m_segmentFile.close();
+    avformat_free_context(m_output);
+    m_output = nullptr;
+}
+
+void StreamRecorder::fail(const QString &error) {
+    if (m_error.isEmpty()) m_error = error;
+    qDebug() << "錄影失敗:" << m_filePath << error;
+
+    // 已寫過檔頭的分段照樣回報，fMP4/TS 寫到哪裡都還能播
+    bool segmentOpen = m_output && !m_files.isEmpty() && m_files.last() == m_filePath;
+    releaseOutput();
+    if (segmentOpen) finishSegment();
+}
+
+void StreamRecorder::finishSegment() {
+    RecordedSegment segment;
+    segment.filePath = m_filePath;
+    segment.startMs = m_segmentStartMs;
+    if (m_segmentEnd != AV_NOPTS_VALUE) segment.durationMs = (m_segmentEnd - m_segmentStart) / 1000;
+    segment.bytes = QFileInfo(m_filePath).size();
+    segment.codec = m_segmentCodec;
+    segment.motion = takeMotionEvents(segment.startMs + segment.durationMs);
+
+    if (segment.durationMs >= 1000) m_bytesPerSecond = segment.bytes * 1000 / segment.durationMs;
+
+    m_totalBytes += segment.bytes;
+    emit segmentFinished(segment);
+}
+
+qint64 StreamRecorder::reserveBytes() const {
+    if (!m_options.preallocate) return 0;
+    if (m_bytesPerSecond <= 0 || m_options.segmentSeconds <= 0) return kInitialReserveBytes;
+    // 多留一成，碼率稍微上升也不必中途再預留
+    return m_bytesPerSecond * m_options.segmentSeconds * 11 / 10;
+}
+
+void StreamRecorder::beginMotionEvent(qint64 timeMs) {
+    QMutexLocker locker(&m_motionMutex);
+    if (m_motionSince < 0) m_motionSince = timeMs;
+}
+
+void StreamRecorder::endMotionEvent(qint64 timeMs, int peak) {
+    QMutexLocker locker(&m_motionMutex);
+    if (m_motionSince < 0) return;
+    m_motionEvents.append({m_motionSince, qMax(m_motionSince, timeMs), peak});
+    m_motionSince = -1;
+}
+
+QVector<MotionEvent> StreamRecorder::takeMotionEvents(qint64 segmentEndMs) {
+    QMutexLocker locker(&m_motionMutex);
+    QVector<MotionEvent> events;
+    QVector<MotionEvent> later;
+    for (const MotionEvent &event : std::as_const(m_motionEvents)) {
+        if (event.startMs >= segmentEndMs) {
+            later.append(event);
+            continue;
+        }
+        MotionEvent head = event;
+        if (event.endMs > segmentEndMs) {
+            head.endMs = segmentEndMs;
+            later.append({segmentEndMs, event.endMs, event.peak});
+        }
+        events.append(head);
+    }
+    m_motionEvents = later;
+
+    // 還沒結束的移動先記到分段結尾，其餘留給下一段
+    if (m_motionSince >= 0 && m_motionSince < segmentEndMs) {
+        events.append({m_motionSince, segmentEndMs, 0});
+        m_motionSince = segmentEndMs;
+    }
+    return events;
+}
+
+void StreamRecorder::openSink(const IngestLayout &layout) {
+    // 舊的轉碼器可能還在池裡跑，等跑完才能換掉
+    m_transcodeStrand.waitIdle();
+    discardEncoded();
+    discardCutBacklog();
+    m_layout = layout;
+    m_hasWallClock = false;     // 重連後時間戳重新起算
+    m_tracks.clear();
+    m_tracks.resize(layout.size());
+
+    // 只看探測結果決定，不再用網址猜來源格式
+    RecordingProfile profile = chooseRecordingProfile(layout, m_options.formatName());
+    const bool globalHeader = m_options.container != RecorderOptions::MpegTs;
+    int outputCount = 0;
+
+    for (const IngestTrack &track : layout) {
+        RecordingProfile::Mode mode = profile.modeFor(track.index);
+        Track &state = m_tracks[track.index];
+
+        if (mode == RecordingProfile::Transcode) {
+            QString error;
+            state.transcoder = std::make_unique<TrackTranscoder>();
+            if (!state.transcoder->open(track, globalHeader, &error)) {
+                qDebug() << "無法轉碼，略過軌道:" << avcodec_get_name(track.codecpar->codec_id) << error;
+                state.transcoder.reset();
+                if (track.index == profile.videoIndex) profile.video = RecordingProfile::Drop;
+                else profile.audio = RecordingProfile::Drop;
+                continue;
+            }
+            state.timeBase = state.transcoder->outputTimeBase();
+            state.codecpar = state.transcoder->outputParameters();
+        } else if (mode == RecordingProfile::Copy) {
+            state.timeBase = track.timeBase;
+            state.codecpar = track.codecpar.get();
+        } else {
+            continue;
+        }
+        state.output = outputCount++;
+    }
+
+    m_videoIndex = profile.video != RecordingProfile::Drop ? profile.videoIndex : -1;
+    emit profileSelected(profile.summary());
+    qDebug() << "錄影方式:" << m_tag << profile.summary();
+
+    if (outputCount == 0) fail("來源沒有可錄製的軌道");
+    m_lastBusyNs = 0;
+    m_loadClock.start();
+}
+
+bool StreamRecorder::openOutput(int64_t startTime) {
+    // 分段起點以第一個寫入的封包為準，含預錄時比開始錄影的時刻早
+    const qint64 startMs = m_hasWallClock ? m_wallClockOffsetMs + startTime / 1000
+                                          : QDateTime::currentMSecsSinceEpoch();
+    const QDateTime start = QDateTime::fromMSecsSinceEpoch(startMs);
+    m_filePath = nextFilePath(startMs);
+    QByteArray path = m_filePath.toUtf8();
+
+    int ret = avformat_alloc_output_context2(&m_output, nullptr, m_options.formatName(), path.constData());
+    if (ret < 0) {
+        fail("無法建立錄影輸出: " + avErrorString(ret));
+        return false;
+    }
+
+    QStringList codecs;
+    for (const Track &track : m_tracks) {
+        if (track.output < 0) continue;
+        codecs << avcodec_get_name(track.codecpar->codec_id);
+        AVStream *out = avformat_new_stream(m_output, nullptr);
+        avcodec_parameters_copy(out->codecpar, track.codecpar);
+        out->codecpar->codec_tag = 0;
+        out->time_base = track.timeBase;
+    }
+
+    // 自己開檔：預留空間後交給 muxer 寫
+    QString ioError;
+    if (!m_segmentFile.open(m_filePath, reserveBytes(), &ioError)) {
+        fail("無法寫入檔案: " + ioError);
+        return false;
+    }
+    m_output->pb = m_segmentFile.io();
+    m_output->flags |= AVFMT_FLAG_CUSTOM_IO;
+    if (!m_keyframes.open(m_filePath)) qDebug() << "無法建立關鍵幀索引:" << m_filePath;
+
+    // 分段開始的實際時間；斷線後的第一段另外記下空檔
+    av_dict_set(&m_output->metadata, "creation_time",
+                start.toUTC().toString(Qt::ISODateWithMs).toUtf8().constData(), 0);
+    if (m_gapStart.isValid()) {
+        QString gap = "gap " + m_gapStart.toString(Qt::ISODate) + "/" + start.toString(Qt::ISODate);
+        av_dict_set(&m_output->metadata, "comment", gap.toUtf8().constData(), 0);
+    }
+
+    // fMP4 每個關鍵幀寫一個 fragment：關檔不必回頭改寫，寫到一半也能播放
+    AVDictionary *options = nullptr;
+    if (m_options.container == RecorderOptions::FragmentedMp4)
+        av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+
+    ret = avformat_write_header(m_output, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        fail("寫入檔頭失敗: " + avErrorString(ret));
+        return false;
+    }
+
+    m_segmentStart = startTime;
+    m_segmentEnd = AV_NOPTS_VALUE;
+    m_segmentStartMs = startMs;
+    m_segmentCodec = codecs.join(" / ");
+    m_lastDts = QVector<int64_t>(int(m_output->nb_streams), AV_NOPTS_VALUE);
+
+    if (m_gapStart.isValid()) {
+        qDebug() << "錄影空檔:" << m_tag << m_gapStart << "~" << start;
+        emit gapRecorded(m_gapStart, start);
+        m_gapStart = QDateTime();
+    }
+
+    if (m_files.isEmpty()) emit started(m_filePath);
+    m_files << m_filePath;
+    return true;
+}
+
+void StreamRecorder::closeOutput() {
+    if (!m_output) return;
+
+    int ret = av_write_trailer(m_output);
+    if (ret < 0) qDebug() << "寫入檔尾失敗:" << m_filePath << avErrorString(ret);
+    releaseOutput();
+    finishSegment();
+}
+
+void StreamRecorder::writePacket(const AVPacket *packet) {
+    if (!m_error.isEmpty() || packet->stream_index >= int(m_tracks.size())) return;
+    const int trackIndex = packet->stream_index;
+    m_lastPacketMs = packetReceivedMs(packet);
+    if (packet->dts != AV_NOPTS_VALUE) {
+        m_wallClockOffsetMs = m_lastPacketMs - av_rescale_q(packet->dts, m_layout[trackIndex].timeBase, AVRational{1, 1000});
+        m_hasWallClock = true;
+    }
+
+    Track &track = m_tracks[trackIndex];
+    if (track.output < 0) return;
+
+    if (track.transcoder) {
+        m_transcodeStrand.waitBelow(kMaxPendingTranscodes);
+        TrackTranscoder *transcoder = track.transcoder.get();
+        AVPacket *input = av_packet_clone(packet);
+        if (input) {
+            m_transcodeStrand.post([this, transcoder, trackIndex, input]() mutable {
+                // 池裡的執行緒輪流跑各路的工作，只算這一段的 CPU 時間
+                const qint64 cpuStart = threadCpuNanoseconds();
+                transcoder->transcode(input, [this, trackIndex](const AVPacket *encoded) {
+                    queueEncoded(trackIndex, encoded);
+                });
+                av_packet_free(&input);
+                StreamMetrics::add(m_metrics->transcodeCpuNs, threadCpuNanoseconds() - cpuStart);
+            });
+        }
+        reportTranscodeLoad();
+    } else {
+        writeTrackPacket(trackIndex, packet);
+    }
+    writeEncoded();
+}
+
+void StreamRecorder::queueEncoded(int trackIndex, const AVPacket *packet) {
+    AVPacket *copy = av_packet_clone(packet);
+    if (!copy) return;
+    QMutexLocker locker(&m_encodedMutex);
+    m_encoded.append({trackIndex, copy});
+}
+
+void StreamRecorder::writeEncoded() {
+    QVector<std::pair<int, AVPacket *>> encoded;
+    {
+        QMutexLocker locker(&m_encodedMutex);
+        encoded.swap(m_encoded);
+    }
+    for (auto &[trackIndex, packet] : encoded) {
+        writeTrackPacket(trackIndex, packet);
+        av_packet_free(&packet);
+    }
+}
+
+void StreamRecorder::discardEncoded() {
+    QMutexLocker locker(&m_encodedMutex);
+    for (auto &entry : m_encoded) av_packet_free(&entry.second);
+    m_encoded.clear();
+}
+
+void StreamRecorder::writeTrackPacket(int trackIndex, const AVPacket *packet) {
+    if (!m_error.isEmpty()) return;
+
+    const Track &track = m_tracks[trackIndex];
+    AVRational inTb = track.timeBase;
+    int64_t time = av_rescale_q(packet->dts, inTb, AV_TIME_BASE_Q);
+    bool cutPoint = (m_videoIndex < 0 || trackIndex == m_videoIndex)
+                    && (packet->flags & AV_PKT_FLAG_KEY);
+
+    if (m_pendingCut != AV_NOPTS_VALUE) {
+        // 切點之前的封包（晚到的音訊）照樣寫進舊分段，保留原本的間隔
+        if (time >= m_pendingCut) {
+            holdForCut(trackIndex, packet);
+            if (allTracksPastCut() || time - m_pendingCut >= kMaxCutWaitUs) completeCut();
+            return;
+        }
+    } else if (!m_output) {
+        // 從第一個關鍵幀開始錄，檔案開頭才能正常解碼
+        if (!cutPoint || !openOutput(time)) return;
+    } else if (cutPoint && m_options.segmentSeconds > 0
+               && time - m_segmentStart >= m_options.segmentSeconds * int64_t(AV_TIME_BASE)) {
+        // 關鍵幀先不開新檔，等其他軌道也越過切點
+        m_pendingCut = time;
+        m_pastCut = QVector<bool>(int(m_tracks.size()), false);
+        holdForCut(trackIndex, packet);
+        if (allTracksPastCut()) completeCut();
+        return;
+    }
+
+    int64_t offset = av_rescale_q(m_segmentStart, AV_TIME_BASE_Q, inTb);
+    if (packet->dts < offset) return;  // 比分段起點還早的音訊，等切點時已經過了上限
+    m_segmentEnd = qMax(m_segmentEnd, av_rescale_q(packet->dts + packet->duration, inTb, AV_TIME_BASE_Q));
+
+    if (av_packet_ref(m_packet, packet) < 0) return;
+    m_packet->stream_index = track.output;
+    m_packet->pts -= offset;
+    m_packet->dts -= offset;
+    m_packet->pos = -1;
+
+    if (cutPoint) {
+        int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        m_keyframes.append(av_rescale_q(pts - offset, inTb, AVRational{1, 1000}), avio_tell(m_output->pb));
+    }
+
+    AVStream *stream = m_output->streams[track.output];
+    av_packet_rescale_ts(m_packet, inTb, stream->time_base);
+
+    int64_t &last = m_lastDts[track.output];
+    if (last != AV_NOPTS_VALUE && m_packet->dts <= last) {
+        m_packet->dts = last + 1;
+        m_packet->pts = qMax(m_packet->pts, m_packet->dts);
+    }
+    last = m_packet->dts;
+
+    int ret = av_interleaved_write_frame(m_output, m_packet);
+    if (ret < 0) {
+        av_packet_unref(m_packet);
+        fail("寫入失敗: " + avErrorString(ret));
+    }
+}
+
+void StreamRecorder::reportTranscodeLoad() {
+    // 每 2 秒回報一次轉碼佔用比例
+    qint64 elapsed = m_loadClock.nsecsElapsed();
+    if (elapsed < 2000000000LL) return;
+
+    qint64 busy = 0;
+    for (const Track &track : m_tracks)
+        if (track.transcoder) busy += track.transcoder->busyNanoseconds();
+
+    emit transcodeLoad(100.0 * (busy - m_lastBusyNs) / elapsed);
+    m_lastBusyNs = busy;
+    m_loadClock.restart();
+}
+
+void StreamRecorder::holdForCut(int trackIndex, const AVPacket *packet) {
+    m_pastCut[trackIndex] = true;
+    AVPacket *copy = av_packet_clone(packet);
+    if (copy) m_cutBacklog.append({trackIndex, copy});
+}
+
+bool StreamRecorder::allTracksPastCut() const {
+    for (size_t i = 0; i < m_tracks.size(); ++i)
+        if (m_tracks[i].output >= 0 && !m_pastCut[int(i)]) return false;
+    return true;
+}
+
+void StreamRecorder::completeCut() {
+    const int64_t cut = m_pendingCut;
+    m_pendingCut = AV_NOPTS_VALUE;
+    QVector<std::pair<int, AVPacket *>> backlog;
+    backlog.swap(m_cutBacklog);
+
+    closeOutput();
+    const bool opened = openOutput(cut);
+    // 第一個是切點的關鍵幀，新分段從它開始
+    for (auto &[trackIndex, packet] : backlog) {
+        if (opened) writeTrackPacket(trackIndex, packet);
+        av_packet_free(&packet);
+    }
+}
+
+void StreamRecorder::discardCutBacklog() {
+    m_pendingCut = AV_NOPTS_VALUE;
+    for (auto &entry : m_cutBacklog) av_packet_free(&entry.second);
+    m_cutBacklog.clear();
+}
+
+void StreamRecorder::flushTranscoders() {
+    // 把編碼器裡剩下的畫面寫完，等池裡這一路的工作都跑完再寫檔
+    for (size_t i = 0; i < m_tracks.size(); ++i) {
+        if (!m_tracks[i].transcoder) continue;
+        const int trackIndex = int(i);
+        TrackTranscoder *transcoder = m_tracks[i].transcoder.get();
+        m_transcodeStrand.post([this, transcoder, trackIndex]() {
+            transcoder->flush([this, trackIndex](const AVPacket *encoded) {
+                queueEncoded(trackIndex, encoded);
+            });
+        });
+    }
+    m_transcodeStrand.waitIdle();
+    writeEncoded();
+}
+
+void StreamRecorder::sinkInterrupted() {
+    // 已經開始錄才算空檔；重連後 openSink 會重建轉碼器，下一個關鍵幀開新分段
+    flushTranscoders();
+    if (m_pendingCut != AV_NOPTS_VALUE) completeCut();
+    closeOutput();
+    // 停滯偵測要等幾秒才觸發，空檔從最後一個封包算起
+    if (!m_files.isEmpty() && !m_gapStart.isValid())
+        m_gapStart = QDateTime::fromMSecsSinceEpoch(m_lastPacketMs);
+}
+
+void StreamRecorder::closeSink() {
+    flushTranscoders();
+    if (m_pendingCut != AV_NOPTS_VALUE) completeCut();
+    closeOutput();
+
+    if (m_error.isEmpty() && m_files.isEmpty())
+        m_error = "沒有收到任何畫面";
+
+    if (m_error.isEmpty())
+        emit finished(m_files, m_totalBytes);
+    else
+        emit failed(m_error);
+}
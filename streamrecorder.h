@@ -0,0 +1,155 @@
+#ifndef STREAMRECORDER_H
+#define STREAMRECORDER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QMutex>
+#include <memory>
+#include <vector>
+
+#include "streamingest.h"
+#include "streamprobe.h"
+#include "tracktranscoder.h"
+#include "transcodepool.h"
+#include "keyframeindex.h"
+#include "recordingindex.h"
+#include "segmentfile.h"
+#include "streammetrics.h"
+
+// 錄影設定
+struct RecorderOptions {
+    enum Container { FragmentedMp4, MpegTs, Mp4 };
+
+    Container container = FragmentedMp4;
+    int segmentSeconds = 300;   // 0 表示不分段，一直寫同一個檔案
+    bool preallocate = true;    // 開檔時依上一段的大小先預留磁碟空間
+
+    QString fileExtension() const { return container == MpegTs ? ".ts" : ".mp4"; }
+    const char *formatName() const { return container == MpegTs ? "mpegts" : "mp4"; }
+};
+
+// 寫完的一個分段
+struct RecordedSegment {
+    QString filePath;
+    qint64 startMs = 0;         // 分段開始的實際時間（epoch 毫秒）
+    qint64 durationMs = 0;      // 依封包時間戳計算
+    qint64 bytes = 0;
+    QString codec;              // 各軌道編碼，例如 "h264 / aac"
+    QVector<MotionEvent> motion;    // 這個分段期間的移動事件
+};
+
+// 錄影接收端：把擷取到的封包 remux 成檔案，不另外連線
+// 依來源編碼自動選擇錄影方式，容器放得下就直接複製，放不下的軌道才轉碼
+// 轉碼在所有攝影機共用的 TranscodePool 上跑，寫檔仍在自己的佇列執行緒
+// 分段模式下在關鍵幀切檔，下一段從同一個關鍵幀開始，不漏畫面
+// 每個分段旁邊另寫一份關鍵幀索引，播放時用來快速跳轉
+// 來源斷線時先收掉目前分段，重連後從第一個關鍵幀開新分段，中斷時間寫進新分段的 metadata
+class StreamRecorder : public QObject, public PacketSink {
+    Q_OBJECT
+public:
+    // 檔名為 <directory>/REC_<分段開始時間>_<tag><副檔名>
+    StreamRecorder(const QString &directory, const QString &tag,
+                   const RecorderOptions &options = RecorderOptions(), QObject *parent = nullptr);
+    ~StreamRecorder() override;
+
+    void openSink(const IngestLayout &layout) override;
+    void writePacket(const AVPacket *packet) override;
+    void closeSink() override;
+    void sinkInterrupted() override;
+    bool wantsPreRoll() const override { return true; }
+    QString sinkName() const override { return "錄影"; }
+
+    // 寫檔量與轉碼 CPU 累加到這裡（通常是來源擷取的計數器）；要在掛上擷取之前設定
+    void setMetrics(const std::shared_ptr<StreamMetrics> &metrics);
+
+    // 移動事件，任何執行緒皆可呼叫；跨分段的事件會切開，各分段各記一段
+    void beginMotionEvent(qint64 timeMs);
+    void endMotionEvent(qint64 timeMs, int peak);
+
+signals:
+    void profileSelected(const QString &summary);
+    void transcodeLoad(double percent);   // 轉碼佔用的時間比例，只有轉碼時才會發出
+    void started(const QString &filePath);
+    void segmentFinished(const RecordedSegment &segment);
+    void gapRecorded(const QDateTime &start, const QDateTime &end);   // 斷線造成的空檔
+    void finished(const QStringList &files, qint64 bytes);
+    void failed(const QString &error);
+
+private:
+    struct Track {
+        int output = -1;                // 輸出軌道，-1 表示不錄
+        AVRational timeBase{0, 1};      // 送進 muxer 的封包時間基準
+        const AVCodecParameters *codecpar = nullptr;
+        std::unique_ptr<TrackTranscoder> transcoder;
+    };
+
+    QString nextFilePath(qint64 startMs) const;
+    void writeTrackPacket(int trackIndex, const AVPacket *packet);
+    void holdForCut(int trackIndex, const AVPacket *packet);
+    bool allTracksPastCut() const;
+    void completeCut();
+    void discardCutBacklog();
+    void reportTranscodeLoad();
+    bool openOutput(int64_t startTime);
+    void closeOutput();
+    void flushTranscoders();
+    void queueEncoded(int trackIndex, const AVPacket *packet);
+    void writeEncoded();
+    void discardEncoded();
+    void finishSegment();
+    QVector<MotionEvent> takeMotionEvents(qint64 segmentEndMs);
+    void fail(const QString &error);
+    void releaseOutput();
+    qint64 reserveBytes() const;
+
+    QString m_directory;
+    QString m_tag;
+    RecorderOptions m_options;
+    IngestLayout m_layout;
+    QString m_error;
+
+    AVFormatContext *m_output = nullptr;
+    SegmentFile m_segmentFile;          // m_output 的 pb 由它提供
+    qint64 m_bytesPerSecond = 0;        // 上一段的平均碼率，估算下一段要預留多少
+    KeyframeIndexWriter m_keyframes;    // 與分段檔同名的 .kfi
+    AVPacket *m_packet = nullptr;
+    QString m_filePath;
+    int m_videoIndex = -1;
+
+    std::vector<Track> m_tracks;        // 依輸入軌道索引
+    TranscodeStrand m_transcodeStrand;  // 這一路所有轉碼軌道依序在池裡跑
+    QMutex m_encodedMutex;
+    QVector<std::pair<int, AVPacket *>> m_encoded;  // 轉碼好、等著寫檔的封包（輸入軌道索引）
+    QVector<int64_t> m_lastDts;         // 輸出時間基準下
+    int64_t m_segmentStart = AV_NOPTS_VALUE; // 微秒，目前分段的起點
+    int64_t m_segmentEnd = AV_NOPTS_VALUE;   // 微秒，目前分段寫到的最後時間
+    // 切分段：關鍵幀到了先不關舊檔，等每個軌道都越過切點；之前的封包還寫進舊檔，之後的先暫存
+    int64_t m_pendingCut = AV_NOPTS_VALUE;   // 微秒，沒有等待中的切點時為 AV_NOPTS_VALUE
+    QVector<bool> m_pastCut;                 // 依輸入軌道索引，是否已收到切點之後的封包
+    QVector<std::pair<int, AVPacket *>> m_cutBacklog;   // 切點之後暫存的封包（輸入軌道索引）
+    qint64 m_segmentStartMs = 0;
+    QString m_segmentCodec;
+
+    QDateTime m_gapStart;               // 斷線時間，重連後寫進下一個分段
+    qint64 m_lastPacketMs = 0;          // 最後收到封包的時間（epoch 毫秒）
+    // 來源時間戳換算成實際時間：最新一個封包的收到時間減去它的時間戳（毫秒）
+    // 預錄重放的封包帶著原本的收到時間，分段起點因此是第一個寫入畫面的時間，不是開始錄的時間
+    qint64 m_wallClockOffsetMs = 0;
+    bool m_hasWallClock = false;
+
+    QMutex m_motionMutex;
+    qint64 m_motionSince = -1;              // 進行中的移動從何時開始，-1 表示沒有
+    QVector<MotionEvent> m_motionEvents;    // 已結束、還沒歸進分段的事件
+
+    QStringList m_files;
+    qint64 m_totalBytes = 0;
+
+    std::shared_ptr<StreamMetrics> m_metrics = std::make_shared<StreamMetrics>();
+    QElapsedTimer m_loadClock;
+    qint64 m_lastBusyNs = 0;
+};
+
+#endif // STREAMRECORDER_H
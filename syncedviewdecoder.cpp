@@ -0,0 +1,264 @@
+#include "syncedviewdecoder.h"
+#include "syncplayback.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+// 佇列只放幾張，跳轉時丟掉的解碼量少
+static const size_t kQueueFrames = 6;
+// 落後時鐘超過這麼多（媒體時間）就不解後面的非關鍵幀
+static const qint64 kLateMs = 1000;
+
+SyncedViewDecoder::SyncedViewDecoder(const QString &directory, const QVector<RecordingEntry> &segments,
+                                     const PlaybackClock *clock, QObject *parent)
+    : QThread(parent), m_directory(directory), m_segments(segments), m_clock(clock) {
+}
+
+SyncedViewDecoder::~SyncedViewDecoder() {
+    stop();
+    wait();
+}
+
+void SyncedViewDecoder::seek(qint64 timeMs) {
+    QMutexLocker locker(&m_mutex);
+    m_pendingSeek = timeMs;
+    ++m_generation;
+    m_queue.clear();
+    m_primed = false;
+    m_wake.wakeOne();
+}
+
+void SyncedViewDecoder::setKeyframesOnly(bool enabled) {
+    m_keyframesOnly = enabled;
+}
+
+void SyncedViewDecoder::setMaxOutputSize(const QSize &size) {
+    m_maxWidth = size.isValid() ? size.width() : 0;
+    m_maxHeight = size.isValid() ? size.height() : 0;
+}
+
+void SyncedViewDecoder::stop() {
+    QMutexLocker locker(&m_mutex);
+    m_stopRequested = true;
+    m_wake.wakeOne();
+}
+
+bool SyncedViewDecoder::takeFrame(qint64 timeMs, QVideoFrame *frame) {
+    QMutexLocker locker(&m_mutex);
+    bool found = false;
+    while (!m_queue.empty() && m_queue.front().timeMs <= timeMs) {
+        *frame = m_queue.front().frame;
+        m_queue.pop_front();
+        found = true;
+    }
+    if (found) m_wake.wakeOne();
+    return found;
+}
+
+bool SyncedViewDecoder::isPrimed() const {
+    QMutexLocker locker(&m_mutex);
+    return m_primed;
+}
+
+void SyncedViewDecoder::run() {
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    m_beforeTarget = av_frame_alloc();
+
+    forever {
+        qint64 target = -1;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_stopRequested && m_pendingSeek < 0 && (m_segment < 0 || m_queue.size() >= kQueueFrames))
+                m_wake.wait(&m_mutex);
+            if (m_stopRequested) break;
+            if (m_pendingSeek >= 0) {
+                target = m_pendingSeek;
+                m_pendingSeek = -1;
+                m_workGeneration = m_generation;
+            }
+        }
+
+        if (target >= 0) {
+            seekTo(target);
+            continue;
+        }
+        if (readPacket()) {
+            decodePacket(m_packet);
+            av_packet_unref(m_packet);
+        }
+    }
+
+    closeSegment();
+    av_frame_free(&m_beforeTarget);
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+}
+
+bool SyncedViewDecoder::openSegment(int segment) {
+    closeSegment();
+
+    const QString path = recordingFilePath(m_directory, m_segments[segment].fileName);
+    int ret = avformat_open_input(&m_input, path.toUtf8().constData(), nullptr, nullptr);
+    if (ret < 0) {
+        qDebug() << "同步回放無法開啟分段:" << path << avErrorString(ret);
+        return false;
+    }
+    if (avformat_find_stream_info(m_input, nullptr) < 0) {
+        closeSegment();
+        return false;
+    }
+
+    m_videoIndex = av_find_best_stream(m_input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    const AVCodec *codec = m_videoIndex >= 0
+        ? avcodec_find_decoder(m_input->streams[m_videoIndex]->codecpar->codec_id) : nullptr;
+    if (!codec) {
+        closeSegment();
+        return false;
+    }
+
+    AVStream *stream = m_input->streams[m_videoIndex];
+    m_timeBase = stream->time_base;
+    m_startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+    m_codec = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codec, stream->codecpar);
+    m_codec->pkt_timebase = stream->time_base;
+    // 同時開很多格，每格少用幾個執行緒
+    m_codec->thread_count = 2;
+    m_decodingKeyframesOnly = m_keyframesOnly;
+    m_codec->skip_frame = m_decodingKeyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+    if (avcodec_open2(m_codec, codec, nullptr) < 0) {
+        closeSegment();
+        return false;
+    }
+
+    m_index = KeyframeIndex::load(path);
+    m_segment = segment;
+    m_waitingForKey = true;
+    return true;
+}
+
+void SyncedViewDecoder::closeSegment() {
+    avcodec_free_context(&m_codec);
+    avformat_close_input(&m_input);
+    m_segment = -1;
+    m_videoIndex = -1;
+    m_index = KeyframeIndex();
+}
+
+void SyncedViewDecoder::seekTo(qint64 timeMs) {
+    av_frame_unref(m_beforeTarget);
+    m_targetMs = timeMs;
+
+    qint64 offset = 0;
+    int segment = locateSegment(m_segments, timeMs, &offset);
+    if (segment < 0 || (segment != m_segment && !openSegment(segment))) {
+        // 這台在這個時間之後沒有錄影：清掉畫面
+        closeSegment();
+        QMutexLocker locker(&m_mutex);
+        if (m_workGeneration == m_generation) m_queue.push_back({timeMs, QVideoFrame()});
+        m_primed = true;
+        return;
+    }
+
+    // 有關鍵幀索引時直接跳到該關鍵幀
+    int key = m_index.floor(offset);
+    if (key >= 0 && qstrcmp(m_input->iformat->name, "mpegts") == 0 && m_index.entries()[key].position >= 0) {
+        av_seek_frame(m_input, -1, m_index.entries()[key].position, AVSEEK_FLAG_BYTE);
+    } else {
+        qint64 target = key >= 0 ? m_index.entries()[key].timeMs : offset;
+        av_seek_frame(m_input, m_videoIndex, m_startTime + av_rescale_q(target, AVRational{1, 1000}, m_timeBase),
+                      AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(m_codec);
+    m_waitingForKey = true;
+}
+
+bool SyncedViewDecoder::readPacket() {
+    int ret = av_read_frame(m_input, m_packet);
+    if (ret < 0) {
+        // 分段結尾：取出剩下的畫面，接著開下一段
+        decodePacket(nullptr);
+        int next = m_segment + 1;
+        while (next < m_segments.size() && !openSegment(next)) ++next;
+        if (next >= m_segments.size()) {
+            closeSegment();
+            QMutexLocker locker(&m_mutex);
+            m_primed = true;
+        }
+        return false;
+    }
+    if (m_packet->stream_index != m_videoIndex) {
+        av_packet_unref(m_packet);
+        return false;
+    }
+    return true;
+}
+
+qint64 SyncedViewDecoder::packetTime(const AVPacket *packet) const {
+    int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    return m_segments[m_segment].startMs + av_rescale_q(pts - m_startTime, m_timeBase, AVRational{1, 1000});
+}
+
+void SyncedViewDecoder::decodePacket(const AVPacket *packet) {
+    const bool keyframesOnly = m_keyframesOnly;
+    if (keyframesOnly != m_decodingKeyframesOnly) {
+        // 切換倍速模式：從下一個關鍵幀重新開始
+        m_decodingKeyframesOnly = keyframesOnly;
+        m_codec->skip_frame = keyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+        avcodec_flush_buffers(m_codec);
+        m_waitingForKey = true;
+    }
+
+    if (packet) {
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            m_waitingForKey = false;
+        } else {
+            if (m_waitingForKey || keyframesOnly) return;
+            // 落後時鐘太多，後面的非關鍵幀都來不及顯示，直接追到下一個關鍵幀
+            if (m_targetMs < 0 && m_clock->isRunning() && packetTime(packet) < m_clock->now() - kLateMs) {
+                m_waitingForKey = true;
+                return;
+            }
+        }
+    }
+
+    avcodec_send_packet(m_codec, packet);
+    // 只解關鍵幀時每張馬上取出，不等解碼器的重排延遲
+    if (packet && keyframesOnly) avcodec_send_packet(m_codec, nullptr);
+    while (avcodec_receive_frame(m_codec, m_frame) == 0) {
+        if (m_frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+            qint64 timeMs = m_segments[m_segment].startMs
+                + av_rescale_q(m_frame->best_effort_timestamp - m_startTime, m_timeBase, AVRational{1, 1000});
+            deliver(m_frame, timeMs);
+        }
+        av_frame_unref(m_frame);
+    }
+    if (packet && keyframesOnly) avcodec_flush_buffers(m_codec);
+}
+
+void SyncedViewDecoder::deliver(const AVFrame *frame, qint64 timeMs) {
+    if (m_targetMs >= 0) {
+        if (timeMs < m_targetMs) {
+            // 還沒到目標：先留著最後一張，不轉換
+            av_frame_unref(m_beforeTarget);
+            av_frame_ref(m_beforeTarget, frame);
+            return;
+        }
+        // 目標落在兩張之間時，先顯示前一張
+        if (timeMs > m_targetMs && m_beforeTarget->buf[0]) push(m_beforeTarget, m_targetMs);
+        av_frame_unref(m_beforeTarget);
+        m_targetMs = -1;
+    }
+    push(frame, timeMs);
+}
+
+void SyncedViewDecoder::push(const AVFrame *frame, qint64 timeMs) {
+    QVideoFrame video = m_converter.convert(frame, QSize(m_maxWidth, m_maxHeight));
+    if (!video.isValid()) return;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_workGeneration != m_generation) return;   // 已經有新的跳轉
+    m_queue.push_back({timeMs, video});
+    m_primed = true;
+}
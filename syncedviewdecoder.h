@@ -0,0 +1,93 @@
+#ifndef SYNCEDVIEWDECODER_H
+#define SYNCEDVIEWDECODER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVideoFrame>
+#include <QVector>
+#include <atomic>
+#include <deque>
+
+#include "ffmpegutils.h"
+#include "keyframeindex.h"
+#include "recordingindex.h"
+#include "videoframeconverter.h"
+
+class PlaybackClock;
+
+// 同步回放中一台攝影機的解碼：依分段順序讀檔，解好的畫面帶實際時間放進小佇列
+// 佇列滿了就等；落後時鐘太多時丟掉非關鍵幀，直接追到下一個關鍵幀
+class SyncedViewDecoder : public QThread {
+    Q_OBJECT
+public:
+    SyncedViewDecoder(const QString &directory, const QVector<RecordingEntry> &segments,
+                      const PlaybackClock *clock, QObject *parent = nullptr);
+    ~SyncedViewDecoder() override;
+
+    const QVector<RecordingEntry> &segments() const { return m_segments; }
+
+    // 以下方法在 GUI 執行緒呼叫，不會阻塞
+    void seek(qint64 timeMs);
+    void setKeyframesOnly(bool enabled);
+    void setMaxOutputSize(const QSize &size);
+    void stop();
+
+    // 取出不晚於 timeMs 的最新一張，較舊的一併丟掉；沒有新畫面時回傳 false
+    bool takeFrame(qint64 timeMs, QVideoFrame *frame);
+    // 跳轉後已經有可顯示的畫面（或這台在該時間沒有錄影）
+    bool isPrimed() const;
+
+protected:
+    void run() override;
+
+private:
+    struct TimedFrame {
+        qint64 timeMs;
+        QVideoFrame frame;
+    };
+
+    bool openSegment(int segment);
+    void closeSegment();
+    void seekTo(qint64 timeMs);
+    bool readPacket();
+    void decodePacket(const AVPacket *packet);
+    void deliver(const AVFrame *frame, qint64 timeMs);
+    void push(const AVFrame *frame, qint64 timeMs);
+    qint64 packetTime(const AVPacket *packet) const;
+
+    const QString m_directory;
+    const QVector<RecordingEntry> m_segments;
+    const PlaybackClock *m_clock;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::deque<TimedFrame> m_queue;
+    bool m_stopRequested = false;
+    qint64 m_pendingSeek = -1;
+    quint64 m_generation = 0;           // 每次跳轉加一，舊的畫面不再放進佇列
+    bool m_primed = false;
+
+    std::atomic_bool m_keyframesOnly{false};
+    std::atomic_int m_maxWidth{0};
+    std::atomic_int m_maxHeight{0};
+
+    // 以下只在解碼執行緒使用
+    AVFormatContext *m_input = nullptr;
+    AVCodecContext *m_codec = nullptr;
+    AVPacket *m_packet = nullptr;
+    AVFrame *m_frame = nullptr;
+    AVFrame *m_beforeTarget = nullptr;  // 跳轉目標之前的最後一張，目標之後沒有剛好的畫面時用它
+    int m_segment = -1;
+    int m_videoIndex = -1;
+    AVRational m_timeBase{1, 1000};
+    int64_t m_startTime = 0;
+    KeyframeIndex m_index;
+    VideoFrameConverter m_converter;
+    quint64 m_workGeneration = 0;
+    qint64 m_targetMs = -1;             // 目前跳轉的目標，之前的畫面不顯示
+    bool m_waitingForKey = true;
+    bool m_decodingKeyframesOnly = false;
+};
+
+#endif // SYNCEDVIEWDECODER_H
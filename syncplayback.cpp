@@ -0,0 +1,163 @@
+#include "syncplayback.h"
+#include "syncedviewdecoder.h"
+#include <QMutexLocker>
+
+// 這個倍速以上只解關鍵幀
+static const double kKeyframesOnlySpeed = 4.0;
+// 跳轉後最多等這麼久讓各格備妥，之後沒跟上的格子邊播邊追
+static const qint64 kPrimeTimeoutMs = 1500;
+static const int kTickIntervalMs = 15;
+
+PlaybackClock::PlaybackClock() {
+    m_timer.start();
+}
+
+qint64 PlaybackClock::nowLocked() const {
+    if (!m_running) return m_anchorTime;
+    return m_anchorTime + qint64((m_timer.elapsed() - m_anchorElapsed) * m_speed);
+}
+
+qint64 PlaybackClock::now() const {
+    QMutexLocker locker(&m_mutex);
+    return nowLocked();
+}
+
+double PlaybackClock::speed() const {
+    QMutexLocker locker(&m_mutex);
+    return m_speed;
+}
+
+bool PlaybackClock::isRunning() const {
+    QMutexLocker locker(&m_mutex);
+    return m_running;
+}
+
+void PlaybackClock::setPosition(qint64 timeMs) {
+    QMutexLocker locker(&m_mutex);
+    m_anchorTime = timeMs;
+    m_anchorElapsed = m_timer.elapsed();
+}
+
+void PlaybackClock::setSpeed(double speed) {
+    QMutexLocker locker(&m_mutex);
+    m_anchorTime = nowLocked();
+    m_anchorElapsed = m_timer.elapsed();
+    m_speed = speed;
+}
+
+void PlaybackClock::setRunning(bool running) {
+    QMutexLocker locker(&m_mutex);
+    m_anchorTime = nowLocked();
+    m_anchorElapsed = m_timer.elapsed();
+    m_running = running;
+}
+
+SyncPlayback::SyncPlayback(QObject *parent) : QObject(parent) {
+    m_tickTimer.setTimerType(Qt::PreciseTimer);
+    m_tickTimer.setInterval(kTickIntervalMs);
+    connect(&m_tickTimer, &QTimer::timeout, this, &SyncPlayback::tick);
+}
+
+SyncPlayback::~SyncPlayback() {
+    clear();
+}
+
+void SyncPlayback::addView(const QString &directory, const QVector<RecordingEntry> &segments, QVideoSink *sink) {
+    if (segments.isEmpty()) return;
+
+    SyncedViewDecoder *decoder = new SyncedViewDecoder(directory, segments, &m_clock, this);
+    decoder->setKeyframesOnly(m_clock.speed() >= kKeyframesOnlySpeed);
+    decoder->start();
+    m_views.append({decoder, sink});
+
+    const qint64 start = segments.first().startMs;
+    const qint64 end = segmentEndMs(segments, segments.size() - 1);
+    m_startMs = m_views.size() == 1 ? start : qMin(m_startMs, start);
+    m_endMs = m_views.size() == 1 ? end : qMax(m_endMs, end);
+    m_tickTimer.start();
+}
+
+void SyncPlayback::clear() {
+    pause();
+    m_tickTimer.stop();
+    for (const View &view : std::as_const(m_views)) {
+        view.decoder->stop();
+        view.decoder->wait();
+        delete view.decoder;
+    }
+    m_views.clear();
+    m_startMs = 0;
+    m_endMs = 0;
+    m_waitingForViews = false;
+}
+
+void SyncPlayback::play() {
+    if (m_views.isEmpty()) return;
+    if (m_clock.now() >= m_endMs) seek(m_startMs);
+    if (!m_playing) {
+        m_playing = true;
+        emit playingChanged(true);
+    }
+    if (!m_waitingForViews) m_clock.setRunning(true);
+}
+
+void SyncPlayback::pause() {
+    m_clock.setRunning(false);
+    if (m_playing) {
+        m_playing = false;
+        emit playingChanged(false);
+    }
+}
+
+void SyncPlayback::seek(qint64 timeMs) {
+    timeMs = qBound(m_startMs, timeMs, m_endMs);
+    // 時鐘停在目標，等各格解到目標再一起走
+    m_clock.setRunning(false);
+    m_clock.setPosition(timeMs);
+    for (const View &view : std::as_const(m_views)) view.decoder->seek(timeMs);
+    m_waitingForViews = true;
+    m_waitTimer.start();
+    m_lastReportedMs = timeMs;
+    emit positionChanged(timeMs);
+}
+
+void SyncPlayback::setSpeed(double speed) {
+    m_clock.setSpeed(speed);
+    updateKeyframesOnly();
+}
+
+void SyncPlayback::setMaxOutputSize(const QSize &size) {
+    for (const View &view : std::as_const(m_views)) view.decoder->setMaxOutputSize(size);
+}
+
+void SyncPlayback::updateKeyframesOnly() {
+    const bool keyframesOnly = m_clock.speed() >= kKeyframesOnlySpeed;
+    for (const View &view : std::as_const(m_views)) view.decoder->setKeyframesOnly(keyframesOnly);
+}
+
+void SyncPlayback::tick() {
+    if (m_waitingForViews) {
+        bool ready = true;
+        for (const View &view : std::as_const(m_views)) ready = ready && view.decoder->isPrimed();
+        if (ready || m_waitTimer.elapsed() > kPrimeTimeoutMs) {
+            m_waitingForViews = false;
+            m_clock.setRunning(m_playing);
+        }
+    }
+
+    // 所有格子依同一個時間取畫面
+    const qint64 now = m_clock.now();
+    for (const View &view : std::as_const(m_views)) {
+        QVideoFrame frame;
+        if (view.decoder->takeFrame(now, &frame) && view.sink) view.sink->setVideoFrame(frame);
+    }
+
+    if (m_playing && now >= m_endMs) {
+        m_clock.setPosition(m_endMs);
+        pause();
+    }
+    if (qAbs(now - m_lastReportedMs) >= 100) {
+        m_lastReportedMs = now;
+        emit positionChanged(now);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef SYNCPLAYBACK_H
+#define SYNCPLAYBACK_H
+
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTimer>
+#include <QVideoSink>
+#include <QVector>
+
+#include "recordingindex.h"
+
+class SyncedViewDecoder;
+
+// 同步回放的共用時鐘：實際時間（epoch 毫秒），可暫停、可變速；各解碼執行緒都讀它
+class PlaybackClock {
+public:
+    PlaybackClock();
+
+    qint64 now() const;
+    double speed() const;
+    bool isRunning() const;
+
+    void setPosition(qint64 timeMs);
+    void setSpeed(double speed);
+    void setRunning(bool running);
+
+private:
+    qint64 nowLocked() const;
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_timer;
+    qint64 m_anchorTime = 0;        // m_anchorElapsed 時的時鐘值
+    qint64 m_anchorElapsed = 0;
+    double m_speed = 1.0;
+    bool m_running = false;
+};
+
+// 多台攝影機的錄影鎖在同一個時鐘上播放
+// 每台一個解碼執行緒先解好幾張，GUI 執行緒依時鐘決定每格顯示哪一張，不會各自漂移
+// 跳轉後等每格都有畫面才讓時鐘往前走；高倍速只解關鍵幀
+class SyncPlayback : public QObject {
+    Q_OBJECT
+public:
+    explicit SyncPlayback(QObject *parent = nullptr);
+    ~SyncPlayback() override;
+
+    // segments 為同一台攝影機依時間排序的分段
+    void addView(const QString &directory, const QVector<RecordingEntry> &segments, QVideoSink *sink);
+    void clear();
+    int viewCount() const { return m_views.size(); }
+
+    qint64 startMs() const { return m_startMs; }
+    qint64 endMs() const { return m_endMs; }
+    qint64 position() const { return m_clock.now(); }
+    double speed() const { return m_clock.speed(); }
+    bool isPlaying() const { return m_playing; }
+
+    void play();
+    void pause();
+    void seek(qint64 timeMs);
+    void setSpeed(double speed);
+
+    // 每格顯示的最大尺寸，格子小時省記憶體與複製
+    void setMaxOutputSize(const QSize &size);
+
+signals:
+    void positionChanged(qint64 timeMs);
+    void playingChanged(bool playing);
+
+private:
+    struct View {
+        SyncedViewDecoder *decoder;
+        QPointer<QVideoSink> sink;
+    };
+
+    void tick();
+    void updateKeyframesOnly();
+
+    PlaybackClock m_clock;
+    QVector<View> m_views;
+    QTimer m_tickTimer;
+    qint64 m_startMs = 0;
+    qint64 m_endMs = 0;
+    bool m_playing = false;
+    bool m_waitingForViews = false;     // 跳轉後等各格備妥
+    QElapsedTimer m_waitTimer;
+    qint64 m_lastReportedMs = -1;
+};
+
+#endif // SYNCPLAYBACK_H
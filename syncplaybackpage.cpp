@@ -0,0 +1,100 @@
+#include "syncplaybackpage.h"
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QDateTime>
+#include <climits>
+#include <cmath>
+
+SyncPlaybackPage::SyncPlaybackPage(QWidget *parent) : QWidget(parent) {
+    m_playback = new SyncPlayback(this);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    QWidget *gridContainer = new QWidget();
+    gridContainer->setStyleSheet("background: black;");
+    m_grid = new QGridLayout(gridContainer);
+    m_grid->setSpacing(2);
+    m_grid->setContentsMargins(0, 0, 0, 0);
+
+    QHBoxLayout *controlLayout = new QHBoxLayout();
+    m_playBtn = new QPushButton("▶");
+    m_playBtn->setFixedSize(40, 40);
+    m_speedCombo = new QComboBox();
+    for (int speed : {1, 2, 4, 8, 16}) m_speedCombo->addItem(QString("%1×").arg(speed), double(speed));
+    m_positionSlider = new QSlider(Qt::Horizontal);
+    m_timeLabel = new QLabel("--:--:--");
+    m_timeLabel->setMinimumWidth(80);
+    QPushButton *backBtn = new QPushButton("返回檔案管理");
+
+    controlLayout->addWidget(m_playBtn);
+    controlLayout->addWidget(new QLabel("速度:"));
+    controlLayout->addWidget(m_speedCombo);
+    controlLayout->addWidget(m_positionSlider);
+    controlLayout->addWidget(m_timeLabel);
+    controlLayout->addWidget(backBtn);
+
+    layout->addWidget(gridContainer, 1);
+    layout->addLayout(controlLayout);
+
+    connect(m_playBtn, &QPushButton::clicked, this, [this](){
+        if (m_playback->isPlaying()) m_playback->pause();
+        else m_playback->play();
+    });
+    connect(m_speedCombo, &QComboBox::currentIndexChanged, this, [this](){
+        m_playback->setSpeed(m_speedCombo->currentData().toDouble());
+    });
+    connect(m_positionSlider, &QSlider::sliderPressed, this, [this](){
+        m_resumeAfterScrub = m_playback->isPlaying();
+        m_playback->pause();
+    });
+    connect(m_positionSlider, &QSlider::sliderMoved, this, [this](int position){
+        // 每格的解碼端只處理最新一次跳轉
+        m_playback->seek(m_playback->startMs() + position);
+    });
+    connect(m_positionSlider, &QSlider::sliderReleased, this, [this](){
+        if (m_resumeAfterScrub) m_playback->play();
+    });
+    connect(m_playback, &SyncPlayback::positionChanged, this, [this](qint64 timeMs){
+        if (!m_positionSlider->isSliderDown()) m_positionSlider->setValue(int(timeMs - m_playback->startMs()));
+        updateTimeLabel(timeMs);
+    });
+    connect(m_playback, &SyncPlayback::playingChanged, this, [this](bool playing){
+        m_playBtn->setText(playing ? "⏸" : "▶");
+    });
+    connect(backBtn, &QPushButton::clicked, this, [this](){
+        unload();
+        emit backRequested();
+    });
+}
+
+void SyncPlaybackPage::load(const QString &directory, const QList<QVector<RecordingEntry>> &cameras, qint64 startMs) {
+    unload();
+
+    const int columns = qMax(1, int(std::ceil(std::sqrt(double(cameras.size())))));
+    const int rows = qMax(1, int(std::ceil(double(cameras.size()) / columns)));
+    for (int i = 0; i < cameras.size(); ++i) {
+        QVideoWidget *widget = new QVideoWidget();
+        widget->setToolTip(cameras[i].first().camera);
+        m_grid->addWidget(widget, i / columns, i % columns);
+        m_videoWidgets.append(widget);
+        m_playback->addView(directory, cameras[i], widget->videoSink());
+    }
+
+    // 每格只需要格子大小的畫面
+    QSize cell(width() / columns, height() / rows);
+    m_playback->setMaxOutputSize(cell * devicePixelRatio());
+    m_playback->setSpeed(m_speedCombo->currentData().toDouble());
+
+    m_positionSlider->setRange(0, int(qMin<qint64>(m_playback->endMs() - m_playback->startMs(), INT_MAX)));
+    m_playback->seek(startMs);
+    m_playback->play();
+}
+
+void SyncPlaybackPage::unload() {
+    m_playback->clear();
+    qDeleteAll(m_videoWidgets);
+    m_videoWidgets.clear();
+}
+
+void SyncPlaybackPage::updateTimeLabel(qint64 timeMs) {
+    m_timeLabel->setText(QDateTime::fromMSecsSinceEpoch(timeMs).toString("HH:mm:ss"));
+}
@@ -0,0 +1,41 @@
+#ifndef SYNCPLAYBACKPAGE_H
+#define SYNCPLAYBACKPAGE_H
+
+#include <QWidget>
+#include <QVideoWidget>
+#include <QGridLayout>
+#include <QPushButton>
+#include <QComboBox>
+#include <QSlider>
+#include <QLabel>
+#include <QList>
+
+#include "syncplayback.h"
+
+// 多攝影機同步回放頁：每台攝影機一格，共用一條時間軸與播放控制
+class SyncPlaybackPage : public QWidget {
+    Q_OBJECT
+public:
+    explicit SyncPlaybackPage(QWidget *parent = nullptr);
+
+    // cameras 每個元素為一台攝影機依時間排序的分段；從 startMs 開始播
+    void load(const QString &directory, const QList<QVector<RecordingEntry>> &cameras, qint64 startMs);
+    void unload();
+
+signals:
+    void backRequested();
+
+private:
+    void updateTimeLabel(qint64 timeMs);
+
+    SyncPlayback *m_playback;
+    QGridLayout *m_grid;
+    QList<QVideoWidget *> m_videoWidgets;
+    QPushButton *m_playBtn;
+    QComboBox *m_speedCombo;
+    QSlider *m_positionSlider;
+    QLabel *m_timeLabel;
+    bool m_resumeAfterScrub = false;
+};
+
+#endif // SYNCPLAYBACKPAGE_H
@@ -0,0 +1,235 @@
+#include "thumbnailstore.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+
+#include "ffmpegutils.h"
+#include "recordingindex.h"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+// 縮圖檔：magic + 版本 + 間隔，接著每張為 時間 + JPEG
+static const quint32 kThumbMagic = 0x54484D42;   // "THMB"
+static const quint32 kThumbVersion = 1;
+static const qint64 kPreviewIntervalMs = 10000;
+
+// 縮圖放在錄影檔所在資料夾的 .thumbs 底下，分散在各儲存位置時也跟著錄影檔走
+QString ThumbnailStore::cachePath(const QString &directory, const QString &fileName) {
+    const QFileInfo info(recordingFilePath(directory, fileName));
+    return info.absolutePath() + "/.thumbs/" + info.fileName() + ".thm";
+}
+
+static QImage frameToImage(SwsContext **sws, const AVFrame *frame) {
+    QSize size = QSize(frame->width, frame->height).scaled(ThumbnailStore::thumbnailSize(), Qt::KeepAspectRatio);
+    *sws = sws_getCachedContext(*sws, frame->width, frame->height, AVPixelFormat(frame->format),
+                                size.width(), size.height(), AV_PIX_FMT_RGB32,
+                                SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!*sws) return QImage();
+
+    QImage image(size, QImage::Format_RGB32);
+    uint8_t *dst[4] = { image.bits(), nullptr, nullptr, nullptr };
+    int dstStride[4] = { int(image.bytesPerLine()), 0, 0, 0 };
+    sws_scale(*sws, frame->data, frame->linesize, 0, frame->height, dst, dstStride);
+    return image;
+}
+
+// 每個時間點跳到其後的第一個關鍵幀，只解那一張
+static ThumbnailStrip extractStrip(const QString &path) {
+    ThumbnailStrip strip;
+    strip.intervalMs = kPreviewIntervalMs;
+
+    AVFormatContext *input = nullptr;
+    if (avformat_open_input(&input, path.toUtf8().constData(), nullptr, nullptr) < 0) return strip;
+    if (avformat_find_stream_info(input, nullptr) < 0) {
+        avformat_close_input(&input);
+        return strip;
+    }
+
+    int videoIndex = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    const AVCodec *codec = videoIndex >= 0
+        ? avcodec_find_decoder(input->streams[videoIndex]->codecpar->codec_id) : nullptr;
+    if (!codec) {
+        avformat_close_input(&input);
+        return strip;
+    }
+
+    AVStream *stream = input->streams[videoIndex];
+    AVCodecContext *decoder = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(decoder, stream->codecpar);
+    decoder->thread_count = 1;                  // 背景工作不搶錄影與即時畫面的 CPU
+    decoder->skip_frame = AVDISCARD_NONKEY;
+    if (avcodec_open2(decoder, codec, nullptr) < 0) {
+        avcodec_free_context(&decoder);
+        avformat_close_input(&input);
+        return strip;
+    }
+
+    const int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    const int64_t durationMs = input->duration > 0 ? input->duration / 1000 : 0;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    SwsContext *sws = nullptr;
+    int64_t lastKeyTime = AV_NOPTS_VALUE;
+
+    for (qint64 target = 0; target == 0 || target < durationMs; target += kPreviewIntervalMs) {
+        if (target > 0) {
+            int64_t ts = startTime + av_rescale_q(target, AVRational{1, 1000}, stream->time_base);
+            if (avformat_seek_file(input, videoIndex, ts, ts, INT64_MAX, 0) < 0) break;
+        }
+
+        // 讀到下一個影像關鍵幀
+        bool found = false;
+        while (av_read_frame(input, packet) >= 0) {
+            if (packet->stream_index == videoIndex && (packet->flags & AV_PKT_FLAG_KEY)) {
+                found = true;
+                break;
+            }
+            av_packet_unref(packet);
+        }
+        if (!found) break;
+
+        int64_t keyTime = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        if (keyTime == lastKeyTime) {
+            // GOP 比間隔長，跳到同一個關鍵幀
+            av_packet_unref(packet);
+            continue;
+        }
+        lastKeyTime = keyTime;
+
+        avcodec_send_packet(decoder, packet);
+        avcodec_send_packet(decoder, nullptr);
+        av_packet_unref(packet);
+        if (avcodec_receive_frame(decoder, frame) == 0) {
+            QImage image = frameToImage(&sws, frame);
+            if (!image.isNull()) {
+                strip.times << av_rescale_q(keyTime - startTime, stream->time_base, AVRational{1, 1000});
+                strip.images << image;
+            }
+            av_frame_unref(frame);
+        }
+        avcodec_flush_buffers(decoder);
+    }
+
+    sws_freeContext(sws);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&input);
+    return strip;
+}
+
+static bool loadStrip(const QString &path, ThumbnailStrip *strip) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> strip->intervalMs >> count;
+    if (magic != kThumbMagic || version != kThumbVersion || in.status() != QDataStream::Ok) return false;
+
+    for (qint32 i = 0; i < count; ++i) {
+        qint64 time = 0;
+        QByteArray jpeg;
+        in >> time >> jpeg;
+        if (in.status() != QDataStream::Ok) return false;
+        strip->times << time;
+        strip->images << QImage::fromData(jpeg, "JPG");
+    }
+    return true;
+}
+
+static void saveStrip(const QString &path, const ThumbnailStrip &strip) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kThumbMagic << kThumbVersion << strip.intervalMs << qint32(strip.images.size());
+    for (int i = 0; i < strip.images.size(); ++i) {
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        strip.images[i].save(&buffer, "JPG", 75);
+        out << strip.times[i] << jpeg;
+    }
+    file.commit();
+}
+
+ThumbnailStore::ThumbnailStore(const QString &directory, QObject *parent)
+    : QObject(parent), m_directory(directory), m_cache(4000) {
+    // 少量低優先權執行緒，永遠讓錄影與即時畫面優先
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 4));
+    m_pool.setThreadPriority(QThread::LowestPriority);
+
+    m_placeholder = QImage(thumbnailSize(), QImage::Format_RGB32);
+    m_placeholder.fill(Qt::black);
+}
+
+ThumbnailStore::~ThumbnailStore() {
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+const ThumbnailStrip *ThumbnailStore::strip(const QString &fileName) {
+    if (const ThumbnailStrip *cached = m_cache.object(fileName)) return cached;
+    request(fileName);
+    return nullptr;
+}
+
+QImage ThumbnailStore::thumbnail(const QString &fileName) {
+    const ThumbnailStrip *cached = strip(fileName);
+    return cached && !cached->images.isEmpty() ? cached->images.first() : m_placeholder;
+}
+
+QImage ThumbnailStore::previewAt(const QString &fileName, qint64 positionMs) {
+    const ThumbnailStrip *cached = strip(fileName);
+    if (!cached || cached->images.isEmpty()) return QImage();
+
+    auto it = std::upper_bound(cached->times.begin(), cached->times.end(), positionMs);
+    int index = qMax(0, int(it - cached->times.begin()) - 1);
+    return cached->images[index];
+}
+
+void ThumbnailStore::generate(const QString &fileName) {
+    m_cache.remove(fileName);
+    QFile::remove(cachePath(m_directory, fileName));
+    request(fileName);
+}
+
+void ThumbnailStore::remove(const QString &fileName) {
+    m_cache.remove(fileName);
+    QFile::remove(cachePath(m_directory, fileName));
+}
+
+void ThumbnailStore::request(const QString &fileName) {
+    if (m_pending.contains(fileName)) return;
+    m_pending.insert(fileName);
+
+    m_pool.start([this, fileName, directory = m_directory]() {
+        // 先讀快取檔，沒有才從錄影檔產生
+        ThumbnailStrip strip;
+        const QString path = cachePath(directory, fileName);
+        if (!loadStrip(path, &strip)) {
+            strip = extractStrip(recordingFilePath(directory, fileName));
+            if (!strip.images.isEmpty()) saveStrip(path, strip);
+        }
+
+        QMetaObject::invokeMethod(this, [this, fileName, strip]() {
+            m_pending.remove(fileName);
+            // 產生失敗（檔案損毀或已刪除）也放一筆空的，避免一直重試
+            m_cache.insert(fileName, new ThumbnailStrip(strip), qMax<qsizetype>(1, strip.images.size()));
+            emit thumbnailsReady(fileName);
+        }, Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,56 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QObject>
+#include <QCache>
+#include <QImage>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
+
+// 一個錄影檔的縮圖：第一張當清單縮圖，其餘每隔 intervalMs 一張供進度條預覽
+struct ThumbnailStrip {
+    qint64 intervalMs = 0;
+    QVector<qint64> times;      // 相對檔案開頭的毫秒
+    QVector<QImage> images;
+};
+
+// 錄影縮圖：背景低優先權執行緒只解關鍵幀產生，存在錄影資料夾的 .thumbs 底下
+// GUI 執行緒只讀記憶體快取，沒有的先回傳空白圖並排程載入，完成後發出 thumbnailsReady
+class ThumbnailStore : public QObject {
+    Q_OBJECT
+public:
+    explicit ThumbnailStore(const QString &directory, QObject *parent = nullptr);
+    ~ThumbnailStore() override;
+
+    static QSize thumbnailSize() { return QSize(160, 90); }
+    // 縮圖快取檔的位置，刪除錄影檔時一併刪掉
+    static QString cachePath(const QString &directory, const QString &fileName);
+
+    // 清單用縮圖；還沒準備好時回傳同尺寸的空白圖
+    QImage thumbnail(const QString &fileName);
+    // 進度條預覽：該時間點之前最近的一張；還沒準備好時回傳空的 QImage
+    QImage previewAt(const QString &fileName, qint64 positionMs);
+
+    // 分段寫完時呼叫，預先產生
+    void generate(const QString &fileName);
+    // 錄影檔刪除時一併清掉快取
+    void remove(const QString &fileName);
+    // 縮圖檔已在別處刪掉時，只清記憶體快取
+    void evict(const QString &fileName) { m_cache.remove(fileName); }
+
+signals:
+    void thumbnailsReady(const QString &fileName);
+
+private:
+    const ThumbnailStrip *strip(const QString &fileName);
+    void request(const QString &fileName);
+
+    QString m_directory;
+    QCache<QString, ThumbnailStrip> m_cache;    // 成本為圖片張數
+    QSet<QString> m_pending;
+    QThreadPool m_pool;
+    QImage m_placeholder;
+};
+
+#endif // THUMBNAILSTORE_H
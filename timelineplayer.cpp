@@ -0,0 +1,202 @@
+#include "timelineplayer.h"
+#include <QUrl>
+#include <QDebug>
+#include <algorithm>
+
+TimelinePlayer::TimelinePlayer(QVideoSink *sink, QObject *parent)
+    : QObject(parent), m_sink(sink) {
+    m_audio = new QAudioOutput(this);
+    for (int slot = 0; slot < 2; ++slot) {
+        QMediaPlayer *player = new QMediaPlayer(this);
+        m_players[slot] = player;
+
+        connect(player, &QMediaPlayer::positionChanged, this, [this, slot](qint64 position){
+            if (slot != m_active || m_current < 0 || m_pendingOffset >= 0) return;
+            emit positionChanged(m_segments[m_current].startMs + position);
+        });
+        connect(player, &QMediaPlayer::mediaStatusChanged, this, [this, slot](QMediaPlayer::MediaStatus status){
+            onMediaStatusChanged(slot, status);
+        });
+        connect(player, &QMediaPlayer::durationChanged, this, [this, slot](qint64 duration){
+            onDurationChanged(slot, duration);
+        });
+    }
+    m_players[m_active]->setVideoOutput(m_sink.data());
+    m_players[m_active]->setAudioOutput(m_audio);
+}
+
+void TimelinePlayer::setSegments(const QString &directory, const QVector<RecordingEntry> &segments) {
+    clear();
+    m_directory = directory;
+    m_segments = segments;
+    std::sort(m_segments.begin(), m_segments.end(), [](const RecordingEntry &a, const RecordingEntry &b) {
+        return a.startMs < b.startMs;
+    });
+    emit rangeChanged(startMs(), endMs());
+    emit positionChanged(startMs());
+}
+
+void TimelinePlayer::clear() {
+    for (int slot = 0; slot < 2; ++slot) {
+        m_players[slot]->stop();
+        m_players[slot]->setSource(QUrl());
+        m_segmentOf[slot] = -1;
+    }
+    m_segments.clear();
+    m_current = -1;
+    m_pendingOffset = -1;
+    setState(QMediaPlayer::StoppedState);
+}
+
+bool TimelinePlayer::contains(const QString &fileName) const {
+    return std::any_of(m_segments.begin(), m_segments.end(), [&](const RecordingEntry &entry) {
+        return entry.fileName == fileName;
+    });
+}
+
+qint64 TimelinePlayer::startMs() const {
+    return m_segments.isEmpty() ? 0 : m_segments.first().startMs;
+}
+
+qint64 TimelinePlayer::endMs() const {
+    return m_segments.isEmpty() ? 0 : segmentEndMs(m_segments, m_segments.size() - 1);
+}
+
+qint64 TimelinePlayer::position() const {
+    if (m_current < 0) return startMs();
+    qint64 offset = m_pendingOffset >= 0 ? m_pendingOffset : active()->position();
+    return m_segments[m_current].startMs + offset;
+}
+
+int TimelinePlayer::locate(qint64 timeMs, qint64 *offsetMs) const {
+    return locateSegment(m_segments, timeMs, offsetMs);
+}
+
+void TimelinePlayer::play() {
+    if (m_segments.isEmpty()) return;
+    setState(QMediaPlayer::PlayingState);
+    if (m_current < 0) {
+        activate(0, 0);
+    } else if (m_pendingOffset < 0) {
+        active()->play();
+    }
+}
+
+void TimelinePlayer::pause() {
+    if (m_current < 0) return;
+    setState(QMediaPlayer::PausedState);
+    if (m_pendingOffset < 0) active()->pause();
+}
+
+void TimelinePlayer::stop() {
+    active()->stop();
+    m_current = -1;
+    m_pendingOffset = -1;
+    setState(QMediaPlayer::StoppedState);
+    emit positionChanged(startMs());
+}
+
+void TimelinePlayer::seek(qint64 timeMs) {
+    qint64 offset = 0;
+    int segment = locate(timeMs, &offset);
+    if (segment < 0) return;
+
+    // 停止狀態下跳轉也要看到畫面
+    if (m_state == QMediaPlayer::StoppedState) setState(QMediaPlayer::PausedState);
+    if (segment != m_current) {
+        activate(segment, offset);
+    } else if (m_pendingOffset >= 0) {
+        m_pendingOffset = offset;
+    } else {
+        active()->setPosition(offset);
+    }
+}
+
+void TimelinePlayer::setVolume(float volume) {
+    m_audio->setVolume(volume);
+}
+
+void TimelinePlayer::setState(QMediaPlayer::PlaybackState state) {
+    if (m_state == state) return;
+    m_state = state;
+    emit playbackStateChanged(state);
+}
+
+void TimelinePlayer::load(int slot, int segment) {
+    m_segmentOf[slot] = segment;
+    m_players[slot]->setSource(QUrl::fromLocalFile(filePathAt(segment)));
+}
+
+void TimelinePlayer::activate(int segment, qint64 offsetMs) {
+    if (m_segmentOf[1 - m_active] == segment) {
+        // 下一段已經預先開好，輸出直接切過去
+        active()->stop();
+        active()->setVideoOutput(nullptr);
+        active()->setAudioOutput(nullptr);
+        m_active = 1 - m_active;
+        active()->setVideoOutput(m_sink.data());
+        active()->setAudioOutput(m_audio);
+    } else if (m_segmentOf[m_active] != segment) {
+        load(m_active, segment);
+    }
+
+    const bool changed = m_current != segment;
+    m_current = segment;
+
+    const QMediaPlayer::MediaStatus status = active()->mediaStatus();
+    if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia
+        || status == QMediaPlayer::BufferingMedia || status == QMediaPlayer::EndOfMedia) {
+        m_pendingOffset = -1;
+        active()->setPosition(offsetMs);
+        if (m_state == QMediaPlayer::PlayingState) active()->play();
+        else active()->pause();
+    } else {
+        m_pendingOffset = offsetMs;
+    }
+
+    if (changed) {
+        emit segmentChanged(m_segments[segment].fileName);
+        prefetch();
+    }
+    emit positionChanged(m_segments[segment].startMs + offsetMs);
+}
+
+void TimelinePlayer::prefetch() {
+    const int next = m_current + 1;
+    if (next < m_segments.size() && m_segmentOf[1 - m_active] != next) load(1 - m_active, next);
+}
+
+void TimelinePlayer::onMediaStatusChanged(int slot, QMediaPlayer::MediaStatus status) {
+    if (slot != m_active || m_current < 0) return;
+
+    switch (status) {
+    case QMediaPlayer::LoadedMedia:
+    case QMediaPlayer::BufferedMedia:
+        if (m_pendingOffset >= 0) {
+            active()->setPosition(m_pendingOffset);
+            m_pendingOffset = -1;
+            if (m_state == QMediaPlayer::PlayingState) active()->play();
+            else active()->pause();
+        }
+        break;
+    case QMediaPlayer::InvalidMedia:
+        qDebug() << "無法播放分段，略過:" << m_segments[m_current].fileName;
+        Q_FALLTHROUGH();
+    case QMediaPlayer::EndOfMedia:
+        if (m_current + 1 < m_segments.size()) {
+            activate(m_current + 1, 0);
+        } else {
+            setState(QMediaPlayer::StoppedState);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void TimelinePlayer::onDurationChanged(int slot, qint64 duration) {
+    const int segment = m_segmentOf[slot];
+    if (segment < 0 || duration <= 0 || m_segments[segment].durationMs > 0) return;
+    m_segments[segment].durationMs = duration;
+    emit rangeChanged(startMs(), endMs());
+}
@@ -0,0 +1,72 @@
+#ifndef TIMELINEPLAYER_H
+#define TIMELINEPLAYER_H
+
+#include <QObject>
+#include <QMediaPlayer>
+#include <QAudioOutput>
+#include <QVideoSink>
+#include <QPointer>
+#include <QVector>
+
+#include "recordingindex.h"
+
+// 同一台攝影機連續的錄影分段當成一條時間軸播放
+// 兩個 QMediaPlayer 輪流：一個播目前的分段，另一個先把下一段開好，播完直接切過去
+// 對外的位置一律是實際時間（epoch 毫秒），分段之間沒錄到的空檔直接跳過
+class TimelinePlayer : public QObject {
+    Q_OBJECT
+public:
+    explicit TimelinePlayer(QVideoSink *sink, QObject *parent = nullptr);
+
+    // segments 會依開始時間排序；directory 是錄影資料夾
+    void setSegments(const QString &directory, const QVector<RecordingEntry> &segments);
+    void clear();
+
+    bool isEmpty() const { return m_segments.isEmpty(); }
+    bool contains(const QString &fileName) const;
+    qint64 startMs() const;
+    qint64 endMs() const;
+    qint64 position() const;
+
+    // 時間點所在的分段與分段內的偏移；落在空檔時取下一段的開頭，超出範圍回傳 -1
+    int locate(qint64 timeMs, qint64 *offsetMs) const;
+    QString fileNameAt(int segment) const { return m_segments[segment].fileName; }
+    QString filePathAt(int segment) const { return recordingFilePath(m_directory, m_segments[segment].fileName); }
+
+    QMediaPlayer::PlaybackState playbackState() const { return m_state; }
+    void play();
+    void pause();
+    void stop();
+    void seek(qint64 timeMs);
+    void setVolume(float volume);
+
+signals:
+    void positionChanged(qint64 timeMs);
+    // 時間軸範圍改變（換了分段組合，或補上未知的分段長度）
+    void rangeChanged(qint64 startMs, qint64 endMs);
+    void playbackStateChanged(QMediaPlayer::PlaybackState state);
+    void segmentChanged(const QString &fileName);
+
+private:
+    QMediaPlayer *active() const { return m_players[m_active]; }
+    void load(int slot, int segment);
+    void activate(int segment, qint64 offsetMs);
+    void prefetch();
+    void setState(QMediaPlayer::PlaybackState state);
+    void onMediaStatusChanged(int slot, QMediaPlayer::MediaStatus status);
+    void onDurationChanged(int slot, qint64 duration);
+
+    QPointer<QVideoSink> m_sink;
+    QAudioOutput *m_audio;
+    QMediaPlayer *m_players[2];
+    int m_segmentOf[2] = {-1, -1};      // 各播放器載入的分段
+    int m_active = 0;
+    int m_current = -1;
+    qint64 m_pendingOffset = -1;        // 分段載入完成後要跳到的位置
+    QMediaPlayer::PlaybackState m_state = QMediaPlayer::StoppedState;   // 換段時維持
+
+    QString m_directory;
+    QVector<RecordingEntry> m_segments;
+};
+
+#endif // TIMELINEPLAYER_H
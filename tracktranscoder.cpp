@@ -0,0 +1,254 @@
+#include "tracktranscoder.h"
+#include "transcodepool.h"
+#include <QElapsedTimer>
+
+extern "C" {
+#include <libavutil/audio_fifo.h>
+#include <libavutil/opt.h>
+#include <libswresample/swresample.h>
+#include <libswscale/swscale.h>
+}
+
+TrackTranscoder::TrackTranscoder() {
+    m_decoded = av_frame_alloc();
+    m_converted = av_frame_alloc();
+    m_encoded = av_packet_alloc();
+}
+
+TrackTranscoder::~TrackTranscoder() {
+    if (m_countedStream) TranscodePool::global().removeStream();
+    avcodec_free_context(&m_decoder);
+    avcodec_free_context(&m_encoder);
+    avcodec_parameters_free(&m_outputPar);
+    av_frame_free(&m_decoded);
+    av_frame_free(&m_converted);
+    av_packet_free(&m_encoded);
+    sws_freeContext(m_sws);
+    swr_free(&m_swr);
+    if (m_fifo) av_audio_fifo_free(m_fifo);
+}
+
+AVRational TrackTranscoder::outputTimeBase() const {
+    return m_encoder ? m_encoder->time_base : AVRational{0, 1};
+}
+
+bool TrackTranscoder::open(const IngestTrack &track, bool globalHeader, QString *error) {
+    m_type = track.type;
+    m_inputTimeBase = track.timeBase;
+
+    const AVCodec *decoder = avcodec_find_decoder(track.codecpar->codec_id);
+    if (!decoder) {
+        *error = QString("找不到解碼器: %1").arg(avcodec_get_name(track.codecpar->codec_id));
+        return false;
+    }
+    m_decoder = avcodec_alloc_context3(decoder);
+    avcodec_parameters_to_context(m_decoder, track.codecpar.get());
+    m_decoder->pkt_timebase = track.timeBase;
+    // 影像路數多時靠共用執行緒池平行，每路自己只用分到的執行緒；切片平行不增加延遲
+    if (m_type == AVMEDIA_TYPE_VIDEO) {
+        TranscodePool::global().addStream();
+        m_countedStream = true;
+        m_decoder->thread_count = TranscodePool::global().threadsPerStream();
+        m_decoder->thread_type = FF_THREAD_SLICE;
+    }
+
+    int ret = avcodec_open2(m_decoder, decoder, nullptr);
+    if (ret < 0) {
+        *error = "解碼器開啟失敗: " + avErrorString(ret);
+        return false;
+    }
+
+    bool ok = m_type == AVMEDIA_TYPE_VIDEO ? openVideoEncoder(track, globalHeader, error)
+                                            : openAudioEncoder(globalHeader, error);
+    if (!ok) return false;
+
+    m_outputPar = avcodec_parameters_alloc();
+    avcodec_parameters_from_context(m_outputPar, m_encoder);
+    return true;
+}
+
+bool TrackTranscoder::openVideoEncoder(const IngestTrack &track, bool globalHeader, QString *error) {
+    const AVCodec *encoder = avcodec_find_encoder_by_name("libx264");
+    if (!encoder) encoder = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!encoder) {
+        *error = "找不到 H.264 編碼器";
+        return false;
+    }
+
+    AVRational frameRate = track.frameRate;
+    if (frameRate.num <= 0 || frameRate.den <= 0 || av_q2d(frameRate) > 120)
+        frameRate = AVRational{25, 1};
+
+    m_encoder = avcodec_alloc_context3(encoder);
+    m_encoder->width = track.codecpar->width;
+    m_encoder->height = track.codecpar->height;
+    m_encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+    m_encoder->time_base = track.timeBase;
+    m_encoder->framerate = frameRate;
+    m_encoder->sample_aspect_ratio = track.codecpar->sample_aspect_ratio;
+    // 每 2 秒一個關鍵幀，分段與預錄才有切點
+    m_encoder->gop_size = qMax(1, int(av_q2d(frameRate) * 2));
+    m_encoder->max_b_frames = 0;
+    if (globalHeader) m_encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    // 預設會依核心數開執行緒，16 路就是 16 倍；改成分到的份額
+    m_encoder->thread_count = TranscodePool::global().threadsPerStream();
+    m_encoder->thread_type = FF_THREAD_SLICE;
+
+    av_opt_set(m_encoder->priv_data, "preset", "ultrafast", 0);
+    av_opt_set(m_encoder->priv_data, "tune", "zerolatency", 0);
+    av_opt_set(m_encoder->priv_data, "crf", "23", 0);
+
+    int ret = avcodec_open2(m_encoder, encoder, nullptr);
+    if (ret < 0) {
+        *error = "H.264 編碼器開啟失敗: " + avErrorString(ret);
+        return false;
+    }
+
+    m_converted->format = AV_PIX_FMT_YUV420P;
+    m_converted->width = m_encoder->width;
+    m_converted->height = m_encoder->height;
+    if (av_frame_get_buffer(m_converted, 0) < 0) {
+        *error = "無法配置轉碼緩衝";
+        return false;
+    }
+    return true;
+}
+
+bool TrackTranscoder::openAudioEncoder(bool globalHeader, QString *error) {
+    const AVCodec *encoder = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    if (!encoder) {
+        *error = "找不到 AAC 編碼器";
+        return false;
+    }
+
+    const int channels = qBound(1, m_decoder->ch_layout.nb_channels, 2);
+
+    m_encoder = avcodec_alloc_context3(encoder);
+    m_encoder->sample_fmt = AV_SAMPLE_FMT_FLTP;
+    m_encoder->sample_rate = m_decoder->sample_rate > 0 ? m_decoder->sample_rate : 8000;
+    av_channel_layout_default(&m_encoder->ch_layout, channels);
+    m_encoder->bit_rate = 64000 * channels;
+    m_encoder->time_base = AVRational{1, m_encoder->sample_rate};
+    if (globalHeader) m_encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    int ret = avcodec_open2(m_encoder, encoder, nullptr);
+    if (ret < 0) {
+        *error = "AAC 編碼器開啟失敗: " + avErrorString(ret);
+        return false;
+    }
+
+    AVChannelLayout inputLayout = {};
+    if (m_decoder->ch_layout.order != AV_CHANNEL_ORDER_UNSPEC)
+        av_channel_layout_copy(&inputLayout, &m_decoder->ch_layout);
+    else
+        av_channel_layout_default(&inputLayout, qMax(1, m_decoder->ch_layout.nb_channels));
+
+    ret = swr_alloc_set_opts2(&m_swr, &m_encoder->ch_layout, m_encoder->sample_fmt, m_encoder->sample_rate,
+                              &inputLayout, m_decoder->sample_fmt, m_decoder->sample_rate, 0, nullptr);
+    av_channel_layout_uninit(&inputLayout);
+    if (ret < 0 || swr_init(m_swr) < 0) {
+        *error = "音訊重取樣初始化失敗";
+        return false;
+    }
+
+    m_fifo = av_audio_fifo_alloc(m_encoder->sample_fmt, channels, qMax(m_encoder->frame_size, 1024) * 4);
+    return m_fifo != nullptr;
+}
+
+void TrackTranscoder::transcode(const AVPacket *packet, const PacketCallback &output) {
+    if (!m_encoder) return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (avcodec_send_packet(m_decoder, packet) == 0) {
+        while (avcodec_receive_frame(m_decoder, m_decoded) == 0) {
+            if (m_type == AVMEDIA_TYPE_VIDEO) encodeVideo(m_decoded, output);
+            else encodeAudio(m_decoded, output);
+            av_frame_unref(m_decoded);
+        }
+    }
+
+    m_busyNs += timer.nsecsElapsed();
+}
+
+void TrackTranscoder::flush(const PacketCallback &output) {
+    if (!m_encoder) return;
+    sendFrame(nullptr, output);
+}
+
+void TrackTranscoder::encodeVideo(AVFrame *decoded, const PacketCallback &output) {
+    int64_t pts = decoded->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE) pts = decoded->pts;
+    if (pts == AV_NOPTS_VALUE) return;
+    if (m_videoStartPts != AV_NOPTS_VALUE && pts < m_videoStartPts) return;
+    // 編碼器要求時間戳嚴格遞增
+    if (m_lastVideoPts != AV_NOPTS_VALUE && pts <= m_lastVideoPts) pts = m_lastVideoPts + 1;
+    m_lastVideoPts = pts;
+
+    AVFrame *frame = decoded;
+    if (decoded->format != AV_PIX_FMT_YUV420P
+        || decoded->width != m_encoder->width || decoded->height != m_encoder->height) {
+        m_sws = sws_getCachedContext(m_sws, decoded->width, decoded->height, AVPixelFormat(decoded->format),
+                                     m_encoder->width, m_encoder->height, AV_PIX_FMT_YUV420P,
+                                     SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!m_sws || av_frame_make_writable(m_converted) < 0) return;
+        sws_scale(m_sws, decoded->data, decoded->linesize, 0, decoded->height,
+                  m_converted->data, m_converted->linesize);
+        frame = m_converted;
+    }
+
+    frame->pts = pts;
+    frame->pict_type = AV_PICTURE_TYPE_NONE;
+    sendFrame(frame, output);
+}
+
+void TrackTranscoder::encodeAudio(AVFrame *decoded, const PacketCallback &output) {
+    const int sampleRate = m_encoder->sample_rate;
+    if (m_nextAudioPts == AV_NOPTS_VALUE) {
+        int64_t pts = decoded->best_effort_timestamp;
+        if (pts == AV_NOPTS_VALUE) return;
+        m_nextAudioPts = av_rescale_q(pts, m_inputTimeBase, AVRational{1, sampleRate});
+    }
+
+    int outSamples = swr_get_out_samples(m_swr, decoded->nb_samples);
+    if (outSamples <= 0) return;
+
+    AVFrame *converted = av_frame_alloc();
+    converted->format = m_encoder->sample_fmt;
+    converted->sample_rate = sampleRate;
+    converted->nb_samples = outSamples;
+    av_channel_layout_copy(&converted->ch_layout, &m_encoder->ch_layout);
+    if (av_frame_get_buffer(converted, 0) == 0) {
+        int samples = swr_convert(m_swr, converted->data, outSamples,
+                                  decoded->extended_data, decoded->nb_samples);
+        if (samples > 0)
+            av_audio_fifo_write(m_fifo, reinterpret_cast<void **>(converted->data), samples);
+    }
+    av_frame_free(&converted);
+
+    // AAC 每次固定吃 frame_size 個樣本
+    const int frameSize = m_encoder->frame_size > 0 ? m_encoder->frame_size : 1024;
+    while (av_audio_fifo_size(m_fifo) >= frameSize) {
+        AVFrame *frame = av_frame_alloc();
+        frame->format = m_encoder->sample_fmt;
+        frame->sample_rate = sampleRate;
+        frame->nb_samples = frameSize;
+        av_channel_layout_copy(&frame->ch_layout, &m_encoder->ch_layout);
+        if (av_frame_get_buffer(frame, 0) == 0) {
+            av_audio_fifo_read(m_fifo, reinterpret_cast<void **>(frame->data), frameSize);
+            frame->pts = m_nextAudioPts;
+            m_nextAudioPts += frameSize;
+            sendFrame(frame, output);
+        }
+        av_frame_free(&frame);
+    }
+}
+
+void TrackTranscoder::sendFrame(AVFrame *frame, const PacketCallback &output) {
+    if (avcodec_send_frame(m_encoder, frame) < 0) return;
+    while (avcodec_receive_packet(m_encoder, m_encoded) == 0) {
+        output(m_encoded);
+        av_packet_unref(m_encoded);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef TRACKTRANSCODER_H
+#define TRACKTRANSCODER_H
+
+#include <QString>
+#include <functional>
+#include <atomic>
+
+#include "ffmpegutils.h"
+
+struct SwsContext;
+struct SwrContext;
+struct AVAudioFifo;
+
+// 單一軌道轉碼：解碼 → 轉格式 → 編碼（影像 H.264、音訊 AAC）
+// 只有容器放不下來源編碼時才使用；同一個轉碼器的呼叫必須依序，錄影時放在 TranscodeStrand 上跑
+class TrackTranscoder {
+public:
+    using PacketCallback = std::function<void(const AVPacket *packet)>;
+
+    TrackTranscoder();
+    ~TrackTranscoder();
+
+    // globalHeader 依輸出容器決定（MP4 需要，MPEG-TS 不需要）
+    bool open(const IngestTrack &track, bool globalHeader, QString *error);
+
+    // 輸出軌道參數與時間基準，輸出封包的時間戳以此為準
+    const AVCodecParameters *outputParameters() const { return m_outputPar; }
+    AVRational outputTimeBase() const;
+
+    // 早於這個時間（輸入時間基準）的畫面只解碼不編碼，剪輯時用來從 GOP 中間開始
+    void setVideoStartPts(int64_t pts) { m_videoStartPts = pts; }
+
+    void transcode(const AVPacket *packet, const PacketCallback &output);
+    void flush(const PacketCallback &output);
+
+    // 累計花在轉碼上的時間，供介面顯示 CPU 負擔；轉碼在工作執行緒上跑，任何執行緒皆可讀
+    qint64 busyNanoseconds() const { return m_busyNs; }
+
+private:
+    bool openVideoEncoder(const IngestTrack &track, bool globalHeader, QString *error);
+    bool openAudioEncoder(bool globalHeader, QString *error);
+    void encodeVideo(AVFrame *decoded, const PacketCallback &output);
+    void encodeAudio(AVFrame *decoded, const PacketCallback &output);
+    void sendFrame(AVFrame *frame, const PacketCallback &output);
+
+    AVMediaType m_type = AVMEDIA_TYPE_UNKNOWN;
+    AVRational m_inputTimeBase{0, 1};
+    AVCodecContext *m_decoder = nullptr;
+    AVCodecContext *m_encoder = nullptr;
+    AVCodecParameters *m_outputPar = nullptr;
+    AVFrame *m_decoded = nullptr;
+    AVFrame *m_converted = nullptr;
+    AVPacket *m_encoded = nullptr;
+
+    SwsContext *m_sws = nullptr;
+    int64_t m_lastVideoPts = AV_NOPTS_VALUE;
+    int64_t m_videoStartPts = AV_NOPTS_VALUE;
+
+    SwrContext *m_swr = nullptr;
+    AVAudioFifo *m_fifo = nullptr;
+    int64_t m_nextAudioPts = AV_NOPTS_VALUE;
+
+    std::atomic<qint64> m_busyNs{0};
+    bool m_countedStream = false;   // 已登記到 TranscodePool 的轉碼路數
+};
+
+#endif // TRACKTRANSCODER_H
@@ -0,0 +1,139 @@
+#include "transcodepool.h"
+#include <QMutexLocker>
+
+// 一個 strand 連續跑幾個工作後讓出，其他攝影機才不會一直等
+static const int kBatchSize = 4;
+// 睡眠上限：萬一漏掉喚醒也不會卡住
+static const unsigned long kIdleWaitMs = 100;
+
+// 目前執行緒在池裡的編號，-1 表示不是工作執行緒
+static thread_local int t_workerIndex = -1;
+
+TranscodePool &TranscodePool::global() {
+    static TranscodePool pool;
+    return pool;
+}
+
+TranscodePool::TranscodePool(int workers) {
+    const int count = qMax(1, workers);
+    for (int i = 0; i < count; ++i) m_workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < count; ++i) {
+        m_workers[i]->thread = QThread::create([this, i]() { run(i); });
+        m_workers[i]->thread->start();
+    }
+}
+
+TranscodePool::~TranscodePool() {
+    m_stopping = true;
+    {
+        QMutexLocker locker(&m_idleMutex);
+        m_workAvailable.wakeAll();
+    }
+    for (const std::unique_ptr<Worker> &worker : m_workers) {
+        worker->thread->wait();
+        delete worker->thread;
+    }
+}
+
+int TranscodePool::threadsPerStream() const {
+    return qMax(1, workerCount() / qMax(1, m_streams.load()));
+}
+
+void TranscodePool::schedule(std::shared_ptr<TranscodeStrandState> strand) {
+    // 工作執行緒自己送的（strand 還沒跑完）放回自己的佇列，其餘輪流分配
+    const int index = t_workerIndex >= 0 ? t_workerIndex : int(m_nextWorker++ % m_workers.size());
+    Worker &worker = *m_workers[index];
+    {
+        QMutexLocker locker(&worker.mutex);
+        worker.strands.push_back(std::move(strand));
+    }
+    ++m_queued;
+
+    QMutexLocker locker(&m_idleMutex);
+    m_workAvailable.wakeOne();
+}
+
+std::shared_ptr<TranscodeStrandState> TranscodePool::take(int index) {
+    // 先照順序跑自己的，沒有就從其他執行緒佇列尾端偷
+    const int count = int(m_workers.size());
+    for (int k = 0; k < count; ++k) {
+        Worker &worker = *m_workers[(index + k) % count];
+        QMutexLocker locker(&worker.mutex);
+        if (worker.strands.empty()) continue;
+        std::shared_ptr<TranscodeStrandState> strand;
+        if (k == 0) {
+            strand = std::move(worker.strands.front());
+            worker.strands.pop_front();
+        } else {
+            strand = std::move(worker.strands.back());
+            worker.strands.pop_back();
+        }
+        --m_queued;
+        return strand;
+    }
+    return nullptr;
+}
+
+void TranscodePool::run(int index) {
+    t_workerIndex = index;
+    while (!m_stopping) {
+        // 跑的期間手上持有一份狀態，擁有者刪掉 strand 也要等這裡放開才釋放
+        if (std::shared_ptr<TranscodeStrandState> strand = take(index)) {
+            if (strand->runBatch()) schedule(std::move(strand));
+            continue;
+        }
+        QMutexLocker locker(&m_idleMutex);
+        if (m_queued == 0 && !m_stopping) m_workAvailable.wait(&m_idleMutex, kIdleWaitMs);
+    }
+}
+
+TranscodeStrand::TranscodeStrand(TranscodePool *pool) : m_pool(pool) {
+}
+
+TranscodeStrand::~TranscodeStrand() {
+    // 工作裡可能用到擁有者的成員，一定要等跑完
+    QMutexLocker locker(&m_state->mutex);
+    while (m_state->scheduled) m_state->progress.wait(&m_state->mutex);
+}
+
+void TranscodeStrand::post(std::function<void()> job) {
+    {
+        QMutexLocker locker(&m_state->mutex);
+        m_state->jobs.push_back(std::move(job));
+        if (m_state->scheduled) return;
+        m_state->scheduled = true;
+    }
+    m_pool->schedule(m_state);
+}
+
+void TranscodeStrand::waitBelow(int count) {
+    TranscodeStrandState &state = *m_state;
+    QMutexLocker locker(&state.mutex);
+    while (int(state.jobs.size()) + (state.running ? 1 : 0) >= count) state.progress.wait(&state.mutex);
+}
+
+bool TranscodeStrandState::runBatch() {
+    for (int i = 0; i < kBatchSize; ++i) {
+        std::function<void()> job;
+        {
+            QMutexLocker locker(&mutex);
+            if (jobs.empty()) break;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running = true;
+        }
+        job();
+        // 工作捕捉的東西在這裡就放掉，不留到擁有者被叫醒之後
+        job = nullptr;
+        QMutexLocker locker(&mutex);
+        running = false;
+        progress.wakeAll();
+    }
+
+    QMutexLocker locker(&mutex);
+    if (!jobs.empty()) return true;
+    // 擁有者被叫醒後可能馬上刪除 strand；這份狀態由呼叫端持有，放開鎖時仍然有效
+    scheduled = false;
+    progress.wakeAll();
+    return false;
+}
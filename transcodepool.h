@@ -0,0 +1,89 @@
+#ifndef TRANSCODEPOOL_H
+#define TRANSCODEPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class TranscodeStrand;
+
+// 一條 strand 的工作佇列與狀態，由 TranscodeStrand 與正在跑它的工作執行緒共同持有
+// 最後一批跑完、叫醒等待的擁有者之後工作執行緒還要放開鎖；strand 這時被刪也不會懸空
+struct TranscodeStrandState {
+    QMutex mutex;
+    QWaitCondition progress;
+    std::deque<std::function<void()>> jobs;
+    bool running = false;
+    bool scheduled = false;     // 已在某個執行緒的佇列裡或正在跑
+
+    // 由工作執行緒呼叫，跑完一批後還有工作就回傳 true
+    bool runBatch();
+};
+
+// 所有攝影機共用的轉碼工作執行緒，數量等於核心數
+// 工作以 TranscodeStrand 為單位排程：每個執行緒有自己的佇列，閒下來就去別的執行緒佇列尾端偷
+// 每路編碼器的內部執行緒數由 threadsPerStream() 決定，總執行緒數不會隨攝影機數增加
+class TranscodePool {
+public:
+    static TranscodePool &global();
+
+    explicit TranscodePool(int workers = QThread::idealThreadCount());
+    ~TranscodePool();
+
+    int workerCount() const { return int(m_workers.size()); }
+
+    // 同時在轉碼的影像路數，由 TrackTranscoder 開關時登記
+    void addStream() { ++m_streams; }
+    void removeStream() { --m_streams; }
+    int activeStreams() const { return m_streams; }
+    // 核心平均分給同時在轉碼的路數，至少 1
+    int threadsPerStream() const;
+
+private:
+    friend class TranscodeStrand;
+
+    struct Worker {
+        QMutex mutex;
+        std::deque<std::shared_ptr<TranscodeStrandState>> strands;
+        QThread *thread = nullptr;
+    };
+
+    void schedule(std::shared_ptr<TranscodeStrandState> strand);
+    std::shared_ptr<TranscodeStrandState> take(int index);
+    void run(int index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    QMutex m_idleMutex;
+    QWaitCondition m_workAvailable;
+    std::atomic_int m_queued{0};            // 所有佇列裡等著跑的 strand 數
+    std::atomic_uint m_nextWorker{0};       // 外部送進來的工作輪流分給各執行緒
+    std::atomic_int m_streams{0};
+    std::atomic_bool m_stopping{false};
+};
+
+// 一串必須依序執行的工作（同一路的解碼器、編碼器不能同時被兩條執行緒使用）
+// 同一時間只會在一個工作執行緒上跑；送工作不會阻塞，要限制排隊長度時用 waitBelow
+class TranscodeStrand {
+public:
+    explicit TranscodeStrand(TranscodePool *pool = &TranscodePool::global());
+    ~TranscodeStrand();
+
+    TranscodeStrand(const TranscodeStrand &) = delete;
+    TranscodeStrand &operator=(const TranscodeStrand &) = delete;
+
+    void post(std::function<void()> job);
+    // 排隊中加上執行中的工作少於 count 才回來
+    void waitBelow(int count);
+    void waitIdle() { waitBelow(1); }
+
+private:
+    TranscodePool *m_pool;
+    std::shared_ptr<TranscodeStrandState> m_state = std::make_shared<TranscodeStrandState>();
+};
+
+#endif // TRANSCODEPOOL_H
@@ -0,0 +1,135 @@
+#include "videoframeconverter.h"
+#include "avframevideobuffer.h"
+#include <cstring>
+#include <memory>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+// 視窗拖曳縮放時尺寸一直變，只保留最近幾種尺寸的緩衝池
+static const int kMaxPools = 4;
+// 平面對齊，讓 sws 與上傳材質都走快速路徑
+static const int kPlaneAlign = 32;
+
+// 不必轉換就能交給 QVideoSink 的格式
+static QVideoFrameFormat::PixelFormat directFormat(int avFormat) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    return AVFrameVideoBuffer::pixelFormatFor(avFormat);
+#else
+    return avFormat == AV_PIX_FMT_YUV420P || avFormat == AV_PIX_FMT_YUVJ420P ? QVideoFrameFormat::Format_YUV420P
+                                                                             : QVideoFrameFormat::Format_Invalid;
+#endif
+}
+
+VideoFrameConverter::VideoFrameConverter() {
+}
+
+VideoFrameConverter::~VideoFrameConverter() {
+    reset();
+}
+
+void VideoFrameConverter::reset() {
+    sws_freeContext(m_sws);
+    m_sws = nullptr;
+    // 還在顯示中的畫面放掉後，緩衝池才真正釋放
+    for (AVBufferPool *pool : std::as_const(m_pools)) av_buffer_pool_uninit(&pool);
+    m_pools.clear();
+}
+
+QVideoFrame VideoFrameConverter::convert(const AVFrame *src, const QSize &maxSize) {
+    // 顯示區比畫面小時直接縮到顯示大小，後續上傳與顯示都省下來
+    QSize outSize(src->width, src->height);
+    if (maxSize.isValid() && !maxSize.isEmpty()
+        && (src->width > maxSize.width() || src->height > maxSize.height())) {
+        outSize = outSize.scaled(maxSize, Qt::KeepAspectRatio);
+        outSize = QSize(qMax(2, outSize.width() & ~1), qMax(2, outSize.height() & ~1));
+    }
+    const bool fullRange = src->format == AV_PIX_FMT_YUVJ420P || src->format == AV_PIX_FMT_YUVJ422P
+                           || src->color_range == AVCOL_RANGE_JPEG;
+
+    const QVideoFrameFormat::PixelFormat direct = directFormat(src->format);
+    if (direct != QVideoFrameFormat::Format_Invalid && outSize == QSize(src->width, src->height)
+        && src->linesize[0] > 0) {
+        // 只增加解碼器緩衝的參考計數
+        AVFrame *frame = av_frame_alloc();
+        if (!frame || av_frame_ref(frame, src) < 0) {
+            av_frame_free(&frame);
+            return QVideoFrame();
+        }
+        return wrap(frame, direct, fullRange);
+    }
+
+    AVFrame *scaled = scale(src, outSize);
+    if (!scaled) return QVideoFrame();
+    return wrap(scaled, QVideoFrameFormat::Format_YUV420P, fullRange);
+}
+
+AVFrame *VideoFrameConverter::scale(const AVFrame *src, const QSize &outSize) {
+    m_sws = sws_getCachedContext(m_sws, src->width, src->height, AVPixelFormat(src->format),
+                                 outSize.width(), outSize.height(), AV_PIX_FMT_YUV420P,
+                                 SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_sws) return nullptr;
+
+    const int bytes = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, outSize.width(), outSize.height(), kPlaneAlign);
+    AVBufferPool *pool = bytes > 0 ? poolFor(outSize, bytes) : nullptr;
+    if (!pool) return nullptr;
+
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) return nullptr;
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = outSize.width();
+    frame->height = outSize.height();
+    frame->buf[0] = av_buffer_pool_get(pool);
+    if (!frame->buf[0]
+        || av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data, AV_PIX_FMT_YUV420P,
+                                frame->width, frame->height, kPlaneAlign) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+
+    sws_scale(m_sws, src->data, src->linesize, 0, src->height, frame->data, frame->linesize);
+    return frame;
+}
+
+AVBufferPool *VideoFrameConverter::poolFor(const QSize &size, int bytes) {
+    const quint64 key = (quint64(size.width()) << 32) | quint64(size.height());
+    if (AVBufferPool *pool = m_pools.value(key)) return pool;
+
+    if (m_pools.size() >= kMaxPools) {
+        for (AVBufferPool *pool : std::as_const(m_pools)) av_buffer_pool_uninit(&pool);
+        m_pools.clear();
+    }
+    AVBufferPool *pool = av_buffer_pool_init(bytes, nullptr);
+    if (pool) m_pools.insert(key, pool);
+    return pool;
+}
+
+QVideoFrame VideoFrameConverter::wrap(AVFrame *frame, QVideoFrameFormat::PixelFormat pixelFormat, bool fullRange) {
+    QVideoFrameFormat format(QSize(frame->width, frame->height), pixelFormat);
+    if (fullRange) format.setColorRange(QVideoFrameFormat::ColorRange_Full);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    return QVideoFrame(std::make_unique<AVFrameVideoBuffer>(frame, format));
+#else
+    // 舊版 Qt 沒有公開的自訂緩衝，只能複製一次
+    QVideoFrame video(format);
+    if (video.map(QVideoFrame::WriteOnly)) {
+        for (int plane = 0; plane < 3; ++plane) {
+            const int width = plane == 0 ? frame->width : (frame->width + 1) / 2;
+            const int height = plane == 0 ? frame->height : (frame->height + 1) / 2;
+            uchar *dst = video.bits(plane);
+            const int dstStride = video.bytesPerLine(plane);
+            for (int row = 0; row < height; ++row)
+                std::memcpy(dst + row * dstStride, frame->data[plane] + row * frame->linesize[plane], width);
+        }
+        video.unmap();
+    } else {
+        video = QVideoFrame();
+    }
+    av_frame_free(&frame);
+    return video;
+#endif
+}
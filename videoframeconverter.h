@@ -0,0 +1,38 @@
+#ifndef VIDEOFRAMECONVERTER_H
+#define VIDEOFRAMECONVERTER_H
+
+#include <QVideoFrame>
+#include <QSize>
+#include <QHash>
+
+#include "ffmpegutils.h"
+
+struct SwsContext;
+struct AVBufferPool;
+
+// AVFrame 轉成 QVideoFrame，需要時順便縮小
+// 不必縮放且顯示端吃得下的 YUV 格式直接包住解碼器的緩衝，不複製也不轉 RGB（Qt 6.8 起）
+// 要縮放或轉格式時寫進依尺寸重複使用的緩衝池，穩定播放時每張畫面不再配置像素緩衝
+// 不是執行緒安全，每個解碼端各用一個
+class VideoFrameConverter {
+public:
+    VideoFrameConverter();
+    ~VideoFrameConverter();
+    VideoFrameConverter(const VideoFrameConverter &) = delete;
+    VideoFrameConverter &operator=(const VideoFrameConverter &) = delete;
+
+    // maxSize 無效時保持原尺寸；失敗回傳無效的 QVideoFrame
+    QVideoFrame convert(const AVFrame *frame, const QSize &maxSize = QSize());
+    void reset();
+
+private:
+    AVFrame *scale(const AVFrame *src, const QSize &outSize);
+    AVBufferPool *poolFor(const QSize &size, int bytes);
+    // 接管 frame
+    static QVideoFrame wrap(AVFrame *frame, QVideoFrameFormat::PixelFormat pixelFormat, bool fullRange);
+
+    SwsContext *m_sws = nullptr;
+    QHash<quint64, AVBufferPool *> m_pools;     // 依輸出尺寸
+};
+
+#endif // VIDEOFRAMECONVERTER_H